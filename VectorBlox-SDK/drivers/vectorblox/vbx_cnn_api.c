@@ -1,4 +1,9 @@
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_completion.h"
+#include "vbx_cnn_reset.h"
+#include "vbx_cnn_queue.h"
+#include "vbx_cnn_ctx.h"
+#include "vbx_cnn_trace.h"
 
 #define debug(a) printf("%s:%d %s=%d\n",__FILE__,__LINE__,#a,(int)(uintptr_t)(a))
 #define debugl(a) printf("%s:%d %s=%lld\n",__FILE__,__LINE__,#a,(intptr_t)(a))
@@ -15,10 +20,21 @@
 #include <stdio.h>
 #define read_register(a,offset)  read_fpga_word((uintptr_t)(a+offset))
 #define write_register(a,offset,val)  write_fpga_word((uintptr_t)(a+offset),val)
+#elif VBX_CNN_REG_MODEL
+#include "vbx_cnn_reg_model.h"
+#include <poll.h>
+#include <errno.h>
+#define read_register(a,offset)  vbx_cnn_reg_model_read((a),(offset))
+#define write_register(a,offset,val)  vbx_cnn_reg_model_write((a),(offset),(val))
 #else
 #define read_register(a,offset)  (a)[(offset)]
 #define write_register(a,offset,val)  ((a)[(offset)]=(val))
 
+#endif
+#include <string.h>
+#if VBX_CNN_CONTEXTS
+#include <sched.h>
+#include <time.h>
 #endif
 static const int CTRL_OFFSET = 0;
 static const int ERR_OFFSET = 1;
@@ -63,6 +79,8 @@ static const int CTRL_REG_ERROR = 0x00000010;
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <poll.h>
+#include <errno.h>
 
 
 static uint64_t u64_from_attribute(const char* filename){
@@ -74,46 +92,52 @@ static uint64_t u64_from_attribute(const char* filename){
   return ret;
 }
 
+//1 if /sys/class/uio/uio<n> is a vbx core, setting *addr to its control
+//registers' physical address, 0 if it is some other device, -1 if there is
+//no uio<n>
+static int uio_vbx_addr(int n,uintptr_t* addr){
+  char buf[4096];
+  char expected_name[]="vbx";
+  snprintf(buf,4096,"/sys/class/uio/uio%d/name",n);
+  int name_fd = open(buf,O_RDONLY);
+  if (name_fd<0){
+    return -1;
+  }
+  read(name_fd,buf,4096);
+  close(name_fd);
+  if(strncmp(expected_name,buf,strlen(expected_name))!=0){
+    return 0;
+  }
+  snprintf(buf,4096,"/sys/class/uio/uio%d/maps/map0/addr",n);
+  *addr = u64_from_attribute(buf);
+  return 1;
+}
+
 //find vbx uio in /sys/class/uio
 //if ctrl_reg_addr is non-null then /sys/class/uio/uio%d/maps/map0/addr must match
 static int find_uio_dev_num(void *ctrl_reg_addr){
-  char buf[4096];
-  char expected_name[]="vbx";
-  for(int n=0;;n++){
-    snprintf(buf,4096,"/sys/class/uio/uio%d/name",n);
-    int name_fd = open(buf,O_RDONLY);
-    if (name_fd>=0){
-      read(name_fd,buf,4096);
-      close(name_fd);
-      if(strncmp(expected_name,buf,strlen(expected_name))==0){
-
-        //name matches,
-        //if ctrl_reg_addr is not NULL, make sure that matches as well.
-        snprintf(buf,4096,"/sys/class/uio/uio%d/maps/map0/addr",n);
-        uintptr_t addr =  u64_from_attribute(buf);
-        if(ctrl_reg_addr && (uintptr_t)ctrl_reg_addr != addr){
-          //name matched but address didn't, skip this device.
-          continue;
-        }
-        return n;
-      }
-    }else{
-      break;
+  uintptr_t addr;
+  int found;
+  for(int n=0;(found = uio_vbx_addr(n,&addr)) >= 0;n++){
+    //name matches,
+    //if ctrl_reg_addr is not NULL, make sure that matches as well.
+    if(found && (!ctrl_reg_addr || (uintptr_t)ctrl_reg_addr == addr)){
+      return n;
     }
   }
   return -1;
 }
-static void* uio_mmap(int fd, int dev_num,int map_num){
+static void* uio_mmap(int fd, int dev_num,int map_num,size_t* mapped){
   char filename[64];
   snprintf(filename,sizeof(filename),"/sys/class/uio/uio%d/maps/map%d/size",dev_num,map_num);
   int64_t size=u64_from_attribute(filename);
   void* _ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
                 fd, map_num * sysconf(_SC_PAGESIZE));
-  
-  return _ptr;
+  *mapped = _ptr == MAP_FAILED ? 0 : size;
+  return _ptr == MAP_FAILED ? NULL : _ptr;
 }
-static void* mmap_vbx_registers(int fd, int dev_num){
-  return uio_mmap(fd, dev_num,0);
+static void* mmap_vbx_registers(int fd, int dev_num,size_t* mapped){
+  return uio_mmap(fd, dev_num,0,mapped);
 
 }
 #if MSS_DDR
@@ -130,8 +154,9 @@ static void* mmap_vbx_dma(){
   int fd = open("/dev/"DMA_DEV, O_RDWR);
 
   size_t size = uio_dma_size();
+  //not cleared here: through the uncached mapping that took longer than
+  //the rest of startup, buffers that need it are zeroed as they are allocated
   void* _ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  memset(_ptr,0,size);
   close(fd);
 
   return _ptr;
@@ -169,27 +194,97 @@ void* virt_to_phys(vbx_cnn_t* vbx_cnn,void* virt){
 }
 #endif //!VBX_SOC_DRIVER
 
-vbx_cnn_t *vbx_cnn_init(void *ctrl_reg_addr) {
-  vbx_cnn_t* the_cnn = (vbx_cnn_t*)malloc(sizeof(vbx_cnn_t));
+int vbx_cnn_enumerate(uintptr_t ctrl_reg_addrs[],int max_cores){
+  int count = 0;
+#if VBX_SOC_DRIVER
+  uintptr_t addr;
+  int found;
+  for(int n=0;count < max_cores && (found = uio_vbx_addr(n,&addr)) >= 0;n++){
+    if(found){
+      ctrl_reg_addrs[count++] = addr;
+    }
+  }
+#endif
+  return count;
+}
+
+#if VBX_CNN_CONTEXTS
+static uint64_t now_us(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+#endif
+
+vbx_cnn_t *vbx_cnn_init_shared(void *ctrl_reg_addr, vbx_cnn_t *dma_owner) {
+  vbx_cnn_t* the_cnn = (vbx_cnn_t*)calloc(1,sizeof(vbx_cnn_t));
+  if(!the_cnn){
+    return NULL;
+  }
+#if VBX_CNN_CONTEXTS
+  uint64_t init_start = now_us();
+  pthread_mutex_init(&the_cnn->submit_lock,NULL);
+  pthread_mutex_init(&the_cnn->dma_lock,NULL);
+  the_cnn->jobs_started = 0;
+  the_cnn->jobs_done = 0;
+  the_cnn->failed_begin = 0;
+  the_cnn->failed_end = 0;
+  the_cnn->failed_status = 0;
+#endif
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+  if(dma_owner){
+    //every core on the fabric sees the same DDR, so they share one window
+    //and one arena, and a model loaded for one can run on any of them
+    the_cnn->dma_owner = dma_owner->dma_owner;
+    the_cnn->dma_buffer = dma_owner->dma_buffer;
+    the_cnn->dma_phys_trans_offset = dma_owner->dma_phys_trans_offset;
+    the_cnn->dma_buffer_end = dma_owner->dma_buffer_end;
+    the_cnn->dma_arena = dma_owner->dma_arena;
+  }else{
+    the_cnn->dma_owner = the_cnn;
+  }
+#endif
 #if VBX_SOC_DRIVER
   int uio_dev_num = find_uio_dev_num(ctrl_reg_addr);
 
   char filename[64];
   snprintf(filename,sizeof(filename),"/dev/uio%d",uio_dev_num);
-  the_cnn->fd = open(filename, O_RDWR);
+  the_cnn->fd = uio_dev_num < 0 ? -1 : open(filename, O_RDWR);
+  if(the_cnn->fd < 0){
+    //left uninitialized, vbx_cnn_free() takes it back
+    return the_cnn;
+  }
 
-  ctrl_reg_addr = (void*)mmap_vbx_registers(the_cnn->fd, uio_dev_num);
-  the_cnn->dma_buffer=mmap_vbx_dma(uio_dev_num);
-  the_cnn->dma_phys_trans_offset = uio_dma_phys_addr(uio_dev_num)-(uintptr_t)the_cnn->dma_buffer;
-  the_cnn->dma_buffer_end = the_cnn->dma_buffer + uio_dma_size(uio_dev_num)-1;
+  ctrl_reg_addr = (void*)mmap_vbx_registers(the_cnn->fd, uio_dev_num,&the_cnn->ctrl_reg_size);
+  if(!ctrl_reg_addr){
+    return the_cnn;
+  }
+  the_cnn->ctrl_reg = ctrl_reg_addr;
+  if(!dma_owner){
+    the_cnn->dma_buffer=mmap_vbx_dma(uio_dev_num);
+    if(the_cnn->dma_buffer == MAP_FAILED){
+      the_cnn->dma_buffer = NULL;
+      return the_cnn;
+    }
+    the_cnn->dma_phys_trans_offset = uio_dma_phys_addr(uio_dev_num)-(uintptr_t)the_cnn->dma_buffer;
+    the_cnn->dma_buffer_end = the_cnn->dma_buffer + uio_dma_size(uio_dev_num)-1;
+    the_cnn->dma_arena = vbx_dma_arena_init(the_cnn->dma_buffer,uio_dma_size(uio_dev_num),
+                                            uio_dma_phys_addr(uio_dev_num),1024);
+  }
   the_cnn->io_buffers = vbx_allocate_dma_buffer(the_cnn,MAX_IO_BUFFERS*sizeof(vbx_cnn_io_ptr_t), 3);
+  if(!the_cnn->io_buffers){
+    return the_cnn;
+  }
 #elif SPLASHKIT_PCIE
-  fpga_init();
-  void* FPGA_DDR_ADDR=(void*)0x40000000;
-  const size_t FPGA_DDR_SIZE=1<<30;//1G
-  the_cnn->dma_buffer=FPGA_DDR_ADDR;
-  the_cnn->dma_phys_trans_offset = 0;
-  the_cnn->dma_buffer_end = the_cnn->dma_buffer + FPGA_DDR_SIZE-1;
+  if(!dma_owner){
+    fpga_init();
+    void* FPGA_DDR_ADDR=(void*)0x40000000;
+    const size_t FPGA_DDR_SIZE=1<<30;//1G
+    the_cnn->dma_buffer=FPGA_DDR_ADDR;
+    the_cnn->dma_phys_trans_offset = 0;
+    the_cnn->dma_buffer_end = the_cnn->dma_buffer + FPGA_DDR_SIZE-1;
+    the_cnn->dma_arena = vbx_dma_arena_init(the_cnn->dma_buffer,FPGA_DDR_SIZE,(uintptr_t)FPGA_DDR_ADDR,1024);
+  }
   the_cnn->io_buffers = vbx_allocate_dma_buffer(the_cnn, MAX_IO_BUFFERS * sizeof(vbx_cnn_io_ptr_t), 3);
 #else
   the_cnn->dma_phys_trans_offset = 0;
@@ -202,33 +297,92 @@ vbx_cnn_t *vbx_cnn_init(void *ctrl_reg_addr) {
   the_cnn->initialized = 1;
   the_cnn->output_valid = 0;
   the_cnn->debug_print_ptr=0;
+#if VBX_CNN_CONTEXTS
+  the_cnn->init_us = now_us() - init_start;
+#else
+  the_cnn->init_us = 0;
+#endif
+  the_cnn->resets = 0;
   return the_cnn;
 }
 
+vbx_cnn_t *vbx_cnn_init(void *ctrl_reg_addr) {
+  return vbx_cnn_init_shared(ctrl_reg_addr,NULL);
+}
 
+void vbx_cnn_free(vbx_cnn_t* vbx_cnn){
+  if(!vbx_cnn){
+    return;
+  }
 #if VBX_SOC_DRIVER || SPLASHKIT_PCIE
-void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t phys_alignment_bits){
-  size_t request_size_aligned = (request_size+1023) & (~1023);
-  int alignment = 1<<phys_alignment_bits;
-  uintptr_t cur_phys = (uintptr_t)virt_to_phys(vbx_cnn,vbx_cnn->dma_buffer);
-  int incr = alignment - ((uintptr_t)(cur_phys) % alignment);
-  vbx_cnn->dma_buffer += (incr % alignment);
+  if(vbx_cnn->io_buffers){
+    vbx_free_dma_buffer(vbx_cnn,vbx_cnn->io_buffers);
+  }
+  if(vbx_cnn->dma_owner == vbx_cnn && vbx_cnn->dma_arena){
+    vbx_dma_arena_destroy(vbx_cnn->dma_arena);
+  }
+#endif
+#if VBX_SOC_DRIVER
+  if(vbx_cnn->dma_owner == vbx_cnn && vbx_cnn->dma_buffer){
+    munmap(vbx_cnn->dma_buffer,vbx_cnn->dma_buffer_end - vbx_cnn->dma_buffer + 1);
+  }
+  if(vbx_cnn->ctrl_reg_size){
+    munmap((void*)vbx_cnn->ctrl_reg,vbx_cnn->ctrl_reg_size);
+  }
+  if(vbx_cnn->fd >= 0){
+    close(vbx_cnn->fd);
+  }
+#endif
+#if VBX_CNN_CONTEXTS
+  pthread_mutex_destroy(&vbx_cnn->submit_lock);
+  pthread_mutex_destroy(&vbx_cnn->dma_lock);
+#endif
+  free(vbx_cnn);
+}
 
-  if (vbx_cnn->dma_buffer + request_size_aligned > vbx_cnn->dma_buffer_end){
+
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+void* vbx_allocate_dma_buffer_flags(vbx_cnn_t* vbx_cnn,size_t request_size,size_t phys_alignment_bits,int flags){
+  vbx_cnn = vbx_cnn->dma_owner;
+  if(!vbx_cnn->dma_arena){
     return NULL;
   }
-  void* ret = (void*)vbx_cnn->dma_buffer;
-  vbx_cnn->dma_buffer+= request_size_aligned;
-  return ret;
+  pthread_mutex_lock(&vbx_cnn->dma_lock);
+  void* ptr = vbx_dma_arena_alloc(vbx_cnn->dma_arena,request_size,phys_alignment_bits);
+  pthread_mutex_unlock(&vbx_cnn->dma_lock);
+  //clear outside the lock, nobody else can be handed this range
+  if(ptr && (flags & VBX_DMA_ZERO)){
+    memset(ptr,0,request_size);
+    __atomic_add_fetch(&vbx_cnn->dma_arena->zeroed,request_size,__ATOMIC_RELAXED);
+  }
+  return ptr;
+}
+void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t phys_alignment_bits){
+  return vbx_allocate_dma_buffer_flags(vbx_cnn,request_size,phys_alignment_bits,VBX_DMA_ZERO);
 }
+int vbx_free_dma_buffer(vbx_cnn_t* vbx_cnn,void* ptr){
+  vbx_cnn = vbx_cnn->dma_owner;
+  pthread_mutex_lock(&vbx_cnn->dma_lock);
+  int status = vbx_dma_arena_free(vbx_cnn->dma_arena,ptr);
+  pthread_mutex_unlock(&vbx_cnn->dma_lock);
+  return status;
+}
+//first byte past the highest buffer handed out so far
 void* vbx_get_dma_pointer(vbx_cnn_t* vbx_cnn){
-  return (void*)(vbx_cnn->dma_buffer);
+  return (void*)(vbx_cnn->dma_buffer + vbx_cnn->dma_arena->high_water);
 }
 #else
 extern void* ddr_uncached_allocate(size_t size);
 void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t phys_alignment_bits){
 	return ddr_uncached_allocate(request_size);
 }
+void* vbx_allocate_dma_buffer_flags(vbx_cnn_t* vbx_cnn,size_t request_size,size_t phys_alignment_bits,int flags){
+	void* ptr = ddr_uncached_allocate(request_size);
+	if(ptr && (flags & VBX_DMA_ZERO)){
+		memset(ptr,0,request_size);
+	}
+	return ptr;
+}
 #endif
 
 
@@ -237,8 +391,47 @@ vbx_cnn_err_e vbx_cnn_get_error_val(vbx_cnn_t *vbx_cnn) {
 }
 
 
+#if VBX_CNN_CONTEXTS
+#define lock_submit(vbx_cnn) pthread_mutex_lock(&(vbx_cnn)->submit_lock)
+#define unlock_submit(vbx_cnn) pthread_mutex_unlock(&(vbx_cnn)->submit_lock)
+#else
+#define lock_submit(vbx_cnn)
+#define unlock_submit(vbx_cnn)
+#endif
+
+//hand the core a model whose io table is already in place,
+//with submit_lock held and the start bit seen low
+static void start_registers(vbx_cnn_t *vbx_cnn, model_t *model, vbx_cnn_io_ptr_t *io_table) {
+  write_register(vbx_cnn->ctrl_reg,IO_OFFSET , (uint32_t)(uintptr_t)virt_to_phys(vbx_cnn,io_table));
+  write_register(vbx_cnn->ctrl_reg,MODEL_OFFSET , (uint32_t)(uintptr_t)virt_to_phys(vbx_cnn,model));
+#if VBX_CNN_REG_MODEL
+  // host pointers don't fit in 32 bits, fill in the upper words as well
+  write_register(vbx_cnn->ctrl_reg,IO_OFFSET+1 , (uint32_t)((uint64_t)(uintptr_t)io_table>>32));
+  write_register(vbx_cnn->ctrl_reg,MODEL_OFFSET+1 , (uint32_t)((uint64_t)(uintptr_t)model>>32));
+#endif
+
+  // Start should be written with 1, other bits should be written
+  // with zeros.
+  write_register(vbx_cnn->ctrl_reg,CTRL_OFFSET,CTRL_REG_START);
+#if VBX_CNN_CONTEXTS
+  vbx_cnn->jobs_started++;
+  vbx_cnn_trace_counter("vbx_cnn jobs on core",vbx_cnn->jobs_started - vbx_cnn->jobs_done);
+#else
+  vbx_cnn_trace_instant("model_start");
+#endif
+}
+
 int vbx_cnn_model_start(vbx_cnn_t *vbx_cnn, model_t *model,
                         vbx_cnn_io_ptr_t io_buffers[]) {
+  vbx_cnn_state_e state = vbx_cnn_get_state(vbx_cnn);
+  if (state == FULL || state == ERROR) {
+    return -1;
+  }
+  lock_submit(vbx_cnn);
+  // wait until start bit is low before starting next model.
+  // Until then the core may still be reading the io table of the model
+  // queued ahead of this one, so the table can't be rewritten either.
+  while (read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET) & CTRL_REG_START);
 #if VBX_SOC_DRIVER
   size_t num_io_buffers = (model_get_num_inputs(model)+
                         model_get_num_outputs(model));
@@ -255,20 +448,9 @@ int vbx_cnn_model_start(vbx_cnn_t *vbx_cnn, model_t *model,
     write_fpga((uintptr_t)vbx_cnn->io_buffers, io_buffers, num_io_buffers * sizeof(vbx_cnn_io_ptr_t));
     io_buffers = vbx_cnn->io_buffers;
 #endif
-  vbx_cnn_state_e state = vbx_cnn_get_state(vbx_cnn);
-  if (state != FULL && state != ERROR) {
-    // wait until start bit is low before starting next model
-    while (read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET) & CTRL_REG_START);
-    write_register(vbx_cnn->ctrl_reg,IO_OFFSET , (uint32_t)(uintptr_t)virt_to_phys(vbx_cnn,io_buffers));
-    write_register(vbx_cnn->ctrl_reg,MODEL_OFFSET , (uint32_t)(uintptr_t)virt_to_phys(vbx_cnn,model));
-
-    // Start should be written with 1, other bits should be written
-    // with zeros.
-    write_register(vbx_cnn->ctrl_reg,CTRL_OFFSET,CTRL_REG_START);
-    return 0;
-  } else {
-    return -1;
-  }
+  start_registers(vbx_cnn,model,io_buffers);
+  unlock_submit(vbx_cnn);
+  return 0;
 }
 
 
@@ -314,8 +496,9 @@ vbx_cnn_state_e vbx_cnn_get_state(vbx_cnn_t *vbx_cnn) {
 }
 
 
-int vbx_cnn_model_poll(vbx_cnn_t *vbx_cnn) {
+static int poll_registers(vbx_cnn_t *vbx_cnn, uint32_t *ctrl) {
   int status = read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET);
+  *ctrl = status;
   if (status & CTRL_REG_SOFT_RESET) {
        return -3;
   }
@@ -333,37 +516,78 @@ int vbx_cnn_model_poll(vbx_cnn_t *vbx_cnn) {
   return -2;
 }
 
+#if VBX_CNN_CONTEXTS
+//Count completions for the whole core, with submit_lock held.
+//OUTPUT_VALID can stand for more than one finished model, so rather than
+//count it, see how many models are still on the core: one running, one
+//waiting behind it with START high. The core runs them in order, so every
+//model handed over before those has finished.
+static int poll_and_count(vbx_cnn_t *vbx_cnn) {
+  uint32_t ctrl;
+  int status = poll_registers(vbx_cnn,&ctrl);
+  uint32_t in_flight = vbx_cnn->jobs_started - vbx_cnn->jobs_done;
+  if (status == -1 || status == -3) {
+    //nothing on the core or queued behind it will finish
+    if (in_flight) {
+      vbx_cnn->failed_begin = vbx_cnn->jobs_done;
+      vbx_cnn->failed_end = vbx_cnn->jobs_started;
+      vbx_cnn->failed_status = status;
+    }
+    vbx_cnn->jobs_done = vbx_cnn->jobs_started;
+    vbx_cnn_trace_counter("vbx_cnn jobs on core",0);
+    return status;
+  }
+  uint32_t on_core = !!(ctrl & CTRL_REG_START) + !!(ctrl & CTRL_REG_RUNNING);
+  if (on_core < in_flight) {
+    vbx_cnn->jobs_done = vbx_cnn->jobs_started - on_core;
+    vbx_cnn_trace_counter("vbx_cnn jobs on core",on_core);
+  }
+  return status;
+}
+#endif
+
+int vbx_cnn_model_poll(vbx_cnn_t *vbx_cnn) {
+#if VBX_CNN_CONTEXTS
+  lock_submit(vbx_cnn);
+  int status = poll_and_count(vbx_cnn);
+  unlock_submit(vbx_cnn);
+  return status;
+#else
+  uint32_t ctrl;
+  return poll_registers(vbx_cnn,&ctrl);
+#endif
+}
+
 
 int vbx_cnn_model_wfi(vbx_cnn_t *vbx_cnn) {
 #if VBX_SOC_DRIVER
-  uint32_t icount = 0U;
   uint32_t pending = 0;
   uint32_t reenable = 1;
+  vbx_cnn_trace_begin("wfi");
   ssize_t readSize = read(vbx_cnn->fd, &pending, sizeof(uint32_t));
+  vbx_cnn_trace_end("wfi");
   if(readSize < 0) {
     close(vbx_cnn->fd);
     return -1;
   }
 
-  while(icount < 1000) icount++;
-  icount = 0U;
-  
+  // the isr reads OUTPUT_VALID back until the clear has landed, so the
+  // interrupt can be unmasked straight after it
   vbx_cnn_model_isr(vbx_cnn);
 
-  while(icount < 1000) icount++;
-  icount = 0U;
-
   ssize_t writeSize = write(vbx_cnn->fd, &reenable, sizeof(uint32_t));
   if(writeSize < 0) {
     close(vbx_cnn->fd);
     return -1;
   }
 #else
+  vbx_cnn_trace_begin("wfi");
   while(1) {
 	if(vbx_cnn->output_valid) {
 		break;
 	}
   }
+  vbx_cnn_trace_end("wfi");
 #endif
   vbx_cnn->output_valid = 0;
   int status = vbx_cnn_model_poll(vbx_cnn);
@@ -371,6 +595,131 @@ int vbx_cnn_model_wfi(vbx_cnn_t *vbx_cnn) {
   return status;
 }
 
+int vbx_cnn_get_completion_fd(vbx_cnn_t* vbx_cnn) {
+#if VBX_SOC_DRIVER
+  return vbx_cnn->fd;
+#elif VBX_CNN_REG_MODEL
+  return vbx_cnn_reg_model_fd(vbx_cnn->ctrl_reg);
+#else
+  return -1;
+#endif
+}
+
+int vbx_cnn_completion_ack(vbx_cnn_t* vbx_cnn) {
+#if VBX_SOC_DRIVER
+  // the fd stays blocking for vbx_cnn_model_wfi, so check before reading
+  struct pollfd pfd = {vbx_cnn->fd,POLLIN,0};
+  uint32_t count;
+  if (poll(&pfd,1,0) <= 0 || !(pfd.revents & POLLIN)) {
+    return 0;
+  }
+  return read(vbx_cnn->fd,&count,sizeof(count)) == sizeof(count);
+#elif VBX_CNN_REG_MODEL
+  return vbx_cnn_reg_model_fd_ack(vbx_cnn->ctrl_reg);
+#else
+  return 0;
+#endif
+}
+
+int vbx_cnn_completion_rearm(vbx_cnn_t* vbx_cnn) {
+#if VBX_SOC_DRIVER
+  // the UIO driver masks the interrupt each time it fires
+  uint32_t reenable = 1;
+  if (write(vbx_cnn->fd,&reenable,sizeof(reenable)) != sizeof(reenable)) {
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+int vbx_cnn_reset(vbx_cnn_t* vbx_cnn) {
+  lock_submit(vbx_cnn);
+  write_register(vbx_cnn->ctrl_reg,CTRL_OFFSET,CTRL_REG_SOFT_RESET);
+  write_register(vbx_cnn->ctrl_reg,CTRL_OFFSET,0);
+#if VBX_CNN_CONTEXTS
+  if (vbx_cnn->jobs_started != vbx_cnn->jobs_done) {
+    vbx_cnn->failed_begin = vbx_cnn->jobs_done;
+    vbx_cnn->failed_end = vbx_cnn->jobs_started;
+    vbx_cnn->failed_status = -3;
+    vbx_cnn->jobs_done = vbx_cnn->jobs_started;
+  }
+  vbx_cnn_trace_counter("vbx_cnn jobs on core",0);
+#endif
+  vbx_cnn_trace_instant("vbx_cnn reset");
+  vbx_cnn->output_valid = 0;
+  vbx_cnn->resets++;
+  uint32_t ctrl = read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET);
+  unlock_submit(vbx_cnn);
+  // a completion that raced the reset would otherwise wake the wait for the next model
+  if (vbx_cnn_completion_ack(vbx_cnn)) {
+    vbx_cnn_completion_rearm(vbx_cnn);
+  }
+  return (ctrl & (CTRL_REG_SOFT_RESET | CTRL_REG_ERROR)) ? -1 : 0;
+}
+
+int vbx_cnn_model_wfi_timeout(vbx_cnn_t* vbx_cnn, uint32_t timeout_us) {
+#if VBX_SOC_DRIVER || VBX_CNN_REG_MODEL
+  struct pollfd pfd = {vbx_cnn_get_completion_fd(vbx_cnn),POLLIN,0};
+  uint64_t deadline_us = now_us() + timeout_us;
+  while (1) {
+    uint64_t now = now_us();
+    int ready = now < deadline_us ? poll(&pfd,1,(deadline_us - now + 999) / 1000) : 0;
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready == 0) {
+      vbx_cnn_reset(vbx_cnn);
+      return VBX_CNN_TIMED_OUT;
+    }
+    if (ready < 0 || !(pfd.revents & POLLIN)) {
+      return -1;
+    }
+    // the fd can still be up from a completion nobody took, so take it and
+    // look again; a job still running waits out the rest of the one deadline
+    vbx_cnn_completion_ack(vbx_cnn);
+#if VBX_SOC_DRIVER
+    // same order as vbx_cnn_model_wfi: clear OUTPUT_VALID, then unmask
+    vbx_cnn_model_isr(vbx_cnn);
+    if (vbx_cnn_completion_rearm(vbx_cnn) < 0) {
+      return -1;
+    }
+    vbx_cnn->output_valid = 0;
+#endif
+    int status = vbx_cnn_model_poll(vbx_cnn);
+    if (status <= 0) {
+      return status == -2 ? 0 : status;
+    }
+  }
+#else
+  return vbx_cnn_model_wfi(vbx_cnn);
+#endif
+}
+
+// lives here rather than in vbx_cnn_queue.c, which has to link against
+// libvbx_cnn_sim where there is no vbx_cnn_reset
+void vbx_cnn_queue_set_watchdog(vbx_cnn_queue_t* queue,uint32_t timeout_us,int max_retries){
+  queue->timeout_ns = (uint64_t)timeout_us*1000;
+  queue->max_retries = max_retries;
+  queue->reset = vbx_cnn_reset;
+}
+
+// lives here rather than in vbx_cnn_queue.c, which has to link against
+// libvbx_cnn_sim where there is no completion fd
+int vbx_cnn_queue_drain(vbx_cnn_queue_t* queue,int* job_ids,int* statuses,int max_jobs){
+  //same order as vbx_cnn_model_wfi: take the notification, clear
+  //OUTPUT_VALID, then unmask. A model finishing between the last two steps
+  //could be missed by an edge interrupt, so look once more after unmasking.
+  vbx_cnn_completion_ack(queue->vbx_cnn);
+  vbx_cnn_queue_service(queue);
+  vbx_cnn_completion_rearm(queue->vbx_cnn);
+  int count = 0;
+  int job_id;
+  while(count < max_jobs && (job_id = vbx_cnn_queue_complete(queue,statuses ? statuses+count : NULL)) >= 0){
+    job_ids[count++] = job_id;
+  }
+  return count;
+}
+
 void vbx_cnn_model_isr(vbx_cnn_t *vbx_cnn) {
 	if(read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET) & CTRL_REG_OUTPUT_VALID){
 		write_register(vbx_cnn->ctrl_reg,CTRL_OFFSET,CTRL_REG_OUTPUT_VALID);
@@ -381,3 +730,151 @@ void vbx_cnn_model_isr(vbx_cnn_t *vbx_cnn) {
 		}
 	}
 }
+
+#if VBX_CNN_CONTEXTS
+//Job ids are the low 31 bits of jobs_started when the job was handed over
+static inline int job_before(uint32_t a,uint32_t b){
+  return (int32_t)((b - a) << 1) > 0;
+}
+
+static vbx_cnn_io_ptr_t* alloc_io_table(vbx_cnn_t* vbx_cnn){
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+  return (vbx_cnn_io_ptr_t*)vbx_allocate_dma_buffer(vbx_cnn,MAX_IO_BUFFERS*sizeof(vbx_cnn_io_ptr_t),3);
+#else
+  //the register model reads the table straight from host memory
+  return (vbx_cnn_io_ptr_t*)calloc(MAX_IO_BUFFERS,sizeof(vbx_cnn_io_ptr_t));
+#endif
+}
+
+static void free_io_table(vbx_cnn_t* vbx_cnn,vbx_cnn_io_ptr_t* table){
+  if(!table){
+    return;
+  }
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+  vbx_free_dma_buffer(vbx_cnn,table);
+#else
+  free(table);
+#endif
+}
+
+vbx_cnn_ctx_t* vbx_cnn_ctx_init(vbx_cnn_t* vbx_cnn,size_t dma_bytes,const char* owner){
+  vbx_cnn_ctx_t* ctx = (vbx_cnn_ctx_t*)calloc(1,sizeof(vbx_cnn_ctx_t));
+  if(!ctx){
+    return NULL;
+  }
+  ctx->vbx_cnn = vbx_cnn;
+  ctx->io_tables[0] = alloc_io_table(vbx_cnn);
+  ctx->io_tables[1] = alloc_io_table(vbx_cnn);
+  if(!ctx->io_tables[0] || !ctx->io_tables[1]){
+    vbx_cnn_ctx_free(ctx);
+    return NULL;
+  }
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+  if(dma_bytes){
+    vbx_cnn_t* dma_owner = vbx_cnn->dma_owner;
+    pthread_mutex_lock(&dma_owner->dma_lock);
+    ctx->dma_arena = vbx_dma_arena_sub(dma_owner->dma_arena,dma_bytes,owner);
+    pthread_mutex_unlock(&dma_owner->dma_lock);
+    if(!ctx->dma_arena){
+      vbx_cnn_ctx_free(ctx);
+      return NULL;
+    }
+  }
+#endif
+  return ctx;
+}
+
+void vbx_cnn_ctx_free(vbx_cnn_ctx_t* ctx){
+  if(!ctx){
+    return;
+  }
+  vbx_cnn_t* vbx_cnn = ctx->vbx_cnn;
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+  if(ctx->dma_arena){
+    pthread_mutex_lock(&vbx_cnn->dma_owner->dma_lock);
+    vbx_dma_arena_release(ctx->dma_arena);
+    pthread_mutex_unlock(&vbx_cnn->dma_owner->dma_lock);
+  }
+#endif
+  free_io_table(vbx_cnn,ctx->io_tables[0]);
+  free_io_table(vbx_cnn,ctx->io_tables[1]);
+  free(ctx);
+}
+
+void* vbx_cnn_ctx_allocate_dma_buffer(vbx_cnn_ctx_t* ctx,size_t request_size,size_t phys_alignment_bits){
+  if(ctx->dma_arena){
+    //only this context allocates from its slice
+    return vbx_dma_arena_alloc_flags(ctx->dma_arena,request_size,phys_alignment_bits,VBX_DMA_ZERO);
+  }
+  return vbx_allocate_dma_buffer(ctx->vbx_cnn,request_size,phys_alignment_bits);
+}
+
+int vbx_cnn_ctx_model_start(vbx_cnn_ctx_t* ctx,model_t* model,vbx_cnn_io_ptr_t io_buffers[]){
+  vbx_cnn_t* vbx_cnn = ctx->vbx_cnn;
+  vbx_cnn_io_ptr_t* table = ctx->io_tables[ctx->next_table];
+
+  //Fill the table outside the lock. This context last used it two jobs
+  //ago, and handing over the job in between waited for the start bit to
+  //drop, so the core has already picked that one up.
+#if SPLASHKIT_PCIE
+  vnnx_graph_t graph;
+  read_fpga((uintptr_t)model,&graph,sizeof(graph));
+  size_t num_io_buffers = model_get_num_inputs((model_t*)&graph)+model_get_num_outputs((model_t*)&graph);
+#else
+  size_t num_io_buffers = model_get_num_inputs(model)+model_get_num_outputs(model);
+#endif
+  if(num_io_buffers > MAX_IO_BUFFERS){
+    return -1;
+  }
+#if VBX_SOC_DRIVER
+  for(size_t io=0;io<num_io_buffers;io++){
+    table[io] = (vbx_cnn_io_ptr_t)virt_to_phys(vbx_cnn,(void*)(uintptr_t)io_buffers[io]);
+  }
+#elif SPLASHKIT_PCIE
+  write_fpga((uintptr_t)table,io_buffers,num_io_buffers*sizeof(vbx_cnn_io_ptr_t));
+#else
+  memcpy(table,io_buffers,num_io_buffers*sizeof(vbx_cnn_io_ptr_t));
+#endif
+
+  lock_submit(vbx_cnn);
+  //The core holds one running model and one queued behind it with START
+  //high. Rather than spin with the lock held until it takes the queued one,
+  //let the caller retry.
+  uint32_t ctrl = read_register(vbx_cnn->ctrl_reg,CTRL_OFFSET);
+  if(ctrl & (CTRL_REG_START|CTRL_REG_ERROR|CTRL_REG_SOFT_RESET)){
+    unlock_submit(vbx_cnn);
+    return -1;
+  }
+  uint32_t seq = vbx_cnn->jobs_started;
+  start_registers(vbx_cnn,model,table);
+  unlock_submit(vbx_cnn);
+
+  ctx->next_table ^= 1;
+  return (int)(seq & VBX_CNN_JOB_ID_MASK);
+}
+
+int vbx_cnn_ctx_poll(vbx_cnn_ctx_t* ctx,int job_id){
+  vbx_cnn_t* vbx_cnn = ctx->vbx_cnn;
+  uint32_t seq = (uint32_t)job_id;
+  lock_submit(vbx_cnn);
+  if(job_before(seq,vbx_cnn->jobs_started) && !job_before(seq,vbx_cnn->jobs_done)){
+    poll_and_count(vbx_cnn);
+  }
+  int status = 0;
+  if(job_before(seq,vbx_cnn->jobs_started) && !job_before(seq,vbx_cnn->jobs_done)){
+    status = 1;
+  }else if(!job_before(seq,vbx_cnn->failed_begin) && job_before(seq,vbx_cnn->failed_end)){
+    status = vbx_cnn->failed_status;
+  }
+  unlock_submit(vbx_cnn);
+  return status;
+}
+
+int vbx_cnn_ctx_wait(vbx_cnn_ctx_t* ctx,int job_id){
+  int status;
+  while((status = vbx_cnn_ctx_poll(ctx,job_id)) > 0){
+    sched_yield();
+  }
+  return status;
+}
+#endif
@@ -1,16 +1,29 @@
 /*!
  * \file
  * \brief API for interacting with Core VectorBlox
+ *
+ * Initializing the core, DMA memory, starting and polling models and reading
+ * their descriptors. Everything built on top has its own header:
+ * vbx_cnn_loader.h, vbx_cnn_packed.h, vbx_cnn_bundle.h, vbx_cnn_io_info.h,
+ * vbx_cnn_dump.h, vbx_cnn_completion.h, vbx_cnn_reset.h, vbx_cnn_wait.h,
+ * vbx_cnn_queue.h, vbx_cnn_batch.h, vbx_cnn_ctx.h, vbx_cnn_cache.h,
+ * vbx_cnn_set.h and vbx_cnn_trace.h.
  */
 
 #ifndef VBX_CNN_API_H
 #define VBX_CNN_API_H
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #include "vnnx-types.h"
 #if defined(__riscv) && defined(__linux)
 #define VBX_SOC_DRIVER 1
 #endif
+#if defined(VBX_SOC_DRIVER) || defined(SPLASHKIT_PCIE) || defined(VBX_CNN_REG_MODEL)
+//drivers that can share the core between threads, see vbx_cnn_ctx_init()
+#define VBX_CNN_CONTEXTS 1
+#include <pthread.h>
+#endif
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -27,7 +40,6 @@ typedef uint64_t vbx_cnn_io_ptr_t;
 struct model_struct;
 typedef struct model_struct model_t;
 
-
 typedef enum {
 	VBX_CNN_CALC_TYPE_UINT8,
 	VBX_CNN_CALC_TYPE_INT8,
@@ -58,7 +70,110 @@ typedef enum {
 }vbx_cnn_err_e;
 
 #define MAX_IO_BUFFERS 10
+
+/**
+ * DMA arena
+ *
+ * Hands out buffers from a contiguous DMA region (the udmabuf mapping on the SoC)
+ * and takes them back again. Alignment is applied to the physical address.
+ * Any block of memory can back an arena, so it can be exercised on a host
+ * with a heap buffer standing in for the mapping.
+ * The region is not cleared up front; buffers are zeroed as they are handed
+ * out, and only those allocated with VBX_DMA_ZERO.
+ */
+#define VBX_DMA_ZERO 0x1  //< clear the buffer before handing it out
+
+struct vbx_dma_block;
+typedef struct vbx_dma_arena{
+	uint8_t* base;
+	size_t size;
+	uintptr_t phys_base;
+	size_t granule;
+	struct vbx_dma_block* blocks;
+	struct vbx_dma_arena* parent;
+	const char* owner;
+	size_t used;
+	size_t peak_used;
+	size_t high_water;
+	size_t zeroed;
+	int allocations;
+}vbx_dma_arena_t;
+
 typedef struct {
+	size_t size;
+	size_t used;
+	size_t peak_used;       //< most bytes ever allocated at once
+	size_t high_water;      //< highest offset ever allocated
+	size_t zeroed;          //< bytes cleared for VBX_DMA_ZERO allocations
+	size_t free;
+	size_t largest_free;
+	int free_blocks;
+	int allocations;
+	int fragmentation_pct;  //< percentage of free bytes outside the largest free block
+}vbx_dma_arena_stats_t;
+
+/**
+ * Create an arena over a block of memory
+ *
+ * @param base Virtual address of the region
+ * @param size Size of the region in bytes
+ * @param phys_base Physical address of base, used for alignment
+ * @param granule Allocation sizes are rounded up to this power of two
+ * @return The arena, or NULL on failure
+ */
+vbx_dma_arena_t* vbx_dma_arena_init(void* base,size_t size,uintptr_t phys_base,size_t granule);
+
+/**
+ * Free the arena bookkeeping and that of its sub-arenas.
+ * The memory itself is owned by the caller of vbx_dma_arena_init().
+ */
+void vbx_dma_arena_destroy(vbx_dma_arena_t* arena);
+
+/**
+ * @param arena The arena to allocate from
+ * @param request_size Bytes needed
+ * @param phys_alignment_bits The physical address is aligned to 1<<phys_alignment_bits
+ * @return pointer to the buffer, or NULL if no free block is big enough
+ */
+void* vbx_dma_arena_alloc(vbx_dma_arena_t* arena,size_t request_size,size_t phys_alignment_bits);
+
+/**
+ * vbx_dma_arena_alloc(), clearing the buffer first if flags has VBX_DMA_ZERO
+ */
+void* vbx_dma_arena_alloc_flags(vbx_dma_arena_t* arena,size_t request_size,size_t phys_alignment_bits,int flags);
+
+/**
+ * @return 0 on success, -1 if ptr is not a buffer allocated from arena
+ */
+int vbx_dma_arena_free(vbx_dma_arena_t* arena,void* ptr);
+
+/**
+ * Free every buffer and sub-arena in the arena at once
+ */
+void vbx_dma_arena_reset(vbx_dma_arena_t* arena);
+
+/**
+ * Reserve size bytes of parent for a single owner (one model, one pipeline, ...).
+ * The owner allocates from the returned arena and gives everything back with
+ * vbx_dma_arena_release() or vbx_dma_arena_reset().
+ *
+ * @param parent The arena to carve from
+ * @param size Bytes to reserve
+ * @param owner Name reported in statistics, not copied
+ * @return The sub-arena, or NULL if parent has no room
+ */
+vbx_dma_arena_t* vbx_dma_arena_sub(vbx_dma_arena_t* parent,size_t size,const char* owner);
+
+/**
+ * Return a sub-arena, and everything allocated from it, to its parent
+ *
+ * @return 0 on success, -1 if child is not a sub-arena
+ */
+int vbx_dma_arena_release(vbx_dma_arena_t* child);
+
+void vbx_dma_arena_get_stats(const vbx_dma_arena_t* arena,vbx_dma_arena_stats_t* stats);
+
+typedef struct vbx_cnn {
 	int32_t initialized;
 	uint32_t version;
 	uint32_t size;/*vbx_cnn_size_conf_e*/
@@ -69,17 +184,44 @@ typedef struct {
   	size_t  dma_phys_trans_offset;
 #if defined(VBX_SOC_DRIVER) || defined(SPLASHKIT_PCIE)
     	int fd;
+    	size_t ctrl_reg_size;         //< bytes of ctrl_reg mapped from fd
     	uint8_t* dma_buffer;
     	uint8_t* dma_buffer_end;
   	vbx_cnn_io_ptr_t *io_buffers;
+	vbx_dma_arena_t* dma_arena;
+	struct vbx_cnn* dma_owner;    //< core whose DMA window and arena this one shares, itself if none
 #endif
-
+#if VBX_CNN_CONTEXTS
+	pthread_mutex_t submit_lock;  //< held while the start, io and model registers are written or polled
+	pthread_mutex_t dma_lock;     //< held while dma_arena is changed
+	uint32_t jobs_started;        //< models handed to the core
+	uint32_t jobs_done;           //< models known to have finished, never ahead of the core
+	uint32_t failed_begin;        //< jobs [failed_begin,failed_end) ended with failed_status
+	uint32_t failed_end;
+	int failed_status;
+#endif
+	uint32_t init_us;             //< time vbx_cnn_init() took, on hosted builds
+	uint32_t resets;              //< soft resets by vbx_cnn_reset()
 }vbx_cnn_t;
 
+/**
+ * Allocate a buffer the core can reach. With the SoC and PCIe drivers it is
+ * zeroed, as by vbx_allocate_dma_buffer_flags(vbx_cnn,request_size,align,VBX_DMA_ZERO).
+ */
+void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t align);
+/**
+ * Allocate a buffer the core can reach. Buffers that are completely written
+ * before the core reads them, such as models and input frames, can skip
+ * the clearing by leaving VBX_DMA_ZERO out of flags.
+ */
+void* vbx_allocate_dma_buffer_flags(vbx_cnn_t* vbx_cnn,size_t request_size,size_t align,int flags);
 #if VBX_SOC_DRIVER || SPLASHKIT_PCIE
-  void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t align);
-#else
-  void* vbx_allocate_dma_buffer(vbx_cnn_t* vbx_cnn,size_t request_size,size_t align);
+  /**
+   * Give a buffer from vbx_allocate_dma_buffer() back to the DMA arena
+   *
+   * @return 0 on success, -1 if ptr was not allocated from vbx_cnn's arena
+   */
+  int vbx_free_dma_buffer(vbx_cnn_t* vbx_cnn,void* ptr);
 #endif
 /**
  * Initialize vbx_cnn IP Core.
@@ -98,6 +240,33 @@ typedef struct {
 //vbx_cnn_t* vbx_cnn_init(void* ctrl_reg_addr,void* firmware_blob);
 vbx_cnn_t* vbx_cnn_init(void* ctrl_reg_addr);
 
+/**
+ * Initialize a further core that shares dma_owner's DMA window and arena,
+ * so buffers and models allocated through either can be used by both.
+ *
+ * @param ctrl_reg_addr The address of this core's S_control port
+ * @param dma_owner A core from vbx_cnn_init(), or NULL to behave like it
+ * @return A vbx_cnn_t structure, as from vbx_cnn_init()
+ */
+vbx_cnn_t* vbx_cnn_init_shared(void* ctrl_reg_addr,vbx_cnn_t* dma_owner);
+
+/**
+ * Release a core from vbx_cnn_init() or vbx_cnn_init_shared(), initialized
+ * or not. A core that owns the DMA window takes it, and everything allocated
+ * from it, along, so cores sharing it must be freed first.
+ */
+void vbx_cnn_free(vbx_cnn_t* vbx_cnn);
+
+/**
+ * Find every VectorBlox core the system exposes (every "vbx" UIO device
+ * on the SoC), in device order
+ *
+ * @param ctrl_reg_addrs Filled with each core's S_control address, for vbx_cnn_init()
+ * @param max_cores Size of ctrl_reg_addrs
+ * @return number of cores found, 0 where cores can't be enumerated
+ */
+int vbx_cnn_enumerate(uintptr_t ctrl_reg_addrs[],int max_cores);
+
 /**
  * Read error register and return the error
  *
@@ -174,7 +343,6 @@ int vbx_cnn_model_wfi(vbx_cnn_t* vbx_cnn);
 
 void vbx_cnn_model_isr(vbx_cnn_t *vbx_cnn);
 
-
 /**
  * Model Parsing Function
  */
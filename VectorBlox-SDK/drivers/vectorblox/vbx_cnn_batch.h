@@ -0,0 +1,52 @@
+/*!
+ * \file
+ * \brief Running one model over many io sets through a job queue
+ */
+
+#ifndef VBX_CNN_BATCH_H
+#define VBX_CNN_BATCH_H
+#include "vbx_cnn_queue.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Queue runs of one model over many io sets with one look at the core,
+ * rather than one per vbx_cnn_queue_submit(). Row i of io_sets holds run i's
+ * inputs followed by its outputs, inputs+outputs pointers to a row. The rows
+ * are copied; the buffers they point to must stay valid until collected.
+ * The runs take consecutive job ids.
+ *
+ * @param queue The queue to use
+ * @param io_sets count rows of io buffers
+ * @param first_job Set to the job id of row 0, may be NULL
+ * @return number of rows queued, from the front, as many as there is room
+ *         for; or -1 if the model has too many io buffers
+ */
+int vbx_cnn_queue_submit_batch(vbx_cnn_queue_t* queue,model_t* model,const vbx_cnn_io_ptr_t* io_sets,int count,int* first_job);
+
+/**
+ * Run one model over count io sets back to back, such as the crops of one
+ * frame, and block until all are done. Runs are fed to the core as the
+ * queue has room, so it goes from one straight into the next, and done is
+ * called with each run's row and status as it finishes, in order, while
+ * the later runs are still going. The queue must have nothing pending.
+ * @code{.cpp}
+ *  vbx_cnn_io_ptr_t io_sets[MAX_CROPS][2];
+ *  for(int c=0;c<num_crops;c++){ io_sets[c][0] = crop_input[c]; io_sets[c][1] = crop_output[c]; }
+ *  vbx_cnn_queue_run_batch(queue,model,&io_sets[0][0],num_crops,classify_crop,labels);
+ * @endcode
+ *
+ * @param queue The queue to use
+ * @param io_sets count rows of io buffers, as for vbx_cnn_queue_submit_batch()
+ * @param done Called with arg, the row and its status as each run finishes; may be NULL
+ * @return number of runs that failed, or -1 if the batch couldn't be queued
+ */
+int vbx_cnn_queue_run_batch(vbx_cnn_queue_t* queue,model_t* model,const vbx_cnn_io_ptr_t* io_sets,int count,
+                            void (*done)(void* arg,int index,int status),void* arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_BATCH_H
@@ -0,0 +1,73 @@
+#include "vbx_cnn_bundle.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int in_file(const vbx_cnn_bundle_t* bundle,uint64_t offset,uint64_t bytes){
+  return offset <= bundle->bytes && bytes <= bundle->bytes - offset;
+}
+
+//The mapping costs no reads up front; only the index pages are touched
+//here, and models are read from the descriptor when they are loaded.
+vbx_cnn_bundle_t* vbx_cnn_bundle_open(const char* filename){
+  vbx_cnn_bundle_t* bundle = (vbx_cnn_bundle_t*)calloc(1,sizeof(vbx_cnn_bundle_t));
+  if(!bundle){
+    return NULL;
+  }
+  struct stat st;
+  bundle->fd = open(filename,O_RDONLY);
+  if(bundle->fd < 0 || fstat(bundle->fd,&st) != 0 || st.st_size < (off_t)sizeof(vbx_cnn_bundle_header_t)){
+    vbx_cnn_bundle_close(bundle);
+    return NULL;
+  }
+  bundle->bytes = st.st_size;
+  void* base = mmap(NULL,bundle->bytes,PROT_READ,MAP_PRIVATE,bundle->fd,0);
+  if(base == MAP_FAILED){
+    vbx_cnn_bundle_close(bundle);
+    return NULL;
+  }
+  bundle->base = (const uint8_t*)base;
+  const vbx_cnn_bundle_header_t* header = (const vbx_cnn_bundle_header_t*)bundle->base;
+  if(header->magic != VBX_CNN_BUNDLE_MAGIC || header->version != VBX_CNN_BUNDLE_VERSION ||
+     header->num_entries > (bundle->bytes - sizeof(*header)) / sizeof(vbx_cnn_bundle_entry_t)){
+    vbx_cnn_bundle_close(bundle);
+    return NULL;
+  }
+  bundle->num_entries = header->num_entries;
+  bundle->entries = (const vbx_cnn_bundle_entry_t*)(header + 1);
+  for(int e=0;e<bundle->num_entries;e++){
+    const vbx_cnn_bundle_entry_t* entry = bundle->entries + e;
+    if(!memchr(entry->name,0,sizeof(entry->name)) || !memchr(entry->post_process,0,sizeof(entry->post_process)) ||
+       !in_file(bundle,entry->model_offset,entry->model_bytes) || !in_file(bundle,entry->test_offset,entry->test_bytes) ||
+       entry->allocate_bytes < entry->model_bytes){
+      vbx_cnn_bundle_close(bundle);
+      return NULL;
+    }
+  }
+  return bundle;
+}
+
+void vbx_cnn_bundle_close(vbx_cnn_bundle_t* bundle){
+  if(!bundle){
+    return;
+  }
+  if(bundle->base){
+    munmap((void*)bundle->base,bundle->bytes);
+  }
+  if(bundle->fd >= 0){
+    close(bundle->fd);
+  }
+  free(bundle);
+}
+
+int vbx_cnn_bundle_find(const vbx_cnn_bundle_t* bundle,const char* name){
+  for(int e=0;e<bundle->num_entries;e++){
+    if(!strcmp(bundle->entries[e].name,name)){
+      return e;
+    }
+  }
+  return -1;
+}
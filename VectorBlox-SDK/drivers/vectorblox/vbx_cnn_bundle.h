@@ -0,0 +1,78 @@
+/*!
+ * \file
+ * \brief Model Bundles
+ *
+ * A bundle is one file holding many models: a header, an index entry per
+ * model with the metadata a demo selects it by, then each .vnnx and its
+ * optional reference tensor dump, page aligned. Opening it maps the file
+ * and checks the index; models are then loaded from the one descriptor by
+ * offset, so nothing is parsed or opened per model.
+ * example/host-c/vbx-bundle packs, lists and unpacks bundles.
+ * @code{.cpp}
+ *  vbx_cnn_bundle_t* bundle = vbx_cnn_bundle_open("models.vbxb");
+ *  const vbx_cnn_bundle_entry_t* entry = bundle->entries + vbx_cnn_bundle_find(bundle,"yolo");
+ *  model_t* model = vbx_cnn_model_load_fd(vbx_cnn,bundle->fd,entry->model_offset,entry->model_bytes);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_BUNDLE_H
+#define VBX_CNN_BUNDLE_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_BUNDLE_MAGIC 0x42584256 // "VBXB"
+#define VBX_CNN_BUNDLE_VERSION 1
+#define VBX_CNN_BUNDLE_ALIGN 4096
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_entries;
+  uint32_t reserved;
+}vbx_cnn_bundle_header_t;
+
+typedef struct {
+  char name[48];
+  char post_process[32];    // postprocess type, as in the demos' model tables
+  uint64_t model_offset;    // of the .vnnx, from the start of the file
+  uint64_t model_bytes;
+  uint64_t allocate_bytes;  // DMA memory the model needs once loaded
+  uint64_t test_offset;     // of a model_dump_io() dump of reference inputs and outputs
+  uint64_t test_bytes;      // 0 if there is none
+}vbx_cnn_bundle_entry_t;
+
+typedef struct {
+  int fd;                   //< for vbx_cnn_model_load_fd() and vbx_cnn_cache_add_fd()
+  const uint8_t* base;      //< the whole file, mapped read only
+  size_t bytes;
+  int num_entries;
+  const vbx_cnn_bundle_entry_t* entries;
+}vbx_cnn_bundle_t;
+
+/**
+ * Map a bundle and check its index
+ *
+ * @param filename Path of the .vbxb file
+ * @return The bundle, or NULL if the file can't be read or the index is
+ *         inconsistent with the file
+ */
+vbx_cnn_bundle_t* vbx_cnn_bundle_open(const char* filename);
+
+/**
+ * Unmap a bundle and close its descriptor. Models already loaded from it
+ * are unaffected; a model cache reading from it must be freed first.
+ */
+void vbx_cnn_bundle_close(vbx_cnn_bundle_t* bundle);
+
+/**
+ * @return Index of the entry called name, or -1 if there is none
+ */
+int vbx_cnn_bundle_find(const vbx_cnn_bundle_t* bundle,const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_BUNDLE_H
@@ -0,0 +1,293 @@
+#include "vbx_cnn_cache.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if VBX_CNN_CONTEXTS
+
+//Only the arena changes are made under the lock; the file is read outside
+//it with the entry marked LOADING, so acquiring a resident model never waits
+//behind another model's load.
+
+//least recently used resident model nothing has pinned
+static vbx_cnn_cache_entry_t* lru_victim(vbx_cnn_cache_t* cache){
+  vbx_cnn_cache_entry_t* victim = NULL;
+  for(int i=0;i<cache->num_entries;i++){
+    vbx_cnn_cache_entry_t* entry = cache->entries + i;
+    if(entry->state == VBX_CNN_CACHE_RESIDENT && !entry->pins &&
+       (!victim || entry->last_use < victim->last_use)){
+      victim = entry;
+    }
+  }
+  return victim;
+}
+
+//Give a model's memory back, with the lock held. The waits forget it
+//before another model can be loaded at its address.
+static void drop_model(vbx_cnn_cache_t* cache,model_t* model){
+  vbx_dma_arena_free(cache->arena,model);
+  for(int w=0;w<cache->num_waits;w++){
+    vbx_cnn_wait_forget(cache->waits[w],model);
+  }
+}
+
+//Evicting the oldest first may free more than the one block needed, but a
+//model loaded after a switch is usually the next one wanted anyway.
+static model_t* make_room(vbx_cnn_cache_t* cache,size_t bytes){
+  model_t* model;
+  while(!(model = (model_t*)vbx_dma_arena_alloc(cache->arena,bytes,12))){
+    vbx_cnn_cache_entry_t* victim = lru_victim(cache);
+    if(!victim){
+      return NULL;
+    }
+    drop_model(cache,victim->model);
+    victim->model = NULL;
+    victim->state = VBX_CNN_CACHE_EMPTY;
+    cache->stats.evictions++;
+    vbx_cnn_trace_instant("model evict");
+  }
+  return model;
+}
+
+//Called and returns with the lock held, entry EMPTY.
+//Returns with the entry RESIDENT, or EMPTY again if the load failed.
+static void load_entry(vbx_cnn_cache_t* cache,vbx_cnn_cache_entry_t* entry){
+  entry->state = VBX_CNN_CACHE_LOADING;
+  pthread_mutex_unlock(&cache->lock);
+  vbx_cnn_trace_begin("model load");
+  uint64_t start = vbx_cnn_wait_time_ns();
+  model_t* model = NULL;
+  struct stat st;
+  int fd = entry->fd;
+  if(entry->filename){
+    fd = open(entry->filename,O_RDONLY);
+    if(fd >= 0 && fstat(fd,&st) == 0){
+      entry->size = st.st_size;
+    }
+  }
+  if(fd >= 0 && entry->size){
+    size_t bytes = vbx_cnn_model_peek_fd(fd,entry->offset,entry->size);
+    if(bytes){
+      pthread_mutex_lock(&cache->lock);
+      entry->bytes = bytes;
+      model = make_room(cache,bytes);
+      pthread_mutex_unlock(&cache->lock);
+    }
+    if(model && vbx_cnn_model_read_fd(fd,entry->offset,entry->size,model) != 0){
+      pthread_mutex_lock(&cache->lock);
+      vbx_dma_arena_free(cache->arena,model);
+      pthread_mutex_unlock(&cache->lock);
+      model = NULL;
+    }
+  }
+  if(entry->filename && fd >= 0){
+    close(fd);
+  }
+  uint64_t load_ns = vbx_cnn_wait_time_ns() - start;
+  vbx_cnn_trace_end("model load");
+  pthread_mutex_lock(&cache->lock);
+  cache->stats.load_us += load_ns/1000;
+  if(model){
+    entry->model = model;
+    entry->state = VBX_CNN_CACHE_RESIDENT;
+    //a prefetched model is about to be wanted, so isn't the first evicted
+    entry->last_use = ++cache->clock;
+    entry->loads++;
+  }else{
+    entry->state = VBX_CNN_CACHE_EMPTY;
+    cache->stats.failures++;
+  }
+  pthread_cond_broadcast(&cache->loaded);
+}
+
+//Each loader takes the next queued model; several in flight keep the
+//storage busy while others copy and check theirs.
+static void* loader_thread(void* arg){
+  vbx_cnn_cache_t* cache = (vbx_cnn_cache_t*)arg;
+  vbx_cnn_trace_thread_name("model loader");
+  pthread_mutex_lock(&cache->lock);
+  while(1){
+    while(!cache->stop && cache->prefetch_head == cache->prefetch_tail){
+      pthread_cond_wait(&cache->work,&cache->lock);
+    }
+    if(cache->stop){
+      break;
+    }
+    int index = cache->prefetch_queue[cache->prefetch_head++ % VBX_CNN_CACHE_MAX_MODELS];
+    vbx_cnn_cache_entry_t* entry = cache->entries + index;
+    //acquired, or already loading, since it was queued
+    if(entry->state != VBX_CNN_CACHE_EMPTY){
+      continue;
+    }
+    load_entry(cache,entry);
+    if(entry->state == VBX_CNN_CACHE_RESIDENT){
+      cache->stats.prefetches++;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return NULL;
+}
+
+vbx_cnn_cache_t* vbx_cnn_cache_init(vbx_dma_arena_t* arena){
+  vbx_cnn_cache_t* cache = (vbx_cnn_cache_t*)calloc(1,sizeof(vbx_cnn_cache_t));
+  if(!cache){
+    return NULL;
+  }
+  cache->arena = arena;
+  pthread_mutex_init(&cache->lock,NULL);
+  pthread_cond_init(&cache->loaded,NULL);
+  pthread_cond_init(&cache->work,NULL);
+  while(cache->num_loaders < VBX_CNN_CACHE_LOADERS &&
+        pthread_create(cache->loaders+cache->num_loaders,NULL,loader_thread,cache) == 0){
+    cache->num_loaders++;
+  }
+  if(!cache->num_loaders){
+    pthread_cond_destroy(&cache->work);
+    pthread_cond_destroy(&cache->loaded);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+    return NULL;
+  }
+  return cache;
+}
+
+void vbx_cnn_cache_free(vbx_cnn_cache_t* cache){
+  if(!cache){
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  cache->stop = 1;
+  pthread_cond_broadcast(&cache->work);
+  pthread_mutex_unlock(&cache->lock);
+  for(int t=0;t<cache->num_loaders;t++){
+    pthread_join(cache->loaders[t],NULL);
+  }
+  for(int i=0;i<cache->num_entries;i++){
+    vbx_cnn_cache_entry_t* entry = cache->entries + i;
+    if(entry->model){
+      drop_model(cache,entry->model);
+    }
+    free(entry->filename);
+  }
+  pthread_cond_destroy(&cache->work);
+  pthread_cond_destroy(&cache->loaded);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+static int add_entry(vbx_cnn_cache_t* cache,const char* filename,int fd,off_t offset,size_t size){
+  pthread_mutex_lock(&cache->lock);
+  int index = -1;
+  char* name = NULL;
+  if(cache->num_entries < VBX_CNN_CACHE_MAX_MODELS && (!filename || (name = strdup(filename)))){
+    index = cache->num_entries++;
+    vbx_cnn_cache_entry_t* entry = cache->entries + index;
+    memset(entry,0,sizeof(vbx_cnn_cache_entry_t));
+    entry->filename = name;
+    entry->fd = fd;
+    entry->offset = offset;
+    entry->size = size;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return index;
+}
+
+int vbx_cnn_cache_add(vbx_cnn_cache_t* cache,const char* filename){
+  return add_entry(cache,filename,-1,0,0);
+}
+
+int vbx_cnn_cache_add_fd(vbx_cnn_cache_t* cache,int fd,off_t offset,size_t size){
+  return add_entry(cache,NULL,fd,offset,size);
+}
+
+int vbx_cnn_cache_add_wait(vbx_cnn_cache_t* cache,vbx_cnn_wait_t* wait){
+  pthread_mutex_lock(&cache->lock);
+  int status = -1;
+  if(cache->num_waits < VBX_CNN_CACHE_MAX_WAITS){
+    cache->waits[cache->num_waits++] = wait;
+    status = 0;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return status;
+}
+
+model_t* vbx_cnn_cache_acquire(vbx_cnn_cache_t* cache,int index){
+  if(index < 0 || index >= cache->num_entries){
+    return NULL;
+  }
+  vbx_cnn_cache_entry_t* entry = cache->entries + index;
+  uint64_t start = vbx_cnn_wait_time_ns();
+  pthread_mutex_lock(&cache->lock);
+  //a prefetch of this model finishing counts as a hit; one that failed is retried
+  while(entry->state == VBX_CNN_CACHE_LOADING){
+    pthread_cond_wait(&cache->loaded,&cache->lock);
+  }
+  if(entry->state == VBX_CNN_CACHE_EMPTY){
+    cache->stats.misses++;
+    load_entry(cache,entry);
+  }else{
+    cache->stats.hits++;
+  }
+  model_t* model = entry->model;
+  if(model){
+    entry->pins++;
+    entry->last_use = ++cache->clock;
+  }
+  cache->stats.stall_us += (vbx_cnn_wait_time_ns() - start)/1000;
+  pthread_mutex_unlock(&cache->lock);
+  return model;
+}
+
+void vbx_cnn_cache_release(vbx_cnn_cache_t* cache,int index){
+  if(index < 0 || index >= cache->num_entries){
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  vbx_cnn_cache_entry_t* entry = cache->entries + index;
+  if(entry->pins){
+    entry->pins--;
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+int vbx_cnn_cache_prefetch(vbx_cnn_cache_t* cache,int index){
+  if(index < 0 || index >= cache->num_entries){
+    return -1;
+  }
+  pthread_mutex_lock(&cache->lock);
+  int status = 0;
+  if(cache->entries[index].state == VBX_CNN_CACHE_EMPTY){
+    int queued = 0;
+    for(uint32_t q=cache->prefetch_head;q!=cache->prefetch_tail;q++){
+      queued |= cache->prefetch_queue[q % VBX_CNN_CACHE_MAX_MODELS] == index;
+    }
+    if(!queued && cache->prefetch_tail - cache->prefetch_head == VBX_CNN_CACHE_MAX_MODELS){
+      status = -1;
+    }else if(!queued){
+      cache->prefetch_queue[cache->prefetch_tail++ % VBX_CNN_CACHE_MAX_MODELS] = index;
+      pthread_cond_signal(&cache->work);
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return status;
+}
+
+void vbx_cnn_cache_get_stats(vbx_cnn_cache_t* cache,vbx_cnn_cache_stats_t* stats){
+  pthread_mutex_lock(&cache->lock);
+  *stats = cache->stats;
+  stats->resident_bytes = 0;
+  stats->resident = 0;
+  for(int i=0;i<cache->num_entries;i++){
+    if(cache->entries[i].state == VBX_CNN_CACHE_RESIDENT){
+      stats->resident_bytes += cache->entries[i].bytes;
+      stats->resident++;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*!
+ * \file
+ * \brief Model cache
+ *
+ * Keeps a catalog of models in a slice of DMA memory too small to hold
+ * them all. A model is loaded the first time it is acquired, and when
+ * there is no room for it the least recently used models that aren't
+ * pinned are evicted until there is. An acquired model stays pinned, at
+ * the same address, until released. A pool of background threads loads
+ * prefetched models, several at once, so the next models load while the
+ * current one runs, and switching costs a load only when the guess was
+ * wrong. Acquiring a model being prefetched waits for that load.
+ * The cache is the only user of its arena: give it the private slice of
+ * a context (vbx_cnn_ctx_init()) or, off target, any arena.
+ * @code{.cpp}
+ *  vbx_cnn_ctx_t* slice = vbx_cnn_ctx_init(vbx_cnn,64<<20,"model cache");
+ *  vbx_cnn_cache_t* cache = vbx_cnn_cache_init(slice->dma_arena);
+ *  int yolo = vbx_cnn_cache_add(cache,"yolo.vnnx");
+ *  int ocr = vbx_cnn_cache_add(cache,"ocr.vnnx");
+ *  model_t* model = vbx_cnn_cache_acquire(cache,yolo);
+ *  vbx_cnn_cache_prefetch(cache,ocr);
+ *  ...
+ *  vbx_cnn_cache_release(cache,yolo);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_CACHE_H
+#define VBX_CNN_CACHE_H
+#include "vbx_cnn_wait.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if VBX_CNN_CONTEXTS
+#define VBX_CNN_CACHE_MAX_MODELS 32
+//enough to keep reads, copies and checks of a demo's models all in flight
+#define VBX_CNN_CACHE_LOADERS 3
+#define VBX_CNN_CACHE_MAX_WAITS 8
+
+typedef enum {
+	VBX_CNN_CACHE_EMPTY,
+	VBX_CNN_CACHE_LOADING,
+	VBX_CNN_CACHE_RESIDENT,
+}vbx_cnn_cache_state_e;
+
+typedef struct {
+	char* filename;        //< NULL for a model read from fd
+	int fd;
+	off_t offset;
+	size_t size;           //< bytes of the model in the file
+	model_t* model;        //< NULL unless resident
+	size_t bytes;          //< DMA memory the model needs, 0 until its header is read
+	uint64_t last_use;
+	int pins;              //< acquires not yet released
+	vbx_cnn_cache_state_e state;
+	uint32_t loads;
+}vbx_cnn_cache_entry_t;
+
+typedef struct {
+	uint32_t hits;         //< acquires that found the model resident, or being prefetched
+	uint32_t misses;       //< acquires that had to load the model
+	uint32_t evictions;
+	uint32_t prefetches;   //< models loaded by the background threads
+	uint32_t failures;     //< loads that failed, or found everything pinned
+	uint64_t load_us;      //< time spent reading models, in the foreground and background
+	uint64_t stall_us;     //< time acquires waited for a model to load
+	size_t resident_bytes;
+	int resident;
+}vbx_cnn_cache_stats_t;
+
+typedef struct {
+	vbx_dma_arena_t* arena;
+	vbx_cnn_cache_entry_t entries[VBX_CNN_CACHE_MAX_MODELS];
+	int num_entries;
+	uint64_t clock;
+	int prefetch_queue[VBX_CNN_CACHE_MAX_MODELS];
+	uint32_t prefetch_head;
+	uint32_t prefetch_tail;
+	int stop;
+	pthread_t loaders[VBX_CNN_CACHE_LOADERS];
+	int num_loaders;
+	pthread_mutex_t lock;
+	pthread_cond_t loaded;   //< signalled when a load finishes
+	pthread_cond_t work;     //< signalled when a prefetch is queued
+	vbx_cnn_wait_t* waits[VBX_CNN_CACHE_MAX_WAITS];  //< told when a model is evicted
+	int num_waits;
+	vbx_cnn_cache_stats_t stats;
+}vbx_cnn_cache_t;
+
+/**
+ * Create a model cache and its loader threads
+ *
+ * @param arena DMA memory the models are loaded into, used by nothing else
+ * @return The cache, or NULL on failure
+ */
+vbx_cnn_cache_t* vbx_cnn_cache_init(vbx_dma_arena_t* arena);
+
+/**
+ * Stop the loader threads and free every model. None may be running.
+ */
+void vbx_cnn_cache_free(vbx_cnn_cache_t* cache);
+
+/**
+ * Add a model to the catalog. Nothing is read until it is acquired or
+ * prefetched.
+ *
+ * @param filename Path of the .vnnx file
+ * @return Index of the model in the cache, or -1 if the catalog is full
+ */
+int vbx_cnn_cache_add(vbx_cnn_cache_t* cache,const char* filename);
+
+/**
+ * As vbx_cnn_cache_add(), for a model stored at offset in an open file
+ * such as a bundle. The descriptor must stay open for the life of the cache.
+ *
+ * @param size Bytes of the model in the file
+ */
+int vbx_cnn_cache_add_fd(vbx_cnn_cache_t* cache,int fd,off_t offset,size_t size);
+
+/**
+ * Have wait drop its estimate for each model the cache evicts, as the next
+ * model may be loaded at the same address. Add every wait the cached
+ * models are run with.
+ *
+ * @return 0 on success, -1 if VBX_CNN_CACHE_MAX_WAITS are already added
+ */
+int vbx_cnn_cache_add_wait(vbx_cnn_cache_t* cache,vbx_cnn_wait_t* wait);
+
+/**
+ * Pin a model, loading it first if it isn't resident. Waits for a
+ * prefetch of the same model rather than loading it twice.
+ *
+ * @param cache The cache to use
+ * @param index Returned by vbx_cnn_cache_add()
+ * @return The model, or NULL if it can't be read, or doesn't fit even
+ *         after evicting every model that isn't pinned
+ */
+model_t* vbx_cnn_cache_acquire(vbx_cnn_cache_t* cache,int index);
+
+/**
+ * Unpin a model acquired with vbx_cnn_cache_acquire(). It stays resident
+ * until evicted, and must not be run after its last release.
+ */
+void vbx_cnn_cache_release(vbx_cnn_cache_t* cache,int index);
+
+/**
+ * Load a model in the background if it isn't resident. Models are
+ * loaded in the order queued, up to VBX_CNN_CACHE_LOADERS at once, and
+ * may evict models that aren't pinned.
+ *
+ * @return 0 if queued or already resident, -1 if the queue is full
+ */
+int vbx_cnn_cache_prefetch(vbx_cnn_cache_t* cache,int index);
+
+void vbx_cnn_cache_get_stats(vbx_cnn_cache_t* cache,vbx_cnn_cache_stats_t* stats);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_CACHE_H
@@ -0,0 +1,54 @@
+/*!
+ * \file
+ * \brief Completion notifications
+ *
+ * The core's interrupt is exposed as a file descriptor that becomes readable
+ * (POLLIN) when a model finishes or the core faults, so it can sit in the same
+ * poll()/epoll() set as cameras, sockets and timers instead of a thread
+ * blocking in vbx_cnn_model_wfi(). After it wakes, an event loop calls
+ * vbx_cnn_completion_ack(), retires finished models with vbx_cnn_model_poll(),
+ * then vbx_cnn_completion_rearm(). vbx_cnn_queue_drain() does all three.
+ * Wakeups may be spurious; treat them as a hint to poll.
+ * @code{.cpp}
+ *  ev.events = EPOLLIN;
+ *  epoll_ctl(epfd,EPOLL_CTL_ADD,vbx_cnn_get_completion_fd(vbx_cnn),&ev);
+ *  ...
+ *  n = vbx_cnn_queue_drain(queue,job_ids,statuses,MAX_JOBS);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_COMPLETION_H
+#define VBX_CNN_COMPLETION_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @param vbx_cnn The vbx_cnn object to use
+ * @return The UIO device fd on the SoC, a timerfd with the register model,
+ *         or -1 if the build has no pollable interrupt
+ */
+int vbx_cnn_get_completion_fd(vbx_cnn_t* vbx_cnn);
+
+/**
+ * Consume a pending notification without blocking
+ *
+ * @param vbx_cnn The vbx_cnn object to use
+ * @return 1 if a notification was consumed, 0 if none was pending
+ */
+int vbx_cnn_completion_ack(vbx_cnn_t* vbx_cnn);
+
+/**
+ * Re-enable the interrupt once OUTPUT_VALID has been cleared
+ *
+ * @param vbx_cnn The vbx_cnn object to use
+ * @return 0 on success, -1 on failure
+ */
+int vbx_cnn_completion_rearm(vbx_cnn_t* vbx_cnn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_COMPLETION_H
@@ -0,0 +1,98 @@
+/*!
+ * \file
+ * \brief Submission contexts
+ *
+ * vbx_cnn_model_start() shares one io table between all callers, and
+ * vbx_cnn_queue_t assumes it is the only one starting models. A context
+ * instead lets each thread or pipeline prepare and start its own jobs:
+ * it owns its io tables and, optionally, a private slice of the DMA region,
+ * so only the few register writes that hand a job to the core are
+ * serialized. Completions are counted once for the whole core, so any
+ * context's poll retires the jobs of all of them.
+ * A context should be used by one thread at a time. Mixing contexts with
+ * vbx_cnn_queue_t or vbx_cnn_model_wfi() on the same core is not supported.
+ * Part of vbx_cnn_api.c, so not available with libvbx_cnn_sim.
+ * @code{.cpp}
+ *  //in each thread
+ *  vbx_cnn_ctx_t* ctx = vbx_cnn_ctx_init(vbx_cnn,4<<20,"camera");
+ *  io_buffers[0] = (vbx_cnn_io_ptr_t)vbx_cnn_ctx_allocate_dma_buffer(ctx,input_bytes,0);
+ *  ...
+ *  while((job = vbx_cnn_ctx_model_start(ctx,model,io_buffers)) < 0) sched_yield();
+ *  status = vbx_cnn_ctx_wait(ctx,job);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_CTX_H
+#define VBX_CNN_CTX_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if VBX_CNN_CONTEXTS
+typedef struct {
+	vbx_cnn_t* vbx_cnn;
+	vbx_dma_arena_t* dma_arena;   //< private slice of the DMA region, or NULL to share vbx_cnn's
+	vbx_cnn_io_ptr_t* io_tables[2];  //< alternated between jobs, so one can be filled while the other waits on the core
+	int next_table;
+}vbx_cnn_ctx_t;
+
+/**
+ * Create a submission context
+ *
+ * @param vbx_cnn The vbx_cnn object to use
+ * @param dma_bytes Size of the context's private slice of the DMA region,
+ *        0 to allocate from the shared region. Only the SoC and PCIe drivers
+ *        have a DMA arena to slice; elsewhere it is ignored.
+ * @param owner Name for the slice in the DMA arena statistics
+ * @return The context, or NULL on failure
+ */
+vbx_cnn_ctx_t* vbx_cnn_ctx_init(vbx_cnn_t* vbx_cnn,size_t dma_bytes,const char* owner);
+
+/**
+ * Free a context and everything allocated from its slice of the DMA region.
+ * Its jobs must have finished.
+ */
+void vbx_cnn_ctx_free(vbx_cnn_ctx_t* ctx);
+
+/**
+ * Allocate DMA memory from the context's slice, or from the shared region
+ * if it has none. Safe to call alongside other threads.
+ */
+void* vbx_cnn_ctx_allocate_dma_buffer(vbx_cnn_ctx_t* ctx,size_t request_size,size_t phys_alignment_bits);
+
+/**
+ * Hand a model run to the core without waiting for it.
+ * The io_buffers array is copied; the buffers it points to must stay
+ * valid until the job finishes.
+ *
+ * @param ctx The context to use
+ * @param model The model
+ * @param io_buffers Inputs followed by outputs, as for vbx_cnn_model_start()
+ * @return job id (>= 0), or -1 if the core can't take another model yet
+ */
+int vbx_cnn_ctx_model_start(vbx_cnn_ctx_t* ctx,model_t* model,vbx_cnn_io_ptr_t io_buffers[]);
+
+/**
+ * Check on a job started through any context, without blocking
+ *
+ * @param ctx The context to use
+ * @param job_id Returned by vbx_cnn_ctx_model_start()
+ * @return 1 while the job is running or queued, 0 once it has finished,
+ *         or the vbx_cnn_model_poll() error it failed with
+ */
+int vbx_cnn_ctx_poll(vbx_cnn_ctx_t* ctx,int job_id);
+
+/**
+ * Poll a job until it finishes, yielding the processor in between
+ *
+ * @return 0 once the job has finished, or the error it failed with
+ */
+int vbx_cnn_ctx_wait(vbx_cnn_ctx_t* ctx,int job_id);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_CTX_H
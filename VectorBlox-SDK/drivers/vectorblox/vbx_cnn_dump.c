@@ -0,0 +1,219 @@
+#include "vbx_cnn_dump.h"
+#include "vbx_cnn_io_info.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#define DUMP_IOV_BATCH 64
+
+//Tensor data goes to the kernel straight from the model and io buffers,
+//a batch of pieces per writev, rather than an fprintf per element.
+typedef struct {
+  int fd;
+  int count;
+  int err;
+  uint64_t written;
+  struct iovec iov[DUMP_IOV_BATCH];
+}dump_writer_t;
+
+static const uint8_t zero_pad[VBX_CNN_DUMP_ALIGN];
+
+static void flush(dump_writer_t* w){
+  struct iovec* iov = w->iov;
+  int count = w->count;
+  while(count && !w->err){
+    ssize_t got = writev(w->fd,iov,count);
+    if(got < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      w->err = 1;
+      break;
+    }
+    while(count && (size_t)got >= iov->iov_len){
+      got -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if(count){
+      iov->iov_base = (uint8_t*)iov->iov_base + got;
+      iov->iov_len -= got;
+    }
+  }
+  w->count = 0;
+}
+
+static void add(dump_writer_t* w,const void* data,size_t bytes){
+  if(!bytes){
+    return;
+  }
+  if(w->count == DUMP_IOV_BATCH){
+    flush(w);
+  }
+  w->iov[w->count].iov_base = (void*)data;
+  w->iov[w->count].iov_len = bytes;
+  w->count++;
+  w->written += bytes;
+}
+
+static void pad(dump_writer_t* w){
+  add(w,zero_pad,(VBX_CNN_DUMP_ALIGN - w->written%VBX_CNN_DUMP_ALIGN)%VBX_CNN_DUMP_ALIGN);
+}
+
+static uint64_t align_up(uint64_t bytes){
+  return (bytes + VBX_CNN_DUMP_ALIGN-1) & ~(uint64_t)(VBX_CNN_DUMP_ALIGN-1);
+}
+
+static int write_dump(const char* filename,vbx_cnn_dump_entry_t* entries,const void** data,int num_entries){
+  vbx_cnn_dump_header_t header = {VBX_CNN_DUMP_MAGIC,VBX_CNN_DUMP_VERSION,num_entries,0};
+  uint64_t offset = align_up(sizeof(header) + num_entries*sizeof(vbx_cnn_dump_entry_t));
+  for(int e=0;e<num_entries;e++){
+    entries[e].offset = offset;
+    offset = align_up(offset + entries[e].bytes);
+  }
+
+  dump_writer_t w;
+  memset(&w,0,sizeof(w));
+  w.fd = open(filename,O_WRONLY|O_CREAT|O_TRUNC,0644);
+  if(w.fd < 0){
+    return -1;
+  }
+  add(&w,&header,sizeof(header));
+  add(&w,entries,num_entries*sizeof(vbx_cnn_dump_entry_t));
+  for(int e=0;e<num_entries;e++){
+    pad(&w);
+    add(&w,data[e],entries[e].bytes);
+  }
+  pad(&w);
+  flush(&w);
+  if(close(w.fd) != 0){
+    w.err = 1;
+  }
+  return w.err ? -1 : 0;
+}
+
+static void set_shape(vbx_cnn_dump_entry_t* entry,const int* shape,int dims){
+  entry->dims = dims < SHAPE_DIMS ? dims : SHAPE_DIMS;
+  if(shape){
+    memcpy(entry->shape,shape,entry->dims*sizeof(int32_t));
+  }
+}
+
+int model_dump_io(const model_t* model,vbx_cnn_io_ptr_t* io_buffers,int use_int8,const char* filename){
+  int num_inputs = model_get_num_inputs(model);
+  int num_outputs = model_get_num_outputs(model);
+  int num_entries = num_inputs + num_outputs;
+  vbx_cnn_dump_entry_t* entries = (vbx_cnn_dump_entry_t*)calloc(num_entries,sizeof(vbx_cnn_dump_entry_t));
+  const void** data = (const void**)calloc(num_entries,sizeof(void*));
+  if(!entries || !data){
+    free(entries);
+    free(data);
+    return -1;
+  }
+  for(int i=0;i<num_inputs;i++){
+    vbx_cnn_dump_entry_t* entry = entries+i;
+    entry->node = -1;
+    entry->kind = VBX_CNN_DUMP_INPUT;
+    entry->index = i;
+    entry->datatype = model_get_input_datatype(model,i);
+    set_shape(entry,model_get_input_shape(model,i),model_get_input_dims(model,i));
+    entry->scale = model_get_input_scale_value(model,i);
+    entry->scale_fix16 = model_get_input_scale_fix16_value(model,i);
+    entry->zero_point = model_get_input_zeropoint(model,i);
+    size_t length = model_get_input_length(model,i);
+    if(!use_int8){
+      entry->datatype = VBX_CNN_CALC_TYPE_INT32;
+      entry->fix16 = 1;
+    }
+    entry->bytes = length*vbx_cnn_calc_type_size(entry->datatype);
+    data[i] = (const void*)(uintptr_t)io_buffers[i];
+  }
+  for(int o=0;o<num_outputs;o++){
+    vbx_cnn_dump_entry_t* entry = entries+num_inputs+o;
+    entry->node = -1;
+    entry->kind = VBX_CNN_DUMP_OUTPUT;
+    entry->index = o;
+    entry->datatype = model_get_output_datatype(model,o);
+    set_shape(entry,model_get_output_shape(model,o),model_get_output_dims(model,o));
+    entry->scale = model_get_output_scale_value(model,o);
+    entry->scale_fix16 = model_get_output_scale_fix16_value(model,o);
+    entry->zero_point = model_get_output_zeropoint(model,o);
+    size_t length = model_get_output_length(model,o);
+    if(!use_int8){
+      entry->datatype = VBX_CNN_CALC_TYPE_INT32;
+      entry->fix16 = 1;
+    }
+    entry->bytes = length*vbx_cnn_calc_type_size(entry->datatype);
+    data[num_inputs+o] = (const void*)(uintptr_t)io_buffers[num_inputs+o];
+  }
+  int status = write_dump(filename,entries,data,num_entries);
+  free(entries);
+  free(data);
+  return status;
+}
+
+static void node_entry(const vnnx_graph_t* graph,const vnnx_subgraph_node_t* node,int n,
+                       const vnnx_tensor_t* tensor,int kind,int index,
+                       vbx_cnn_dump_entry_t* entry,const void** data){
+  entry->node = n;
+  entry->kind = kind;
+  entry->index = index;
+  memcpy(entry->name,node->output_description,sizeof(entry->name));
+  entry->name[sizeof(entry->name)-1] = 0;
+  entry->datatype = tensor->type;
+  set_shape(entry,tensor->shape,tensor->dims);
+  entry->scale = tensor->scale;
+  entry->scale_fix16 = tensor->scale_f16;
+  entry->zero_point = tensor->zero;
+  size_t length = 1;
+  for(int d=0;d<entry->dims;d++){
+    if(tensor->shape[d] > 0){
+      length *= tensor->shape[d];
+    }
+  }
+  size_t bytes = length*vbx_cnn_calc_type_size((vbx_cnn_calc_type_e)tensor->type);
+  //leave out anything that is not inside the model's allocation
+  if(tensor->direct && tensor->direct < graph->allocate_bytes &&
+     bytes <= graph->allocate_bytes - tensor->direct){
+    entry->bytes = bytes;
+    *data = (const void*)((uintptr_t)graph + (uintptr_t)tensor->direct);
+  }
+}
+
+int model_dump_nodes(const model_t* model,const char* filename){
+  const vnnx_graph_t* graph = (const vnnx_graph_t*)model;
+  int num_entries = 0;
+  for(int n=0;n<graph->num_layers;n++){
+    num_entries += graph->subgraphs[n].num_inputs + graph->subgraphs[n].num_outputs;
+  }
+  vbx_cnn_dump_entry_t* entries = (vbx_cnn_dump_entry_t*)calloc(num_entries ? num_entries : 1,sizeof(vbx_cnn_dump_entry_t));
+  const void** data = (const void**)calloc(num_entries ? num_entries : 1,sizeof(void*));
+  if(!entries || !data){
+    free(entries);
+    free(data);
+    return -1;
+  }
+  int e = 0;
+  for(int n=0;n<graph->num_layers;n++){
+    const vnnx_subgraph_node_t* node = graph->subgraphs + n;
+    const vnnx_tensor_t* tensors = (const vnnx_tensor_t*)((uintptr_t)graph+(uintptr_t)node->tensors);
+    for(int i=0;i<node->num_inputs;i++,e++){
+      node_entry(graph,node,n,tensors+i,VBX_CNN_DUMP_INPUT,i,entries+e,data+e);
+    }
+    //outputs are the last tensors of the node, or of its last sublayer
+    int num_outputs = node->num_outputs;
+    if(node->num_sublayers > 0){
+      const vnnx_layer_t* sublayers = (const vnnx_layer_t*)((uintptr_t)graph+(uintptr_t)node->sublayers);
+      num_outputs = sublayers[node->num_sublayers-1].num_outputs;
+    }
+    for(int o=0;o<node->num_outputs;o++,e++){
+      node_entry(graph,node,n,tensors+node->num_tensors-num_outputs+o,VBX_CNN_DUMP_OUTPUT,o,entries+e,data+e);
+    }
+  }
+  int status = write_dump(filename,entries,data,num_entries);
+  free(entries);
+  free(data);
+  return status;
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file
+ * \brief Tensor Dumps
+ *
+ * A dump is one file: a header, an index entry per tensor, then the raw
+ * tensor data, each 64 byte aligned. It is written straight from the model
+ * and io buffers in a few large writes; example/host-c/vbx-dump lists it and
+ * converts it to JSON or .npy files on the host.
+ */
+
+#ifndef VBX_CNN_DUMP_H
+#define VBX_CNN_DUMP_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_DUMP_MAGIC 0x44584256 // "VBXD"
+#define VBX_CNN_DUMP_VERSION 1
+#define VBX_CNN_DUMP_ALIGN 64
+
+typedef enum {
+  VBX_CNN_DUMP_INPUT = 0,
+  VBX_CNN_DUMP_OUTPUT = 1
+}vbx_cnn_dump_kind_e;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_entries;
+  uint32_t reserved;
+}vbx_cnn_dump_header_t;
+
+typedef struct {
+  char name[48];     // node description, empty for model io
+  int32_t node;      // graph node, -1 for model io
+  int32_t kind;      // vbx_cnn_dump_kind_e
+  int32_t index;     // input or output index within the node or model
+  int32_t datatype;  // vbx_cnn_calc_type_e of the stored elements
+  int32_t fix16;     // non zero if elements are int32 fix16 rather than quantized values
+  int32_t dims;
+  int32_t shape[SHAPE_DIMS];
+  float scale;
+  int32_t scale_fix16;
+  int32_t zero_point;
+  int32_t reserved;
+  uint64_t offset;   // of the data, from the start of the file
+  uint64_t bytes;
+}vbx_cnn_dump_entry_t;
+
+/**
+ * Dump the inputs and outputs of a model run
+ *
+ * @param model The model that was run
+ * @param io_buffers The buffers passed to vbx_cnn_model_start(), inputs then outputs
+ * @param use_int8 0 if the output buffers have been converted to fix16
+ * @param filename File to write
+ * @return 0 on success, -1 if the file could not be written
+ */
+int model_dump_io(const model_t* model,vbx_cnn_io_ptr_t* io_buffers,int use_int8,const char* filename);
+
+/**
+ * Dump the input and output tensors of every node of a model, as left by
+ * the last run. The binary counterpart of model_get_debug_json(), which
+ * writes the same values one element at a time.
+ *
+ * @param model The model that was run
+ * @param filename File to write
+ * @return 0 on success, -1 if the file could not be written
+ */
+int model_dump_nodes(const model_t* model,const char* filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_DUMP_H
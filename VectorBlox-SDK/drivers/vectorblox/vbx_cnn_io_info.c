@@ -0,0 +1,72 @@
+#include "vbx_cnn_io_info.h"
+#include <string.h>
+
+size_t vbx_cnn_calc_type_size(vbx_cnn_calc_type_e datatype){
+  switch(datatype){
+  case VBX_CNN_CALC_TYPE_UINT8:
+  case VBX_CNN_CALC_TYPE_INT8:
+    return 1;
+  case VBX_CNN_CALC_TYPE_INT16:
+    return 2;
+  case VBX_CNN_CALC_TYPE_INT32:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+//the whole shape array is kept, not just dims of it; callers index
+//past dims on low rank tensors and get what the model stored there
+static void fill_shape(vbx_cnn_tensor_info_t* t,const int* shape){
+  if(shape){
+    memcpy(t->shape,shape,sizeof(t->shape));
+  }
+}
+
+//Only the public accessors are used, so this works the same against the
+//simulator library as against the driver.
+model_io_info_t* model_io_info_init(const model_t* model){
+  if(!model || model_check_sanity(model) != 0){
+    return NULL;
+  }
+  int num_inputs = model_get_num_inputs(model);
+  int num_outputs = model_get_num_outputs(model);
+  model_io_info_t* info = (model_io_info_t*)calloc(1,sizeof(model_io_info_t) +
+                                                   (num_inputs+num_outputs)*sizeof(vbx_cnn_tensor_info_t));
+  if(!info){
+    return NULL;
+  }
+  info->model = model;
+  info->num_inputs = num_inputs;
+  info->num_outputs = num_outputs;
+  info->inputs = (vbx_cnn_tensor_info_t*)(info+1);
+  info->outputs = info->inputs + num_inputs;
+
+  for(int i=0;i<num_inputs;i++){
+    vbx_cnn_tensor_info_t* t = info->inputs+i;
+    t->length = model_get_input_length(model,i);
+    t->datatype = model_get_input_datatype(model,i);
+    t->bytes = t->length*vbx_cnn_calc_type_size(t->datatype);
+    t->dims = model_get_input_dims(model,i);
+    fill_shape(t,model_get_input_shape(model,i));
+    t->scale = model_get_input_scale_value(model,i);
+    t->scale_fix16 = model_get_input_scale_fix16_value(model,i);
+    t->zero_point = model_get_input_zeropoint(model,i);
+  }
+  for(int o=0;o<num_outputs;o++){
+    vbx_cnn_tensor_info_t* t = info->outputs+o;
+    t->length = model_get_output_length(model,o);
+    t->datatype = model_get_output_datatype(model,o);
+    t->bytes = t->length*vbx_cnn_calc_type_size(t->datatype);
+    t->dims = model_get_output_dims(model,o);
+    fill_shape(t,model_get_output_shape(model,o));
+    t->scale = model_get_output_scale_value(model,o);
+    t->scale_fix16 = model_get_output_scale_fix16_value(model,o);
+    t->zero_point = model_get_output_zeropoint(model,o);
+  }
+  return info;
+}
+
+void model_io_info_free(model_io_info_t* info){
+  free(info);
+}
@@ -0,0 +1,69 @@
+/*!
+ * \file
+ * \brief Model IO Descriptors
+ *
+ * Every model_get_* accessor walks the graph to find its tensor.
+ * These are the same answers collected once, so per frame code can index
+ * them directly.
+ */
+
+#ifndef VBX_CNN_IO_INFO_H
+#define VBX_CNN_IO_INFO_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  size_t length;  // elements
+  size_t bytes;   // length * size of datatype
+  int dims;
+  int shape[SHAPE_DIMS];
+  vbx_cnn_calc_type_e datatype;
+  float scale;
+  int scale_fix16;
+  int zero_point;
+}vbx_cnn_tensor_info_t;
+
+typedef struct {
+  const model_t* model;
+  int num_inputs;
+  int num_outputs;
+  vbx_cnn_tensor_info_t* inputs;
+  vbx_cnn_tensor_info_t* outputs; // follows inputs in the same allocation
+}model_io_info_t;
+
+/**
+ * Collect the descriptors of every input and output of a model.
+ * Build once after loading the model and keep it for the life of the model.
+ *
+ * @param model The model to describe
+ * @return the descriptors, NULL on allocation failure or an insane model.
+ *         Release with model_io_info_free()
+ */
+model_io_info_t* model_io_info_init(const model_t* model);
+
+void model_io_info_free(model_io_info_t* info);
+
+/**
+ * Read the io descriptors of the model stored at offset in an open file,
+ * .vnnx or packed, without loading it. Only the header and the nodes and
+ * tensors of the inputs and outputs are read.
+ *
+ * @param size Bytes of the model in the file
+ * @return the descriptors, with model NULL until it is set to the model once
+ *         loaded, or NULL if the file can't be read or the model is not sane
+ */
+model_io_info_t* vbx_cnn_model_peek_io_info_fd(int fd,off_t offset,size_t size);
+
+/**
+ * Size in bytes of one element of datatype
+ * @return element size, 0 for VBX_CNN_CALC_TYPE_UNKNOWN
+ */
+size_t vbx_cnn_calc_type_size(vbx_cnn_calc_type_e datatype);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_IO_INFO_H
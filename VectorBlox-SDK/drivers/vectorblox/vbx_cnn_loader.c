@@ -0,0 +1,324 @@
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_packed.h"
+#include "vbx_cnn_io_info.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//Reads this large keep the syscall count down without holding up
+//the first bytes behind one huge request.
+#define LOAD_CHUNK_SIZE (4*1024*1024)
+
+static int read_fully(int fd,void* dst,size_t size,off_t offset){
+  uint8_t* p = (uint8_t*)dst;
+  while(size){
+    size_t request = size < LOAD_CHUNK_SIZE ? size : LOAD_CHUNK_SIZE;
+    ssize_t got = pread(fd,p,request,offset);
+    if(got < 0 && errno == EINTR){
+      continue;
+    }
+    if(got <= 0){
+      return -1;
+    }
+    p += got;
+    offset += got;
+    size -= got;
+  }
+  return 0;
+}
+
+//the chunk table follows the header; checked here so every chunk fits its buffer
+static uint64_t* read_chunk_table(int fd,off_t offset,size_t size,const vbx_cnn_packed_header_t* header){
+  size_t table_bytes = (header->num_chunks+1)*sizeof(uint64_t);
+  if(size < sizeof(*header) || table_bytes > size - sizeof(*header)){
+    return NULL;
+  }
+  uint64_t* offsets = (uint64_t*)malloc(table_bytes);
+  if(!offsets || read_fully(fd,offsets,table_bytes,offset+sizeof(*header)) != 0){
+    free(offsets);
+    return NULL;
+  }
+  if(offsets[0] < sizeof(*header)+table_bytes || offsets[header->num_chunks] > size){
+    free(offsets);
+    return NULL;
+  }
+  for(uint32_t c=0;c<header->num_chunks;c++){
+    if(offsets[c+1] <= offsets[c] || offsets[c+1] - offsets[c] > header->chunk_bytes){
+      free(offsets);
+      return NULL;
+    }
+  }
+  return offsets;
+}
+
+static int packed_header_ok(const vbx_cnn_packed_header_t* header){
+  return header->magic == VBX_CNN_PACKED_MAGIC && header->version == VBX_CNN_PACKED_VERSION &&
+    header->chunk_bytes && header->data_bytes >= sizeof(vnnx_graph_t) &&
+    header->num_chunks == (header->data_bytes + header->chunk_bytes - 1) / header->chunk_bytes &&
+    header->allocate_bytes >= header->data_bytes;
+}
+
+typedef struct {
+  int fd;
+  off_t offset;
+  const vbx_cnn_packed_header_t* header;
+  const uint64_t* offsets;
+  uint8_t* dst;
+  uint32_t next_chunk;
+  int failed;
+}unpack_t;
+
+//Chunk c into its place in dst, through buffer unless it was stored as is
+static int unpack_chunk(int fd,off_t offset,const vbx_cnn_packed_header_t* header,const uint64_t* offsets,
+                        uint32_t c,uint8_t* dst,uint8_t* buffer){
+  size_t begin = (size_t)c*header->chunk_bytes;
+  size_t bytes = header->data_bytes - begin < header->chunk_bytes ? header->data_bytes - begin : header->chunk_bytes;
+  size_t stored = offsets[c+1] - offsets[c];
+  off_t from = offset + offsets[c];
+  if(stored == bytes){
+    return read_fully(fd,dst+begin,bytes,from);
+  }
+  return read_fully(fd,buffer,stored,from) || vbx_cnn_lz_decompress(buffer,stored,dst+begin,bytes);
+}
+
+//Each thread claims the next chunk and reads it into its own buffer, or
+//straight into place if it was stored as is, then decompresses it into place.
+static void* unpack_chunks(void* arg){
+  unpack_t* unpack = (unpack_t*)arg;
+  const vbx_cnn_packed_header_t* header = unpack->header;
+  uint8_t* buffer = (uint8_t*)malloc(header->chunk_bytes);
+  if(!buffer){
+    __atomic_store_n(&unpack->failed,1,__ATOMIC_RELAXED);
+    return NULL;
+  }
+  while(!__atomic_load_n(&unpack->failed,__ATOMIC_RELAXED)){
+    uint32_t c = __atomic_fetch_add(&unpack->next_chunk,1,__ATOMIC_RELAXED);
+    if(c >= header->num_chunks){
+      break;
+    }
+    if(unpack_chunk(unpack->fd,unpack->offset,header,unpack->offsets,c,unpack->dst,buffer)){
+      __atomic_store_n(&unpack->failed,1,__ATOMIC_RELAXED);
+    }
+  }
+  free(buffer);
+  return NULL;
+}
+
+int vbx_cnn_packed_read_fd(int fd,off_t offset,size_t size,void* dst,int threads){
+  vbx_cnn_packed_header_t header;
+  if(size < sizeof(header) || read_fully(fd,&header,sizeof(header),offset) != 0 || !packed_header_ok(&header)){
+    return -1;
+  }
+  uint64_t* offsets = read_chunk_table(fd,offset,size,&header);
+  if(!offsets){
+    return -1;
+  }
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd,offset,size,POSIX_FADV_WILLNEED);
+#endif
+  unpack_t unpack = {fd,offset,&header,offsets,(uint8_t*)dst,0,0};
+#if VBX_CNN_CONTEXTS
+  pthread_t workers[VBX_CNN_PACKED_THREADS];
+  int started = 0;
+  if(threads > VBX_CNN_PACKED_THREADS){
+    threads = VBX_CNN_PACKED_THREADS;
+  }
+  //this thread is one of them
+  while(started < threads-1 && started < (int)header.num_chunks-1 &&
+        pthread_create(workers+started,NULL,unpack_chunks,&unpack) == 0){
+    started++;
+  }
+  unpack_chunks(&unpack);
+  for(int t=0;t<started;t++){
+    pthread_join(workers[t],NULL);
+  }
+#else
+  unpack_chunks(&unpack);
+#endif
+  free(offsets);
+  return unpack.failed ? -1 : 0;
+}
+
+size_t vbx_cnn_model_peek_fd(int fd,off_t offset,size_t size){
+  //the header says how big the model is once loaded,
+  //so the DMA buffer can be allocated before any of it is read
+  union {
+    vnnx_graph_t graph;
+    vbx_cnn_packed_header_t packed;
+  }header;
+  size_t header_bytes = size < sizeof(header) ? size : sizeof(header);
+  if(header_bytes < sizeof(header.packed) || read_fully(fd,&header,header_bytes,offset) != 0){
+    return 0;
+  }
+  if(header.packed.magic == VBX_CNN_PACKED_MAGIC){
+    return packed_header_ok(&header.packed) ? header.packed.allocate_bytes : 0;
+  }
+  if(header_bytes < sizeof(header.graph) || model_check_sanity((model_t*)&header.graph) != 0){
+    return 0;
+  }
+  size_t data_bytes = model_get_data_bytes((model_t*)&header.graph);
+  size_t allocate_bytes = model_get_allocate_bytes((model_t*)&header.graph);
+  if(data_bytes != size || allocate_bytes < data_bytes){
+    return 0;
+  }
+  return allocate_bytes;
+}
+
+int vbx_cnn_model_read_fd(int fd,off_t offset,size_t size,model_t* model){
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd,offset,size,POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(fd,offset,size,POSIX_FADV_WILLNEED);
+#endif
+  //Only the model's data bytes are written; like the copy it replaces,
+  //the rest of the allocation is working space the core initializes itself,
+  //so none of it needs clearing first.
+  uint32_t magic;
+  if(size < sizeof(magic) || read_fully(fd,&magic,sizeof(magic),offset) != 0){
+    return -1;
+  }
+  int err;
+  if(magic == VBX_CNN_PACKED_MAGIC){
+    err = vbx_cnn_packed_read_fd(fd,offset,size,model,VBX_CNN_PACKED_THREADS);
+  }else{
+    err = read_fully(fd,model,size,offset);
+  }
+  if(err || model_check_sanity(model) != 0){
+    return -1;
+  }
+  return 0;
+}
+
+//The parts of a stored model the io descriptors are read from, each put in
+//its place in a host copy of the model that is otherwise never filled in
+typedef struct {
+  int fd;
+  off_t offset;
+  size_t data_bytes;
+  uint8_t* dst;
+  vbx_cnn_packed_header_t header;  //magic 0 unless the model is packed
+  uint64_t* offsets;
+  uint8_t* chunk;
+  uint8_t* unpacked;               //per chunk, 1 once it is in dst
+}io_peek_t;
+
+static int peek_range(io_peek_t* peek,uint64_t begin,uint64_t bytes){
+  if(begin > peek->data_bytes || bytes > peek->data_bytes - begin){
+    return -1;
+  }
+  if(!peek->header.magic){
+    return read_fully(peek->fd,peek->dst+begin,bytes,peek->offset+begin);
+  }
+  for(uint64_t c=begin/peek->header.chunk_bytes;bytes && c<=(begin+bytes-1)/peek->header.chunk_bytes;c++){
+    if(!peek->unpacked[c]){
+      if(unpack_chunk(peek->fd,peek->offset,&peek->header,peek->offsets,c,peek->dst,peek->chunk)){
+        return -1;
+      }
+      peek->unpacked[c] = 1;
+    }
+  }
+  return 0;
+}
+
+//the header, then for each input and output the node and the tensor describing it
+static int peek_io(io_peek_t* peek){
+  const vnnx_graph_t* graph = (const vnnx_graph_t*)peek->dst;
+  if(peek_range(peek,0,sizeof(vnnx_graph_t)) || model_check_sanity((const model_t*)graph) != 0){
+    return -1;
+  }
+  uint64_t num_io = (uint64_t)graph->num_inputs + graph->num_outputs;
+  if(peek_range(peek,graph->io_nodes,num_io*sizeof(int32_t)) ||
+     peek_range(peek,graph->io_offsets,num_io*sizeof(int32_t))){
+    return -1;
+  }
+  const int32_t* io_nodes = (const int32_t*)(peek->dst + graph->io_nodes);
+  const int32_t* io_offsets = (const int32_t*)(peek->dst + graph->io_offsets);
+  for(uint64_t i=0;i<num_io;i++){
+    if(io_nodes[i] < 0 || io_offsets[i] < 0){
+      return -1;
+    }
+    uint64_t node_offset = offsetof(vnnx_graph_t,subgraphs) + (uint64_t)io_nodes[i]*sizeof(vnnx_subgraph_node_t);
+    if(peek_range(peek,node_offset,sizeof(vnnx_subgraph_node_t))){
+      return -1;
+    }
+    const vnnx_subgraph_node_t* node = (const vnnx_subgraph_node_t*)(peek->dst + node_offset);
+    if(peek_range(peek,node->tensors + (uint64_t)io_offsets[i]*sizeof(vnnx_tensor_t),sizeof(vnnx_tensor_t))){
+      return -1;
+    }
+  }
+  return 0;
+}
+
+model_io_info_t* vbx_cnn_model_peek_io_info_fd(int fd,off_t offset,size_t size){
+  io_peek_t peek;
+  memset(&peek,0,sizeof(peek));
+  peek.fd = fd;
+  peek.offset = offset;
+  uint32_t magic;
+  if(size < sizeof(magic) || read_fully(fd,&magic,sizeof(magic),offset) != 0){
+    return NULL;
+  }
+  model_io_info_t* info = NULL;
+  if(magic == VBX_CNN_PACKED_MAGIC){
+    if(read_fully(fd,&peek.header,sizeof(peek.header),offset) != 0 || !packed_header_ok(&peek.header) ||
+       !(peek.offsets = read_chunk_table(fd,offset,size,&peek.header))){
+      return NULL;
+    }
+    peek.data_bytes = peek.header.data_bytes;
+    peek.chunk = (uint8_t*)malloc(peek.header.chunk_bytes);
+    peek.unpacked = (uint8_t*)calloc(peek.header.num_chunks,1);
+  }else{
+    peek.data_bytes = size;
+  }
+  //only the pages read into are ever touched
+  peek.dst = (uint8_t*)calloc(1,peek.data_bytes);
+  if(peek.dst && (!peek.header.magic || (peek.chunk && peek.unpacked)) && peek_io(&peek) == 0 &&
+     model_get_data_bytes((const model_t*)peek.dst) == peek.data_bytes){
+    info = model_io_info_init((const model_t*)peek.dst);
+  }
+  if(info){
+    info->model = NULL;
+  }
+  free(peek.dst);
+  free(peek.unpacked);
+  free(peek.chunk);
+  free(peek.offsets);
+  return info;
+}
+
+model_t* vbx_cnn_model_load_fd(vbx_cnn_t* vbx_cnn,int fd,off_t offset,size_t size){
+  size_t allocate_bytes = vbx_cnn_model_peek_fd(fd,offset,size);
+  if(!allocate_bytes){
+    return NULL;
+  }
+  //page aligned, so the kernel copies whole pages straight into the mapping
+  model_t* model = (model_t*)vbx_allocate_dma_buffer_flags(vbx_cnn,allocate_bytes,12,0);
+  if(!model){
+    return NULL;
+  }
+  if(vbx_cnn_model_read_fd(fd,offset,size,model) != 0){
+#if VBX_SOC_DRIVER || SPLASHKIT_PCIE
+    vbx_free_dma_buffer(vbx_cnn,model);
+#endif
+    return NULL;
+  }
+  return model;
+}
+
+model_t* vbx_cnn_model_load(vbx_cnn_t* vbx_cnn,const char* filename){
+  int fd = open(filename,O_RDONLY);
+  if(fd < 0){
+    return NULL;
+  }
+  struct stat st;
+  model_t* model = NULL;
+  if(fstat(fd,&st) == 0){
+    model = vbx_cnn_model_load_fd(vbx_cnn,fd,0,st.st_size);
+  }
+  close(fd);
+  return model;
+}
@@ -0,0 +1,53 @@
+/*!
+ * \file
+ * \brief Loading .vnnx models into DMA memory
+ */
+
+#ifndef VBX_CNN_LOADER_H
+#define VBX_CNN_LOADER_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Load a .vnnx model file into DMA memory.
+ * The size is taken from the model header, the buffer is allocated once and
+ * the file is read straight into it; there is no copy through host memory.
+ *
+ * @param vbx_cnn The vbx_cnn object to allocate from
+ * @param filename Path of the .vnnx file
+ * @return The model, ready for vbx_cnn_model_start(), or NULL if the file can't
+ *         be read, is not a sane model, or does not fit
+ */
+model_t* vbx_cnn_model_load(vbx_cnn_t* vbx_cnn,const char* filename);
+
+/**
+ * As vbx_cnn_model_load(), for a model stored at offset in an open file
+ *
+ * @param size Bytes of the model in the file
+ */
+model_t* vbx_cnn_model_load_fd(vbx_cnn_t* vbx_cnn,int fd,off_t offset,size_t size);
+
+/**
+ * Check the model stored at offset in an open file, without loading it
+ *
+ * @param size Bytes of the model in the file
+ * @return Bytes of DMA memory the model needs once loaded, or 0 if it is
+ *         not a sane model
+ */
+size_t vbx_cnn_model_peek_fd(int fd,off_t offset,size_t size);
+
+/**
+ * Read a model checked by vbx_cnn_model_peek_fd() into memory the caller
+ * allocated, page aligned and at least as large as that returned
+ *
+ * @return 0 on success, -1 if the file can't be read or the model is not sane
+ */
+int vbx_cnn_model_read_fd(int fd,off_t offset,size_t size,model_t* model);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_LOADER_H
@@ -0,0 +1,210 @@
+#include "vbx_cnn_packed.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Each sequence is a token, literal bytes, then a copy from earlier output:
+//  token          literal length in the high nibble, match length-4 in the low,
+//                 15 meaning more length bytes follow, each added until one isn't 255
+//  literals
+//  offset         2 bytes, little endian, back from the current output
+//The last sequence is literals only. Matches don't start in the last 12 bytes
+//or reach the last 5, so a decoder can copy in whole words.
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+static uint32_t read32(const uint8_t* p){
+  uint32_t v;
+  memcpy(&v,p,sizeof(v));
+  return v;
+}
+
+static uint32_t lz_hash(uint32_t v){
+  return (v*2654435761u) >> (32-LZ_HASH_BITS);
+}
+
+static uint8_t* put_length(uint8_t* op,uint8_t* oend,size_t len){
+  for(len-=15;len >= 255;len-=255){
+    if(op >= oend){
+      return NULL;
+    }
+    *op++ = 255;
+  }
+  if(op >= oend){
+    return NULL;
+  }
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+//match_bytes 0 for the closing literals
+static uint8_t* put_sequence(uint8_t* op,uint8_t* oend,const uint8_t* literals,size_t literal_bytes,
+                             size_t offset,size_t match_bytes){
+  if(op >= oend){
+    return NULL;
+  }
+  uint8_t* token = op++;
+  *token = (literal_bytes < 15 ? literal_bytes : 15) << 4;
+  if(literal_bytes >= 15 && !(op = put_length(op,oend,literal_bytes))){
+    return NULL;
+  }
+  if((size_t)(oend-op) < literal_bytes){
+    return NULL;
+  }
+  memcpy(op,literals,literal_bytes);
+  op += literal_bytes;
+  if(!match_bytes){
+    return op;
+  }
+  if(oend-op < 2){
+    return NULL;
+  }
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  match_bytes -= LZ_MIN_MATCH;
+  *token |= match_bytes < 15 ? match_bytes : 15;
+  if(match_bytes >= 15 && !(op = put_length(op,oend,match_bytes))){
+    return NULL;
+  }
+  return op;
+}
+
+//Greedy, one hash probe per position: packing happens once, on the host,
+//so the byte codes are kept simple for the loader rather than tight.
+size_t vbx_cnn_lz_compress(const uint8_t* src,size_t src_bytes,uint8_t* dst,size_t dst_capacity){
+  uint32_t table[1 << LZ_HASH_BITS];
+  memset(table,0,sizeof(table));
+  const uint8_t* ip = src;
+  const uint8_t* anchor = src;
+  const uint8_t* end = src + src_bytes;
+  const uint8_t* match_limit = src_bytes > LZ_MATCH_LIMIT ? end - LZ_MATCH_LIMIT : src;
+  uint8_t* op = dst;
+  uint8_t* oend = dst + dst_capacity;
+  while(ip < match_limit){
+    uint32_t h = lz_hash(read32(ip));
+    const uint8_t* ref = src + table[h];
+    table[h] = ip - src;
+    if(ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(ref) != read32(ip)){
+      ip++;
+      continue;
+    }
+    size_t match_bytes = LZ_MIN_MATCH;
+    while(ip + match_bytes < end - LZ_LAST_LITERALS && ref[match_bytes] == ip[match_bytes]){
+      match_bytes++;
+    }
+    op = put_sequence(op,oend,anchor,ip-anchor,ip-ref,match_bytes);
+    if(!op){
+      return 0;
+    }
+    ip += match_bytes;
+    anchor = ip;
+  }
+  op = put_sequence(op,oend,anchor,end-anchor,0,0);
+  return op ? (size_t)(op-dst) : 0;
+}
+
+static int get_length(const uint8_t** ip,const uint8_t* iend,size_t* len){
+  uint8_t b;
+  do{
+    if(*ip >= iend){
+      return -1;
+    }
+    b = *(*ip)++;
+    *len += b;
+  }while(b == 255);
+  return 0;
+}
+
+int vbx_cnn_lz_decompress(const uint8_t* src,size_t src_bytes,uint8_t* dst,size_t dst_bytes){
+  const uint8_t* ip = src;
+  const uint8_t* iend = src + src_bytes;
+  uint8_t* op = dst;
+  uint8_t* oend = dst + dst_bytes;
+  while(ip < iend){
+    uint8_t token = *ip++;
+    size_t len = token >> 4;
+    if(len == 15 && get_length(&ip,iend,&len) != 0){
+      return -1;
+    }
+    if(len > (size_t)(iend-ip) || len > (size_t)(oend-op)){
+      return -1;
+    }
+    memcpy(op,ip,len);
+    op += len;
+    ip += len;
+    if(ip == iend){
+      break;
+    }
+    if(iend-ip < 2){
+      return -1;
+    }
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if(!offset || offset > (size_t)(op-dst)){
+      return -1;
+    }
+    len = token & 15;
+    if(len == 15 && get_length(&ip,iend,&len) != 0){
+      return -1;
+    }
+    len += LZ_MIN_MATCH;
+    if(len > (size_t)(oend-op)){
+      return -1;
+    }
+    const uint8_t* ref = op - offset;
+    if(offset >= len){
+      memcpy(op,ref,len);
+      op += len;
+    }else{
+      //an overlapping copy repeats the offset bytes before it: copy them
+      //once, then keep doubling what has been copied, whole repeats each time
+      memcpy(op,ref,offset);
+      size_t done = offset;
+      while(done < len){
+        size_t n = done < len - done ? done : len - done;
+        memcpy(op+done,op,n);
+        done += n;
+      }
+      op += len;
+    }
+  }
+  return op == oend ? 0 : -1;
+}
+
+void* vbx_cnn_packed_compress(const model_t* model,size_t* packed_bytes){
+  size_t data_bytes = model_get_data_bytes((model_t*)model);
+  uint32_t num_chunks = (data_bytes + VBX_CNN_PACKED_CHUNK - 1) / VBX_CNN_PACKED_CHUNK;
+  size_t table_bytes = sizeof(vbx_cnn_packed_header_t) + (num_chunks+1)*sizeof(uint64_t);
+  //never larger than storing every chunk as is
+  uint8_t* image = (uint8_t*)malloc(table_bytes + data_bytes);
+  if(!image){
+    return NULL;
+  }
+  vbx_cnn_packed_header_t* header = (vbx_cnn_packed_header_t*)image;
+  header->magic = VBX_CNN_PACKED_MAGIC;
+  header->version = VBX_CNN_PACKED_VERSION;
+  header->chunk_bytes = VBX_CNN_PACKED_CHUNK;
+  header->num_chunks = num_chunks;
+  header->data_bytes = data_bytes;
+  header->allocate_bytes = model_get_allocate_bytes((model_t*)model);
+  uint64_t* offsets = (uint64_t*)(header + 1);
+  const uint8_t* data = (const uint8_t*)model;
+  size_t offset = table_bytes;
+  for(uint32_t c=0;c<num_chunks;c++){
+    size_t begin = (size_t)c*VBX_CNN_PACKED_CHUNK;
+    size_t bytes = data_bytes - begin < VBX_CNN_PACKED_CHUNK ? data_bytes - begin : VBX_CNN_PACKED_CHUNK;
+    offsets[c] = offset;
+    //a chunk that comes out no smaller is stored as is
+    size_t packed = vbx_cnn_lz_compress(data+begin,bytes,image+offset,bytes-1);
+    if(!packed){
+      memcpy(image+offset,data+begin,bytes);
+      packed = bytes;
+    }
+    offset += packed;
+  }
+  offsets[num_chunks] = offset;
+  *packed_bytes = offset;
+  return image;
+}
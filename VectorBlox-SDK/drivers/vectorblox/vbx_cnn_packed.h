@@ -0,0 +1,74 @@
+/*!
+ * \file
+ * \brief Compressed Models
+ *
+ * A .vbxz file is a model cut into chunks that are compressed separately
+ * (LZ4 style byte codes), so it is read in far fewer bytes and can be
+ * decompressed by several threads at once, each chunk straight into its
+ * place in the model's DMA buffer; no full size copy is made. A chunk that
+ * doesn't compress is stored as is and read straight into place.
+ * vbx_cnn_model_load(), vbx_cnn_model_load_fd(), the model cache and
+ * bundles take .vbxz files wherever they take a .vnnx.
+ * example/host-c/vbx-pack makes them.
+ *
+ * The header is followed by num_chunks+1 uint64_t offsets, from the start
+ * of the header; chunk c is stored in [offset[c],offset[c+1]).
+ */
+
+#ifndef VBX_CNN_PACKED_H
+#define VBX_CNN_PACKED_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_PACKED_MAGIC 0x5a584256 // "VBXZ"
+#define VBX_CNN_PACKED_VERSION 1
+#define VBX_CNN_PACKED_CHUNK (256*1024)
+#define VBX_CNN_PACKED_THREADS 4 // chunks the loaders decompress at once
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t chunk_bytes;     // decompressed bytes per chunk, the last may be short
+  uint32_t num_chunks;
+  uint64_t data_bytes;      // of the model, as model_get_data_bytes()
+  uint64_t allocate_bytes;  // as model_get_allocate_bytes()
+}vbx_cnn_packed_header_t;
+
+/**
+ * Compress a model into a .vbxz image
+ *
+ * @param model The model, as read from its .vnnx
+ * @param packed_bytes Set to the size of the image
+ * @return The image, to be released with free(), or NULL on allocation failure
+ */
+void* vbx_cnn_packed_compress(const model_t* model,size_t* packed_bytes);
+
+/**
+ * Decompress the .vbxz image at offset in an open file into dst
+ *
+ * @param size Bytes of the image in the file
+ * @param dst At least data_bytes from the header
+ * @param threads Chunks to decompress at once
+ * @return 0 on success, -1 if the file can't be read or is corrupt
+ */
+int vbx_cnn_packed_read_fd(int fd,off_t offset,size_t size,void* dst,int threads);
+
+/**
+ * Compress src into at most dst_capacity bytes
+ * @return Bytes written, or 0 if they don't fit
+ */
+size_t vbx_cnn_lz_compress(const uint8_t* src,size_t src_bytes,uint8_t* dst,size_t dst_capacity);
+
+/**
+ * Decompress src, which must produce exactly dst_bytes
+ * @return 0 on success, -1 if src is corrupt
+ */
+int vbx_cnn_lz_decompress(const uint8_t* src,size_t src_bytes,uint8_t* dst,size_t dst_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_PACKED_H
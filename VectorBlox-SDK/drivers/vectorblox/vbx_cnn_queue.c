@@ -0,0 +1,290 @@
+#include "vbx_cnn_queue.h"
+#include "vbx_cnn_batch.h"
+#include "vbx_cnn_trace.h"
+#include <string.h>
+
+//The core holds one running model plus one queued in its start registers,
+//so never hand it more than this many jobs at a time.
+#define VBX_CNN_CORE_SLOTS 2
+
+//Sequence numbers only ever increase; a job lives in jobs[seq % depth].
+//  [head,retired)  finished, waiting to be collected by vbx_cnn_queue_complete
+//  [retired,issue) handed to the core, oldest first
+//  [issue,tail)    submitted, not yet started
+static inline vbx_cnn_job_t* job_at(vbx_cnn_queue_t* queue, uint32_t seq){
+  return queue->jobs + (seq % queue->depth);
+}
+
+static void retire_in_flight(vbx_cnn_queue_t* queue,int status){
+  while(queue->retired != queue->issue){
+    job_at(queue,queue->retired)->status = status;
+    queue->retired++;
+  }
+  vbx_cnn_trace_counter("queue in flight",0);
+}
+
+//The core hung or faulted on the oldest job handed to it. Reset it, then
+//give that job another go or fail it; the one queued behind it never ran,
+//so it goes back to waiting with the rest.
+static void recover(vbx_cnn_queue_t* queue,int status){
+  vbx_cnn_watchdog_stats_t* stats = &queue->watchdog;
+  vbx_cnn_trace_instant(status == VBX_CNN_TIMED_OUT ? "watchdog timeout" : "watchdog error");
+  queue->reset(queue->vbx_cnn);
+  queue->retire_ns = vbx_cnn_wait_time_ns();
+  stats->resets++;
+  if(queue->retired == queue->issue){
+    return;
+  }
+  vbx_cnn_job_t* job = job_at(queue,queue->retired);
+  if(status == VBX_CNN_TIMED_OUT){
+    stats->timeouts++;
+  }else{
+    stats->errors++;
+  }
+  if(++job->attempts > queue->max_retries){
+    job->status = status;
+    queue->retired++;
+    stats->failed++;
+  }else{
+    stats->requeued++;
+  }
+  queue->issue = queue->retired;
+  vbx_cnn_trace_counter("queue in flight",0);
+}
+
+//the oldest job handed to the core has run past the deadline; one queued
+//behind another only starts running once that one is done
+static int overdue(vbx_cnn_queue_t* queue,uint64_t now){
+  vbx_cnn_job_t* job = job_at(queue,queue->retired);
+  uint64_t start_ns = job->start_ns > queue->retire_ns ? job->start_ns : queue->retire_ns;
+  return now > start_ns && now - start_ns > queue->timeout_ns;
+}
+
+//Handle a vbx_cnn_model_poll() result that isn't "still running".
+//Returns nonzero once nothing more can be retired.
+static int retire(vbx_cnn_queue_t* queue,int status){
+  queue->retire_ns = vbx_cnn_wait_time_ns();
+  if(status == 0){
+    //poll cleared output_valid for exactly one model
+    job_at(queue,queue->retired)->status = 0;
+    queue->retired++;
+    vbx_cnn_trace_counter("queue in flight",queue->issue - queue->retired);
+    return 0;
+  }
+  if(status == -2){
+    //core idle with nothing valid: every job it was given has finished
+    retire_in_flight(queue,0);
+    return 1;
+  }
+  if(queue->timeout_ns){
+    recover(queue,status);
+    return 1;
+  }
+  //core error or in reset, nothing on it or behind it will complete
+  queue->issue = queue->tail;
+  retire_in_flight(queue,status);
+  return 1;
+}
+
+vbx_cnn_queue_t* vbx_cnn_queue_init(vbx_cnn_t* vbx_cnn,int depth){
+  if(depth < 1){
+    return NULL;
+  }
+  vbx_cnn_queue_t* queue = (vbx_cnn_queue_t*)malloc(sizeof(vbx_cnn_queue_t));
+  if(!queue){
+    return NULL;
+  }
+  queue->jobs = (vbx_cnn_job_t*)calloc(depth,sizeof(vbx_cnn_job_t));
+  if(!queue->jobs){
+    free(queue);
+    return NULL;
+  }
+  queue->vbx_cnn = vbx_cnn;
+  queue->depth = depth;
+  queue->head = 0;
+  queue->retired = 0;
+  queue->issue = 0;
+  queue->tail = 0;
+  queue->wait = NULL;
+  queue->retire_ns = 0;
+  queue->timeout_ns = 0;
+  queue->max_retries = 0;
+  queue->reset = NULL;
+  memset(&queue->watchdog,0,sizeof(queue->watchdog));
+  return queue;
+}
+
+void vbx_cnn_queue_free(vbx_cnn_queue_t* queue){
+  if(queue){
+    free(queue->jobs);
+    free(queue);
+  }
+}
+
+int vbx_cnn_queue_service(vbx_cnn_queue_t* queue){
+  int err = 0;
+  //retire whatever the core has finished, oldest first
+  while(queue->retired != queue->issue){
+    //read the clock first, so a poll that was late getting to the core
+    //can't make a job look overdue
+    uint64_t now = queue->timeout_ns ? vbx_cnn_wait_time_ns() : 0;
+    int status = vbx_cnn_model_poll(queue->vbx_cnn);
+    if(status > 0){
+      if(queue->timeout_ns && overdue(queue,now)){
+        recover(queue,VBX_CNN_TIMED_OUT);
+      }
+      break;
+    }
+    if(retire(queue,status)){
+      err = status == -2 || queue->timeout_ns ? 0 : status;
+      break;
+    }
+  }
+  if(err){
+    return err;
+  }
+
+  //keep the core's next-model slot filled
+  int recovered = 0;
+  while(queue->issue != queue->tail &&
+        queue->issue - queue->retired < VBX_CNN_CORE_SLOTS){
+    vbx_cnn_state_e state = vbx_cnn_get_state(queue->vbx_cnn);
+    if(state == ERROR && queue->timeout_ns && queue->issue == queue->retired && !recovered){
+      //faulted with nothing of ours on it
+      recover(queue,-1);
+      recovered = 1;
+      continue;
+    }
+    if(state != READY && state != RUNNING_READY){
+      break;
+    }
+    vbx_cnn_job_t* job = job_at(queue,queue->issue);
+    if(vbx_cnn_model_start(queue->vbx_cnn,job->model,job->io_buffers) != 0){
+      break;
+    }
+    job->start_ns = vbx_cnn_wait_time_ns();
+    queue->issue++;
+    vbx_cnn_trace_counter("queue in flight",queue->issue - queue->retired);
+  }
+  return 0;
+}
+
+int vbx_cnn_queue_submit(vbx_cnn_queue_t* queue,model_t* model,vbx_cnn_io_ptr_t io_buffers[]){
+  size_t num_io_buffers = model_get_num_inputs(model)+model_get_num_outputs(model);
+  if(num_io_buffers > MAX_IO_BUFFERS){
+    return -1;
+  }
+  if(queue->tail - queue->head >= (uint32_t)queue->depth){
+    //make room if the core has finished something nobody has collected yet
+    vbx_cnn_queue_service(queue);
+    if(queue->tail - queue->head >= (uint32_t)queue->depth){
+      return -1;
+    }
+  }
+  uint32_t seq = queue->tail;
+  vbx_cnn_job_t* job = job_at(queue,seq);
+  job->model = model;
+  memcpy(job->io_buffers,io_buffers,num_io_buffers*sizeof(vbx_cnn_io_ptr_t));
+  job->status = 1;
+  job->attempts = 0;
+  queue->tail++;
+  vbx_cnn_trace_counter("queue pending",queue->tail - queue->head);
+  vbx_cnn_queue_service(queue);
+  return (int)(seq & VBX_CNN_JOB_ID_MASK);
+}
+
+int vbx_cnn_queue_complete(vbx_cnn_queue_t* queue,int* status){
+  vbx_cnn_queue_service(queue);
+  if(queue->head == queue->retired){
+    return -1;
+  }
+  uint32_t seq = queue->head++;
+  vbx_cnn_trace_counter("queue pending",queue->tail - queue->head);
+  if(status){
+    *status = job_at(queue,seq)->status;
+  }
+  return (int)(seq & VBX_CNN_JOB_ID_MASK);
+}
+
+int vbx_cnn_queue_wait(vbx_cnn_queue_t* queue,int* status){
+  if(queue->head == queue->tail){
+    return -1;
+  }
+  int job_id;
+  while((job_id = vbx_cnn_queue_complete(queue,status)) < 0){
+    if(queue->wait && queue->retired != queue->issue){
+      //a job queued behind another only starts running once that one is done
+      vbx_cnn_job_t* job = job_at(queue,queue->retired);
+      uint64_t start_ns = job->start_ns > queue->retire_ns ? job->start_ns : queue->retire_ns;
+      uint64_t deadline_ns = queue->timeout_ns ? start_ns + queue->timeout_ns : 0;
+      int poll_status = vbx_cnn_wait_model_until(queue->wait,job->model,start_ns,deadline_ns);
+      //still running at the deadline is left to vbx_cnn_queue_service()
+      if(poll_status <= 0){
+        retire(queue,poll_status);
+      }
+    }
+  }
+  return job_id;
+}
+
+int vbx_cnn_queue_pending(vbx_cnn_queue_t* queue){
+  return (int)(queue->tail - queue->head);
+}
+
+void vbx_cnn_queue_set_wait(vbx_cnn_queue_t* queue,vbx_cnn_wait_t* wait){
+  queue->wait = wait;
+}
+
+int vbx_cnn_queue_submit_batch(vbx_cnn_queue_t* queue,model_t* model,const vbx_cnn_io_ptr_t* io_sets,int count,int* first_job){
+  size_t num_io_buffers = model_get_num_inputs(model)+model_get_num_outputs(model);
+  if(num_io_buffers > MAX_IO_BUFFERS || count < 0){
+    return -1;
+  }
+  if(first_job){
+    *first_job = (int)(queue->tail & VBX_CNN_JOB_ID_MASK);
+  }
+  if(queue->tail - queue->head + count > (uint32_t)queue->depth){
+    vbx_cnn_queue_service(queue);
+  }
+  //every job goes in before the core is looked at, once, for all of them
+  int queued = 0;
+  while(queued < count && queue->tail - queue->head < (uint32_t)queue->depth){
+    vbx_cnn_job_t* job = job_at(queue,queue->tail);
+    job->model = model;
+    memcpy(job->io_buffers,io_sets + queued*num_io_buffers,num_io_buffers*sizeof(vbx_cnn_io_ptr_t));
+    job->status = 1;
+    job->attempts = 0;
+    queue->tail++;
+    queued++;
+  }
+  if(queued){
+    vbx_cnn_trace_counter("queue pending",queue->tail - queue->head);
+    vbx_cnn_queue_service(queue);
+  }
+  return queued;
+}
+
+int vbx_cnn_queue_run_batch(vbx_cnn_queue_t* queue,model_t* model,const vbx_cnn_io_ptr_t* io_sets,int count,
+                            void (*done)(void* arg,int index,int status),void* arg){
+  size_t num_io_buffers = model_get_num_inputs(model)+model_get_num_outputs(model);
+  if(num_io_buffers > MAX_IO_BUFFERS || count < 0 || queue->head != queue->tail){
+    return -1;
+  }
+  vbx_cnn_trace_begin("batch");
+  int submitted = 0;
+  int failed = 0;
+  for(int index=0;index<count;index++){
+    //top up before each wait, so the core never runs dry behind a callback
+    submitted += vbx_cnn_queue_submit_batch(queue,model,io_sets + submitted*num_io_buffers,count-submitted,NULL);
+    int status = -1;
+    vbx_cnn_queue_wait(queue,&status);
+    if(status){
+      failed++;
+    }
+    if(done){
+      done(arg,index,status);
+    }
+  }
+  vbx_cnn_trace_end("batch");
+  return failed;
+}
@@ -0,0 +1,160 @@
+/*!
+ * \file
+ * \brief Inference job queue
+ *
+ * Jobs are submitted without waiting for the core; the queue starts them
+ * as soon as the core can accept a model, keeping its next-model slot full,
+ * and hands back finished jobs in submission order.
+ * The queue only uses the calls in vbx_cnn_api.h, so it runs the same way on hardware
+ * and against the simulator.
+ * @code{.cpp}
+ *  vbx_cnn_queue_t* queue = vbx_cnn_queue_init(vbx_cnn,4);
+ *  while (input = get_input()){
+      io_buffers[0] = input;
+      while(vbx_cnn_queue_submit(queue,model,io_buffers) < 0){
+        job = vbx_cnn_queue_wait(queue,&status);
+        consume_output(job,status);
+      }
+   }
+   while((job = vbx_cnn_queue_wait(queue,&status)) >= 0) consume_output(job,status);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_QUEUE_H
+#define VBX_CNN_QUEUE_H
+#include "vbx_cnn_wait.h"
+#include "vbx_cnn_reset.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_JOB_ID_MASK 0x7fffffff
+typedef struct {
+	model_t* model;
+	vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS];
+	int status;
+	uint64_t start_ns;
+	int attempts;          //< times the watchdog has reset the core while this job was running
+}vbx_cnn_job_t;
+
+typedef struct {
+	uint32_t timeouts;     //< jobs still running at their deadline
+	uint32_t errors;       //< jobs the core raised an error on
+	uint32_t resets;       //< soft resets to recover the core
+	uint32_t requeued;     //< jobs started again after a reset
+	uint32_t failed;       //< jobs given up on after max_retries
+}vbx_cnn_watchdog_stats_t;
+
+typedef struct {
+	vbx_cnn_t* vbx_cnn;
+	vbx_cnn_job_t* jobs;
+	int depth;
+	uint32_t head;
+	uint32_t retired;
+	uint32_t issue;
+	uint32_t tail;
+	vbx_cnn_wait_t* wait;
+	uint64_t retire_ns;
+	uint64_t timeout_ns;
+	int max_retries;
+	int (*reset)(vbx_cnn_t*);
+	vbx_cnn_watchdog_stats_t watchdog;
+}vbx_cnn_queue_t;
+
+/**
+ * Create a job queue in front of the core
+ *
+ * @param vbx_cnn The vbx_cnn object to use
+ * @param depth Maximum number of jobs submitted but not yet collected
+ * @return The queue, or NULL on failure
+ */
+vbx_cnn_queue_t* vbx_cnn_queue_init(vbx_cnn_t* vbx_cnn,int depth);
+void vbx_cnn_queue_free(vbx_cnn_queue_t* queue);
+
+/**
+ * Queue a model run. The io_buffers array is copied, so the caller may
+ * reuse it immediately; the buffers it points to must stay valid until
+ * the job is collected.
+ *
+ * @param queue The queue to use
+ * @param model The model
+ * @param io_buffers Inputs followed by outputs, as for vbx_cnn_model_start()
+ * @return job id (>= 0), or -1 if the queue is full
+ */
+int vbx_cnn_queue_submit(vbx_cnn_queue_t* queue,model_t* model,vbx_cnn_io_ptr_t io_buffers[]);
+
+/**
+ * Collect the oldest finished job without blocking
+ *
+ * @param queue The queue to use
+ * @param status Set to 0 if the job ran, or the vbx_cnn_model_poll() error
+ * @return job id of the finished job, or -1 if the oldest job is not done
+ */
+int vbx_cnn_queue_complete(vbx_cnn_queue_t* queue,int* status);
+
+/**
+ * Block until the oldest job finishes and collect it
+ *
+ * @param queue The queue to use
+ * @param status Set to 0 if the job ran, or the vbx_cnn_model_poll() error
+ * @return job id of the finished job, or -1 if the queue is empty
+ */
+int vbx_cnn_queue_wait(vbx_cnn_queue_t* queue,int* status);
+
+/**
+ * Retire finished jobs and start queued ones. Called by every queue
+ * function, and may be called from an idle loop to refill the core sooner.
+ *
+ * @param queue The queue to use
+ * @return 0, or the vbx_cnn_model_poll() error that failed the running jobs
+ */
+int vbx_cnn_queue_service(vbx_cnn_queue_t* queue);
+
+/**
+ * @param queue The queue to use
+ * @return number of jobs submitted and not yet collected
+ */
+int vbx_cnn_queue_pending(vbx_cnn_queue_t* queue);
+
+/**
+ * Have vbx_cnn_queue_wait() sleep through jobs using wait's estimates,
+ * instead of polling continuously.
+ *
+ * @param queue The queue to use
+ * @param wait The wait policy, or NULL to poll
+ */
+void vbx_cnn_queue_set_wait(vbx_cnn_queue_t* queue,vbx_cnn_wait_t* wait);
+
+/**
+ * Collect every finished job without blocking, for event loops woken by
+ * vbx_cnn_get_completion_fd(). Acknowledges and re-arms the notification.
+ * Part of vbx_cnn_api.c, so not available with libvbx_cnn_sim.
+ *
+ * @param queue The queue to use
+ * @param job_ids Filled with the ids of the collected jobs, oldest first
+ * @param statuses Filled with each job's status, may be NULL
+ * @param max_jobs Size of job_ids and statuses
+ * @return number of jobs collected
+ */
+int vbx_cnn_queue_drain(vbx_cnn_queue_t* queue,int* job_ids,int* statuses,int max_jobs);
+
+/**
+ * Give every job a deadline of timeout_us from when it starts running.
+ * A job still running at its deadline, or one the core raises an error on,
+ * has the core soft reset with vbx_cnn_reset(). It is then started again,
+ * up to max_retries times, after which it completes with VBX_CNN_TIMED_OUT
+ * or the error status. Jobs queued behind it are started again without
+ * counting against them. Counts are kept in queue->watchdog.
+ * Lives in vbx_cnn_api.c, so not available with libvbx_cnn_sim.
+ *
+ * @param queue The queue to use
+ * @param timeout_us Longest a job may run, 0 to turn the watchdog off
+ * @param max_retries Resets a job may be started again after
+ */
+void vbx_cnn_queue_set_watchdog(vbx_cnn_queue_t* queue,uint32_t timeout_us,int max_retries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_QUEUE_H
@@ -0,0 +1,403 @@
+#define _GNU_SOURCE
+#include "vbx_cnn_reg_model.h"
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+//register layout and control bits, must match vbx_cnn_api.c
+#define CTRL_OFFSET 0
+#define ERR_OFFSET 1
+#define MODEL_OFFSET 4
+#define IO_OFFSET 6
+
+#define CTRL_REG_SOFT_RESET 0x00000001
+#define CTRL_REG_START 0x00000002
+#define CTRL_REG_RUNNING 0x00000004
+#define CTRL_REG_OUTPUT_VALID 0x00000008
+#define CTRL_REG_ERROR 0x00000010
+
+//a hung model's run time, long enough that only a reset ends it
+#define HANG_NS (3600ull*1000000000ull)
+
+typedef struct {
+  model_t* model;
+  uint32_t latency_us;
+}latency_entry_t;
+
+typedef int (*sim_model_start_fn)(vbx_cnn_t*,model_t*,vbx_cnn_io_ptr_t[]);
+typedef int (*sim_model_poll_fn)(vbx_cnn_t*);
+typedef vbx_cnn_err_e (*sim_get_error_fn)(vbx_cnn_t*);
+
+struct vbx_cnn_reg_model{
+  //must stay first, the driver only ever sees a pointer to the registers
+  uint32_t regs[VBX_CNN_REG_MODEL_NUM_REGS];
+  pthread_mutex_t lock;
+
+  uint32_t default_latency_us;
+  uint32_t jitter_pct;
+  unsigned int seed;
+  latency_entry_t* latencies;
+  int num_latencies;
+  int hangs;
+
+  //the core runs one model and holds one more behind it, like the hardware
+  int in_reset;
+  int output_valid;
+  int error;
+  int running;
+  uint64_t running_start_ns;
+  uint64_t running_end_ns;
+  int pending;
+  uint64_t pending_latency_ns;
+
+  //stands in for the UIO interrupt, readable once OUTPUT_VALID would be set
+  int timer_fd;
+  uint64_t armed_ns;
+  int fd_acked;
+
+  vbx_cnn_reg_model_run_fn run;
+  void* run_arg;
+
+  void* sim_lib;
+  vbx_cnn_t* sim_cnn;
+  sim_model_start_fn sim_model_start;
+  sim_model_poll_fn sim_model_poll;
+  sim_get_error_fn sim_get_error;
+
+  vbx_cnn_reg_model_stats_t stats;
+};
+
+static uint64_t now_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+static inline vbx_cnn_reg_model_t* from_regs(volatile uint32_t* regs){
+  return (vbx_cnn_reg_model_t*)regs;
+}
+
+static uint32_t lookup_latency_us(vbx_cnn_reg_model_t* rm,model_t* model){
+  for(int i=0;i<rm->num_latencies;i++){
+    if(rm->latencies[i].model == model){
+      return rm->latencies[i].latency_us;
+    }
+  }
+  return rm->default_latency_us;
+}
+
+//retire every model that has finished by now, starting the held one behind it
+static void advance(vbx_cnn_reg_model_t* rm,uint64_t now){
+  while(rm->running && rm->running_end_ns <= now){
+    rm->stats.models_completed++;
+    rm->stats.busy_ns += rm->running_end_ns - rm->running_start_ns;
+    rm->output_valid = 1;
+    if(rm->pending){
+      rm->pending = 0;
+      rm->running_start_ns = rm->running_end_ns;
+      rm->running_end_ns += rm->pending_latency_ns;
+      rm->stats.models_started++;
+    }else{
+      rm->running = 0;
+    }
+  }
+}
+
+//Keep the timer in step with the core, behaving like a level interrupt on
+//OUTPUT_VALID or ERROR: it fires when the running model is due, or straight
+//away while either bit is set. Re-arming discards expirations nobody has read
+//yet, so once it has fired it is left alone until vbx_cnn_reg_model_fd_ack()
+//reads it, the way the UIO interrupt stays pending until it is read.
+static void arm_timer(vbx_cnn_reg_model_t* rm,uint64_t now){
+  uint64_t when = 0;
+  int fired = rm->armed_ns && rm->armed_ns <= now;
+  if(fired && !rm->fd_acked){
+    return;
+  }
+  if(rm->output_valid || rm->error){
+    if(fired){
+      //already fired for this completion
+      return;
+    }
+    when = 1;
+  }else if(rm->running){
+    when = rm->running_end_ns;
+  }
+  if(when == rm->armed_ns){
+    return;
+  }
+  struct itimerspec its = {{0,0},{when/1000000000ull,when%1000000000ull}};
+  timerfd_settime(rm->timer_fd,TFD_TIMER_ABSTIME,&its,NULL);
+  rm->armed_ns = when;
+  rm->fd_acked = 0;
+}
+
+static void soft_reset(vbx_cnn_reg_model_t* rm){
+  rm->in_reset = 1;
+  rm->output_valid = 0;
+  rm->error = 0;
+  rm->running = 0;
+  rm->pending = 0;
+  rm->regs[ERR_OFFSET] = 0;
+}
+
+static void raise_error(vbx_cnn_reg_model_t* rm,uint32_t err){
+  rm->error = 1;
+  rm->running = 0;
+  rm->pending = 0;
+  rm->regs[ERR_OFFSET] = err;
+}
+
+static void start_model(vbx_cnn_reg_model_t* rm){
+  uint64_t model_addr = rm->regs[MODEL_OFFSET] | ((uint64_t)rm->regs[MODEL_OFFSET+1]<<32);
+  uint64_t io_addr = rm->regs[IO_OFFSET] | ((uint64_t)rm->regs[IO_OFFSET+1]<<32);
+  model_t* model = (model_t*)(uintptr_t)model_addr;
+  if(rm->error || rm->in_reset || (rm->running && rm->pending)){
+    //a real core ignores START while it can't accept a model
+    return;
+  }
+  if(rm->run){
+    //timing starts once the functional model is done, so its cost
+    //shows up as driver time rather than stretching the modelled latency
+    int err = rm->run(rm->run_arg,model,(vbx_cnn_io_ptr_t*)(uintptr_t)io_addr);
+    if(err){
+      raise_error(rm,err);
+      return;
+    }
+  }
+  uint64_t now = now_ns();
+  advance(rm,now);
+  uint64_t latency_ns = (uint64_t)lookup_latency_us(rm,model)*1000;
+  if(rm->jitter_pct){
+    int64_t spread = (int64_t)(latency_ns*rm->jitter_pct/100);
+    latency_ns += (int64_t)(rand_r(&rm->seed) % (2*spread+1)) - spread;
+  }
+  if(rm->hangs){
+    rm->hangs--;
+    latency_ns = HANG_NS;
+  }
+  if(!rm->running){
+    rm->running = 1;
+    rm->running_start_ns = now;
+    rm->running_end_ns = now + latency_ns;
+    rm->stats.models_started++;
+  }else{
+    rm->pending = 1;
+    rm->pending_latency_ns = latency_ns;
+  }
+}
+
+static uint32_t ctrl_value(vbx_cnn_reg_model_t* rm){
+  uint32_t ctrl = 0;
+  if(rm->in_reset) ctrl |= CTRL_REG_SOFT_RESET;
+  if(rm->pending) ctrl |= CTRL_REG_START;
+  if(rm->running) ctrl |= CTRL_REG_RUNNING;
+  if(rm->output_valid) ctrl |= CTRL_REG_OUTPUT_VALID;
+  if(rm->error) ctrl |= CTRL_REG_ERROR;
+  return ctrl;
+}
+
+uint32_t vbx_cnn_reg_model_read(volatile uint32_t* regs,int offset){
+  vbx_cnn_reg_model_t* rm = from_regs(regs);
+  uint32_t val;
+  pthread_mutex_lock(&rm->lock);
+  rm->stats.reg_reads++;
+  if(offset == CTRL_OFFSET){
+    uint64_t now = now_ns();
+    advance(rm,now);
+    arm_timer(rm,now);
+    val = ctrl_value(rm);
+  }else{
+    val = rm->regs[offset];
+  }
+  pthread_mutex_unlock(&rm->lock);
+  return val;
+}
+
+void vbx_cnn_reg_model_write(volatile uint32_t* regs,int offset,uint32_t val){
+  vbx_cnn_reg_model_t* rm = from_regs(regs);
+  pthread_mutex_lock(&rm->lock);
+  rm->stats.reg_writes++;
+  if(offset != CTRL_OFFSET){
+    rm->regs[offset] = val;
+  }else if(val & CTRL_REG_SOFT_RESET){
+    soft_reset(rm);
+  }else{
+    if(val == 0){
+      rm->in_reset = 0;
+    }
+    if(val & CTRL_REG_OUTPUT_VALID){
+      //write 1 to clear, anything finished since the last read is cleared too
+      advance(rm,now_ns());
+      rm->output_valid = 0;
+    }
+    if(val & CTRL_REG_START){
+      start_model(rm);
+    }
+  }
+  if(offset == CTRL_OFFSET){
+    arm_timer(rm,now_ns());
+  }
+  pthread_mutex_unlock(&rm->lock);
+}
+
+vbx_cnn_reg_model_t* vbx_cnn_reg_model_init(uint32_t default_latency_us){
+  vbx_cnn_reg_model_t* rm = (vbx_cnn_reg_model_t*)calloc(1,sizeof(vbx_cnn_reg_model_t));
+  if(!rm){
+    return NULL;
+  }
+  rm->timer_fd = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC);
+  if(rm->timer_fd < 0){
+    free(rm);
+    return NULL;
+  }
+  pthread_mutex_init(&rm->lock,NULL);
+  rm->default_latency_us = default_latency_us;
+  rm->seed = 1;
+  rm->in_reset = 1;
+  return rm;
+}
+
+void vbx_cnn_reg_model_free(vbx_cnn_reg_model_t* rm){
+  if(!rm){
+    return;
+  }
+  if(rm->sim_lib){
+    dlclose(rm->sim_lib);
+  }
+  close(rm->timer_fd);
+  pthread_mutex_destroy(&rm->lock);
+  free(rm->latencies);
+  free(rm);
+}
+
+void* vbx_cnn_reg_model_regs(vbx_cnn_reg_model_t* rm){
+  return rm->regs;
+}
+
+int vbx_cnn_reg_model_set_latency(vbx_cnn_reg_model_t* rm,model_t* model,uint32_t latency_us){
+  int ret = 0;
+  pthread_mutex_lock(&rm->lock);
+  int i;
+  for(i=0;i<rm->num_latencies;i++){
+    if(rm->latencies[i].model == model){
+      break;
+    }
+  }
+  if(i == rm->num_latencies){
+    latency_entry_t* latencies = (latency_entry_t*)realloc(rm->latencies,(i+1)*sizeof(latency_entry_t));
+    if(!latencies){
+      ret = -1;
+    }else{
+      rm->latencies = latencies;
+      rm->latencies[i].model = model;
+      rm->num_latencies++;
+    }
+  }
+  if(ret == 0){
+    rm->latencies[i].latency_us = latency_us;
+  }
+  pthread_mutex_unlock(&rm->lock);
+  return ret;
+}
+
+void vbx_cnn_reg_model_set_jitter(vbx_cnn_reg_model_t* rm,uint32_t jitter_pct){
+  pthread_mutex_lock(&rm->lock);
+  rm->jitter_pct = jitter_pct < 100 ? jitter_pct : 99;
+  pthread_mutex_unlock(&rm->lock);
+}
+
+void vbx_cnn_reg_model_set_run_hook(vbx_cnn_reg_model_t* rm,vbx_cnn_reg_model_run_fn run,void* arg){
+  pthread_mutex_lock(&rm->lock);
+  rm->run = run;
+  rm->run_arg = arg;
+  pthread_mutex_unlock(&rm->lock);
+}
+
+static int sim_run(void* arg,model_t* model,vbx_cnn_io_ptr_t io_buffers[]){
+  vbx_cnn_reg_model_t* rm = (vbx_cnn_reg_model_t*)arg;
+  if(rm->sim_model_start(rm->sim_cnn,model,io_buffers) != 0){
+    return MODEL_BLOB_INVALID;
+  }
+  int status;
+  while((status = rm->sim_model_poll(rm->sim_cnn)) > 0);
+  if(status == 0 || status == -2){
+    return 0;
+  }
+  int err = rm->sim_get_error ? (int)rm->sim_get_error(rm->sim_cnn) : 0;
+  return err ? err : MODEL_BLOB_INVALID;
+}
+
+int vbx_cnn_reg_model_attach_sim(vbx_cnn_reg_model_t* rm,const char* lib_path){
+  //DEEPBIND keeps the library resolving its own vbx_cnn_* symbols
+  //instead of binding to the driver's
+  void* lib = dlopen(lib_path,RTLD_NOW|RTLD_LOCAL|RTLD_DEEPBIND);
+  if(!lib){
+    return -1;
+  }
+  vbx_cnn_t* (*sim_init)(void*) = (vbx_cnn_t* (*)(void*))dlsym(lib,"vbx_cnn_init");
+  rm->sim_model_start = (sim_model_start_fn)dlsym(lib,"vbx_cnn_model_start");
+  rm->sim_model_poll = (sim_model_poll_fn)dlsym(lib,"vbx_cnn_model_poll");
+  rm->sim_get_error = (sim_get_error_fn)dlsym(lib,"vbx_cnn_get_error_val");
+  if(!sim_init || !rm->sim_model_start || !rm->sim_model_poll){
+    dlclose(lib);
+    return -1;
+  }
+  rm->sim_cnn = sim_init(NULL);
+  if(!rm->sim_cnn){
+    dlclose(lib);
+    return -1;
+  }
+  rm->sim_lib = lib;
+  vbx_cnn_reg_model_set_run_hook(rm,sim_run,rm);
+  return 0;
+}
+
+int vbx_cnn_reg_model_fd(volatile uint32_t* regs){
+  return from_regs(regs)->timer_fd;
+}
+
+int vbx_cnn_reg_model_fd_ack(volatile uint32_t* regs){
+  vbx_cnn_reg_model_t* rm = from_regs(regs);
+  uint64_t expirations;
+  pthread_mutex_lock(&rm->lock);
+  int acked = read(rm->timer_fd,&expirations,sizeof(expirations)) == sizeof(expirations);
+  if(acked){
+    rm->fd_acked = 1;
+  }
+  pthread_mutex_unlock(&rm->lock);
+  return acked;
+}
+
+void vbx_cnn_reg_model_inject_hang(vbx_cnn_reg_model_t* rm,int num_models){
+  pthread_mutex_lock(&rm->lock);
+  rm->hangs += num_models;
+  pthread_mutex_unlock(&rm->lock);
+}
+
+void vbx_cnn_reg_model_inject_error(vbx_cnn_reg_model_t* rm,vbx_cnn_err_e err){
+  pthread_mutex_lock(&rm->lock);
+  raise_error(rm,err);
+  arm_timer(rm,now_ns());
+  pthread_mutex_unlock(&rm->lock);
+}
+
+void vbx_cnn_reg_model_get_stats(vbx_cnn_reg_model_t* rm,vbx_cnn_reg_model_stats_t* stats){
+  pthread_mutex_lock(&rm->lock);
+  *stats = rm->stats;
+  pthread_mutex_unlock(&rm->lock);
+}
+
+//Host stand-in for the uncached DDR allocator vbx_allocate_dma_buffer
+//uses outside the SoC driver.
+void* ddr_uncached_allocate(size_t size){
+  void* ptr;
+  if(posix_memalign(&ptr,4096,size) != 0){
+    return NULL;
+  }
+  memset(ptr,0,size);
+  return ptr;
+}
@@ -0,0 +1,112 @@
+/*!
+ * \file
+ * \brief Software model of the VectorBlox CNN control registers
+ *
+ * Stands in for the memory mapped S_control port so the driver, the job
+ * queue and application pipelines can be run and profiled on any Linux host.
+ * Build vbx_cnn_api.c with -DVBX_CNN_REG_MODEL and hand the register block to
+ * vbx_cnn_init():
+ * @code{.c}
+ *  vbx_cnn_reg_model_t* reg_model = vbx_cnn_reg_model_init(2000);
+ *  vbx_cnn_reg_model_set_latency(reg_model,model,8500);
+ *  vbx_cnn_t* vbx_cnn = vbx_cnn_init(vbx_cnn_reg_model_regs(reg_model));
+ * @endcode
+ *
+ * Model completions are timed from CLOCK_MONOTONIC; no thread runs behind the
+ * registers, the model catches up whenever a register is accessed.
+ */
+
+#ifndef VBX_CNN_REG_MODEL_H
+#define VBX_CNN_REG_MODEL_H
+#include <stdint.h>
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_REG_MODEL_NUM_REGS 16
+
+struct vbx_cnn_reg_model;
+typedef struct vbx_cnn_reg_model vbx_cnn_reg_model_t;
+
+/**
+ * Functional hook, called when the core picks up a model.
+ *
+ * @param arg The arg given to vbx_cnn_reg_model_set_run_hook()
+ * @param model Address written to the model register
+ * @param io_buffers Address written to the io register
+ * @return 0 on success, otherwise the value to report in the error register
+ */
+typedef int (*vbx_cnn_reg_model_run_fn)(void* arg,model_t* model,vbx_cnn_io_ptr_t io_buffers[]);
+
+typedef struct {
+	uint64_t reg_reads;
+	uint64_t reg_writes;
+	uint64_t models_started;
+	uint64_t models_completed;
+	uint64_t busy_ns;          //< time spent with a model running
+}vbx_cnn_reg_model_stats_t;
+
+/**
+ * @param default_latency_us Run time of models without an entry set by
+ *        vbx_cnn_reg_model_set_latency()
+ * @return The register model, or NULL on failure
+ */
+vbx_cnn_reg_model_t* vbx_cnn_reg_model_init(uint32_t default_latency_us);
+void vbx_cnn_reg_model_free(vbx_cnn_reg_model_t* reg_model);
+
+/**
+ * @return The register block to pass to vbx_cnn_init()
+ */
+void* vbx_cnn_reg_model_regs(vbx_cnn_reg_model_t* reg_model);
+
+/**
+ * Set how long model takes from being picked up to setting OUTPUT_VALID
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int vbx_cnn_reg_model_set_latency(vbx_cnn_reg_model_t* reg_model,model_t* model,uint32_t latency_us);
+
+/**
+ * Vary every model's latency uniformly by up to +/- jitter_pct percent,
+ * for a spread of run times like the real core's
+ */
+void vbx_cnn_reg_model_set_jitter(vbx_cnn_reg_model_t* reg_model,uint32_t jitter_pct);
+
+void vbx_cnn_reg_model_set_run_hook(vbx_cnn_reg_model_t* reg_model,vbx_cnn_reg_model_run_fn run,void* arg);
+
+/**
+ * Run models through libvbx_cnn_sim as they are picked up, so outputs
+ * are bit-accurate as well as timed. The library is opened privately so its
+ * copy of the API does not clash with the driver's.
+ *
+ * @param lib_path Path to libvbx_cnn_sim.so
+ * @return 0 on success, -1 if the library or its symbols can't be loaded
+ */
+int vbx_cnn_reg_model_attach_sim(vbx_cnn_reg_model_t* reg_model,const char* lib_path);
+
+/**
+ * Raise the error bit as the core would on a fault.
+ * Cleared by soft reset.
+ */
+void vbx_cnn_reg_model_inject_error(vbx_cnn_reg_model_t* reg_model,vbx_cnn_err_e err);
+
+/**
+ * Have the next num_models models picked up never finish, as a core
+ * stuck on a bad descriptor would. Only a soft reset gets it going again.
+ */
+void vbx_cnn_reg_model_inject_hang(vbx_cnn_reg_model_t* reg_model,int num_models);
+
+void vbx_cnn_reg_model_get_stats(vbx_cnn_reg_model_t* reg_model,vbx_cnn_reg_model_stats_t* stats);
+
+//register backend used by vbx_cnn_api.c when built with VBX_CNN_REG_MODEL
+uint32_t vbx_cnn_reg_model_read(volatile uint32_t* regs,int offset);
+void vbx_cnn_reg_model_write(volatile uint32_t* regs,int offset,uint32_t val);
+int vbx_cnn_reg_model_fd(volatile uint32_t* regs);
+int vbx_cnn_reg_model_fd_ack(volatile uint32_t* regs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_REG_MODEL_H
@@ -0,0 +1,44 @@
+/*!
+ * \file
+ * \brief Recovering a core that has hung or faulted
+ */
+
+#ifndef VBX_CNN_RESET_H
+#define VBX_CNN_RESET_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Status of a model that was still running when its deadline passed
+ */
+#define VBX_CNN_TIMED_OUT -4
+
+/**
+ * Soft reset the core, as vbx_cnn_init() does, dropping the running model
+ * and the one queued behind it along with any completion not yet taken.
+ * Contexts see their jobs on the core fail with -3.
+ * Part of vbx_cnn_api.c, so not available with libvbx_cnn_sim.
+ *
+ * @param vbx_cnn The vbx_cnn object to use
+ * @return 0 once the core is ready for a model, -1 if it is still in error or reset
+ */
+int vbx_cnn_reset(vbx_cnn_t* vbx_cnn);
+
+/**
+ * vbx_cnn_model_wfi(), giving up after timeout_us. A model that does not
+ * finish in time is treated as hung: the core is reset with vbx_cnn_reset()
+ * and VBX_CNN_TIMED_OUT returned. Without a completion fd to wait on,
+ * as on bare metal, there is no timeout and this is vbx_cnn_model_wfi().
+ * Part of vbx_cnn_api.c, so not available with libvbx_cnn_sim.
+ *
+ * @return as vbx_cnn_model_wfi(), or VBX_CNN_TIMED_OUT
+ */
+int vbx_cnn_model_wfi_timeout(vbx_cnn_t* vbx_cnn,uint32_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_RESET_H
@@ -0,0 +1,196 @@
+#include "vbx_cnn_set.h"
+#include <string.h>
+
+static inline vbx_cnn_set_job_t* job_at(vbx_cnn_set_t* set,uint32_t seq){
+  return set->jobs + (seq % set->depth);
+}
+
+vbx_cnn_set_t* vbx_cnn_set_init(vbx_cnn_t* cores[],int num_cores,int depth){
+  if(num_cores < 1 || num_cores > VBX_CNN_MAX_CORES || depth < 1){
+    return NULL;
+  }
+  vbx_cnn_set_t* set = (vbx_cnn_set_t*)calloc(1,sizeof(vbx_cnn_set_t));
+  if(!set){
+    return NULL;
+  }
+  set->jobs = (vbx_cnn_set_job_t*)calloc(depth,sizeof(vbx_cnn_set_job_t));
+  set->depth = depth;
+  set->num_cores = num_cores;
+  for(int c=0;c<num_cores;c++){
+    set->cores[c] = cores[c];
+    //every core gets the full depth, so one core can take all the work
+    //when the others are kept for other models
+    set->queues[c] = vbx_cnn_queue_init(cores[c],depth);
+    set->waits[c] = vbx_cnn_wait_init(cores[c],200);
+    if(!set->queues[c] || !set->waits[c]){
+      vbx_cnn_set_free(set);
+      return NULL;
+    }
+    vbx_cnn_queue_set_wait(set->queues[c],set->waits[c]);
+  }
+  if(!set->jobs){
+    vbx_cnn_set_free(set);
+    return NULL;
+  }
+  return set;
+}
+
+vbx_cnn_set_t* vbx_cnn_set_open(int depth){
+  uintptr_t addrs[VBX_CNN_MAX_CORES];
+  vbx_cnn_t* cores[VBX_CNN_MAX_CORES];
+  int num_cores = vbx_cnn_enumerate(addrs,VBX_CNN_MAX_CORES);
+  int opened;
+  vbx_cnn_set_t* set = NULL;
+  for(opened=0;opened<num_cores;opened++){
+    cores[opened] = vbx_cnn_init_shared((void*)addrs[opened],opened ? cores[0] : NULL);
+    if(!cores[opened] || !cores[opened]->initialized){
+      vbx_cnn_free(cores[opened]);
+      break;
+    }
+  }
+  if(opened == num_cores){
+    set = vbx_cnn_set_init(cores,num_cores,depth);
+  }
+  if(!set){
+    //core 0 owns the DMA window the others share, so it goes last
+    while(opened--){
+      vbx_cnn_free(cores[opened]);
+    }
+    return NULL;
+  }
+  set->owns_cores = 1;
+  return set;
+}
+
+void vbx_cnn_set_free(vbx_cnn_set_t* set){
+  if(!set){
+    return;
+  }
+  for(int c=0;c<set->num_cores;c++){
+    vbx_cnn_queue_free(set->queues[c]);
+    vbx_cnn_wait_free(set->waits[c]);
+  }
+  for(int c=set->num_cores-1;set->owns_cores && c>=0;c--){
+    vbx_cnn_free(set->cores[c]);
+  }
+  free(set->affinities);
+  free(set->jobs);
+  free(set);
+}
+
+int vbx_cnn_set_set_affinity(vbx_cnn_set_t* set,model_t* model,uint32_t core_mask){
+  core_mask &= (1u << set->num_cores) - 1;
+  if(!core_mask){
+    return -1;
+  }
+  int i;
+  for(i=0;i<set->num_affinities;i++){
+    if(set->affinities[i].model == model){
+      break;
+    }
+  }
+  if(i == set->num_affinities){
+    vbx_cnn_affinity_t* affinities = (vbx_cnn_affinity_t*)realloc(set->affinities,(i+1)*sizeof(vbx_cnn_affinity_t));
+    if(!affinities){
+      return -1;
+    }
+    set->affinities = affinities;
+    set->affinities[i].model = model;
+    set->num_affinities++;
+  }
+  set->affinities[i].core_mask = core_mask;
+  return 0;
+}
+
+static uint32_t core_mask(vbx_cnn_set_t* set,model_t* model){
+  for(int i=0;i<set->num_affinities;i++){
+    if(set->affinities[i].model == model){
+      return set->affinities[i].core_mask;
+    }
+  }
+  return (1u << set->num_cores) - 1;
+}
+
+//learned run time of model on any core, 0 until one has timed it;
+//until then the pending job count decides
+static uint32_t estimate_us(vbx_cnn_set_t* set,model_t* model){
+  uint32_t estimate_us,deviation_us;
+  for(int c=0;c<set->num_cores;c++){
+    if(vbx_cnn_wait_get_estimate(set->waits[c],model,&estimate_us,&deviation_us)){
+      return estimate_us;
+    }
+  }
+  return 0;
+}
+
+int vbx_cnn_set_submit(vbx_cnn_set_t* set,model_t* model,vbx_cnn_io_ptr_t io_buffers[]){
+  if(set->tail - set->head >= (uint32_t)set->depth){
+    return -1;
+  }
+  uint32_t mask = core_mask(set,model);
+  int best = -1;
+  for(int c=0;c<set->num_cores;c++){
+    if(!(mask & (1u << c)) || vbx_cnn_queue_pending(set->queues[c]) >= set->depth){
+      continue;
+    }
+    if(best < 0 || set->load_us[c] < set->load_us[best] ||
+       (set->load_us[c] == set->load_us[best] &&
+        vbx_cnn_queue_pending(set->queues[c]) < vbx_cnn_queue_pending(set->queues[best]))){
+      best = c;
+    }
+  }
+  if(best < 0 || vbx_cnn_queue_submit(set->queues[best],model,io_buffers) < 0){
+    return -1;
+  }
+  uint32_t seq = set->tail++;
+  vbx_cnn_set_job_t* job = job_at(set,seq);
+  job->core = best;
+  job->cost_us = estimate_us(set,model);
+  set->load_us[best] += job->cost_us;
+  return (int)(seq & VBX_CNN_JOB_ID_MASK);
+}
+
+//a core's jobs are collected in the order they went to it, so the set's
+//oldest job is always the oldest of its core's queue
+static int collect(vbx_cnn_set_t* set,int core_job){
+  if(core_job < 0){
+    return -1;
+  }
+  uint32_t seq = set->head++;
+  vbx_cnn_set_job_t* job = job_at(set,seq);
+  set->load_us[job->core] -= job->cost_us;
+  set->jobs_run[job->core]++;
+  return (int)(seq & VBX_CNN_JOB_ID_MASK);
+}
+
+static void service_all(vbx_cnn_set_t* set){
+  for(int c=0;c<set->num_cores;c++){
+    vbx_cnn_queue_service(set->queues[c]);
+  }
+}
+
+int vbx_cnn_set_complete(vbx_cnn_set_t* set,int* status){
+  service_all(set);
+  if(set->head == set->tail){
+    return -1;
+  }
+  vbx_cnn_set_job_t* job = job_at(set,set->head);
+  return collect(set,vbx_cnn_queue_complete(set->queues[job->core],status));
+}
+
+int vbx_cnn_set_wait(vbx_cnn_set_t* set,int* status){
+  service_all(set);
+  if(set->head == set->tail){
+    return -1;
+  }
+  //the other cores hold a running and a queued job each, enough to stay
+  //busy for as long as this one takes
+  vbx_cnn_set_job_t* job = job_at(set,set->head);
+  int job_id = collect(set,vbx_cnn_queue_wait(set->queues[job->core],status));
+  service_all(set);
+  return job_id;
+}
+
+int vbx_cnn_set_pending(vbx_cnn_set_t* set){
+  return (int)(set->tail - set->head);
+}
@@ -0,0 +1,122 @@
+/*!
+ * \file
+ * \brief Device sets
+ *
+ * Runs jobs across several cores, each fed by its own vbx_cnn_queue_t.
+ * Every job goes to the least loaded core it may run on, by the estimated
+ * run time of the jobs already waiting there, and finished jobs are handed
+ * back in submission order as from a single queue. A model can be limited
+ * to some of the cores with vbx_cnn_set_set_affinity().
+ * The cores share one DMA window, so a model loaded once, through any of
+ * them, runs on all of them without its weights being copied.
+ * Uses vbx_cnn_enumerate(), so not available with libvbx_cnn_sim.
+ * @code{.cpp}
+ *  vbx_cnn_set_t* set = vbx_cnn_set_open(4);
+ *  model_t* model = vbx_cnn_model_load(set->cores[0],"yolo.vnnx");
+ *  while(vbx_cnn_set_submit(set,model,io_buffers) < 0){
+ *    job = vbx_cnn_set_wait(set,&status);
+ *  }
+ * @endcode
+ */
+
+#ifndef VBX_CNN_SET_H
+#define VBX_CNN_SET_H
+#include "vbx_cnn_queue.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_MAX_CORES 8
+
+typedef struct {
+	int core;
+	uint32_t cost_us;
+}vbx_cnn_set_job_t;
+
+typedef struct {
+	model_t* model;
+	uint32_t core_mask;
+}vbx_cnn_affinity_t;
+
+typedef struct {
+	int num_cores;
+	vbx_cnn_t* cores[VBX_CNN_MAX_CORES];
+	vbx_cnn_queue_t* queues[VBX_CNN_MAX_CORES];
+	vbx_cnn_wait_t* waits[VBX_CNN_MAX_CORES];
+	uint64_t load_us[VBX_CNN_MAX_CORES];  //< estimated run time of the jobs on each core not yet collected
+	uint64_t jobs_run[VBX_CNN_MAX_CORES];
+	vbx_cnn_set_job_t* jobs;
+	int depth;
+	uint32_t head;
+	uint32_t tail;
+	vbx_cnn_affinity_t* affinities;
+	int num_affinities;
+	int owns_cores;               //< opened by vbx_cnn_set_open(), so freed with the set
+}vbx_cnn_set_t;
+
+/**
+ * Run jobs across cores that are already initialized. The set does not
+ * take ownership of them.
+ *
+ * @param cores Cores sharing one DMA window, see vbx_cnn_init_shared()
+ * @param num_cores Number of cores, at most VBX_CNN_MAX_CORES
+ * @param depth Maximum number of jobs submitted but not yet collected
+ * @return The set, or NULL on failure
+ */
+vbx_cnn_set_t* vbx_cnn_set_init(vbx_cnn_t* cores[],int num_cores,int depth);
+
+/**
+ * Initialize every core vbx_cnn_enumerate() finds and run jobs across them
+ *
+ * @param depth Maximum number of jobs submitted but not yet collected
+ * @return The set, or NULL if there are no cores or on failure
+ */
+vbx_cnn_set_t* vbx_cnn_set_open(int depth);
+/**
+ * Free the set. Cores opened by vbx_cnn_set_open() go with it, cores given
+ * to vbx_cnn_set_init() are left to the caller.
+ */
+void vbx_cnn_set_free(vbx_cnn_set_t* set);
+
+/**
+ * Only run model on the cores in core_mask, bit n standing for cores[n].
+ * Models without an affinity run on any core.
+ *
+ * @return 0 on success, -1 on allocation failure or an empty mask
+ */
+int vbx_cnn_set_set_affinity(vbx_cnn_set_t* set,model_t* model,uint32_t core_mask);
+
+/**
+ * Queue a model run on the least loaded core it may use. The io_buffers
+ * array is copied, as by vbx_cnn_queue_submit().
+ *
+ * @return job id (>= 0), or -1 if the set or every allowed core is full
+ */
+int vbx_cnn_set_submit(vbx_cnn_set_t* set,model_t* model,vbx_cnn_io_ptr_t io_buffers[]);
+
+/**
+ * Collect the oldest job without blocking
+ *
+ * @param set The set to use
+ * @param status Set to 0 if the job ran, or the vbx_cnn_model_poll() error
+ * @return job id of the finished job, or -1 if the oldest job is not done
+ */
+int vbx_cnn_set_complete(vbx_cnn_set_t* set,int* status);
+
+/**
+ * Block until the oldest job finishes and collect it
+ *
+ * @return job id of the finished job, or -1 if the set is empty
+ */
+int vbx_cnn_set_wait(vbx_cnn_set_t* set,int* status);
+
+/**
+ * @return number of jobs submitted and not yet collected
+ */
+int vbx_cnn_set_pending(vbx_cnn_set_t* set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_SET_H
@@ -0,0 +1,255 @@
+#include "vbx_cnn_trace.h"
+#include "vbx_cnn_wait.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENT_BEGIN 'B'
+#define EVENT_END 'E'
+#define EVENT_INSTANT 'i'
+#define EVENT_COUNTER 'C'
+#define FLUSH_CHUNK 256
+
+typedef struct {
+  uint64_t ts_ns;
+  const char* name;
+  int64_t value;
+  char phase;
+}trace_event_t;
+
+//Each thread owns one ring and is the only writer of head. The flusher is
+//the only user of tail, and reads events between them. Rings stay allocated
+//for the life of the process, so a thread never records into freed memory.
+typedef struct trace_ring {
+  struct trace_ring* next;
+  const char* thread_name;
+  int named;       //thread_name written to the file
+  uint32_t tid;
+  uint64_t mask;
+  uint64_t head;   //events recorded
+  uint64_t tail;   //events flushed or dropped
+  trace_event_t* events;
+}trace_ring_t;
+
+static int trace_enabled;
+static uint64_t trace_ring_events;
+static trace_ring_t* trace_rings;
+static uint32_t trace_next_tid;
+static __thread trace_ring_t* thread_ring;
+
+static FILE* trace_file;
+static int trace_flushing;
+static int trace_first;
+static uint64_t trace_epoch_ns;
+static vbx_cnn_trace_stats_t trace_stats;
+
+static trace_ring_t* new_ring(){
+  trace_ring_t* ring = (trace_ring_t*)calloc(1,sizeof(trace_ring_t));
+  if(!ring){
+    return NULL;
+  }
+  ring->events = (trace_event_t*)malloc(trace_ring_events*sizeof(trace_event_t));
+  if(!ring->events){
+    free(ring);
+    return NULL;
+  }
+  ring->mask = trace_ring_events-1;
+  ring->tid = __atomic_add_fetch(&trace_next_tid,1,__ATOMIC_RELAXED);
+  trace_ring_t* head = __atomic_load_n(&trace_rings,__ATOMIC_ACQUIRE);
+  do{
+    ring->next = head;
+  }while(!__atomic_compare_exchange_n(&trace_rings,&head,ring,1,__ATOMIC_RELEASE,__ATOMIC_ACQUIRE));
+  return ring;
+}
+
+static trace_ring_t* my_ring(){
+  trace_ring_t* ring = thread_ring;
+  if(!ring){
+    ring = thread_ring = new_ring();
+  }
+  return ring;
+}
+
+static void record(char phase,const char* name,int64_t value){
+  trace_ring_t* ring = my_ring();
+  if(!ring){
+    return;
+  }
+  uint64_t head = ring->head;
+  trace_event_t* event = ring->events + (head & ring->mask);
+  event->ts_ns = vbx_cnn_wait_time_ns();
+  event->name = name;
+  event->value = value;
+  event->phase = phase;
+  __atomic_store_n(&ring->head,head+1,__ATOMIC_RELEASE);
+}
+
+void vbx_cnn_trace_begin(const char* name){
+  if(__atomic_load_n(&trace_enabled,__ATOMIC_RELAXED)) record(EVENT_BEGIN,name,0);
+}
+
+void vbx_cnn_trace_end(const char* name){
+  if(__atomic_load_n(&trace_enabled,__ATOMIC_RELAXED)) record(EVENT_END,name,0);
+}
+
+void vbx_cnn_trace_instant(const char* name){
+  if(__atomic_load_n(&trace_enabled,__ATOMIC_RELAXED)) record(EVENT_INSTANT,name,0);
+}
+
+void vbx_cnn_trace_counter(const char* name,int64_t value){
+  if(__atomic_load_n(&trace_enabled,__ATOMIC_RELAXED)) record(EVENT_COUNTER,name,value);
+}
+
+void vbx_cnn_trace_thread_name(const char* name){
+  if(!__atomic_load_n(&trace_enabled,__ATOMIC_RELAXED)){
+    return;
+  }
+  trace_ring_t* ring = my_ring();
+  if(ring){
+    ring->thread_name = name;
+    __atomic_store_n(&ring->named,0,__ATOMIC_RELEASE);
+  }
+}
+
+static void write_string(FILE* f,const char* s){
+  fputc('"',f);
+  for(;s && *s;s++){
+    if(*s == '"' || *s == '\\'){
+      fputc('\\',f);
+    }
+    if((unsigned char)*s >= ' '){
+      fputc(*s,f);
+    }
+  }
+  fputc('"',f);
+}
+
+static void write_event(FILE* f,uint32_t tid,const trace_event_t* event){
+  fputs(trace_first ? "\n" : ",\n",f);
+  trace_first = 0;
+  fputs("{\"name\":",f);
+  write_string(f,event->name);
+  //microseconds since vbx_cnn_trace_open(), small enough to print exactly
+  double ts_us = (int64_t)(event->ts_ns-trace_epoch_ns)/1000.0;
+  fprintf(f,",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",event->phase,ts_us,tid);
+  if(event->phase == EVENT_COUNTER){
+    fprintf(f,",\"args\":{\"value\":%lld}",(long long)event->value);
+  }else if(event->phase == EVENT_INSTANT){
+    fputs(",\"s\":\"t\"",f);
+  }
+  fputc('}',f);
+}
+
+//Copy out a chunk, then check the writer hasn't lapped it while copying.
+//The slot at head may be mid write, so only events after head-size are safe.
+static int drain_ring(trace_ring_t* ring){
+  trace_event_t chunk[FLUSH_CHUNK];
+  int written = 0;
+  if(ring->thread_name && !__atomic_exchange_n(&ring->named,1,__ATOMIC_ACQ_REL)){
+    fputs(trace_first ? "\n" : ",\n",trace_file);
+    trace_first = 0;
+    fprintf(trace_file,"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",ring->tid);
+    write_string(trace_file,ring->thread_name);
+    fputs("}}",trace_file);
+  }
+  while(1){
+    uint64_t head = __atomic_load_n(&ring->head,__ATOMIC_ACQUIRE);
+    uint64_t size = ring->mask+1;
+    if(head - ring->tail > size-1){
+      trace_stats.dropped += head - (size-1) - ring->tail;
+      ring->tail = head - (size-1);
+    }
+    if(ring->tail == head){
+      return written;
+    }
+    uint64_t n = head - ring->tail < FLUSH_CHUNK ? head - ring->tail : FLUSH_CHUNK;
+    for(uint64_t e=0;e<n;e++){
+      chunk[e] = ring->events[(ring->tail+e) & ring->mask];
+    }
+    uint64_t after = __atomic_load_n(&ring->head,__ATOMIC_ACQUIRE);
+    uint64_t first_safe = after >= size-1 ? after - (size-1) : 0;
+    for(uint64_t e=0;e<n;e++){
+      if(ring->tail+e < first_safe){
+        trace_stats.dropped++;
+        continue;
+      }
+      write_event(trace_file,ring->tid,chunk+e);
+      written++;
+    }
+    ring->tail += n;
+  }
+}
+
+int vbx_cnn_trace_open(const char* filename,int events_per_thread){
+  if(__atomic_exchange_n(&trace_flushing,1,__ATOMIC_ACQUIRE)){
+    return -1;
+  }
+  if(trace_file){
+    __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+    return -1;
+  }
+  trace_file = fopen(filename,"w");
+  if(!trace_file){
+    __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+    return -1;
+  }
+  //rings from an earlier trace keep their size
+  if(!trace_ring_events){
+    uint64_t events = events_per_thread > 0 ? events_per_thread : VBX_CNN_TRACE_EVENTS;
+    trace_ring_events = 2;
+    while(trace_ring_events < events){
+      trace_ring_events <<= 1;
+    }
+  }
+  for(trace_ring_t* ring = __atomic_load_n(&trace_rings,__ATOMIC_ACQUIRE);ring;ring=ring->next){
+    ring->tail = __atomic_load_n(&ring->head,__ATOMIC_ACQUIRE);
+    ring->named = 0;
+  }
+  memset(&trace_stats,0,sizeof(trace_stats));
+  trace_first = 1;
+  trace_epoch_ns = vbx_cnn_wait_time_ns();
+  fputs("[",trace_file);
+  __atomic_store_n(&trace_enabled,1,__ATOMIC_RELEASE);
+  __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+  return 0;
+}
+
+//with trace_flushing held
+static int drain_rings(){
+  int written = 0;
+  for(trace_ring_t* ring = __atomic_load_n(&trace_rings,__ATOMIC_ACQUIRE);ring;ring=ring->next){
+    written += drain_ring(ring);
+  }
+  trace_stats.written += written;
+  fflush(trace_file);
+  return written;
+}
+
+int vbx_cnn_trace_flush(){
+  //one flush at a time; a thread that finds another flushing has nothing to do
+  if(__atomic_exchange_n(&trace_flushing,1,__ATOMIC_ACQUIRE)){
+    return 0;
+  }
+  int written = trace_file ? drain_rings() : -1;
+  __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+  return written;
+}
+
+int vbx_cnn_trace_close(){
+  __atomic_store_n(&trace_enabled,0,__ATOMIC_RELEASE);
+  while(__atomic_exchange_n(&trace_flushing,1,__ATOMIC_ACQUIRE));
+  if(!trace_file){
+    __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+    return -1;
+  }
+  drain_rings();
+  fputs("\n]\n",trace_file);
+  int err = fclose(trace_file);
+  trace_file = NULL;
+  __atomic_store_n(&trace_flushing,0,__ATOMIC_RELEASE);
+  return err ? -1 : 0;
+}
+
+void vbx_cnn_trace_get_stats(vbx_cnn_trace_stats_t* stats){
+  *stats = trace_stats;
+}
@@ -0,0 +1,94 @@
+/*!
+ * \file
+ * \brief Tracing
+ *
+ * Spans, instants and counters are recorded into a ring per thread, without
+ * locks, stamped with vbx_cnn_wait_time_ns(). vbx_cnn_trace_flush() drains the
+ * rings into a Chrome trace JSON file, for chrome://tracing or ui.perfetto.dev.
+ * The driver records model starts, completions, waits and queue depth; the
+ * application adds its own stages with the same calls.
+ *
+ * Until vbx_cnn_trace_open() is called every record call is a load and a
+ * branch. Names are stored by pointer, so pass string literals.
+ *
+ * @code
+ *  vbx_cnn_trace_open("trace.json",0);
+ *  while(running){
+ *    vbx_cnn_trace_begin("postprocess");
+ *    ...
+ *    vbx_cnn_trace_end("postprocess");
+ *    if(++frames % 64 == 0) vbx_cnn_trace_flush();
+ *  }
+ *  vbx_cnn_trace_close();
+ * @endcode
+ */
+
+#ifndef VBX_CNN_TRACE_H
+#define VBX_CNN_TRACE_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VBX_CNN_TRACE_EVENTS 16384 // default events kept per thread between flushes
+
+typedef struct {
+  uint64_t written; //< events written to the file
+  uint64_t dropped; //< events overwritten in a ring before a flush reached them
+}vbx_cnn_trace_stats_t;
+
+/**
+ * Start tracing into filename
+ *
+ * @param filename The JSON file to write, truncated
+ * @param events_per_thread Ring size, rounded up to a power of two, 0 for VBX_CNN_TRACE_EVENTS
+ * @return 0 on success, -1 if the file could not be opened or a trace is already open
+ */
+int vbx_cnn_trace_open(const char* filename,int events_per_thread);
+
+/**
+ * Write the events recorded since the last flush, from every thread.
+ * Recording carries on while this runs; events it can't reach before their
+ * ring wraps are counted as dropped.
+ *
+ * @return events written, or -1 if no trace is open
+ */
+int vbx_cnn_trace_flush();
+
+/**
+ * Flush, finish the JSON file and stop recording. Other threads should have
+ * stopped recording first.
+ *
+ * @return 0 on success, -1 if the file could not be written
+ */
+int vbx_cnn_trace_close();
+
+void vbx_cnn_trace_get_stats(vbx_cnn_trace_stats_t* stats);
+
+/**
+ * Name the calling thread's track in the trace
+ */
+void vbx_cnn_trace_thread_name(const char* name);
+
+/**
+ * Begin and end a span on the calling thread. Spans nest, and must end on
+ * the thread they began on.
+ */
+void vbx_cnn_trace_begin(const char* name);
+void vbx_cnn_trace_end(const char* name);
+
+/**
+ * Mark a point in time on the calling thread
+ */
+void vbx_cnn_trace_instant(const char* name);
+
+/**
+ * Record a value, drawn as a graph over time
+ */
+void vbx_cnn_trace_counter(const char* name,int64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_TRACE_H
@@ -0,0 +1,202 @@
+#include "vbx_cnn_wait.h"
+#include "vbx_cnn_trace.h"
+#include <string.h>
+#include <time.h>
+
+//Latency estimates follow the smoothed round trip estimator TCP uses:
+//estimate moves 1/8 of the way to each sample, deviation 1/4 of the way to
+//each sample's distance from the estimate.
+#define ESTIMATE_SHIFT 3
+#define DEVIATION_SHIFT 2
+//keep spinning for this many deviations before the expected finish
+#define GUARD_DEVIATIONS 2
+
+uint64_t vbx_cnn_wait_time_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+//The estimates are shared with vbx_cnn_wait_forget(), which a model cache
+//calls from whichever thread evicts the model.
+static inline void lock_models(vbx_cnn_wait_t* wait){
+#if VBX_CNN_CONTEXTS
+  pthread_mutex_lock(&wait->lock);
+#endif
+}
+
+static inline void unlock_models(vbx_cnn_wait_t* wait){
+#if VBX_CNN_CONTEXTS
+  pthread_mutex_unlock(&wait->lock);
+#endif
+}
+
+static vbx_cnn_latency_t* find_latency(vbx_cnn_wait_t* wait,model_t* model,int create){
+  for(int i=0;i<wait->num_models;i++){
+    if(wait->models[i].model == model){
+      return wait->models+i;
+    }
+  }
+  if(!create){
+    return NULL;
+  }
+  vbx_cnn_latency_t* models = (vbx_cnn_latency_t*)realloc(wait->models,(wait->num_models+1)*sizeof(vbx_cnn_latency_t));
+  if(!models){
+    return NULL;
+  }
+  wait->models = models;
+  vbx_cnn_latency_t* entry = wait->models + wait->num_models++;
+  memset(entry,0,sizeof(*entry));
+  entry->model = model;
+  return entry;
+}
+
+static void add_sample(vbx_cnn_latency_t* entry,uint64_t sample_ns){
+  if(entry->samples == 0){
+    entry->estimate_ns = sample_ns;
+    entry->deviation_ns = sample_ns/8;
+  }else{
+    int64_t err = (int64_t)sample_ns - (int64_t)entry->estimate_ns;
+    int64_t abs_err = err < 0 ? -err : err;
+    entry->estimate_ns += err/(1<<ESTIMATE_SHIFT);
+    entry->deviation_ns += (abs_err - (int64_t)entry->deviation_ns)/(1<<DEVIATION_SHIFT);
+  }
+  entry->samples++;
+}
+
+static void sleep_ns(vbx_cnn_wait_t* wait,uint64_t ns){
+  //nanosleep reliably oversleeps by tens of microseconds on Linux,
+  //so ask for less by however much the last sleeps overran
+  uint64_t request = ns > wait->oversleep_ns ? ns - wait->oversleep_ns : 0;
+  if(request == 0){
+    return;
+  }
+  struct timespec ts = {request/1000000000ull,request%1000000000ull};
+  uint64_t before = vbx_cnn_wait_time_ns();
+  vbx_cnn_trace_begin("sleep");
+  nanosleep(&ts,NULL);
+  vbx_cnn_trace_end("sleep");
+  uint64_t slept = vbx_cnn_wait_time_ns() - before;
+  int64_t over = (int64_t)slept - (int64_t)request;
+  wait->oversleep_ns += (over - (int64_t)wait->oversleep_ns)/(1<<ESTIMATE_SHIFT);
+  if((int64_t)wait->oversleep_ns < 0){
+    wait->oversleep_ns = 0;
+  }
+  wait->stats.sleeps++;
+  wait->stats.sleep_ns += slept;
+}
+
+vbx_cnn_wait_t* vbx_cnn_wait_init(vbx_cnn_t* vbx_cnn,uint32_t spin_window_us){
+  vbx_cnn_wait_t* wait = (vbx_cnn_wait_t*)calloc(1,sizeof(vbx_cnn_wait_t));
+  if(!wait){
+    return NULL;
+  }
+  wait->vbx_cnn = vbx_cnn;
+  wait->spin_window_ns = (uint64_t)spin_window_us*1000;
+#if VBX_CNN_CONTEXTS
+  pthread_mutex_init(&wait->lock,NULL);
+#endif
+  return wait;
+}
+
+void vbx_cnn_wait_free(vbx_cnn_wait_t* wait){
+  if(wait){
+#if VBX_CNN_CONTEXTS
+    pthread_mutex_destroy(&wait->lock);
+#endif
+    free(wait->models);
+    free(wait);
+  }
+}
+
+void vbx_cnn_wait_forget(vbx_cnn_wait_t* wait,model_t* model){
+  lock_models(wait);
+  vbx_cnn_latency_t* entry = find_latency(wait,model,0);
+  if(entry){
+    *entry = wait->models[--wait->num_models];
+  }
+  unlock_models(wait);
+}
+
+//one poll, sleeping first if the model isn't due for a while,
+//but never past deadline_ns
+static int wait_step(vbx_cnn_wait_t* wait,model_t* model,uint64_t start_ns,uint64_t deadline_ns){
+  int status = vbx_cnn_model_poll(wait->vbx_cnn);
+  if(status <= 0){
+    return status;
+  }
+  uint64_t estimate_ns = 0,deviation_ns = 0;
+  lock_models(wait);
+  vbx_cnn_latency_t* entry = find_latency(wait,model,0);
+  if(entry && entry->samples){
+    estimate_ns = entry->estimate_ns;
+    deviation_ns = entry->deviation_ns;
+  }
+  unlock_models(wait);
+  if(estimate_ns){
+    uint64_t guard = deviation_ns*GUARD_DEVIATIONS;
+    if(guard < wait->spin_window_ns){
+      guard = wait->spin_window_ns;
+    }
+    uint64_t wake_ns = start_ns + estimate_ns;
+    wake_ns = wake_ns > guard ? wake_ns - guard : 0;
+    if(deadline_ns && wake_ns > deadline_ns){
+      wake_ns = deadline_ns;
+    }
+    uint64_t now = vbx_cnn_wait_time_ns();
+    if(now < wake_ns){
+      sleep_ns(wait,wake_ns - now);
+      return status;
+    }
+  }
+  wait->stats.spin_polls++;
+  return status;
+}
+
+int vbx_cnn_wait_model_until(vbx_cnn_wait_t* wait,model_t* model,uint64_t start_ns,uint64_t deadline_ns){
+  uint64_t begin = vbx_cnn_wait_time_ns();
+  uint64_t slept = wait->stats.sleep_ns;
+  vbx_cnn_trace_begin("wait_model");
+  int seen_running = 0;
+  int status;
+  while((status = wait_step(wait,model,start_ns,deadline_ns)) > 0){
+    seen_running = 1;
+    if(deadline_ns && vbx_cnn_wait_time_ns() >= deadline_ns){
+      break;
+    }
+  }
+  uint64_t end = vbx_cnn_wait_time_ns();
+  vbx_cnn_trace_end("wait_model");
+  //if the model was done before we started looking, when it finished is unknown
+  if(seen_running && status == 0){
+    lock_models(wait);
+    vbx_cnn_latency_t* entry = find_latency(wait,model,1);
+    if(entry){
+      add_sample(entry,end - start_ns);
+    }
+    unlock_models(wait);
+  }
+  uint64_t total = end - begin;
+  slept = wait->stats.sleep_ns - slept;
+  wait->stats.waits++;
+  wait->stats.spin_ns += total > slept ? total - slept : 0;
+  return status;
+}
+
+int vbx_cnn_wait_model(vbx_cnn_wait_t* wait,model_t* model,uint64_t start_ns){
+  return vbx_cnn_wait_model_until(wait,model,start_ns,0);
+}
+
+int vbx_cnn_wait_get_estimate(vbx_cnn_wait_t* wait,model_t* model,uint32_t* estimate_us,uint32_t* deviation_us){
+  lock_models(wait);
+  vbx_cnn_latency_t* entry = find_latency(wait,model,0);
+  uint32_t samples = entry ? entry->samples : 0;
+  if(samples && estimate_us){
+    *estimate_us = entry->estimate_ns/1000;
+  }
+  if(samples && deviation_us){
+    *deviation_us = entry->deviation_ns/1000;
+  }
+  unlock_models(wait);
+  return samples;
+}
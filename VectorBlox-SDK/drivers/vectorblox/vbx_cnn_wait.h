@@ -0,0 +1,104 @@
+/*!
+ * \file
+ * \brief Adaptive wait
+ *
+ * Keeps a running estimate of how long each model takes, keyed by model pointer,
+ * and waits for a model by sleeping through most of its expected run time,
+ * then polling through a short window around the expected finish.
+ * A model with no estimate yet is polled the whole time.
+ * @code{.cpp}
+ *  vbx_cnn_wait_t* wait = vbx_cnn_wait_init(vbx_cnn,200);
+ *  vbx_cnn_model_start(vbx_cnn,model,io_buffers);
+ *  uint64_t start_ns = vbx_cnn_wait_time_ns();
+ *  ...
+ *  status = vbx_cnn_wait_model(wait,model,start_ns);
+ * @endcode
+ */
+
+#ifndef VBX_CNN_WAIT_H
+#define VBX_CNN_WAIT_H
+#include "vbx_cnn_api.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	model_t* model;
+	uint64_t estimate_ns;
+	uint64_t deviation_ns;
+	uint32_t samples;
+}vbx_cnn_latency_t;
+
+typedef struct {
+	uint64_t waits;
+	uint64_t sleeps;
+	uint64_t spin_polls;
+	uint64_t sleep_ns;
+	uint64_t spin_ns;
+}vbx_cnn_wait_stats_t;
+
+typedef struct {
+	vbx_cnn_t* vbx_cnn;
+	vbx_cnn_latency_t* models;
+	int num_models;
+	uint64_t spin_window_ns;
+	uint64_t oversleep_ns;
+	vbx_cnn_wait_stats_t stats;
+#if VBX_CNN_CONTEXTS
+	pthread_mutex_t lock;         //< held while models is read or changed
+#endif
+}vbx_cnn_wait_t;
+
+/**
+ * @param vbx_cnn The vbx_cnn object to use
+ * @param spin_window_us Minimum time to poll before a model's expected finish
+ * @return The wait policy, or NULL on failure
+ */
+vbx_cnn_wait_t* vbx_cnn_wait_init(vbx_cnn_t* vbx_cnn,uint32_t spin_window_us);
+void vbx_cnn_wait_free(vbx_cnn_wait_t* wait);
+
+/**
+ * @return CLOCK_MONOTONIC time in ns, to record when a model was started
+ */
+uint64_t vbx_cnn_wait_time_ns();
+
+/**
+ * Wait for model to finish, and update its estimate
+ *
+ * @param wait The wait policy to use
+ * @param model The model running, or queued behind the running one
+ * @param start_ns vbx_cnn_wait_time_ns() when model started running
+ * @return the final vbx_cnn_model_poll() status
+ */
+int vbx_cnn_wait_model(vbx_cnn_wait_t* wait,model_t* model,uint64_t start_ns);
+
+/**
+ * vbx_cnn_wait_model(), returning 1 if model is still running at deadline_ns.
+ * Nothing is reset; the caller decides what to do with a late model.
+ *
+ * @param deadline_ns vbx_cnn_wait_time_ns() to give up at, 0 for none
+ * @return the final vbx_cnn_model_poll() status
+ */
+int vbx_cnn_wait_model_until(vbx_cnn_wait_t* wait,model_t* model,uint64_t start_ns,uint64_t deadline_ns);
+
+/**
+ * @param wait The wait policy to use
+ * @param model The model to look up
+ * @param estimate_us Set to the estimated run time, may be NULL
+ * @param deviation_us Set to the mean deviation from the estimate, may be NULL
+ * @return number of runs the estimate is based on, 0 if there is none
+ */
+int vbx_cnn_wait_get_estimate(vbx_cnn_wait_t* wait,model_t* model,uint32_t* estimate_us,uint32_t* deviation_us);
+
+/**
+ * Drop the estimate for model, once its memory is freed, so a model later
+ * loaded at the same address starts without one. Safe to call from another
+ * thread than the one waiting.
+ */
+void vbx_cnn_wait_forget(vbx_cnn_wait_t* wait,model_t* model);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //VBX_CNN_WAIT_H
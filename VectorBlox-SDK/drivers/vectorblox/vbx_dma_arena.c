@@ -0,0 +1,253 @@
+#include "vbx_cnn_api.h"
+#include <string.h>
+
+//Block bookkeeping lives in ordinary heap memory rather than in the arena,
+//the arena is usually an uncached mapping and every header access there
+//would be a trip to DDR.
+//Blocks are kept in address order and cover the whole arena, so a free
+//only has to look at its two neighbours to coalesce.
+typedef struct vbx_dma_block{
+  struct vbx_dma_block* prev;
+  struct vbx_dma_block* next;
+  size_t offset;
+  size_t size;
+  int in_use;
+  vbx_dma_arena_t* child;
+}vbx_dma_block_t;
+
+static vbx_dma_block_t* new_block(size_t offset,size_t size){
+  vbx_dma_block_t* block = (vbx_dma_block_t*)calloc(1,sizeof(vbx_dma_block_t));
+  if(block){
+    block->offset = offset;
+    block->size = size;
+  }
+  return block;
+}
+
+//split block so that it ends at offset, the tail becomes a new free block
+static int split_block(vbx_dma_block_t* block,size_t offset){
+  if(offset == block->offset + block->size){
+    return 0;
+  }
+  vbx_dma_block_t* tail = new_block(offset,block->offset + block->size - offset);
+  if(!tail){
+    return -1;
+  }
+  tail->prev = block;
+  tail->next = block->next;
+  if(block->next){
+    block->next->prev = tail;
+  }
+  block->next = tail;
+  block->size = offset - block->offset;
+  return 0;
+}
+
+//merge next into block, both must be free
+static void merge_next(vbx_dma_block_t* block){
+  vbx_dma_block_t* next = block->next;
+  block->size += next->size;
+  block->next = next->next;
+  if(next->next){
+    next->next->prev = block;
+  }
+  free(next);
+}
+
+vbx_dma_arena_t* vbx_dma_arena_init(void* base,size_t size,uintptr_t phys_base,size_t granule){
+  if(granule == 0 || (granule & (granule-1))){
+    return NULL;
+  }
+  vbx_dma_arena_t* arena = (vbx_dma_arena_t*)calloc(1,sizeof(vbx_dma_arena_t));
+  if(!arena){
+    return NULL;
+  }
+  arena->base = (uint8_t*)base;
+  arena->size = size;
+  arena->phys_base = phys_base;
+  arena->granule = granule;
+  arena->blocks = new_block(0,size);
+  if(!arena->blocks){
+    free(arena);
+    return NULL;
+  }
+  return arena;
+}
+
+void vbx_dma_arena_destroy(vbx_dma_arena_t* arena){
+  if(!arena){
+    return;
+  }
+  vbx_dma_block_t* block = arena->blocks;
+  while(block){
+    vbx_dma_block_t* next = block->next;
+    if(block->child){
+      vbx_dma_arena_destroy(block->child);
+    }
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
+
+void* vbx_dma_arena_alloc(vbx_dma_arena_t* arena,size_t request_size,size_t phys_alignment_bits){
+  size_t size = (request_size + arena->granule-1) & ~(arena->granule-1);
+  uintptr_t alignment = (uintptr_t)1 << phys_alignment_bits;
+  if(size == 0){
+    size = arena->granule;
+  }
+  for(vbx_dma_block_t* block = arena->blocks;block;block = block->next){
+    if(block->in_use || block->size < size){
+      continue;
+    }
+    uintptr_t phys = arena->phys_base + block->offset;
+    size_t pad = (alignment - (phys % alignment)) % alignment;
+    if(pad + size > block->size){
+      continue;
+    }
+    if(pad){
+      //leave the padding behind as its own free block
+      if(split_block(block,block->offset + pad) != 0){
+        return NULL;
+      }
+      block = block->next;
+    }
+    if(split_block(block,block->offset + size) != 0){
+      return NULL;
+    }
+    block->in_use = 1;
+    arena->used += size;
+    arena->allocations++;
+    if(arena->used > arena->peak_used){
+      arena->peak_used = arena->used;
+    }
+    if(block->offset + size > arena->high_water){
+      arena->high_water = block->offset + size;
+    }
+    return arena->base + block->offset;
+  }
+  return NULL;
+}
+
+void* vbx_dma_arena_alloc_flags(vbx_dma_arena_t* arena,size_t request_size,size_t phys_alignment_bits,int flags){
+  void* ptr = vbx_dma_arena_alloc(arena,request_size,phys_alignment_bits);
+  if(ptr && (flags & VBX_DMA_ZERO)){
+    //only what was asked for, the rounding up to the granule is never read
+    memset(ptr,0,request_size);
+    arena->zeroed += request_size;
+  }
+  return ptr;
+}
+
+static vbx_dma_block_t* find_block(vbx_dma_arena_t* arena,void* ptr){
+  if((uint8_t*)ptr < arena->base || (uint8_t*)ptr >= arena->base + arena->size){
+    return NULL;
+  }
+  size_t offset = (uint8_t*)ptr - arena->base;
+  for(vbx_dma_block_t* block = arena->blocks;block;block = block->next){
+    if(block->offset == offset && block->in_use){
+      return block;
+    }
+    if(block->offset > offset){
+      break;
+    }
+  }
+  return NULL;
+}
+
+int vbx_dma_arena_free(vbx_dma_arena_t* arena,void* ptr){
+  vbx_dma_block_t* block = find_block(arena,ptr);
+  if(!block || block->child){
+    return -1;
+  }
+  block->in_use = 0;
+  arena->used -= block->size;
+  arena->allocations--;
+  if(block->next && !block->next->in_use){
+    merge_next(block);
+  }
+  if(block->prev && !block->prev->in_use){
+    merge_next(block->prev);
+  }
+  return 0;
+}
+
+void vbx_dma_arena_reset(vbx_dma_arena_t* arena){
+  vbx_dma_block_t* block = arena->blocks->next;
+  while(block){
+    vbx_dma_block_t* next = block->next;
+    if(block->child){
+      vbx_dma_arena_destroy(block->child);
+    }
+    free(block);
+    block = next;
+  }
+  if(arena->blocks->child){
+    vbx_dma_arena_destroy(arena->blocks->child);
+  }
+  arena->blocks->next = NULL;
+  arena->blocks->offset = 0;
+  arena->blocks->size = arena->size;
+  arena->blocks->in_use = 0;
+  arena->blocks->child = NULL;
+  arena->used = 0;
+  arena->allocations = 0;
+}
+
+vbx_dma_arena_t* vbx_dma_arena_sub(vbx_dma_arena_t* parent,size_t size,const char* owner){
+  //children are carved on granule boundaries, so they inherit the granule
+  uint8_t* base = (uint8_t*)vbx_dma_arena_alloc(parent,size,0);
+  if(!base){
+    return NULL;
+  }
+  vbx_dma_block_t* block = find_block(parent,base);
+  vbx_dma_arena_t* child = vbx_dma_arena_init(base,block->size,
+                                              parent->phys_base + block->offset,
+                                              parent->granule);
+  if(!child){
+    vbx_dma_arena_free(parent,base);
+    return NULL;
+  }
+  child->owner = owner;
+  child->parent = parent;
+  block->child = child;
+  return child;
+}
+
+int vbx_dma_arena_release(vbx_dma_arena_t* child){
+  vbx_dma_arena_t* parent = child->parent;
+  if(!parent){
+    return -1;
+  }
+  vbx_dma_block_t* block = find_block(parent,child->base);
+  if(!block || block->child != child){
+    return -1;
+  }
+  block->child = NULL;
+  vbx_dma_arena_destroy(child);
+  return vbx_dma_arena_free(parent,block->offset + parent->base);
+}
+
+void vbx_dma_arena_get_stats(const vbx_dma_arena_t* arena,vbx_dma_arena_stats_t* stats){
+  memset(stats,0,sizeof(*stats));
+  stats->size = arena->size;
+  stats->used = arena->used;
+  stats->peak_used = arena->peak_used;
+  stats->high_water = arena->high_water;
+  stats->zeroed = arena->zeroed;
+  stats->allocations = arena->allocations;
+  for(const vbx_dma_block_t* block = arena->blocks;block;block = block->next){
+    if(block->in_use){
+      continue;
+    }
+    stats->free += block->size;
+    stats->free_blocks++;
+    if(block->size > stats->largest_free){
+      stats->largest_free = block->size;
+    }
+  }
+  //share of free memory that can't be handed out as one buffer
+  if(stats->free){
+    stats->fragmentation_pct = (int)(100 - (stats->largest_free*100)/stats->free);
+  }
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vbx_cnn_api.h"
+
+#define ARENA_BYTES (64 * 1024)
+#define GRANULE 64
+// 64 bytes past a page, so page aligned buffers need padding
+#define PHYS_BASE 0x10000040
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static size_t offset_of(const vbx_dma_arena_t *arena, const void *ptr) {
+	return (const uint8_t *)ptr - arena->base;
+}
+
+static void test_free_and_coalesce(uint8_t *block) {
+	vbx_dma_arena_t *arena = vbx_dma_arena_init(block, ARENA_BYTES, PHYS_BASE, GRANULE);
+	vbx_dma_arena_stats_t stats;
+	CHECK(arena != NULL);
+
+	// sizes are rounded up to the granule
+	uint8_t *a = vbx_dma_arena_alloc(arena, 100, 0);
+	CHECK(a == arena->base);
+	CHECK(arena->used == 128 && arena->allocations == 1);
+
+	// page aligned physically, leaving a padding block between a and b
+	uint8_t *b = vbx_dma_arena_alloc(arena, 1000, 12);
+	CHECK(b != NULL);
+	CHECK((PHYS_BASE + offset_of(arena, b)) % 4096 == 0);
+	CHECK(offset_of(arena, b) == 4096 - 64);
+	vbx_dma_arena_get_stats(arena, &stats);
+	CHECK(stats.free_blocks == 2);
+	CHECK(stats.free == ARENA_BYTES - 128 - 1024);
+	CHECK(stats.largest_free == ARENA_BYTES - offset_of(arena, b) - 1024);
+	CHECK(stats.fragmentation_pct == (int)(100 - stats.largest_free * 100 / stats.free));
+
+	// the padding is handed out again, first fit
+	uint8_t *c = vbx_dma_arena_alloc(arena, 3000, 0);
+	CHECK(c == a + 128);
+	CHECK(arena->used == 128 + 1024 + 3008);
+
+	// a bad pointer or a second free is refused
+	CHECK(vbx_dma_arena_free(arena, a + 1) == -1);
+	CHECK(vbx_dma_arena_free(arena, a) == 0);
+	CHECK(vbx_dma_arena_free(arena, a) == -1);
+
+	// c merges with a before it and the rest of the padding after it
+	CHECK(vbx_dma_arena_free(arena, c) == 0);
+	vbx_dma_arena_get_stats(arena, &stats);
+	CHECK(stats.free_blocks == 2);
+	CHECK(stats.allocations == 1 && stats.used == 1024);
+
+	// and b with everything either side, back to one block
+	CHECK(vbx_dma_arena_free(arena, b) == 0);
+	vbx_dma_arena_get_stats(arena, &stats);
+	CHECK(stats.free_blocks == 1 && stats.free == ARENA_BYTES);
+	CHECK(stats.largest_free == ARENA_BYTES && stats.fragmentation_pct == 0);
+	CHECK(stats.used == 0 && stats.allocations == 0);
+	CHECK(stats.peak_used == 128 + 1024 + 3008);
+	CHECK(stats.high_water == offset_of(arena, b) + 1024);
+
+	// reused after the free
+	uint8_t *d = vbx_dma_arena_alloc(arena, 64, 0);
+	CHECK(d == arena->base);
+	CHECK(vbx_dma_arena_alloc(arena, ARENA_BYTES, 0) == NULL);
+	CHECK(vbx_dma_arena_free(arena, d) == 0);
+	vbx_dma_arena_destroy(arena);
+
+	CHECK(vbx_dma_arena_init(block, ARENA_BYTES, PHYS_BASE, 48) == NULL);
+}
+
+static void test_zero(uint8_t *block) {
+	vbx_dma_arena_t *arena = vbx_dma_arena_init(block, ARENA_BYTES, PHYS_BASE, GRANULE);
+	memset(block, 0xff, ARENA_BYTES);
+	uint8_t *plain = vbx_dma_arena_alloc_flags(arena, 100, 0, 0);
+	CHECK(plain && plain[0] == 0xff);
+	uint8_t *zeroed = vbx_dma_arena_alloc_flags(arena, 100, 0, VBX_DMA_ZERO);
+	CHECK(zeroed != NULL);
+	int clear = 1;
+	for (int i = 0; zeroed && i < 100; i++) {
+		clear &= zeroed[i] == 0;
+	}
+	CHECK(clear);
+	// only what was asked for is cleared, not the rounding up to the granule
+	CHECK(zeroed && zeroed[100] == 0xff);
+	CHECK(arena->zeroed == 100);
+	vbx_dma_arena_destroy(arena);
+}
+
+static void test_sub_and_reset(uint8_t *block) {
+	vbx_dma_arena_t *arena = vbx_dma_arena_init(block, ARENA_BYTES, PHYS_BASE, GRANULE);
+	vbx_dma_arena_stats_t stats;
+	uint8_t *a = vbx_dma_arena_alloc(arena, 256, 0);
+
+	vbx_dma_arena_t *child = vbx_dma_arena_sub(arena, 8030, "model");
+	CHECK(child != NULL);
+	CHECK(child->parent == arena && child->size == 8064 && child->granule == GRANULE);
+	CHECK(child->phys_base == PHYS_BASE + offset_of(arena, child->base));
+	CHECK(arena->used == 256 + child->size && arena->allocations == 2);
+	// the child's block can only go back through vbx_dma_arena_release
+	CHECK(vbx_dma_arena_free(arena, child->base) == -1);
+	CHECK(vbx_dma_arena_release(arena) == -1);
+
+	uint8_t *x = vbx_dma_arena_alloc(child, 4000, 0);
+	uint8_t *y = vbx_dma_arena_alloc(child, 4000, 0);
+	CHECK(x == child->base && y == x + 4032);
+	CHECK(vbx_dma_arena_alloc(child, 128, 0) == NULL);
+	CHECK(arena->used == 256 + child->size);
+	CHECK(vbx_dma_arena_free(arena, x) == -1);
+	CHECK(vbx_dma_arena_free(child, x) == 0);
+	vbx_dma_arena_get_stats(child, &stats);
+	CHECK(stats.used == 4032 && stats.peak_used == 8064 && stats.free_blocks == 1);
+
+	CHECK(vbx_dma_arena_release(child) == 0);
+	vbx_dma_arena_get_stats(arena, &stats);
+	CHECK(stats.used == 256 && stats.allocations == 1 && stats.free_blocks == 1);
+
+	// reset drops buffers and sub-arenas alike
+	CHECK(vbx_dma_arena_sub(arena, 4096, "pipeline") != NULL);
+	CHECK(vbx_dma_arena_alloc(arena, 1000, 8) != NULL);
+	vbx_dma_arena_reset(arena);
+	vbx_dma_arena_get_stats(arena, &stats);
+	CHECK(stats.used == 0 && stats.allocations == 0);
+	CHECK(stats.free_blocks == 1 && stats.free == ARENA_BYTES && stats.fragmentation_pct == 0);
+	CHECK(stats.peak_used >= 256 + 4096 + 1024);
+	CHECK(vbx_dma_arena_alloc(arena, 256, 0) == a);
+	vbx_dma_arena_destroy(arena);
+}
+
+int main() {
+	uint8_t *block = malloc(ARENA_BYTES);
+	if (!block) {
+		return 1;
+	}
+	test_free_and_coalesce(block);
+	test_zero(block);
+	test_sub_and_reset(block);
+	free(block);
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("arena-test passed\n");
+	return 0;
+}
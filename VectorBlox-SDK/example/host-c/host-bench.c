@@ -0,0 +1,595 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_completion.h"
+#include "vbx_cnn_ctx.h"
+#include "vbx_cnn_batch.h"
+#include "vbx_cnn_cache.h"
+#include "vbx_cnn_set.h"
+#include "vbx_cnn_trace.h"
+#include "vbx_cnn_reg_model.h"
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t cpu_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+typedef struct {
+	vbx_cnn_t *vbx_cnn;
+	model_t *model;
+	int tag;
+	int iterations;
+	int check;
+	int errors;
+} ctx_thread_t;
+
+// stands in for the core when no simulator is attached: stamps the output
+// with the input's tag and counts the runs, so a job started with another
+// thread's io table shows up
+static int tag_run(void *arg, model_t *model, vbx_cnn_io_ptr_t io_buffers[]) {
+	if (!model_get_num_inputs(model) || !model_get_num_outputs(model)) {
+		return 0;
+	}
+	uint32_t *input = (uint32_t *)(uintptr_t)io_buffers[0];
+	uint32_t *output = (uint32_t *)(uintptr_t)io_buffers[model_get_num_inputs(model)];
+	output[0] = input[0];
+	output[1]++;
+	return 0;
+}
+
+static void *ctx_thread(void *arg) {
+	ctx_thread_t *t = (ctx_thread_t *)arg;
+	vbx_cnn_trace_thread_name("ctx thread");
+	vbx_cnn_ctx_t *ctx = vbx_cnn_ctx_init(t->vbx_cnn, 0, NULL);
+	vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS];
+	int num_inputs = model_get_num_inputs(t->model);
+	int num_outputs = model_get_num_outputs(t->model);
+	for (int i = 0; i < num_inputs; ++i) {
+		io_buffers[i] = (vbx_cnn_io_ptr_t)vbx_cnn_ctx_allocate_dma_buffer(ctx,
+				model_get_input_length(t->model, i) * sizeof(uint8_t) + 2 * sizeof(uint32_t), 0);
+	}
+	for (int o = 0; o < num_outputs; ++o) {
+		io_buffers[num_inputs + o] = (vbx_cnn_io_ptr_t)vbx_cnn_ctx_allocate_dma_buffer(ctx,
+				model_get_output_length(t->model, o) * sizeof(uint32_t) + 2 * sizeof(uint32_t), 0);
+	}
+	uint32_t tags[2] = {0, 0};
+	uint32_t *input = num_inputs && num_outputs ? (uint32_t *)(uintptr_t)io_buffers[0] : tags;
+	uint32_t *output = num_inputs && num_outputs ? (uint32_t *)(uintptr_t)io_buffers[num_inputs] : tags;
+	input[0] = t->tag;
+	output[1] = t->check ? 0 : t->iterations;
+	// two jobs in flight per thread, collected oldest first
+	int jobs[2], submitted = 0, done = 0;
+	while (done < t->iterations) {
+		if (submitted < t->iterations && submitted - done < 2) {
+			int job = vbx_cnn_ctx_model_start(ctx, t->model, io_buffers);
+			if (job >= 0) {
+				jobs[submitted++ % 2] = job;
+				continue;
+			}
+		}
+		if (submitted > done && vbx_cnn_ctx_poll(ctx, jobs[done % 2]) <= 0) {
+			done++;
+		} else {
+			sched_yield();
+		}
+	}
+	if (output[0] != input[0] || output[1] != (uint32_t)t->iterations) {
+		t->errors++;
+	}
+	vbx_cnn_ctx_free(ctx);
+	return NULL;
+}
+
+static void print_run(const char *name, int iterations, uint64_t elapsed_ns, uint64_t cpu_elapsed_ns,
+		vbx_cnn_reg_model_stats_t *before, vbx_cnn_reg_model_stats_t *after) {
+	uint64_t busy_ns = after->busy_ns - before->busy_ns;
+	printf("%-12s %9.1f inf/s %9.1f us/inf %6.1f%% busy %6.1f%% cpu %8.1f reads/inf\n", name,
+			iterations * 1e9 / elapsed_ns,
+			elapsed_ns / 1e3 / iterations,
+			100.0 * busy_ns / elapsed_ns,
+			100.0 * cpu_elapsed_ns / elapsed_ns,
+			(double)(after->reg_reads - before->reg_reads) / iterations);
+	// between runs, so writing the trace isn't timed
+	vbx_cnn_trace_flush();
+}
+
+// crops of one frame run through the same model
+#define BATCH_CROPS 8
+
+static void count_crop(void *arg, int index, int status) {
+	if (status == 0) {
+		(*(int *)arg)++;
+	}
+}
+
+// size of the udmabuf window on the SoC
+#define DMA_WINDOW_BYTES (256u << 20)
+
+// start up the SoC driver's DMA side with a file mapping standing in for the
+// udmabuf window: the model and io buffers allocated from a fresh arena, with
+// only what needs it cleared, then after clearing the whole window as init did
+static void dma_init_bench(model_t *model) {
+	char path[] = "/tmp/host-bench-dmaXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return;
+	}
+	unlink(path);
+	if (ftruncate(fd, DMA_WINDOW_BYTES) != 0) {
+		close(fd);
+		return;
+	}
+	int num_inputs = model_get_num_inputs(model);
+	int num_outputs = model_get_num_outputs(model);
+	for (int full = 0; full < 2; full++) {
+		uint64_t start = now_ns();
+		uint8_t *window = mmap(NULL, DMA_WINDOW_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (window == MAP_FAILED) {
+			break;
+		}
+		if (full) {
+			memset(window, 0, DMA_WINDOW_BYTES);
+		}
+		vbx_dma_arena_t *arena = vbx_dma_arena_init(window, DMA_WINDOW_BYTES, 0x100000, 1024);
+		vbx_dma_arena_alloc_flags(arena, MAX_IO_BUFFERS * sizeof(vbx_cnn_io_ptr_t), 3, VBX_DMA_ZERO);
+		void *blob = vbx_dma_arena_alloc_flags(arena, model_get_allocate_bytes(model), 12, 0);
+		memcpy(blob, model, model_get_data_bytes(model));
+		for (int i = 0; i < num_inputs; i++) {
+			vbx_dma_arena_alloc_flags(arena, model_get_input_length(model, i), 0, 0);
+		}
+		for (int o = 0; o < num_outputs; o++) {
+			vbx_dma_arena_alloc_flags(arena, model_get_output_length(model, o) * sizeof(uint32_t), 0, VBX_DMA_ZERO);
+		}
+		uint64_t elapsed_ns = now_ns() - start;
+		printf("%-12s %9.1f ms for a %u MB window, %zu KB cleared\n", full ? "init[clear]" : "init[lazy]",
+				elapsed_ns / 1e6, DMA_WINDOW_BYTES >> 20, (full ? DMA_WINDOW_BYTES : arena->zeroed) >> 10);
+		vbx_dma_arena_destroy(arena);
+		munmap(window, DMA_WINDOW_BYTES);
+	}
+	close(fd);
+}
+
+// a catalog larger than the memory given to it: the model file stands in for
+// CACHE_MODELS models, loaded into a file mapping with room for CACHE_RESIDENT,
+// switched between the way run-video-model changes demos
+#define CACHE_MODELS 6
+#define CACHE_RESIDENT 3
+#define CACHE_FRAMES 8
+
+static void cache_bench(vbx_cnn_t *vbx_cnn, vbx_cnn_reg_model_t *reg_model, const char *filename, model_t *model,
+		vbx_cnn_io_ptr_t *io_buffers, int iterations) {
+	size_t window_bytes = CACHE_RESIDENT * ((model_get_allocate_bytes(model) + 4095) & ~(size_t)4095);
+	char path[] = "/tmp/host-bench-cacheXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return;
+	}
+	unlink(path);
+	uint8_t *window = MAP_FAILED;
+	if (ftruncate(fd, window_bytes) == 0) {
+		window = mmap(NULL, window_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (window == MAP_FAILED) {
+		return;
+	}
+	for (int prefetch = 0; prefetch < 2; prefetch++) {
+		vbx_cnn_reg_model_stats_t before, after;
+		vbx_dma_arena_t *arena = vbx_dma_arena_init(window, window_bytes, 0x100000, 1024);
+		vbx_cnn_cache_t *cache = vbx_cnn_cache_init(arena);
+		int index[CACHE_MODELS];
+		for (int m = 0; m < CACHE_MODELS; m++) {
+			index[m] = vbx_cnn_cache_add(cache, filename);
+		}
+		// every other switch goes back to the first model, so it is never the
+		// least recently used; the others take turns in the remaining room
+		int switches = iterations / CACHE_FRAMES;
+		vbx_cnn_reg_model_get_stats(reg_model, &before);
+		uint64_t start = now_ns();
+		uint64_t cpu_start = cpu_ns();
+		for (int s = 0; s < switches; s++) {
+			int current = s % 2 ? 1 + (s / 2) % (CACHE_MODELS - 1) : 0;
+			int next = (s + 1) % 2 ? 1 + ((s + 1) / 2) % (CACHE_MODELS - 1) : 0;
+			model_t *cached = vbx_cnn_cache_acquire(cache, index[current]);
+			if (!cached) {
+				fprintf(stderr, "Unable to load %s into the model cache\n", filename);
+				break;
+			}
+			if (prefetch) {
+				vbx_cnn_cache_prefetch(cache, index[next]);
+			}
+			for (int f = 0; f < CACHE_FRAMES; f++) {
+				vbx_cnn_model_start(vbx_cnn, cached, io_buffers);
+				while (vbx_cnn_model_poll(vbx_cnn) > 0);
+			}
+			vbx_cnn_cache_release(cache, index[current]);
+		}
+		vbx_cnn_reg_model_get_stats(reg_model, &after);
+		print_run(prefetch ? "cache+pf" : "cache", switches * CACHE_FRAMES, now_ns() - start, cpu_ns() - cpu_start,
+				&before, &after);
+		vbx_cnn_cache_stats_t stats;
+		vbx_cnn_cache_get_stats(cache, &stats);
+		printf("%-12s %u hits, %u misses, %u evictions, %u prefetched, %.1f ms loading, %.1f ms stalled\n", "",
+				stats.hits, stats.misses, stats.evictions, stats.prefetches, stats.load_us / 1e3, stats.stall_us / 1e3);
+		vbx_cnn_cache_free(cache);
+		vbx_dma_arena_destroy(arena);
+	}
+	munmap(window, window_bytes);
+}
+
+// start up the way run-video-model did and does: every model loaded in turn,
+// against the first loaded alone and the rest then queued on the cache's
+// loaders together, timing until the first is ready to run and the last is
+static void startup_bench(const char *filename, model_t *model) {
+	size_t window_bytes = CACHE_MODELS * ((model_get_allocate_bytes(model) + 4095) & ~(size_t)4095);
+	char path[] = "/tmp/host-bench-startupXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return;
+	}
+	unlink(path);
+	uint8_t *window = MAP_FAILED;
+	if (ftruncate(fd, window_bytes) == 0) {
+		window = mmap(NULL, window_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (window == MAP_FAILED) {
+		return;
+	}
+	// faulted in up front, as the udmabuf window is, so neither run pays for it
+	memset(window, 0, window_bytes);
+	for (int pooled = 0; pooled < 2; pooled++) {
+		vbx_dma_arena_t *arena = vbx_dma_arena_init(window, window_bytes, 0x100000, 1024);
+		vbx_cnn_cache_t *cache = vbx_cnn_cache_init(arena);
+		int index[CACHE_MODELS];
+		for (int m = 0; m < CACHE_MODELS; m++) {
+			index[m] = vbx_cnn_cache_add(cache, filename);
+		}
+		uint64_t start = now_ns();
+		uint64_t first_ns = 0;
+		for (int m = 0; m < CACHE_MODELS; m++) {
+			if (!vbx_cnn_cache_acquire(cache, index[m])) {
+				fprintf(stderr, "Unable to load %s into the model cache\n", filename);
+				break;
+			}
+			if (!m) {
+				first_ns = now_ns() - start;
+				for (int q = 1; pooled && q < CACHE_MODELS; q++) {
+					vbx_cnn_cache_prefetch(cache, index[q]);
+				}
+			}
+		}
+		uint64_t all_ns = now_ns() - start;
+		printf("%-12s %9.1f ms to the first of %d models, %9.1f ms to all\n", pooled ? "startup[pool]" : "startup[seq]",
+				first_ns / 1e6, CACHE_MODELS, all_ns / 1e6);
+		for (int m = 0; m < CACHE_MODELS; m++) {
+			vbx_cnn_cache_release(cache, index[m]);
+		}
+		vbx_cnn_cache_free(cache);
+		vbx_dma_arena_destroy(arena);
+	}
+	munmap(window, window_bytes);
+}
+
+// jobs that hang or fault now and then, recovered by the queue's watchdog;
+// the longest gap between completions shows the worst case stays bounded
+static void watchdog_bench(vbx_cnn_t *vbx_cnn, vbx_cnn_reg_model_t *reg_model, model_t *model,
+		vbx_cnn_io_ptr_t *io_buffers, int iterations, uint32_t latency_us) {
+	vbx_cnn_reg_model_stats_t before, after;
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(vbx_cnn, 4);
+	vbx_cnn_queue_set_watchdog(queue, 5 * latency_us, 1);
+	int status, failed = 0, submitted = 0, done = 0;
+	uint64_t worst_ns = 0;
+	vbx_cnn_reg_model_get_stats(reg_model, &before);
+	uint64_t start = now_ns();
+	uint64_t cpu_start = cpu_ns();
+	uint64_t last = start;
+	while (done < iterations) {
+		if (submitted < iterations && vbx_cnn_queue_submit(queue, model, io_buffers) >= 0) {
+			if (submitted % 50 == 25) {
+				vbx_cnn_reg_model_inject_hang(reg_model, 1);
+			}
+			if (submitted % 97 == 60) {
+				vbx_cnn_reg_model_inject_error(reg_model, INVALID_NETWORK_ADDRESS);
+			}
+			submitted++;
+			continue;
+		}
+		vbx_cnn_queue_wait(queue, &status);
+		failed += status != 0;
+		done++;
+		uint64_t now = now_ns();
+		if (now - last > worst_ns) {
+			worst_ns = now - last;
+		}
+		last = now;
+	}
+	vbx_cnn_reg_model_get_stats(reg_model, &after);
+	print_run("watchdog[4]", iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+	vbx_cnn_watchdog_stats_t *stats = &queue->watchdog;
+	printf("%-12s %u timeouts, %u errors, %u resets, %u requeued, %d failed, %.1f ms worst gap\n", "",
+			stats->timeouts, stats->errors, stats->resets, stats->requeued, failed, worst_ns / 1e6);
+	vbx_cnn_queue_free(queue);
+}
+
+// totals across the cores of a set, busy averaged so 100% is every core running
+static void get_set_stats(vbx_cnn_reg_model_t **reg_models, int num_cores, vbx_cnn_reg_model_stats_t *stats) {
+	memset(stats, 0, sizeof(*stats));
+	for (int c = 0; c < num_cores; c++) {
+		vbx_cnn_reg_model_stats_t core;
+		vbx_cnn_reg_model_get_stats(reg_models[c], &core);
+		stats->reg_reads += core.reg_reads;
+		stats->reg_writes += core.reg_writes;
+		stats->models_started += core.models_started;
+		stats->models_completed += core.models_completed;
+		stats->busy_ns += core.busy_ns / num_cores;
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr,
+				"Usage: %s MODEL_FILE [LATENCY_US] [ITERATIONS] [JITTER_PCT] [LIBVBX_CNN_SIM]\n"
+				"   runs MODEL_FILE against the software register model, timing each\n"
+				"   inference as LATENCY_US (default 1000) +/- JITTER_PCT percent on the core.\n"
+				"   With LIBVBX_CNN_SIM the simulator also computes the outputs.\n",
+				argv[0]);
+		return 1;
+	}
+	uint32_t latency_us = argc > 2 ? atoi(argv[2]) : 1000;
+	int iterations = argc > 3 ? atoi(argv[3]) : 1000;
+
+	vbx_cnn_reg_model_t *reg_model = vbx_cnn_reg_model_init(latency_us);
+	if (argc > 4) {
+		vbx_cnn_reg_model_set_jitter(reg_model, atoi(argv[4]));
+	}
+	if (argc > 5 && vbx_cnn_reg_model_attach_sim(reg_model, argv[5]) != 0) {
+		fprintf(stderr, "Unable to load simulator %s\n", argv[5]);
+		return 1;
+	}
+	vbx_cnn_t *vbx_cnn = vbx_cnn_init(vbx_cnn_reg_model_regs(reg_model));
+	const char *trace_file = getenv("VBX_CNN_TRACE");
+	if (trace_file && vbx_cnn_trace_open(trace_file, 0) != 0) {
+		fprintf(stderr, "Unable to write %s\n", trace_file);
+		return 1;
+	}
+	vbx_cnn_trace_thread_name("host-bench");
+
+	model_t *model = vbx_cnn_model_load(vbx_cnn, argv[1]);
+	if (!model) {
+		fprintf(stderr, "Unable to correctly read %s. Exiting\n", argv[1]);
+		return 1;
+	}
+	if (model_check_sanity(model) != 0) {
+		printf("Model %s is not sane\n", argv[1]);
+		return 1;
+	}
+
+	vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS];
+	int num_inputs = model_get_num_inputs(model);
+	for (int i = 0; i < num_inputs; ++i) {
+		io_buffers[i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(vbx_cnn,
+				model_get_input_length(model, i) * sizeof(uint8_t), 0);
+	}
+	for (int o = 0; o < (int)model_get_num_outputs(model); ++o) {
+		io_buffers[num_inputs + o] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(vbx_cnn,
+				model_get_output_length(model, o) * sizeof(uint32_t), 0);
+	}
+
+	vbx_cnn_reg_model_stats_t before, after;
+	uint64_t start, cpu_start;
+	printf("vbx_cnn_init took %u us\n", vbx_cnn->init_us);
+	dma_init_bench(model);
+	printf("%d inferences, %u us each on the core\n", iterations, latency_us);
+
+	//one model at a time, the way run-model drives the core
+	vbx_cnn_reg_model_get_stats(reg_model, &before);
+	start = now_ns();
+	cpu_start = cpu_ns();
+	for (int i = 0; i < iterations; i++) {
+		vbx_cnn_model_start(vbx_cnn, model, io_buffers);
+		while (vbx_cnn_model_poll(vbx_cnn) > 0);
+	}
+	vbx_cnn_reg_model_get_stats(reg_model, &after);
+	print_run("start+poll", iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+
+	int depths[] = {1, 2, 4, 8};
+	for (int d = 0; d < (int)(sizeof(depths) / sizeof(*depths)); d++) {
+		char name[32];
+		int status;
+		vbx_cnn_queue_t *queue = vbx_cnn_queue_init(vbx_cnn, depths[d]);
+		vbx_cnn_reg_model_get_stats(reg_model, &before);
+		start = now_ns();
+		cpu_start = cpu_ns();
+		for (int i = 0; i < iterations; i++) {
+			while (vbx_cnn_queue_submit(queue, model, io_buffers) < 0) {
+				vbx_cnn_queue_wait(queue, &status);
+			}
+		}
+		while (vbx_cnn_queue_wait(queue, &status) >= 0);
+		vbx_cnn_reg_model_get_stats(reg_model, &after);
+		snprintf(name, sizeof(name), "queue[%d]", depths[d]);
+		print_run(name, iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+		vbx_cnn_queue_free(queue);
+	}
+
+	//the crops of a frame, each with its own buffers: submitted and waited on
+	//one at a time, the way classifier_predict does, against one batch
+	int num_io = num_inputs + model_get_num_outputs(model);
+	vbx_cnn_io_ptr_t *io_sets = malloc(BATCH_CROPS * num_io * sizeof(vbx_cnn_io_ptr_t));
+	for (int c = 0; c < BATCH_CROPS; c++) {
+		for (int i = 0; i < num_io; i++) {
+			size_t bytes = i < num_inputs ? model_get_input_length(model, i) :
+					model_get_output_length(model, i - num_inputs) * sizeof(uint32_t);
+			io_sets[c * num_io + i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(vbx_cnn, bytes, 0);
+		}
+	}
+	for (int batched = 0; batched < 2; batched++) {
+		int status, collected = 0;
+		vbx_cnn_queue_t *queue = vbx_cnn_queue_init(vbx_cnn, 4);
+		vbx_cnn_reg_model_get_stats(reg_model, &before);
+		start = now_ns();
+		cpu_start = cpu_ns();
+		for (int frame = 0; frame < iterations / BATCH_CROPS; frame++) {
+			if (batched) {
+				vbx_cnn_queue_run_batch(queue, model, io_sets, BATCH_CROPS, count_crop, &collected);
+				continue;
+			}
+			for (int c = 0; c < BATCH_CROPS; c++) {
+				vbx_cnn_queue_submit(queue, model, io_sets + c * num_io);
+				vbx_cnn_queue_wait(queue, &status);
+				count_crop(&collected, c, status);
+			}
+		}
+		vbx_cnn_reg_model_get_stats(reg_model, &after);
+		print_run(batched ? "crops[batch]" : "crops[1x1]", collected, now_ns() - start, cpu_ns() - cpu_start,
+				&before, &after);
+		vbx_cnn_queue_free(queue);
+	}
+	free(io_sets);
+
+	//queue sleeping through each job on its learned latency
+	vbx_cnn_wait_t *wait = vbx_cnn_wait_init(vbx_cnn, 200);
+	for (int pass = 0; pass < 2; pass++) {
+		int status;
+		vbx_cnn_queue_t *queue = vbx_cnn_queue_init(vbx_cnn, 4);
+		vbx_cnn_queue_set_wait(queue, wait);
+		vbx_cnn_reg_model_get_stats(reg_model, &before);
+		start = now_ns();
+		cpu_start = cpu_ns();
+		for (int i = 0; i < iterations; i++) {
+			while (vbx_cnn_queue_submit(queue, model, io_buffers) < 0) {
+				vbx_cnn_queue_wait(queue, &status);
+			}
+		}
+		while (vbx_cnn_queue_wait(queue, &status) >= 0);
+		vbx_cnn_reg_model_get_stats(reg_model, &after);
+		//the first pass is learning the model's latency
+		if (pass == 1) {
+			uint32_t estimate_us, deviation_us;
+			print_run("wait[4]", iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+			vbx_cnn_wait_get_estimate(wait, model, &estimate_us, &deviation_us);
+			printf("%-12s %9u us estimate +/- %u us, %.1f ms slept, %.1f ms spun\n", "",
+					estimate_us, deviation_us, wait->stats.sleep_ns / 1e6, wait->stats.spin_ns / 1e6);
+		}
+		vbx_cnn_queue_free(queue);
+		memset(&wait->stats, 0, sizeof(wait->stats));
+	}
+	vbx_cnn_wait_free(wait);
+
+	//event loop driven by the completion fd, as an application would alongside its other inputs
+	int epfd = epoll_create1(0);
+	struct epoll_event ev = {0};
+	ev.events = EPOLLIN;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, vbx_cnn_get_completion_fd(vbx_cnn), &ev);
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(vbx_cnn, 4);
+	int job_ids[4], wakeups = 0, submitted = 0, done = 0;
+	vbx_cnn_reg_model_get_stats(reg_model, &before);
+	start = now_ns();
+	cpu_start = cpu_ns();
+	while (done < iterations) {
+		while (submitted < iterations && vbx_cnn_queue_submit(queue, model, io_buffers) >= 0) {
+			submitted++;
+		}
+		if (epoll_wait(epfd, &ev, 1, -1) > 0) {
+			wakeups++;
+		}
+		done += vbx_cnn_queue_drain(queue, job_ids, NULL, 4);
+	}
+	vbx_cnn_reg_model_get_stats(reg_model, &after);
+	print_run("epoll[4]", iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+	printf("%-12s %9.2f wakeups/inf\n", "", (double)wakeups / iterations);
+	vbx_cnn_queue_free(queue);
+	close(epfd);
+
+	watchdog_bench(vbx_cnn, reg_model, model, io_buffers, iterations, latency_us);
+	cache_bench(vbx_cnn, reg_model, argv[1], model, io_buffers, iterations);
+	startup_bench(argv[1], model);
+
+	//threads sharing the core through their own submission contexts
+	int check = argc <= 5 && model_get_num_inputs(model) && model_get_num_outputs(model);
+	if (check) {
+		vbx_cnn_reg_model_set_run_hook(reg_model, tag_run, NULL);
+	}
+	int num_threads[] = {1, 2, 4};
+	for (int n = 0; n < (int)(sizeof(num_threads) / sizeof(*num_threads)); n++) {
+		char name[32];
+		pthread_t threads[4];
+		ctx_thread_t args[4];
+		int errors = 0;
+		vbx_cnn_reg_model_get_stats(reg_model, &before);
+		start = now_ns();
+		cpu_start = cpu_ns();
+		for (int t = 0; t < num_threads[n]; t++) {
+			args[t] = (ctx_thread_t){vbx_cnn, model, 0x100 + t, iterations / num_threads[n], check, 0};
+			pthread_create(threads + t, NULL, ctx_thread, args + t);
+		}
+		for (int t = 0; t < num_threads[n]; t++) {
+			pthread_join(threads[t], NULL);
+			errors += args[t].errors;
+		}
+		vbx_cnn_reg_model_get_stats(reg_model, &after);
+		snprintf(name, sizeof(name), "ctx[%dt]", num_threads[n]);
+		print_run(name, iterations / num_threads[n] * num_threads[n], now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+		if (check && errors) {
+			printf("%-12s %d threads had jobs run with the wrong io table\n", "", errors);
+		}
+	}
+
+	//a second core sharing the first one's DMA window, jobs spread across both
+	vbx_cnn_reg_model_t *reg_models[2] = {reg_model, vbx_cnn_reg_model_init(latency_us)};
+	if (argc > 4) {
+		vbx_cnn_reg_model_set_jitter(reg_models[1], atoi(argv[4]));
+	}
+	if (argc > 5) {
+		vbx_cnn_reg_model_attach_sim(reg_models[1], argv[5]);
+	}
+	vbx_cnn_t *cores[2] = {vbx_cnn, vbx_cnn_init_shared(vbx_cnn_reg_model_regs(reg_models[1]), vbx_cnn)};
+	for (int num_cores = 1; num_cores <= 2; num_cores++) {
+		char name[32];
+		int status;
+		vbx_cnn_set_t *set = vbx_cnn_set_init(cores, num_cores, 4 * num_cores);
+		get_set_stats(reg_models, num_cores, &before);
+		start = now_ns();
+		cpu_start = cpu_ns();
+		for (int i = 0; i < iterations; i++) {
+			while (vbx_cnn_set_submit(set, model, io_buffers) < 0) {
+				vbx_cnn_set_wait(set, &status);
+			}
+		}
+		while (vbx_cnn_set_wait(set, &status) >= 0);
+		get_set_stats(reg_models, num_cores, &after);
+		snprintf(name, sizeof(name), "set[%d]", num_cores);
+		print_run(name, iterations, now_ns() - start, cpu_ns() - cpu_start, &before, &after);
+		if (num_cores > 1) {
+			printf("%-12s %9llu + %llu jobs per core\n", "",
+					(unsigned long long)set->jobs_run[0], (unsigned long long)set->jobs_run[1]);
+		}
+		vbx_cnn_set_free(set);
+	}
+
+	if (trace_file) {
+		vbx_cnn_trace_stats_t trace_stats;
+		vbx_cnn_trace_close();
+		vbx_cnn_trace_get_stats(&trace_stats);
+		printf("trace: %llu events written to %s, %llu dropped\n", (unsigned long long)trace_stats.written,
+				trace_file, (unsigned long long)trace_stats.dropped);
+	}
+	vbx_cnn_reg_model_free(reg_models[1]);
+	vbx_cnn_reg_model_free(reg_model);
+	return 0;
+}
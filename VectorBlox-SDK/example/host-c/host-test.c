@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include "host-test.h"
+#include "graph_version.h"
+
+model_t *test_model_build(size_t filler_bytes) {
+	// graph and two subgraph nodes, the filler, the tensors, then the io tables
+	size_t filler = offsetof(vnnx_graph_t, subgraphs) + 2 * sizeof(vnnx_subgraph_node_t);
+	size_t tensors = filler + filler_bytes;
+	size_t io_nodes = tensors + 3 * sizeof(vnnx_tensor_t);
+	size_t io_offsets = io_nodes + 3 * sizeof(int32_t);
+	size_t total = io_offsets + 3 * sizeof(int32_t);
+	uint8_t *data = calloc(1, total);
+	if (!data) {
+		return NULL;
+	}
+	for (size_t i = filler; i < tensors; i++) {
+		data[i] = (i * 7) >> 5;
+	}
+	vnnx_graph_t *graph = (vnnx_graph_t *)data;
+	graph->version = VNNX_GRAPH_VERSION;
+	graph->magic = 0x1ABE11ED;
+	graph->num_inputs = 1;
+	graph->num_outputs = 2;
+	graph->data_bytes = total;
+	graph->allocate_bytes = total + 4096;
+	graph->io_nodes = io_nodes;
+	graph->io_offsets = io_offsets;
+	// node 0 produces the input, node 1 both outputs
+	graph->subgraphs[0].tensors = tensors;
+	graph->subgraphs[1].tensors = tensors + sizeof(vnnx_tensor_t);
+
+	static const int shapes[3][4] = {{1, 3, 16, 16}, {1, 10, 1, 1}, {1, 4, 8, 8}};
+	static const int types[3] = {VBX_CNN_CALC_TYPE_UINT8, VBX_CNN_CALC_TYPE_INT8, VBX_CNN_CALC_TYPE_INT16};
+	vnnx_tensor_t *tensor = (vnnx_tensor_t *)(data + tensors);
+	for (int t = 0; t < 3; t++) {
+		tensor[t].type = types[t];
+		memcpy(tensor[t].shape, shapes[t], sizeof(shapes[t]));
+		tensor[t].dims = 4;
+		tensor[t].scale = 0.5f * (t + 1);
+		tensor[t].scale_f16 = 32768 * (t + 1);
+		tensor[t].zero = t - 1;
+	}
+	int32_t *nodes = (int32_t *)(data + io_nodes);
+	int32_t *offsets = (int32_t *)(data + io_offsets);
+	nodes[0] = 0; nodes[1] = 1; nodes[2] = 1;
+	offsets[0] = 0; offsets[1] = 0; offsets[2] = 1;
+	return (model_t *)data;
+}
+
+int test_file_write(char path[64], const char *suffix, const void *data, size_t bytes) {
+	snprintf(path, 64, "/tmp/host-test-XXXXXX%s", suffix);
+	int fd = mkstemps(path, strlen(suffix));
+	if (fd < 0) {
+		return -1;
+	}
+	int ok = write(fd, data, bytes) == (ssize_t)bytes;
+	close(fd);
+	return ok ? 0 : -1;
+}
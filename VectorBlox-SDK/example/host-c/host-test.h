@@ -0,0 +1,38 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+#include <stdio.h>
+#include "vbx_cnn_api.h"
+
+// shared by the tests make check runs: failed checks are printed and
+// counted, and the test exits with 1 if there were any
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static inline int test_result(const char *name) {
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("%s passed\n", name);
+	return 0;
+}
+
+/*
+ * A model the driver can load, describe and start without a real network:
+ * one uint8 input {1,3,16,16}, an int8 output {1,10,1,1} and an int16 output
+ * {1,4,8,8}, with filler_bytes of patterned weights between the graph and
+ * the tensors, so the io descriptors can be pushed past the first packed chunk.
+ * Released with free().
+ */
+model_t *test_model_build(size_t filler_bytes);
+
+// writes bytes to a new file in /tmp named after suffix, into path; 0 on success
+int test_file_write(char path[64], const char *suffix, const void *data, size_t bytes);
+
+#endif // HOST_TEST_H
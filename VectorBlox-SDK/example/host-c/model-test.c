@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "host-test.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_packed.h"
+#include "vbx_cnn_bundle.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_reg_model.h"
+
+// enough weights that the model spans several packed chunks
+#define FILLER_BYTES (600 * 1024)
+
+static int same_io_info(const model_io_info_t *a, const model_io_info_t *b) {
+	if (!a || !b || a->num_inputs != b->num_inputs || a->num_outputs != b->num_outputs) {
+		return 0;
+	}
+	for (int t = 0; t < a->num_inputs + a->num_outputs; t++) {
+		const vbx_cnn_tensor_info_t *x = a->inputs + t, *y = b->inputs + t;
+		if (x->length != y->length || x->bytes != y->bytes || x->dims != y->dims ||
+		    memcmp(x->shape, y->shape, sizeof(x->shape)) || x->datatype != y->datatype ||
+		    x->scale != y->scale || x->scale_fix16 != y->scale_fix16 || x->zero_point != y->zero_point) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// the model stored at offset in fd reads, loads and describes as the original
+static void check_stored(vbx_cnn_t *vbx_cnn, const model_t *original, const model_io_info_t *info,
+                         int fd, off_t offset, size_t size, int packed) {
+	size_t data_bytes = model_get_data_bytes(original);
+	size_t allocate_bytes = vbx_cnn_model_peek_fd(fd, offset, size);
+	CHECK(allocate_bytes == model_get_allocate_bytes(original));
+
+	model_t *model = NULL;
+	CHECK(posix_memalign((void **)&model, 4096, allocate_bytes) == 0);
+	CHECK(vbx_cnn_model_read_fd(fd, offset, size, model) == 0);
+	CHECK(memcmp(model, original, data_bytes) == 0);
+	free(model);
+
+	// DMA buffers outside the SoC driver come from posix_memalign
+	model = vbx_cnn_model_load_fd(vbx_cnn, fd, offset, size);
+	CHECK(model && memcmp(model, original, data_bytes) == 0);
+	free(model);
+
+	model_io_info_t *peeked = vbx_cnn_model_peek_io_info_fd(fd, offset, size);
+	CHECK(peeked && peeked->model == NULL);
+	CHECK(same_io_info(peeked, info));
+	if (peeked) {
+		model_io_info_free(peeked);
+	}
+	// cut short, it is refused rather than read past: by the peek, or for a
+	// packed model, whose header is whole, by reading the chunk table
+	if (packed) {
+		model = NULL;
+		CHECK(posix_memalign((void **)&model, 4096, allocate_bytes) == 0);
+		CHECK(vbx_cnn_model_read_fd(fd, offset, size / 2, model) == -1);
+		free(model);
+	} else {
+		CHECK(vbx_cnn_model_peek_fd(fd, offset, size / 2) == 0);
+	}
+}
+
+static void check_file(vbx_cnn_t *vbx_cnn, const model_t *original, const model_io_info_t *info,
+                       const char *path, int packed) {
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	CHECK(fd >= 0 && fstat(fd, &st) == 0);
+	check_stored(vbx_cnn, original, info, fd, 0, st.st_size, packed);
+	close(fd);
+	model_t *model = vbx_cnn_model_load(vbx_cnn, path);
+	CHECK(model && memcmp(model, original, model_get_data_bytes(original)) == 0);
+	free(model);
+}
+
+// a .vbxb holding the model both plain and packed, each on its own page
+static void *bundle_build(const void *plain, size_t plain_bytes, const void *packed, size_t packed_bytes,
+                          size_t *bundle_bytes) {
+	size_t plain_offset = VBX_CNN_BUNDLE_ALIGN;
+	size_t packed_offset = (plain_offset + plain_bytes + VBX_CNN_BUNDLE_ALIGN - 1) & ~(size_t)(VBX_CNN_BUNDLE_ALIGN - 1);
+	*bundle_bytes = packed_offset + packed_bytes;
+	uint8_t *bundle = calloc(1, *bundle_bytes);
+	if (!bundle) {
+		return NULL;
+	}
+	vbx_cnn_bundle_header_t *header = (vbx_cnn_bundle_header_t *)bundle;
+	header->magic = VBX_CNN_BUNDLE_MAGIC;
+	header->version = VBX_CNN_BUNDLE_VERSION;
+	header->num_entries = 2;
+	vbx_cnn_bundle_entry_t *entries = (vbx_cnn_bundle_entry_t *)(header + 1);
+	strcpy(entries[0].name, "plain");
+	entries[0].model_offset = plain_offset;
+	entries[0].model_bytes = plain_bytes;
+	entries[0].allocate_bytes = model_get_allocate_bytes((const model_t *)plain);
+	strcpy(entries[1].name, "packed");
+	entries[1].model_offset = packed_offset;
+	entries[1].model_bytes = packed_bytes;
+	entries[1].allocate_bytes = entries[0].allocate_bytes;
+	memcpy(bundle + plain_offset, plain, plain_bytes);
+	memcpy(bundle + packed_offset, packed, packed_bytes);
+	return bundle;
+}
+
+int main() {
+	vbx_cnn_reg_model_t *reg_model = vbx_cnn_reg_model_init(0);
+	model_t *model = test_model_build(FILLER_BYTES);
+	if (!reg_model || !model) {
+		return 1;
+	}
+	vbx_cnn_t *vbx_cnn = vbx_cnn_init(vbx_cnn_reg_model_regs(reg_model));
+	CHECK(vbx_cnn != NULL);
+	model_io_info_t *info = model_io_info_init(model);
+	CHECK(info != NULL);
+	size_t model_bytes = model_get_data_bytes(model);
+
+	size_t packed_bytes = 0;
+	void *packed = vbx_cnn_packed_compress(model, &packed_bytes);
+	CHECK(packed != NULL);
+	CHECK(((vbx_cnn_packed_header_t *)packed)->num_chunks == (model_bytes + VBX_CNN_PACKED_CHUNK - 1) / VBX_CNN_PACKED_CHUNK);
+	size_t bundle_bytes = 0;
+	void *bundle = bundle_build(model, model_bytes, packed, packed_bytes, &bundle_bytes);
+	CHECK(bundle != NULL);
+
+	char vnnx_path[64], vbxz_path[64], vbxb_path[64];
+	CHECK(test_file_write(vnnx_path, ".vnnx", model, model_bytes) == 0);
+	CHECK(test_file_write(vbxz_path, ".vbxz", packed, packed_bytes) == 0);
+	CHECK(test_file_write(vbxb_path, ".vbxb", bundle, bundle_bytes) == 0);
+	check_file(vbx_cnn, model, info, vnnx_path, 0);
+	check_file(vbx_cnn, model, info, vbxz_path, 1);
+
+	vbx_cnn_bundle_t *opened = vbx_cnn_bundle_open(vbxb_path);
+	CHECK(opened && opened->num_entries == 2);
+	if (opened) {
+		const char *names[2] = {"packed", "plain"};
+		for (int n = 0; n < 2; n++) {
+			int e = vbx_cnn_bundle_find(opened, names[n]);
+			CHECK(e == 1 - n);
+			if (e >= 0) {
+				const vbx_cnn_bundle_entry_t *entry = opened->entries + e;
+				check_stored(vbx_cnn, model, info, opened->fd, entry->model_offset, entry->model_bytes, e == 1);
+			}
+		}
+		CHECK(vbx_cnn_bundle_find(opened, "missing") < 0);
+		vbx_cnn_bundle_close(opened);
+	}
+
+	unlink(vnnx_path);
+	unlink(vbxz_path);
+	unlink(vbxb_path);
+	free(bundle);
+	free(packed);
+	model_io_info_free(info);
+	vbx_cnn_free(vbx_cnn);
+	vbx_cnn_reg_model_free(reg_model);
+	free(model);
+	return test_result("model-test");
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../pdma/pdma_helpers.h"
+
+#define FRAMES 20
+#define MAX_OUTPUTS 16
+
+// a channel moves bytes at this rate while the cpu is free to do other work,
+// after the ioctl round trip that sets each transfer up
+typedef struct {
+	double mbps;
+	double setup_us;
+	double cpu_mbps;   // a cpu copy out of uncached DMA memory
+	int transfers;
+} dma_model_t;
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns){
+	struct timespec ts = {ns / 1000000000ull, ns % 1000000000ull};
+	nanosleep(&ts, NULL);
+}
+
+// stands in for START_XFER + FINISH_XFER on a dma-proxy channel
+static int32_t memcpy_xfer(void* arg, int channel, uint64_t destbuf, uint64_t srcbuf, size_t n){
+	dma_model_t* dma = (dma_model_t*)arg;
+	(void)channel;
+	uint64_t start = now_ns();
+	memcpy((void*)(uintptr_t)destbuf, (void*)(uintptr_t)srcbuf, n);
+	__atomic_fetch_add(&dma->transfers, 1, __ATOMIC_RELAXED);
+	uint64_t transfer_ns = (uint64_t)(dma->setup_us * 1e3 + n * 1e3 / dma->mbps);
+	uint64_t elapsed_ns = now_ns() - start;
+	if (elapsed_ns < transfer_ns) {
+		sleep_ns(transfer_ns - elapsed_ns);
+	}
+	return 0;
+}
+
+// the cost curves pdma_copy_calibrate() would measure on target
+static uint64_t simulated_cost(void* arg, const pdma_copy_t* copy, int engine, size_t n){
+	dma_model_t* dma = (dma_model_t*)arg;
+	if (engine == PDMA_ENGINE_CPU) {
+		return (uint64_t)(n * 1e3 / dma->cpu_mbps);
+	}
+	int channels = n >= PDMA_SG_SPLIT_BYTES ? copy->pdma->num_channels : 1;
+	return (uint64_t)(dma->setup_us * 1e3 + n * 1e3 / (dma->mbps * channels));
+}
+
+// postprocessing that reads an output, at about the cpu cost of decoding it
+static uint32_t process(const int8_t* data, size_t n, int passes){
+	uint32_t sum = 0;
+	for (int p = 0; p < passes; p++) {
+		for (size_t i = 0; i < n; i++) {
+			sum = sum * 31 + data[i];
+		}
+	}
+	return sum;
+}
+
+static void print_mode(const char* name, uint64_t best_ns, const dma_model_t* dma, int match){
+	printf("%-12s %9.3f ms per frame %4d transfers%s\n", name, best_ns / 1e6, dma->transfers / FRAMES,
+			match ? "" : "  MISMATCH");
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr,
+				"Usage: %s OUTPUT_BYTES... [-m MBPS] [-s SETUP_US] [-c CPU_MBPS] [-p PASSES]\n"
+				"   times copying a model's outputs into the PDMA window then postprocessing each,\n"
+				"   with a memcpy stand-in for the dma-proxy channels that takes as long as\n"
+				"   MBPS (default 400) would after SETUP_US (default 15) for the ioctls of each transfer:\n"
+				"   copied one at a time as the demos did, submitted together and processed as each\n"
+				"   arrives on 1 to %d channels, then as one scatter-gather list. Last the list is\n"
+				"   routed by size, calibrated against a cpu copying CPU_MBPS (default 100) out of\n"
+				"   DMA memory; the cpu's copies there are this machine's own memcpy.\n"
+				"   PASSES (default 4) sets how much work postprocessing does per byte\n",
+				argv[0], PDMA_MAX_CHANNELS);
+		return 1;
+	}
+	dma_model_t dma = {400, 15, 100, 0};
+	int passes = 4;
+	size_t lengths[MAX_OUTPUTS];
+	size_t offsets[MAX_OUTPUTS];
+	int num_outputs = 0;
+	size_t total_bytes = 0;
+	for (int a = 1; a < argc; a++) {
+		if (!strcmp(argv[a], "-m") && a + 1 < argc) {
+			dma.mbps = atof(argv[++a]);
+		} else if (!strcmp(argv[a], "-s") && a + 1 < argc) {
+			dma.setup_us = atof(argv[++a]);
+		} else if (!strcmp(argv[a], "-c") && a + 1 < argc) {
+			dma.cpu_mbps = atof(argv[++a]);
+		} else if (!strcmp(argv[a], "-p") && a + 1 < argc) {
+			passes = atoi(argv[++a]);
+		} else if (num_outputs < MAX_OUTPUTS && atol(argv[a]) > 0) {
+			// laid out like DMA buffers allocated one after another
+			offsets[num_outputs] = (total_bytes + PDMA_SG_ALIGN - 1) & ~(size_t)(PDMA_SG_ALIGN - 1);
+			lengths[num_outputs] = atol(argv[a]);
+			total_bytes = offsets[num_outputs] + lengths[num_outputs];
+			num_outputs++;
+		}
+	}
+	if (!num_outputs || dma.mbps <= 0 || dma.cpu_mbps <= 0) {
+		fprintf(stderr, "Expected output sizes in bytes\n");
+		return 1;
+	}
+	int8_t* outputs = malloc(total_bytes);
+	// room for frames in flight in the ring, and the calibration's largest copy
+	size_t staging_bytes = 3 * total_bytes > PDMA_COPY_CALIBRATE_MAX ? 3 * total_bytes : PDMA_COPY_CALIBRATE_MAX;
+	int8_t* staging = malloc(staging_bytes);
+	for (size_t i = 0; i < total_bytes; i++) {
+		outputs[i] = (int8_t)(i * 7);
+	}
+	memset(staging, 0, staging_bytes);
+	// phys is the virtual address, so the stand-in copies straight into it
+	pdma_window_t window = {staging, (uint64_t)(uintptr_t)staging, staging_bytes, 0, -1};
+	uint32_t expected = 0;
+	for (int o = 0; o < num_outputs; o++) {
+		expected += process(outputs + offsets[o], lengths[o], passes);
+	}
+
+	printf("%d outputs, %zu bytes, %.0f MB/s per channel, %.0f us per transfer\n", num_outputs, total_bytes,
+			dma.mbps, dma.setup_us);
+	for (int channels = 0; channels <= PDMA_MAX_CHANNELS; channels = channels ? channels * 2 : 1) {
+		// 0 channels: the blocking copies the demos made before postprocessing
+		pdma_async_t* pdma = pdma_async_init(channels ? channels : 1, memcpy_xfer, &dma);
+		if (!pdma) {
+			return 1;
+		}
+		uint64_t best_ns = UINT64_MAX;
+		int match = 1;
+		dma.transfers = 0;
+		for (int f = 0; f < FRAMES; f++) {
+			int32_t tokens[MAX_OUTPUTS];
+			uint32_t sum = 0;
+			uint64_t start = now_ns();
+			for (int o = 0; o < num_outputs; o++) {
+				uint64_t dst = (uint64_t)(uintptr_t)(staging + offsets[o]);
+				uint64_t src = (uint64_t)(uintptr_t)(outputs + offsets[o]);
+				if (channels) {
+					tokens[o] = pdma_async_submit(pdma, dst, src, lengths[o]);
+				} else {
+					memcpy_xfer(&dma, 0, dst, src, lengths[o]);
+				}
+			}
+			for (int o = 0; o < num_outputs; o++) {
+				if (channels) {
+					match &= pdma_async_wait(pdma, tokens[o]) == 0;
+				}
+				sum += process(staging + offsets[o], lengths[o], passes);
+			}
+			uint64_t elapsed_ns = now_ns() - start;
+			best_ns = elapsed_ns < best_ns ? elapsed_ns : best_ns;
+			match &= sum == expected;
+			memset(staging, 0, total_bytes);
+		}
+		pdma_async_close(pdma);
+		char name[32];
+		snprintf(name, sizeof(name), channels ? "async[%dch]" : "blocking", channels);
+		print_mode(name, best_ns, &dma, match);
+	}
+
+	for (int routed = 0; routed <= 1; routed++) {
+		for (int channels = 1; channels <= PDMA_MAX_CHANNELS; channels *= 2) {
+			pdma_async_t* pdma = pdma_async_init(channels, memcpy_xfer, &dma);
+			if (!pdma) {
+				return 1;
+			}
+			pdma_copy_t copy;
+			pdma_copy_init(&copy, pdma, &window);
+			if (routed) {
+				pdma_copy_calibrate(&copy, PDMA_SOURCE_DMA, simulated_cost, &dma);
+			}
+			uint64_t best_ns = UINT64_MAX;
+			int match = 1;
+			dma.transfers = 0;
+			for (int f = 0; f < FRAMES; f++) {
+				pdma_region_t regions[MAX_OUTPUTS];
+				uint32_t sum = 0;
+				uint64_t start = now_ns();
+				for (int o = 0; o < num_outputs; o++) {
+					regions[o].src = outputs + offsets[o];
+					regions[o].n = lengths[o];
+				}
+				int32_t token = pdma_copy_submit(&copy, PDMA_SOURCE_DMA, 0, regions, num_outputs);
+				match &= pdma_copy_wait(&copy, token) == 0;
+				for (int o = 0; o < num_outputs && match; o++) {
+					sum += process(regions[o].dst, lengths[o], passes);
+				}
+				uint64_t elapsed_ns = now_ns() - start;
+				best_ns = elapsed_ns < best_ns ? elapsed_ns : best_ns;
+				match &= sum == expected;
+				memset(staging, 0, total_bytes);
+			}
+			pdma_async_close(pdma);
+			char name[32];
+			snprintf(name, sizeof(name), routed ? "route[%dch]" : "sg[%dch]", channels);
+			print_mode(name, best_ns, &dma, match);
+			if (routed && copy.threshold[PDMA_SOURCE_DMA] != SIZE_MAX) {
+				printf("             PDMA from %zu bytes\n", copy.threshold[PDMA_SOURCE_DMA]);
+			} else if (routed) {
+				printf("             cpu at every size\n");
+			}
+		}
+	}
+
+	// each frame in its own ring slot, so one is copied while the one before is postprocessed
+	for (int channels = 1; channels <= PDMA_MAX_CHANNELS; channels *= 2) {
+		pdma_async_t* pdma = pdma_async_init(channels, memcpy_xfer, &dma);
+		pdma_ring_t* ring = pdma_ring_init(window.size);
+		if (!pdma || !ring) {
+			return 1;
+		}
+		pdma_copy_t copy;
+		pdma_copy_init(&copy, pdma, &window);
+		pdma_region_t regions[2][MAX_OUTPUTS];
+		int slots[2];
+		int32_t tokens[2];
+		int match = 1;
+		dma.transfers = 0;
+		uint64_t start = now_ns();
+		for (int f = 0; f <= FRAMES; f++) {
+			if (f < FRAMES) {
+				pdma_region_t* frame = regions[f % 2];
+				size_t offset;
+				for (int o = 0; o < num_outputs; o++) {
+					frame[o].src = outputs + offsets[o];
+					frame[o].n = lengths[o];
+				}
+				slots[f % 2] = pdma_ring_try_acquire(ring, pdma_pack_bytes(frame, num_outputs), &offset);
+				tokens[f % 2] = slots[f % 2] >= 0 ? pdma_copy_submit(&copy, PDMA_SOURCE_DMA, offset, frame, num_outputs) : -1;
+			}
+			if (f > 0) {
+				int last = (f - 1) % 2;
+				uint32_t sum = 0;
+				match &= pdma_copy_wait(&copy, tokens[last]) == 0;
+				for (int o = 0; o < num_outputs && match; o++) {
+					sum += process(regions[last][o].dst, lengths[o], passes);
+				}
+				match &= sum == expected;
+				if (slots[last] >= 0) {
+					pdma_ring_release(ring, slots[last]);
+				}
+			}
+		}
+		uint64_t frame_ns = (now_ns() - start) / FRAMES;
+		pdma_async_close(pdma);
+		pdma_ring_close(ring);
+		char name[32];
+		snprintf(name, sizeof(name), "ring[%dch]", channels);
+		print_mode(name, frame_ns, &dma, match);
+	}
+	free(staging);
+	free(outputs);
+	return 0;
+}
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "host-test.h"
+#include "../pdma/pdma_helpers.h"
+
+#define WINDOW_BYTES (256 * 1024)
+#define SOURCE_BYTES (256 * 1024)
+
+// stands in for the dma-proxy channels, addresses are the process's own
+static int32_t memcpy_xfer(void *arg, int channel, uint64_t destbuf, uint64_t srcbuf, size_t n) {
+	memcpy((void *)(uintptr_t)destbuf, (const void *)(uintptr_t)srcbuf, n);
+	return 0;
+}
+
+static size_t window_offset(const pdma_window_t *window, const pdma_region_t *region) {
+	return region->dst - window->virt;
+}
+
+static void test_sg_pack(uint8_t *source, pdma_window_t *window) {
+	pdma_async_t *pdma = pdma_async_init(2, memcpy_xfer, NULL);
+	CHECK(pdma != NULL);
+	pdma_region_t regions[5] = {
+		{source, 100, NULL},
+		{source + 300, 50, NULL},             // within PDMA_SG_MAX_GAP, joins with its gap
+		{source + 300 + 50 + PDMA_SG_MAX_GAP + 1, 70, NULL},  // just too far, a new aligned segment
+		{source + 16, 10, NULL},              // behind the one before, a new segment
+		{source + 128 * 1024, 100 * 1024, NULL},  // split between the channels
+	};
+	memset(window->virt, 0, window->size);
+	int32_t token = pdma_async_submit_sg(pdma, window, 10, regions, 5);
+	CHECK(token >= 0);
+	CHECK(pdma_async_wait(pdma, token) == 0);
+
+	size_t expected[5];
+	expected[0] = 64;                              // 10 rounded up to PDMA_SG_ALIGN
+	expected[1] = expected[0] + 300;
+	expected[2] = (expected[1] + 50 + 63) & ~(size_t)63;
+	expected[3] = (expected[2] + 70 + 63) & ~(size_t)63;
+	expected[4] = (expected[3] + 10 + 63) & ~(size_t)63;
+	for (int r = 0; r < 5; r++) {
+		CHECK(window_offset(window, regions + r) == expected[r]);
+		CHECK(window_offset(window, regions + r) % PDMA_SG_ALIGN == 0 || r == 1);
+		CHECK(memcmp(regions[r].dst, regions[r].src, regions[r].n) == 0);
+	}
+	// the gap is copied along with the regions either side of it
+	CHECK(memcmp(regions[0].dst, source, 350) == 0);
+
+	// the layout from offset 0 takes what pdma_pack_bytes says
+	size_t bytes = pdma_pack_bytes(regions, 5);
+	CHECK(pdma_async_wait(pdma, pdma_async_submit_sg(pdma, window, 0, regions, 5)) == 0);
+	CHECK(bytes == window_offset(window, regions + 4) + regions[4].n);
+	// and no more will fit after the end of the window
+	CHECK(pdma_async_submit_sg(pdma, window, window->size - bytes + 1, regions, 5) == -1);
+	CHECK(pdma_async_submit_sg(pdma, window, window->size - bytes, regions, 5) >= 0);
+	CHECK(pdma_async_wait_all(pdma) == 0);
+	pdma_async_close(pdma);
+}
+
+typedef struct {
+	pdma_ring_t *ring;
+	int slot;
+	int released;
+} release_arg_t;
+
+static void *release_later(void *arg) {
+	release_arg_t *release = (release_arg_t *)arg;
+	usleep(20000);
+	release->released = 1;
+	pdma_ring_release(release->ring, release->slot);
+	return NULL;
+}
+
+static void test_ring(void) {
+	pdma_ring_t *ring = pdma_ring_init(WINDOW_BYTES);
+	int slots[PDMA_RING_SLOTS];
+	size_t offset, offsets[PDMA_RING_SLOTS];
+	CHECK(ring != NULL);
+	CHECK(pdma_ring_try_acquire(ring, WINDOW_BYTES + 1, &offset) == -1);
+
+	// every slot in flight holds the ring back, with the window far from full
+	for (int s = 0; s < PDMA_RING_SLOTS; s++) {
+		slots[s] = pdma_ring_try_acquire(ring, 1000, &offsets[s]);
+		CHECK(slots[s] >= 0);
+		CHECK(offsets[s] == (size_t)s * 1024);
+	}
+	CHECK(pdma_ring_try_acquire(ring, 1000, &offset) == -1);
+
+	// slots come back oldest first, so releasing a later one frees nothing yet
+	pdma_ring_release(ring, slots[3]);
+	CHECK(pdma_ring_try_acquire(ring, 1000, &offset) == -1);
+
+	// pdma_ring_acquire waits for another thread to release the oldest
+	release_arg_t release = {ring, slots[0], 0};
+	pthread_t thread;
+	pthread_create(&thread, NULL, release_later, &release);
+	int slot = pdma_ring_acquire(ring, 1000, &offset);
+	CHECK(slot >= 0);
+	CHECK(release.released);
+	CHECK(offset == PDMA_RING_SLOTS * 1024);
+	pthread_join(thread, NULL);
+	CHECK(pdma_ring_try_acquire(ring, 1000, &offset) == -1);
+	pdma_ring_close(ring);
+
+	// out of bytes rather than slots: the next slot wraps to the start once it is free
+	ring = pdma_ring_init(4096);
+	int a = pdma_ring_try_acquire(ring, 2048, &offset);
+	int b = pdma_ring_try_acquire(ring, 1024, &offset);
+	CHECK(a >= 0 && b >= 0 && offset == 2048);
+	CHECK(pdma_ring_try_acquire(ring, 2048, &offset) == -1);
+	pdma_ring_release(ring, a);
+	CHECK(pdma_ring_try_acquire(ring, 2048, &offset) >= 0);
+	CHECK(offset == 0);
+	pdma_ring_close(ring);
+}
+
+int main() {
+	uint8_t *source = malloc(SOURCE_BYTES);
+	pdma_window_t window;
+	window.virt = malloc(WINDOW_BYTES);
+	if (!source || !window.virt) {
+		return 1;
+	}
+	window.phys = (uint64_t)(uintptr_t)window.virt;
+	window.size = WINDOW_BYTES;
+	window.src_offset = 0;
+	window.fd = -1;
+	for (int i = 0; i < SOURCE_BYTES; i++) {
+		source[i] = i * 31 + (i >> 8);
+	}
+	test_sg_pack(source, &window);
+	test_ring();
+	free(window.virt);
+	free(source);
+	return test_result("pdma-test");
+}
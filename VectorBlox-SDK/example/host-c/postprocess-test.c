@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+#include "host-test.h"
+#include "postprocess.h"
+
+// defined in postprocess.c, not in its header
+int8_t fix16_to_int8(fix16_t input, fix16_t f16_scale, int32_t zero_point);
+int ultralytics_process_box_int8(fix16_t *xywh, const int8_t *box, fix16_t angle, const int h, const int w,
+                                 const int H, const int W, int zero_point, fix16_t scale_output);
+
+#define MAX_BOXES 200
+#define MAX_FACES 24
+
+static unsigned seed = 1;
+
+static int rnd(void) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+// mostly well below any threshold, with about hot in 100000 values high
+static int8_t *tensor(int channels, int pixels, int hot) {
+	int8_t *t = malloc(channels * pixels);
+	for (int i = 0; i < channels * pixels; i++) {
+		t[i] = (int8_t)(rnd() % 100 - 120);
+		if ((rnd() * 32768 + rnd()) % 100000 < hot) {
+			t[i] = (int8_t)(rnd() % 127);
+		}
+	}
+	return t;
+}
+
+static fix16_t dequantize(int8_t *t, int index, fix16_t scale, int zero_point) {
+	return int8_to_fix16_single(t[index], scale, zero_point);
+}
+
+/*
+ * Every cell of every tensor read in place, as post_process_ultra_int8 did
+ * before it gathered only the rows of cells that pass the threshold; the
+ * argmax tensor is used with 9 outputs unless they are angles or keypoints.
+ */
+static int dense_ultra(int8_t **outputs, int *shapes[], fix16_t *post, fix16_t thresh, int zero_points[],
+                       fix16_t scale_outs[], int max_boxes, int is_obb, int is_pose, int num_outputs) {
+	int count = 0;
+	int C = shapes[0][1];
+	int post_sz = C + 4 + is_obb + !!is_pose * 51;
+	int has_argmax = num_outputs == 9 && !is_obb && !is_pose;
+	fix16_t log_odds = fix16_log(fix16_div(thresh, fix16_sub(fix16_one, thresh)));
+	for (int o = 0; o < 6; o += 2) {
+		int H = shapes[o][2], W = shapes[o][3];
+		int8_t *scores = outputs[o];
+		int8_t threshold8 = fix16_to_int8(log_odds, scale_outs[o], zero_points[o]);
+		fix16_t inv_H = fix16_div(fix16_one, fix16_from_int(H));
+		fix16_t inv_W = fix16_div(fix16_one, fix16_from_int(W));
+		for (int h = 0; h < H; h++) {
+			for (int w = 0; w < W; w++) {
+				int hw = h * W + w;
+				int valid = 0;
+				if (has_argmax) {
+					valid = scores[((uint8_t *)outputs[6 + o / 2])[hw] * H * W + hw] > threshold8;
+				} else {
+					for (int c = 0; c < C; c++) {
+						valid |= scores[c * H * W + hw] > threshold8;
+					}
+				}
+				if (!valid || count >= max_boxes) {
+					continue;
+				}
+				fix16_t *row = post + count * post_sz;
+				fix16_t angle = fix16_minimum;
+				if (is_obb) {
+					angle = fix16_logistic_activate(dequantize(outputs[6 + o / 2], hw, scale_outs[6 + o / 2], zero_points[6 + o / 2]));
+					angle = fix16_mul(fix16_sub(angle, F16(0.25)), F16(3.141592741));
+					row[4 + C] = angle;
+				}
+				int8_t box[64];
+				for (int c = 0; c < 64; c++) {
+					box[c] = outputs[o + 1][c * H * W + hw];
+				}
+				ultralytics_process_box_int8(row, box, angle, h, w, H, W, zero_points[o + 1], scale_outs[o + 1]);
+				for (int p = 0; is_pose && p < 17; p++) {
+					fix16_t x, y, score;
+					if (is_pose == 2) {
+						int k = 6 + o;
+						x = dequantize(outputs[k], (p * 2 + 0) * H * W + hw, scale_outs[k], zero_points[k]);
+						y = dequantize(outputs[k], (p * 2 + 1) * H * W + hw, scale_outs[k], zero_points[k]);
+						score = dequantize(outputs[k + 1], p * H * W + hw, scale_outs[k], zero_points[k]);
+					} else {
+						int k = 6 + o / 2;
+						x = dequantize(outputs[k], (p * 3 + 0) * H * W + hw, scale_outs[k], zero_points[k]);
+						y = dequantize(outputs[k], (p * 3 + 1) * H * W + hw, scale_outs[k], zero_points[k]);
+						score = dequantize(outputs[k], (p * 3 + 2) * H * W + hw, scale_outs[k], zero_points[k]);
+					}
+					row[4 + C + 3 * p + 0] = fix16_mul(fix16_add(fix16_mul(x, F16(2.)), fix16_from_int(w)), inv_W);
+					row[4 + C + 3 * p + 1] = fix16_mul(fix16_add(fix16_mul(y, F16(2.)), fix16_from_int(h)), inv_H);
+					row[4 + C + 3 * p + 2] = fix16_logistic_activate(score);
+				}
+				for (int c = 0; c < C; c++) {
+					int8_t val = scores[c * H * W + hw];
+					row[4 + c] = val > threshold8 ? fix16_logistic_activate(int8_to_fix16_single(val, scale_outs[o], zero_points[o])) : 0;
+				}
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+typedef struct {
+	int num_outputs;
+	int8_t *outputs[12];
+	int shape[12][4];
+	int *shapes[12];
+	int zero_points[12];
+	fix16_t scale_outs[12];
+} heads_t;
+
+// three strides of class and box tensors, then the argmax, angle or keypoint tensors
+static void ultra_heads(heads_t *heads, int num_outputs, int is_obb, int is_pose, int C) {
+	static const int sizes[3] = {80, 40, 20};
+	heads->num_outputs = num_outputs;
+	for (int s = 0; s < 3; s++) {
+		int H = sizes[s], o = 2 * s;
+		int extra[2] = {0, 0};
+		if (num_outputs == 9) {
+			extra[0] = is_pose ? 51 : 1;
+		} else if (num_outputs == 12) {
+			extra[0] = 34;
+			extra[1] = 17;
+		}
+		int channels[4] = {C, 64, extra[0], extra[1]};
+		int index[4] = {o, o + 1, num_outputs == 12 ? 6 + 2 * s : 6 + s, 7 + 2 * s};
+		for (int t = 0; t < 4; t++) {
+			if (!channels[t]) {
+				continue;
+			}
+			int *shape = heads->shape[index[t]];
+			shape[0] = 1;
+			shape[1] = channels[t];
+			shape[2] = H;
+			shape[3] = H;
+			// a few dozen cells pass, however many classes
+			heads->outputs[index[t]] = tensor(channels[t], H * H, t == 0 ? 240 / C : 30000);
+		}
+		if (num_outputs == 9 && !is_obb && !is_pose) {
+			int8_t *scores = heads->outputs[o];
+			uint8_t *argmax = (uint8_t *)heads->outputs[6 + s];
+			for (int hw = 0; hw < H * H; hw++) {
+				int best = 0;
+				for (int c = 1; c < C; c++) {
+					if (scores[c * H * H + hw] > scores[best * H * H + hw]) {
+						best = c;
+					}
+				}
+				argmax[hw] = best;
+			}
+		}
+	}
+	for (int i = 0; i < num_outputs; i++) {
+		heads->shapes[i] = heads->shape[i];
+		heads->zero_points[i] = rnd() % 20 - 10;
+		heads->scale_outs[i] = F16(0.05) + rnd() * 3;
+	}
+}
+
+static void heads_free(heads_t *heads) {
+	for (int i = 0; i < heads->num_outputs; i++) {
+		free(heads->outputs[i]);
+	}
+}
+
+static void test_ultra(int num_outputs, int is_obb, int is_pose, int C) {
+	heads_t heads;
+	ultra_heads(&heads, num_outputs, is_obb, is_pose, C);
+	int post_sz = C + 4 + is_obb + !!is_pose * 51;
+	fix16_t *sparse = calloc(MAX_BOXES * post_sz, sizeof(fix16_t));
+	fix16_t *dense = calloc(MAX_BOXES * post_sz, sizeof(fix16_t));
+	int sparse_count = post_process_ultra_int8(heads.outputs, heads.shapes, sparse, F16(0.3), heads.zero_points,
+	                                           heads.scale_outs, MAX_BOXES, is_obb, is_pose, num_outputs);
+	int dense_count = dense_ultra(heads.outputs, heads.shapes, dense, F16(0.3), heads.zero_points,
+	                              heads.scale_outs, MAX_BOXES, is_obb, is_pose, num_outputs);
+	CHECK(sparse_count > 0);
+	CHECK(sparse_count == dense_count);
+	CHECK(memcmp(sparse, dense, MAX_BOXES * post_sz * sizeof(fix16_t)) == 0);
+	free(sparse);
+	free(dense);
+	heads_free(&heads);
+}
+
+/*
+ * With 9 outputs the last three are the argmax of the classes, so a cell is
+ * kept on its argmax class's score alone. For OBB and pose models they are
+ * angles or keypoints instead and every class is scanned.
+ */
+static void test_argmax(void) {
+	static const int sizes[3] = {4, 2, 1};
+	const int C = 4;
+	heads_t heads;
+	heads.num_outputs = 9;
+	for (int s = 0; s < 3; s++) {
+		int pixels = sizes[s] * sizes[s];
+		int channels[3] = {C, 64, 1};
+		int index[3] = {2 * s, 2 * s + 1, 6 + s};
+		for (int t = 0; t < 3; t++) {
+			int *shape = heads.shape[index[t]];
+			shape[0] = 1;
+			shape[1] = channels[t];
+			shape[2] = sizes[s];
+			shape[3] = sizes[s];
+			heads.outputs[index[t]] = calloc(channels[t], pixels);
+		}
+		memset(heads.outputs[2 * s], -128, C * pixels);
+	}
+	for (int i = 0; i < 9; i++) {
+		heads.shapes[i] = heads.shape[i];
+		heads.zero_points[i] = 0;
+		heads.scale_outs[i] = F16(0.05);
+	}
+	// cell 0 scores class 2 highly but its argmax names class 0; cell 1 agrees on class 3
+	int pixels = sizes[0] * sizes[0];
+	int8_t *scores = heads.outputs[0];
+	scores[2 * pixels + 0] = 100;
+	scores[3 * pixels + 1] = 100;
+	heads.outputs[6][0] = 0;
+	heads.outputs[6][1] = 3;
+
+	fix16_t post[4 * (C + 4 + 1 + 51)];
+	int count = post_process_ultra_int8(heads.outputs, heads.shapes, post, F16(0.3), heads.zero_points,
+	                                    heads.scale_outs, 4, 0, 0, 9);
+	CHECK(count == 1);
+	CHECK(post[4 + 3] > F16(0.5) && post[4 + 2] == 0);
+
+	// as angles the same tensors say nothing about the classes, so both cells are kept
+	count = post_process_ultra_int8(heads.outputs, heads.shapes, post, F16(0.3), heads.zero_points,
+	                                heads.scale_outs, 4, 1, 0, 9);
+	CHECK(count == 2);
+	CHECK(post[4 + 2] > F16(0.5));
+	CHECK(post[(C + 5) + 4 + 3] > F16(0.5));
+	heads_free(&heads);
+}
+
+// SCRFD's int8 path against the fix16 one on the same maps, dequantized whole
+static void test_scrfd(int hot) {
+	const int W = 640, H = 480;
+	int pixels[3] = {(H / 8) * (W / 8), (H / 16) * (W / 16), (H / 32) * (W / 32)};
+	int channels[3] = {2, 8, 20};
+	int8_t *outputs[9];
+	fix16_t *maps[9];
+	int zero_points[9];
+	fix16_t scale_outs[9];
+	for (int i = 0; i < 9; i++) {
+		int size = channels[i / 3] * pixels[i % 3];
+		outputs[i] = tensor(channels[i / 3], pixels[i % 3], i < 3 ? hot : 50000);
+		zero_points[i] = rnd() % 20 - 10;
+		scale_outs[i] = F16(0.01) + rnd() * 2;
+		maps[i] = malloc(size * sizeof(fix16_t));
+		int8_to_fix16(maps[i], outputs[i], size, scale_outs[i], zero_points[i]);
+	}
+	object_t sparse[MAX_FACES], dense[MAX_FACES];
+	memset(sparse, 0, sizeof(sparse));
+	memset(dense, 0, sizeof(dense));
+	int sparse_count = post_process_scrfd_int8(sparse, MAX_FACES, outputs, zero_points, scale_outs, W, H, F16(0.5), F16(0.4), NULL);
+	int dense_count = post_process_scrfd(dense, MAX_FACES, maps, W, H, F16(0.5), F16(0.4));
+	CHECK(sparse_count > 0);
+	CHECK(sparse_count == dense_count);
+	CHECK(memcmp(sparse, dense, sizeof(sparse)) == 0);
+	for (int i = 0; i < 9; i++) {
+		free(outputs[i]);
+		free(maps[i]);
+	}
+}
+
+int main() {
+	test_argmax();
+	for (int r = 0; r < 3; r++) {
+		test_ultra(6, 0, 0, 80);
+		test_ultra(9, 0, 0, 80);
+		test_ultra(12, 0, 2, 1);
+		test_ultra(9, 1, 0, 15);
+		test_ultra(9, 0, 1, 1);
+		test_scrfd(100);
+		test_scrfd(5000);
+	}
+	return test_result("postprocess-test");
+}
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include "host-test.h"
+#include "vbx_cnn_completion.h"
+#include "vbx_cnn_batch.h"
+#include "vbx_cnn_reg_model.h"
+
+#define LATENCY_US 500
+#define JOBS 12
+
+typedef struct {
+	vbx_cnn_reg_model_t *reg_model;
+	vbx_cnn_t *vbx_cnn;
+	model_t *model;
+	model_t *slow_model;
+	vbx_cnn_io_ptr_t io_buffers[3];
+} core_t;
+
+// jobs are collected in the order submitted, across models of different run times
+static void test_fifo(core_t *core) {
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(core->vbx_cnn, 4);
+	CHECK(queue != NULL);
+	CHECK(vbx_cnn_queue_complete(queue, NULL) == -1);
+	CHECK(vbx_cnn_queue_wait(queue, NULL) == -1);
+	int submitted = 0, collected = 0, status;
+	while (collected < JOBS) {
+		model_t *model = submitted % 3 ? core->model : core->slow_model;
+		if (submitted < JOBS && vbx_cnn_queue_submit(queue, model, core->io_buffers) >= 0) {
+			submitted++;
+			continue;
+		}
+		// full, the depth counts jobs not yet collected
+		CHECK(submitted == JOBS || vbx_cnn_queue_pending(queue) == 4);
+		status = -1;
+		CHECK(vbx_cnn_queue_wait(queue, &status) == collected);
+		CHECK(status == 0);
+		collected++;
+	}
+	CHECK(vbx_cnn_queue_pending(queue) == 0);
+	CHECK(vbx_cnn_queue_wait(queue, NULL) == -1);
+	vbx_cnn_queue_free(queue);
+}
+
+// the completion fd wakes the caller, vbx_cnn_queue_drain collects what has
+// finished oldest first and leaves the fd quiet once everything is taken
+static void test_drain(core_t *core) {
+	int fd = vbx_cnn_get_completion_fd(core->vbx_cnn);
+	CHECK(fd >= 0);
+	// take what the jobs before left pending, after which there is nothing
+	vbx_cnn_completion_ack(core->vbx_cnn);
+	CHECK(vbx_cnn_completion_ack(core->vbx_cnn) == 0);
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(core->vbx_cnn, 8);
+	for (int j = 0; j < 6; j++) {
+		CHECK(vbx_cnn_queue_submit(queue, core->model, core->io_buffers) == j);
+	}
+	int job_ids[8], statuses[8];
+	int collected = 0, wakeups = 0;
+	while (collected < 6 && wakeups < 100) {
+		struct pollfd pfd = {fd, POLLIN, 0};
+		CHECK(poll(&pfd, 1, 1000) == 1);
+		wakeups++;
+		// room for two at a time, the rest stay for the next call
+		int n = vbx_cnn_queue_drain(queue, job_ids, statuses, 2);
+		CHECK(n >= 0 && n <= 2);
+		for (int i = 0; i < n; i++) {
+			CHECK(job_ids[i] == collected);
+			CHECK(statuses[i] == 0);
+			collected++;
+		}
+	}
+	CHECK(collected == 6);
+	CHECK(vbx_cnn_queue_drain(queue, job_ids, NULL, 8) == 0);
+	struct pollfd pfd = {fd, POLLIN, 0};
+	CHECK(poll(&pfd, 1, 0) == 0);
+	CHECK(vbx_cnn_completion_ack(core->vbx_cnn) == 0);
+	vbx_cnn_queue_free(queue);
+}
+
+// a hung job is reset and started again, up to max_retries times, then failed;
+// the jobs queued behind it start again without counting against them
+static void test_watchdog(core_t *core) {
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(core->vbx_cnn, 4);
+	// long enough that only the hung jobs time out on a loaded machine
+	vbx_cnn_queue_set_watchdog(queue, 100 * LATENCY_US, 1);
+	uint32_t resets = core->vbx_cnn->resets;
+	int status;
+
+	// hangs once, runs on the retry
+	vbx_cnn_reg_model_inject_hang(core->reg_model, 1);
+	for (int j = 0; j < 3; j++) {
+		CHECK(vbx_cnn_queue_submit(queue, core->model, core->io_buffers) == j);
+	}
+	for (int j = 0; j < 3; j++) {
+		status = -1;
+		CHECK(vbx_cnn_queue_wait(queue, &status) == j);
+		CHECK(status == 0);
+	}
+	CHECK(queue->watchdog.timeouts == 1);
+	CHECK(queue->watchdog.resets == 1);
+	CHECK(queue->watchdog.requeued == 1);
+	CHECK(queue->watchdog.failed == 0);
+	CHECK(queue->watchdog.errors == 0);
+
+	// hangs on the retry as well, so it is given up on. A hang is used up by
+	// the next model started, so this job runs on its own
+	vbx_cnn_reg_model_inject_hang(core->reg_model, 2);
+	CHECK(vbx_cnn_queue_submit(queue, core->model, core->io_buffers) == 3);
+	CHECK(vbx_cnn_queue_wait(queue, &status) == 3);
+	CHECK(status == VBX_CNN_TIMED_OUT);
+	for (int j = 4; j < 6; j++) {
+		CHECK(vbx_cnn_queue_submit(queue, core->model, core->io_buffers) == j);
+	}
+	for (int j = 4; j < 6; j++) {
+		status = -1;
+		CHECK(vbx_cnn_queue_wait(queue, &status) == j);
+		CHECK(status == 0);
+	}
+	CHECK(queue->watchdog.timeouts == 3);
+	CHECK(queue->watchdog.resets == 3);
+	CHECK(queue->watchdog.requeued == 2);
+	CHECK(queue->watchdog.failed == 1);
+	CHECK(core->vbx_cnn->resets == resets + 3);
+	vbx_cnn_queue_free(queue);
+}
+
+typedef struct {
+	int indices[JOBS];
+	int statuses[JOBS];
+	int calls;
+} batch_log_t;
+
+static void log_run(void *arg, int index, int status) {
+	batch_log_t *log = (batch_log_t *)arg;
+	if (log->calls < JOBS) {
+		log->indices[log->calls] = index;
+		log->statuses[log->calls] = status;
+	}
+	log->calls++;
+}
+
+// every row is run, and done is called once per row in row order, with more
+// rows than the queue holds at once
+static void test_batch(core_t *core) {
+	vbx_cnn_queue_t *queue = vbx_cnn_queue_init(core->vbx_cnn, 3);
+	vbx_cnn_io_ptr_t io_sets[JOBS][3];
+	for (int r = 0; r < JOBS; r++) {
+		memcpy(io_sets[r], core->io_buffers, sizeof(io_sets[r]));
+	}
+	batch_log_t log = {{0}, {0}, 0};
+	CHECK(vbx_cnn_queue_run_batch(queue, core->model, &io_sets[0][0], JOBS, log_run, &log) == 0);
+	CHECK(log.calls == JOBS);
+	for (int r = 0; r < JOBS; r++) {
+		CHECK(log.indices[r] == r);
+		CHECK(log.statuses[r] == 0);
+	}
+	CHECK(vbx_cnn_queue_pending(queue) == 0);
+
+	// submit_batch takes as many rows as there is room for, with consecutive ids
+	int first_job = -1;
+	CHECK(vbx_cnn_queue_submit_batch(queue, core->model, &io_sets[0][0], 5, &first_job) == 3);
+	CHECK(first_job == JOBS);
+	// and run_batch refuses to start with jobs pending
+	CHECK(vbx_cnn_queue_run_batch(queue, core->model, &io_sets[0][0], 1, NULL, NULL) == -1);
+	for (int j = 0; j < 3; j++) {
+		CHECK(vbx_cnn_queue_wait(queue, NULL) == first_job + j);
+	}
+	vbx_cnn_queue_free(queue);
+}
+
+int main() {
+	core_t core;
+	core.reg_model = vbx_cnn_reg_model_init(LATENCY_US);
+	core.model = test_model_build(0);
+	core.slow_model = test_model_build(64);
+	if (!core.reg_model || !core.model || !core.slow_model) {
+		return 1;
+	}
+	vbx_cnn_reg_model_set_latency(core.reg_model, core.slow_model, 3 * LATENCY_US);
+	core.vbx_cnn = vbx_cnn_init(vbx_cnn_reg_model_regs(core.reg_model));
+	CHECK(core.vbx_cnn && core.vbx_cnn->initialized);
+	for (int i = 0; i < 3; i++) {
+		core.io_buffers[i] = (vbx_cnn_io_ptr_t)(uintptr_t)vbx_allocate_dma_buffer(core.vbx_cnn, 1024, 0);
+	}
+	test_fifo(&core);
+	test_drain(&core);
+	test_watchdog(&core);
+	test_batch(&core);
+	vbx_cnn_free(core.vbx_cnn);
+	vbx_cnn_reg_model_free(core.reg_model);
+	free(core.model);
+	free(core.slow_model);
+	return test_result("queue-test");
+}
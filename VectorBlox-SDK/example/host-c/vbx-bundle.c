@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_packed.h"
+#include "vbx_cnn_dump.h"
+#include "vbx_cnn_bundle.h"
+
+#define ALIGN_UP(x) (((x) + VBX_CNN_BUNDLE_ALIGN - 1) & ~(uint64_t)(VBX_CNN_BUNDLE_ALIGN - 1))
+
+typedef struct {
+	uint8_t *model;
+	uint8_t *test;
+} blobs_t;
+
+static uint8_t *read_file(const char *filename, uint64_t *bytes) {
+	FILE *fp = fopen(filename, "rb");
+	if (!fp) {
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	uint8_t *data = size > 0 ? malloc(size) : NULL;
+	if (data && fread(data, 1, size, fp) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	*bytes = size;
+	return data;
+}
+
+static int is_packed(const uint8_t *data, uint64_t bytes) {
+	return data && bytes >= sizeof(vbx_cnn_packed_header_t) &&
+			((const vbx_cnn_packed_header_t *)data)->magic == VBX_CNN_PACKED_MAGIC;
+}
+
+// NAME:POSTPROCESS:MODEL.vnnx[:TEST.vbxd], or MODEL.vbxz
+static int read_entry(char *spec, vbx_cnn_bundle_entry_t *entry, blobs_t *blobs) {
+	char *fields[4] = {NULL, NULL, NULL, NULL};
+	int num_fields = 0;
+	for (char *field = strtok(spec, ":"); field && num_fields < 4; field = strtok(NULL, ":")) {
+		fields[num_fields++] = field;
+	}
+	if (num_fields < 3 || strlen(fields[0]) >= sizeof(entry->name) || strlen(fields[1]) >= sizeof(entry->post_process)) {
+		fprintf(stderr, "Expected NAME:POSTPROCESS:MODEL.vnnx[:TEST.vbxd], names under %d characters\n",
+				(int)sizeof(entry->post_process));
+		return -1;
+	}
+	memset(entry, 0, sizeof(*entry));
+	strcpy(entry->name, fields[0]);
+	strcpy(entry->post_process, fields[1]);
+	blobs->model = read_file(fields[2], &entry->model_bytes);
+	model_t *model = (model_t *)blobs->model;
+	if (is_packed(blobs->model, entry->model_bytes)) {
+		// vbx-pack output, decompressed by the loader
+		entry->allocate_bytes = ((vbx_cnn_packed_header_t *)blobs->model)->allocate_bytes;
+	} else if (!model || entry->model_bytes < sizeof(vnnx_graph_t) || model_check_sanity(model) != 0 ||
+			model_get_data_bytes(model) != entry->model_bytes) {
+		fprintf(stderr, "%s is not a readable model\n", fields[2]);
+		return -1;
+	} else {
+		entry->allocate_bytes = model_get_allocate_bytes(model);
+	}
+	if (fields[3]) {
+		blobs->test = read_file(fields[3], &entry->test_bytes);
+		if (!blobs->test || entry->test_bytes < sizeof(vbx_cnn_dump_header_t) ||
+				((vbx_cnn_dump_header_t *)blobs->test)->magic != VBX_CNN_DUMP_MAGIC) {
+			fprintf(stderr, "%s is not a readable tensor dump\n", fields[3]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// the next blob starts on a page after bytes written
+static void pad(FILE *fp, uint64_t bytes) {
+	static const uint8_t zeros[VBX_CNN_BUNDLE_ALIGN];
+	fwrite(zeros, 1, ALIGN_UP(bytes) - bytes, fp);
+}
+
+static int create_bundle(const char *filename, int num_entries, char **specs) {
+	vbx_cnn_bundle_header_t header = {VBX_CNN_BUNDLE_MAGIC, VBX_CNN_BUNDLE_VERSION, num_entries, 0};
+	vbx_cnn_bundle_entry_t *entries = calloc(num_entries, sizeof(vbx_cnn_bundle_entry_t));
+	blobs_t *blobs = calloc(num_entries, sizeof(blobs_t));
+	int status = 0;
+	// blobs follow the index, each on its own page
+	uint64_t offset = ALIGN_UP(sizeof(header) + num_entries * sizeof(vbx_cnn_bundle_entry_t));
+	for (int e = 0; e < num_entries && !status; e++) {
+		status = read_entry(specs[e], entries + e, blobs + e);
+		for (int d = 0; d < e && !status; d++) {
+			if (!strcmp(entries[d].name, entries[e].name)) {
+				fprintf(stderr, "%s is in the bundle twice\n", entries[e].name);
+				status = -1;
+			}
+		}
+		entries[e].model_offset = offset;
+		offset += ALIGN_UP(entries[e].model_bytes);
+		if (entries[e].test_bytes) {
+			entries[e].test_offset = offset;
+			offset += ALIGN_UP(entries[e].test_bytes);
+		}
+	}
+	FILE *fp = status ? NULL : fopen(filename, "wb");
+	if (!status && !fp) {
+		fprintf(stderr, "Unable to write %s\n", filename);
+		status = -1;
+	}
+	if (fp) {
+		fwrite(&header, 1, sizeof(header), fp);
+		fwrite(entries, sizeof(vbx_cnn_bundle_entry_t), num_entries, fp);
+		pad(fp, sizeof(header) + num_entries * sizeof(vbx_cnn_bundle_entry_t));
+		for (int e = 0; e < num_entries; e++) {
+			fwrite(blobs[e].model, 1, entries[e].model_bytes, fp);
+			pad(fp, entries[e].model_bytes);
+			if (entries[e].test_bytes) {
+				fwrite(blobs[e].test, 1, entries[e].test_bytes, fp);
+				pad(fp, entries[e].test_bytes);
+			}
+		}
+		if (fclose(fp) != 0) {
+			fprintf(stderr, "Unable to write %s\n", filename);
+			status = -1;
+		}
+	}
+	for (int e = 0; e < num_entries; e++) {
+		free(blobs[e].model);
+		free(blobs[e].test);
+	}
+	free(blobs);
+	free(entries);
+	return status;
+}
+
+static void list_bundle(const vbx_cnn_bundle_t *bundle) {
+	printf("%-24s %-20s %10s %10s %10s %10s\n", "name", "postprocess", "offset", "bytes", "dma_bytes", "test_bytes");
+	for (int e = 0; e < bundle->num_entries; e++) {
+		const vbx_cnn_bundle_entry_t *entry = bundle->entries + e;
+		printf("%-24s %-20s %10llu %10llu %10llu %10llu\n", entry->name, entry->post_process,
+				(unsigned long long)entry->model_offset, (unsigned long long)entry->model_bytes,
+				(unsigned long long)entry->allocate_bytes, (unsigned long long)entry->test_bytes);
+	}
+}
+
+static int write_blob(const char *path, const uint8_t *data, uint64_t bytes) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		fprintf(stderr, "Unable to write %s\n", path);
+		return -1;
+	}
+	fwrite(data, 1, bytes, fp);
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Unable to write %s\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static int unpack_bundle(const vbx_cnn_bundle_t *bundle, const char *dir) {
+	char path[1024];
+	for (int e = 0; e < bundle->num_entries; e++) {
+		const vbx_cnn_bundle_entry_t *entry = bundle->entries + e;
+		snprintf(path, sizeof(path), "%s/%s.%s", dir, entry->name,
+				is_packed(bundle->base + entry->model_offset, entry->model_bytes) ? "vbxz" : "vnnx");
+		if (write_blob(path, bundle->base + entry->model_offset, entry->model_bytes) != 0) {
+			return -1;
+		}
+		if (entry->test_bytes) {
+			snprintf(path, sizeof(path), "%s/%s.vbxd", dir, entry->name);
+			if (write_blob(path, bundle->base + entry->test_offset, entry->test_bytes) != 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2 || (argc > 2 && strcmp(argv[2], "-c") && (argc != 4 || strcmp(argv[2], "-x")))) {
+		fprintf(stderr,
+				"Usage: %s BUNDLE.vbxb [-c NAME:POSTPROCESS:MODEL.vnnx[:TEST.vbxd]...|-x DIR]\n"
+				"   lists the models in a bundle\n"
+				"   -c  creates the bundle from the models, each with the name and postprocess type the\n"
+				"       demos look it up by, and optionally a model_dump_io() dump of reference inputs and outputs\n"
+				"       MODEL may be a vbx-pack .vbxz, which loads decompressed\n"
+				"   -x  writes each model to DIR as NAME.vnnx (or NAME.vbxz), and its dump as NAME.vbxd\n",
+				argv[0]);
+		return 1;
+	}
+	if (argc > 2 && !strcmp(argv[2], "-c")) {
+		return create_bundle(argv[1], argc - 3, argv + 3) ? 1 : 0;
+	}
+	vbx_cnn_bundle_t *bundle = vbx_cnn_bundle_open(argv[1]);
+	if (!bundle) {
+		fprintf(stderr, "%s is not a readable model bundle\n", argv[1]);
+		return 1;
+	}
+	int status = 0;
+	if (argc == 2) {
+		list_bundle(bundle);
+	} else {
+		status = unpack_bundle(bundle, argv[3]);
+	}
+	vbx_cnn_bundle_close(bundle);
+	return status ? 1 : 0;
+}
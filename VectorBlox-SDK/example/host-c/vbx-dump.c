@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_dump.h"
+
+typedef struct {
+	const uint8_t *base;
+	size_t bytes;
+	const vbx_cnn_dump_header_t *header;
+	const vbx_cnn_dump_entry_t *entries;
+} dump_t;
+
+static int open_dump(dump_t *dump, const char *filename) {
+	memset(dump, 0, sizeof(*dump));
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(vbx_cnn_dump_header_t)) {
+		close(fd);
+		return -1;
+	}
+	dump->bytes = st.st_size;
+	dump->base = mmap(NULL, dump->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (dump->base == MAP_FAILED) {
+		dump->base = NULL;
+		return -1;
+	}
+	dump->header = (const vbx_cnn_dump_header_t *)dump->base;
+	dump->entries = (const vbx_cnn_dump_entry_t *)(dump->header + 1);
+	if (dump->header->magic != VBX_CNN_DUMP_MAGIC || dump->header->version != VBX_CNN_DUMP_VERSION ||
+			dump->header->num_entries > (dump->bytes - sizeof(vbx_cnn_dump_header_t)) / sizeof(vbx_cnn_dump_entry_t)) {
+		return -1;
+	}
+	for (unsigned e = 0; e < dump->header->num_entries; e++) {
+		const vbx_cnn_dump_entry_t *entry = dump->entries + e;
+		if (entry->offset > dump->bytes || entry->bytes > dump->bytes - entry->offset ||
+				entry->dims < 0 || entry->dims > SHAPE_DIMS) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static size_t entry_length(const vbx_cnn_dump_entry_t *entry) {
+	size_t size = vbx_cnn_calc_type_size((vbx_cnn_calc_type_e)entry->datatype);
+	return size ? entry->bytes / size : 0;
+}
+
+static int32_t entry_value(const vbx_cnn_dump_entry_t *entry, const uint8_t *data, size_t i) {
+	switch (entry->datatype) {
+	case VBX_CNN_CALC_TYPE_UINT8: return ((const uint8_t *)data)[i];
+	case VBX_CNN_CALC_TYPE_INT8: return ((const int8_t *)data)[i];
+	case VBX_CNN_CALC_TYPE_INT16: return ((const int16_t *)data)[i];
+	default: return ((const int32_t *)data)[i];
+	}
+}
+
+static const char *type_name(int datatype, int fix16) {
+	static const char *names[] = {"uint8", "int8", "int16", "int32"};
+	if (fix16) return "fix16";
+	return datatype >= 0 && datatype < 4 ? names[datatype] : "unknown";
+}
+
+static void list_dump(const dump_t *dump) {
+	printf("%5s %-6s %3s %-24s %-7s %-22s %12s %6s %10s\n", "node", "kind", "idx", "name", "type", "shape", "scale", "zero", "bytes");
+	for (unsigned e = 0; e < dump->header->num_entries; e++) {
+		const vbx_cnn_dump_entry_t *entry = dump->entries + e;
+		char shape[64] = "";
+		int len = 0;
+		for (int d = 0; d < entry->dims && len < (int)sizeof(shape); d++) {
+			len += snprintf(shape + len, sizeof(shape) - len, d ? ",%d" : "%d", entry->shape[d]);
+		}
+		printf("%5d %-6s %3d %-24.24s %-7s %-22s %12g %6d %10llu\n", entry->node,
+				entry->kind == VBX_CNN_DUMP_INPUT ? "input" : "output", entry->index, entry->name,
+				type_name(entry->datatype, entry->fix16), shape, entry->scale, entry->zero_point,
+				(unsigned long long)entry->bytes);
+	}
+}
+
+// one tensor in the layout print_json and model_get_debug_json used to write
+static void json_tensor(FILE *fp, const dump_t *dump, const vbx_cnn_dump_entry_t *entry) {
+	fprintf(fp, "\"zero\":%d,", entry->zero_point);
+	fprintf(fp, "\"scale\":%d,", entry->scale_fix16);
+	fprintf(fp, "\"shape\":[");
+	if (!entry->dims) fprintf(fp, "],\n");
+	for (int d = 0; d < entry->dims; d++) {
+		fprintf(fp, d == entry->dims - 1 ? "%d],\n" : "%d,", entry->shape[d]);
+	}
+	fprintf(fp, "\"data\":[ ");
+	size_t length = entry_length(entry);
+	const uint8_t *data = dump->base + entry->offset;
+	for (size_t i = 0; i < length; i++) {
+		fprintf(fp, i == length - 1 ? "%d]\n" : "%d,", entry_value(entry, data, i));
+	}
+	if (!length) fprintf(fp, "]\n");
+}
+
+static void json_list(FILE *fp, const dump_t *dump, int node, int kind) {
+	int first = 1;
+	for (unsigned e = 0; e < dump->header->num_entries; e++) {
+		const vbx_cnn_dump_entry_t *entry = dump->entries + e;
+		if (entry->node != node || entry->kind != kind) {
+			continue;
+		}
+		fprintf(fp, first ? "{" : "},\n{");
+		json_tensor(fp, dump, entry);
+		first = 0;
+	}
+	if (!first) fprintf(fp, "}");
+}
+
+static int write_json(const dump_t *dump, const char *dir) {
+	char path[1024];
+	int last_node = -2;
+	for (unsigned e = 0; e < dump->header->num_entries; e++) {
+		int node = dump->entries[e].node;
+		if (node == last_node) {
+			continue;
+		}
+		last_node = node;
+		if (node < 0) {
+			snprintf(path, sizeof(path), "%s/io.json", dir);
+		} else {
+			snprintf(path, sizeof(path), "%s/node%03d.json", dir, node);
+		}
+		FILE *fp = fopen(path, "w");
+		if (!fp) {
+			fprintf(stderr, "Unable to write %s\n", path);
+			return -1;
+		}
+		fprintf(fp, node < 0 ? "{\n\"inputs\":[\n" : "{\"inputs\":[\n");
+		json_list(fp, dump, node, VBX_CNN_DUMP_INPUT);
+		fprintf(fp, node < 0 ? "],\n\n\"outputs\":[\n" : "],\n\"outputs\":[\n");
+		json_list(fp, dump, node, VBX_CNN_DUMP_OUTPUT);
+		fprintf(fp, "]\n}\n");
+		fclose(fp);
+	}
+	return 0;
+}
+
+// .npy version 1.0, header padded so the data starts 64 byte aligned
+static int write_npy(const dump_t *dump, const vbx_cnn_dump_entry_t *entry, const char *path) {
+	static const char *descr[] = {"|u1", "|i1", "<i2", "<i4"};
+	char header[256];
+	int len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (",
+			entry->datatype >= 0 && entry->datatype < 4 ? descr[entry->datatype] : "|u1");
+	for (int d = 0; d < entry->dims; d++) {
+		len += snprintf(header + len, sizeof(header) - len, "%d,%s", entry->shape[d], d == entry->dims - 1 ? "" : " ");
+	}
+	len += snprintf(header + len, sizeof(header) - len, "), }");
+	int total = (10 + len + 1 + 63) & ~63;
+	memset(header + len, ' ', total - 10 - len - 1);
+	header[total - 10 - 1] = '\n';
+	uint8_t preamble[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, (uint8_t)(total - 10), (uint8_t)((total - 10) >> 8)};
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		return -1;
+	}
+	fwrite(preamble, 1, sizeof(preamble), fp);
+	fwrite(header, 1, total - 10, fp);
+	fwrite(dump->base + entry->offset, 1, entry->bytes, fp);
+	return fclose(fp);
+}
+
+static int write_npys(const dump_t *dump, const char *dir) {
+	char path[1024];
+	for (unsigned e = 0; e < dump->header->num_entries; e++) {
+		const vbx_cnn_dump_entry_t *entry = dump->entries + e;
+		const char *kind = entry->kind == VBX_CNN_DUMP_INPUT ? "input" : "output";
+		if (!entry->bytes) {
+			continue; // data was not captured
+		}
+		if (entry->node < 0) {
+			snprintf(path, sizeof(path), "%s/%s%d.npy", dir, kind, entry->index);
+		} else {
+			snprintf(path, sizeof(path), "%s/node%03d_%s%d.npy", dir, entry->node, kind, entry->index);
+		}
+		if (write_npy(dump, entry, path) != 0) {
+			fprintf(stderr, "Unable to write %s\n", path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2 && argc != 4) {
+		fprintf(stderr,
+				"Usage: %s DUMP.vbxd [-j|-n DIR]\n"
+				"   lists the tensors in a dump written by model_dump_io() or model_dump_nodes()\n"
+				"   -j  writes them to DIR as io.json or node%%03d.json, as print_json and model_get_debug_json did\n"
+				"   -n  writes each to DIR as a .npy file; scale and zero point are in the listing\n",
+				argv[0]);
+		return 1;
+	}
+	dump_t dump;
+	if (open_dump(&dump, argv[1]) != 0) {
+		fprintf(stderr, "%s is not a readable tensor dump\n", argv[1]);
+		return 1;
+	}
+	int status = 0;
+	if (argc == 2) {
+		list_dump(&dump);
+	} else if (!strcmp(argv[2], "-j")) {
+		status = write_json(&dump, argv[3]);
+	} else if (!strcmp(argv[2], "-n")) {
+		status = write_npys(&dump, argv[3]);
+	} else {
+		fprintf(stderr, "Unknown option %s\n", argv[2]);
+		status = -1;
+	}
+	munmap((void *)dump.base, dump.bytes);
+	return status ? 1 : 0;
+}
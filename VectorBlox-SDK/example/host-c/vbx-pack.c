@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_packed.h"
+
+#define RUNS 5
+
+static uint64_t now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int write_file(const char *filename, const void *data, size_t bytes) {
+	FILE *fp = fopen(filename, "wb");
+	if (!fp) {
+		return -1;
+	}
+	fwrite(data, 1, bytes, fp);
+	return fclose(fp);
+}
+
+// best of RUNS warm loads, plus reading the file's bytes at storage_mbps from cold
+static void print_load(const char *name, uint64_t best_ns, size_t file_bytes, double storage_mbps, int match) {
+	double storage_ms = file_bytes / (storage_mbps * 1e3);
+	printf("%-12s %9.1f ms warm %9.1f ms from storage at %.0f MB/s%s\n", name, best_ns / 1e6,
+			best_ns / 1e6 + storage_ms, storage_mbps, match ? "" : "  MISMATCH");
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr,
+				"Usage: %s MODEL.vnnx PACKED.vbxz [STORAGE_MBPS]\n"
+				"   compresses MODEL.vnnx into PACKED.vbxz, then times loading each the way the driver does:\n"
+				"   the .vnnx read whole, and the .vbxz decompressed by 1 to %d threads. Loads are timed\n"
+				"   from the page cache; the time to read the file from storage at STORAGE_MBPS\n"
+				"   (default 25, an SD card) is added for an estimate from cold\n",
+				argv[0], VBX_CNN_PACKED_THREADS);
+		return 1;
+	}
+	double storage_mbps = argc > 3 ? atof(argv[3]) : 25;
+	int fd = open(argv[1], O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Unable to read %s\n", argv[1]);
+		return 1;
+	}
+	size_t model_bytes = st.st_size;
+	size_t allocate_bytes = vbx_cnn_model_peek_fd(fd, 0, model_bytes);
+	model_t *model = allocate_bytes ? aligned_alloc(4096, (allocate_bytes + 4095) & ~(size_t)4095) : NULL;
+	if (!model || vbx_cnn_model_read_fd(fd, 0, model_bytes, model) != 0) {
+		fprintf(stderr, "%s is not a readable model\n", argv[1]);
+		return 1;
+	}
+	if (*(uint32_t *)model == VBX_CNN_PACKED_MAGIC) {
+		fprintf(stderr, "%s is already packed\n", argv[1]);
+		return 1;
+	}
+	size_t packed_bytes;
+	uint64_t start = now_ns();
+	void *packed = vbx_cnn_packed_compress(model, &packed_bytes);
+	uint64_t pack_ns = now_ns() - start;
+	if (!packed || write_file(argv[2], packed, packed_bytes) != 0) {
+		fprintf(stderr, "Unable to write %s\n", argv[2]);
+		return 1;
+	}
+	free(packed);
+	printf("%s: %zu bytes, packed into %zu bytes (%.1f%%) in %.1f ms\n", argv[2], model_bytes, packed_bytes,
+			100.0 * packed_bytes / model_bytes, pack_ns / 1e6);
+
+	int packed_fd = open(argv[2], O_RDONLY);
+	uint8_t *loaded = aligned_alloc(4096, (allocate_bytes + 4095) & ~(size_t)4095);
+	if (packed_fd < 0 || !loaded) {
+		return 1;
+	}
+	uint64_t best_ns = UINT64_MAX;
+	int match = 1;
+	for (int r = 0; r < RUNS; r++) {
+		start = now_ns();
+		match &= vbx_cnn_model_read_fd(fd, 0, model_bytes, (model_t *)loaded) == 0;
+		uint64_t elapsed_ns = now_ns() - start;
+		best_ns = elapsed_ns < best_ns ? elapsed_ns : best_ns;
+	}
+	print_load("vnnx", best_ns, model_bytes, storage_mbps, match && !memcmp(loaded, model, model_bytes));
+	for (int threads = 1; threads <= VBX_CNN_PACKED_THREADS; threads *= 2) {
+		char name[32];
+		best_ns = UINT64_MAX;
+		match = 1;
+		for (int r = 0; r < RUNS; r++) {
+			memset(loaded, 0, model_bytes);
+			start = now_ns();
+			match &= vbx_cnn_packed_read_fd(packed_fd, 0, packed_bytes, loaded, threads) == 0;
+			uint64_t elapsed_ns = now_ns() - start;
+			best_ns = elapsed_ns < best_ns ? elapsed_ns : best_ns;
+			match &= !memcmp(loaded, model, model_bytes);
+		}
+		snprintf(name, sizeof(name), "vbxz[%dt]", threads);
+		print_load(name, best_ns, packed_bytes, storage_mbps, match);
+	}
+	close(packed_fd);
+	close(fd);
+	free(loaded);
+	free(model);
+	return 0;
+}
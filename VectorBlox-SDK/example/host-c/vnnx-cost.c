@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_io_info.h"
+
+#define MAX_CALIBRATION 64
+
+// MACs, bytes moved and node count are the terms the latency estimate is fitted on
+enum { TERM_MACS, TERM_BYTES, TERM_NODES, NUM_TERMS };
+
+typedef struct {
+	int type;
+	const char *description;
+	uint64_t macs;
+	uint64_t weight_bytes;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	int32_t scratchpad_bytes;
+} node_cost_t;
+
+typedef struct {
+	vnnx_graph_t *graph;
+	size_t file_bytes;
+	int num_nodes;
+	node_cost_t *nodes;
+	node_cost_t total;
+	int32_t max_scratchpad_bytes;
+} model_cost_t;
+
+typedef struct {
+	int valid;
+	double coeff[NUM_TERMS]; // ms per MAC, per byte, per node
+	int points;
+	double rms_error_ms;
+	int size_conf;
+} latency_fit_t;
+
+static const char *op_name(int type) {
+#define OP(x) case x: return #x;
+	switch (type) {
+		OP(ADD) OP(AVERAGE_POOL_2D) OP(CONCATENATION) OP(CONV_2D) OP(DEPTHWISE_CONV_2D)
+		OP(DEPTH_TO_SPACE) OP(DEQUANTIZE) OP(FULLY_CONNECTED) OP(LOGISTIC) OP(MAX_POOL_2D)
+		OP(MUL) OP(RELU) OP(RELU6) OP(RESHAPE) OP(RESIZE_BILINEAR) OP(SOFTMAX)
+		OP(SPACE_TO_DEPTH) OP(TANH) OP(PAD) OP(GATHER) OP(TRANSPOSE) OP(MEAN) OP(SUB)
+		OP(DIV) OP(SQUEEZE) OP(STRIDED_SLICE) OP(EXP) OP(SPLIT) OP(LOG_SOFTMAX) OP(CAST)
+		OP(PRELU) OP(MAXIMUM) OP(ARG_MAX) OP(MINIMUM) OP(PADV2) OP(SLICE) OP(TRANSPOSE_CONV)
+		OP(TILE) OP(SUM) OP(REDUCE_MAX) OP(PACK) OP(UNPACK) OP(RESIZE_NEAREST_NEIGHBOR)
+		OP(LEAKY_RELU) OP(SQUARED_DIFFERENCE) OP(MIRROR_PAD) OP(SPLIT_V) OP(QUANTIZE)
+		OP(HARD_SWISH) OP(BATCH_MATMUL) OP(GELU) OP(DILATE) OP(REDUCE_WINDOW)
+		OP(IDENTITY) OP(ELTWISE) OP(PREFETCH) OP(LUT) OP(PIXEL_SHUFFLE)
+	}
+#undef OP
+	return "UNKNOWN";
+}
+
+static size_t type_bytes(int type) {
+	size_t bytes = vbx_cnn_calc_type_size((vbx_cnn_calc_type_e)type);
+	return bytes ? bytes : 1;
+}
+
+// NULL if the object would run past the end of the file
+static void *graph_object(model_cost_t *cost, obj_off_t offset, size_t bytes) {
+	if (offset == 0 || offset > cost->file_bytes || bytes > cost->file_bytes - offset) {
+		return NULL;
+	}
+	return (uint8_t *)cost->graph + offset;
+}
+
+static uint64_t tensor_elements(const vnnx_tensor_t *tensor) {
+	uint64_t elements = 1;
+	int dims = tensor->dims < SHAPE_DIMS ? tensor->dims : SHAPE_DIMS;
+	for (int d = 0; d < dims; d++) {
+		if (tensor->shape[d] > 0) elements *= tensor->shape[d];
+	}
+	return elements;
+}
+
+static uint64_t filter_elements(const int32_t *filter_shape, int dims) {
+	uint64_t elements = 1;
+	for (int d = 0; d < dims; d++) {
+		if (filter_shape[d] > 0) elements *= filter_shape[d];
+	}
+	return elements;
+}
+
+// Every output element of a convolution takes filter_elements/kernels MACs,
+// which holds whether the filter is laid out for a full or a depthwise conv.
+static void conv_cost(node_cost_t *node, const int32_t *filter_shape, int32_t kernels, uint64_t output_elements) {
+	uint64_t filter = filter_elements(filter_shape, 4);
+	if (kernels <= 0) kernels = 1;
+	node->macs += output_elements * (filter / kernels);
+	node->weight_bytes += filter + kernels * sizeof(int32_t); // int8 weights, int32 bias
+}
+
+static int analyze_node(model_cost_t *cost, int n) {
+	vnnx_subgraph_node_t *sg = cost->graph->subgraphs + n;
+	node_cost_t *node = cost->nodes + n;
+	vnnx_tensor_t *tensors = graph_object(cost, sg->tensors, sg->num_tensors * sizeof(vnnx_tensor_t));
+	vnnx_layer_t *sublayers = NULL;
+	if (sg->num_sublayers > 0) {
+		sublayers = graph_object(cost, sg->sublayers, sg->num_sublayers * sizeof(vnnx_layer_t));
+	}
+	if (!tensors || (sg->num_sublayers > 0 && !sublayers)) {
+		return -1;
+	}
+	node->type = sg->type;
+	node->description = sg->output_description;
+	node->scratchpad_bytes = sg->scratchpad_bytes;
+
+	// inputs come first in the tensor list, outputs are the last tensors of the
+	// last sublayer (same as model_get_debug_json)
+	int num_outputs = sublayers ? sublayers[sg->num_sublayers - 1].num_outputs : sg->num_outputs;
+	int output_start = sg->num_tensors - num_outputs;
+	uint64_t output_elements = 0;
+	for (int i = 0; i < sg->num_inputs && i < sg->num_tensors; i++) {
+		node->read_bytes += tensor_elements(tensors + i) * type_bytes(tensors[i].type);
+	}
+	for (int o = output_start < 0 ? 0 : output_start; o < sg->num_tensors; o++) {
+		output_elements += tensor_elements(tensors + o);
+		node->write_bytes += tensor_elements(tensors + o) * type_bytes(tensors[o].type);
+	}
+
+	if (sg->type == CONV_2D || sg->type == DEPTHWISE_CONV_2D || sg->type == TRANSPOSE_CONV) {
+		conv_cost(node, sg->Conv2DOptions.filter_shape_dims, sg->Conv2DOptions.kernels, output_elements);
+	} else if (sg->type == FULLY_CONNECTED) {
+		uint64_t filter = filter_elements(sg->FullyConnectedOptions.filter_shape_dims, 2);
+		node->macs += filter;
+		node->weight_bytes += filter + output_elements * sizeof(int32_t);
+	}
+
+	// convolutions fused into the node as sublayers
+	for (int s = 0; s < sg->num_sublayers; s++) {
+		vnnx_layer_t *layer = sublayers + s;
+		if (layer->type != CONV_2D && layer->type != DEPTHWISE_CONV_2D) {
+			continue;
+		}
+		uint64_t layer_elements = output_elements;
+		vnnx_tensor_t *layer_tensors = graph_object(cost, layer->tensors, layer->num_tensors * sizeof(vnnx_tensor_t));
+		if (layer_tensors && layer->num_outputs > 0 && layer->num_outputs <= layer->num_tensors) {
+			layer_elements = tensor_elements(layer_tensors + layer->num_tensors - layer->num_outputs);
+		}
+		conv_cost(node, layer->Conv2DOptions.filter_shape_dims, layer->Conv2DOptions.kernels, layer_elements);
+	}
+	return 0;
+}
+
+static int analyze_model(model_cost_t *cost, const char *filename) {
+	memset(cost, 0, sizeof(*cost));
+	FILE *fp = fopen(filename, "rb");
+	if (!fp) {
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	cost->file_bytes = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (cost->file_bytes < sizeof(vnnx_graph_t)) {
+		fclose(fp);
+		return -1;
+	}
+	cost->graph = malloc(cost->file_bytes);
+	if (!cost->graph || fread(cost->graph, 1, cost->file_bytes, fp) != cost->file_bytes) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	if (model_check_sanity((model_t *)cost->graph) != 0 ||
+			cost->graph->num_layers < 0 ||
+			sizeof(vnnx_graph_t) + cost->graph->num_layers * sizeof(vnnx_subgraph_node_t) > cost->file_bytes) {
+		return -1;
+	}
+	cost->num_nodes = cost->graph->num_layers;
+	cost->nodes = calloc(cost->num_nodes + 1, sizeof(node_cost_t));
+	if (!cost->nodes) {
+		return -1;
+	}
+	for (int n = 0; n < cost->num_nodes; n++) {
+		if (analyze_node(cost, n) != 0) {
+			return -1;
+		}
+		node_cost_t *node = cost->nodes + n;
+		cost->total.macs += node->macs;
+		cost->total.weight_bytes += node->weight_bytes;
+		cost->total.read_bytes += node->read_bytes;
+		cost->total.write_bytes += node->write_bytes;
+		if (node->scratchpad_bytes > cost->max_scratchpad_bytes) {
+			cost->max_scratchpad_bytes = node->scratchpad_bytes;
+		}
+	}
+	return 0;
+}
+
+static void free_model_cost(model_cost_t *cost) {
+	free(cost->nodes);
+	free(cost->graph);
+}
+
+static void node_terms(const node_cost_t *node, double terms[NUM_TERMS]) {
+	terms[TERM_MACS] = node->macs;
+	terms[TERM_BYTES] = node->weight_bytes + node->read_bytes + node->write_bytes;
+	terms[TERM_NODES] = 1;
+}
+
+static double estimate_ms(const latency_fit_t *fit, const node_cost_t *node, int nodes) {
+	double terms[NUM_TERMS];
+	node_terms(node, terms);
+	terms[TERM_NODES] = nodes;
+	double ms = 0;
+	for (int t = 0; t < NUM_TERMS; t++) {
+		ms += fit->coeff[t] * terms[t];
+	}
+	return ms;
+}
+
+// Least squares over the terms in use; fails if singular or any coefficient is negative
+static int solve_fit(double x[][NUM_TERMS], const double *y, int points, const int *use, int num_use, double *coeff) {
+	double a[NUM_TERMS][NUM_TERMS + 1] = {{0}};
+	for (int p = 0; p < points; p++) {
+		for (int i = 0; i < num_use; i++) {
+			for (int j = 0; j < num_use; j++) {
+				a[i][j] += x[p][use[i]] * x[p][use[j]];
+			}
+			a[i][num_use] += x[p][use[i]] * y[p];
+		}
+	}
+	for (int c = 0; c < num_use; c++) {
+		int pivot = c;
+		for (int r = c + 1; r < num_use; r++) {
+			if (fabs(a[r][c]) > fabs(a[pivot][c])) pivot = r;
+		}
+		if (fabs(a[pivot][c]) < 1e-300) {
+			return -1;
+		}
+		for (int k = 0; k <= num_use; k++) {
+			double tmp = a[c][k]; a[c][k] = a[pivot][k]; a[pivot][k] = tmp;
+		}
+		for (int r = 0; r < num_use; r++) {
+			if (r == c) continue;
+			double f = a[r][c] / a[c][c];
+			for (int k = c; k <= num_use; k++) {
+				a[r][k] -= f * a[c][k];
+			}
+		}
+	}
+	for (int i = 0; i < NUM_TERMS; i++) coeff[i] = 0;
+	for (int i = 0; i < num_use; i++) {
+		coeff[use[i]] = a[i][num_use] / a[i][i];
+		if (coeff[use[i]] < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Calibration file: one "MODEL.vnnx MEASURED_MS" per line, times as reported by run-model
+static int calibrate(latency_fit_t *fit, const char *filename) {
+	static const int subsets[][NUM_TERMS + 1] = {
+		{3, TERM_MACS, TERM_BYTES, TERM_NODES},
+		{2, TERM_MACS, TERM_BYTES},
+		{2, TERM_MACS, TERM_NODES},
+		{2, TERM_BYTES, TERM_NODES},
+		{1, TERM_MACS},
+		{1, TERM_BYTES},
+	};
+	double x[MAX_CALIBRATION][NUM_TERMS];
+	double y[MAX_CALIBRATION];
+	char line[1024], path[1024];
+	double ms;
+	memset(fit, 0, sizeof(*fit));
+	fit->size_conf = -1;
+	FILE *fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "Unable to open calibration file %s\n", filename);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) && fit->points < MAX_CALIBRATION) {
+		if (line[0] == '#' || sscanf(line, "%1023s %lf", path, &ms) != 2) {
+			continue;
+		}
+		model_cost_t cost;
+		if (analyze_model(&cost, path) != 0) {
+			fprintf(stderr, "Skipping calibration model %s, unable to analyze\n", path);
+			free_model_cost(&cost);
+			continue;
+		}
+		int size_conf = cost.graph->vbx_nn_preset;
+		if (fit->size_conf >= 0 && size_conf != fit->size_conf) {
+			fprintf(stderr, "Calibration model %s is for a different size configuration\n", path);
+		}
+		fit->size_conf = size_conf;
+		node_terms(&cost.total, x[fit->points]);
+		x[fit->points][TERM_NODES] = cost.num_nodes;
+		y[fit->points] = ms;
+		fit->points++;
+		free_model_cost(&cost);
+	}
+	fclose(fp);
+
+	for (int s = 0; s < (int)(sizeof(subsets) / sizeof(*subsets)); s++) {
+		int num_use = subsets[s][0];
+		if (num_use > fit->points) {
+			continue;
+		}
+		if (solve_fit(x, y, fit->points, subsets[s] + 1, num_use, fit->coeff) == 0) {
+			fit->valid = 1;
+			break;
+		}
+	}
+	if (!fit->valid) {
+		fprintf(stderr, "Unable to fit a latency model to %s\n", filename);
+		return -1;
+	}
+	double sum = 0;
+	for (int p = 0; p < fit->points; p++) {
+		double err = 0;
+		for (int t = 0; t < NUM_TERMS; t++) err += fit->coeff[t] * x[p][t];
+		err -= y[p];
+		sum += err * err;
+	}
+	fit->rms_error_ms = sqrt(sum / fit->points);
+	return 0;
+}
+
+static void print_model(const char *filename, model_cost_t *cost, const latency_fit_t *fit, int verbose,
+		double budget_ms, double dma_limit_mb) {
+	double total_ms = fit->valid ? estimate_ms(fit, &cost->total, cost->num_nodes) : 0;
+	printf("%s: %d nodes, size conf %d\n", filename, cost->num_nodes, (int)cost->graph->vbx_nn_preset);
+	if (verbose) {
+		printf("%4s %-24s %-24s %12s %10s %10s %10s %9s", "node", "type", "output", "MACs", "weights", "read", "written", "scratch");
+		if (fit->valid) printf(" %9s %6s", "est ms", "%");
+		printf("\n");
+		for (int n = 0; n < cost->num_nodes; n++) {
+			node_cost_t *node = cost->nodes + n;
+			printf("%4d %-24s %-24.24s %12llu %10llu %10llu %10llu %9d", n, op_name(node->type), node->description,
+					(unsigned long long)node->macs, (unsigned long long)node->weight_bytes,
+					(unsigned long long)node->read_bytes, (unsigned long long)node->write_bytes, (int)node->scratchpad_bytes);
+			if (fit->valid) {
+				double ms = estimate_ms(fit, node, 1);
+				printf(" %9.3f %5.1f%%", ms, total_ms > 0 ? 100.0 * ms / total_ms : 0);
+			}
+			printf("\n");
+		}
+	}
+	printf("  MACs           %12.3f G\n", cost->total.macs / 1e9);
+	printf("  weights        %12.3f MB\n", cost->total.weight_bytes / 1e6);
+	printf("  activations    %12.3f MB read, %.3f MB written\n", cost->total.read_bytes / 1e6, cost->total.write_bytes / 1e6);
+	printf("  scratchpad     %12d bytes largest node\n", (int)cost->max_scratchpad_bytes);
+	double dma_mb = model_get_allocate_bytes((model_t *)cost->graph) / 1e6;
+	printf("  DMA            %12.3f MB model + buffers", dma_mb);
+	if (dma_limit_mb > 0) printf(" (%s %.1f MB limit)", dma_mb <= dma_limit_mb ? "fits" : "EXCEEDS", dma_limit_mb);
+	printf("\n");
+	if (fit->valid) {
+		printf("  latency        %12.3f ms estimated (+/- %.3f ms rms on %d calibration runs)", total_ms, fit->rms_error_ms, fit->points);
+		if (budget_ms > 0) printf(" (%s %.1f ms budget)", total_ms <= budget_ms ? "fits" : "EXCEEDS", budget_ms);
+		printf("\n");
+		if (fit->size_conf != (int)cost->graph->vbx_nn_preset) {
+			printf("  calibrated for size conf %d, estimate may not apply\n", fit->size_conf);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	latency_fit_t fit = {0};
+	double budget_ms = 0, dma_limit_mb = 0;
+	int verbose = 1;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:b:d:s")) != -1) {
+		switch (opt) {
+		case 'c':
+			if (calibrate(&fit, optarg) != 0) return 1;
+			break;
+		case 'b':
+			budget_ms = atof(optarg);
+			break;
+		case 'd':
+			dma_limit_mb = atof(optarg);
+			break;
+		case 's':
+			verbose = 0;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr,
+				"Usage: %s [-c CALIBRATION] [-b BUDGET_MS] [-d DMA_LIMIT_MB] [-s] MODEL.vnnx...\n"
+				"   reports MACs, weight bytes, activation bytes and scratchpad use per node and in total.\n"
+				"   -c  fit a latency estimate to CALIBRATION, lines of \"MODEL.vnnx MEASURED_MS\"\n"
+				"   -b  flag models whose estimated latency exceeds BUDGET_MS\n"
+				"   -d  flag models whose DMA footprint exceeds DMA_LIMIT_MB\n"
+				"   -s  totals only\n",
+				argv[0]);
+		return 1;
+	}
+	if (fit.valid) {
+		printf("latency fit: %.3g ms/GMAC %.3g ms/MB %.3g ms/node\n",
+				fit.coeff[TERM_MACS] * 1e9, fit.coeff[TERM_BYTES] * 1e6, fit.coeff[TERM_NODES]);
+	}
+	int status = 0;
+	for (int i = optind; i < argc; i++) {
+		model_cost_t cost;
+		if (analyze_model(&cost, argv[i]) != 0) {
+			fprintf(stderr, "Unable to analyze %s\n", argv[i]);
+			status = 1;
+		} else {
+			print_model(argv[i], &cost, &fit, verbose, budget_ms, dma_limit_mb);
+		}
+		free_model_cost(&cost);
+	}
+	return status;
+}
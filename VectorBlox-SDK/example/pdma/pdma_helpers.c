@@ -0,0 +1,537 @@
+#include "pdma_helpers.h"
+#include "mchp-dma-proxy.h"
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <time.h>
+
+
+uint64_t
+get_phy_addr(char* dev) {
+    char bufinfo[128];
+    uint64_t phy_addr;
+    FILE*    fp;
+
+    printf("Getting address of %s \n", &dev[strlen("/dev/")]);
+    snprintf(bufinfo, sizeof(bufinfo), "/sys/class/u-dma-buf/%s/phys_addr", &dev[strlen("/dev/")]);
+    printf("Getting address of %s \n", bufinfo);
+
+    fp = fopen(bufinfo, "r");
+    fscanf(fp, "%lx", &phy_addr);
+    fclose(fp);
+
+    printf("Phy addr of %s is 0x%lX\n", bufinfo, phy_addr);
+
+    return phy_addr;
+}
+
+
+int32_t pdma_ch_open(){
+	char channel_name[64] = {0};
+    const char* dma_channel_names[] = { "dma-proxy0", /* add unique channel names here */ };
+    int32_t chn_fd;
+    snprintf(channel_name, sizeof(channel_name) - sizeof("/dev/"), "/dev/%s", dma_channel_names[0]);
+    chn_fd = open(channel_name, O_RDWR);
+	return chn_fd;
+}
+
+int32_t pdma_ch_cpy(uint64_t destbuf,  uint64_t srcbuf, size_t n, int32_t chn_fd){
+	struct mpfs_dma_proxy_channel_config channel_config_t;
+    channel_config_t.src = srcbuf;
+    channel_config_t.dst = destbuf;
+    channel_config_t.length = n;
+
+    //printf("0x%lX == %.4f MB ==> 0x%lX \n",channel_config_t.src,n/(1024.0*1024),channel_config_t.dst);
+
+    if (ioctl(chn_fd, MPFS_DMA_PROXY_START_XFER, &channel_config_t) != 0) {
+        printf("transfer not started");
+		return -1;
+    }
+
+    if (ioctl(chn_fd, MPFS_DMA_PROXY_FINISH_XFER, &proxy_status_e) != 0) {
+        printf("transfer not finixhed");
+		return -1;
+    }
+
+    return 0;
+}
+
+int32_t pdma_ch_close(int32_t chn_fd){
+	if (close(chn_fd) != 0) {
+		printf("failed to close");
+        return -1;
+    }
+	return 0;
+}
+
+
+#define PDMA_TOKEN_MASK 0x7fffffff
+
+static int32_t proxy_xfer(void* arg, int channel, uint64_t destbuf, uint64_t srcbuf, size_t n){
+	pdma_async_t* pdma = (pdma_async_t*)arg;
+	return pdma_ch_cpy(destbuf, srcbuf, n, pdma->chn_fd[channel]);
+}
+
+// one per channel: takes the next segment of the oldest waiting submission
+// and blocks in it, so the channel starts another the moment it finishes and
+// a submission's segments spread over every idle channel
+static void* pdma_worker(void* arg){
+	pdma_async_t* pdma = (pdma_async_t*)arg;
+	pthread_mutex_lock(&pdma->lock);
+	int channel = pdma->num_workers++;
+	pthread_cond_broadcast(&pdma->done);
+	while (1) {
+		while (!pdma->stop && pdma->next_start == pdma->next_token) {
+			pthread_cond_wait(&pdma->work, &pdma->lock);
+		}
+		if (pdma->next_start == pdma->next_token) {
+			break;
+		}
+		pdma_xfer_t* xfer = pdma->xfers + pdma->next_start % PDMA_MAX_PENDING;
+		pdma_segment_t* segment = xfer->segments + xfer->next_segment++;
+		if (xfer->next_segment == xfer->num_segments) {
+			pdma->next_start++;
+		}
+		pthread_mutex_unlock(&pdma->lock);
+		int failed = pdma->xfer(pdma->xfer_arg, channel, segment->dst, segment->src, segment->n) != 0;
+		pthread_mutex_lock(&pdma->lock);
+		xfer->failed |= failed;
+		if (--xfer->segments_left == 0) {
+			xfer->status = xfer->failed ? -1 : 0;
+			pthread_cond_broadcast(&pdma->done);
+		}
+	}
+	pthread_mutex_unlock(&pdma->lock);
+	return NULL;
+}
+
+pdma_async_t* pdma_async_init(int num_channels, pdma_xfer_fn xfer, void* arg){
+	if (num_channels < 1 || num_channels > PDMA_MAX_CHANNELS) {
+		return NULL;
+	}
+	pdma_async_t* pdma = (pdma_async_t*)calloc(1, sizeof(pdma_async_t));
+	if (!pdma) {
+		return NULL;
+	}
+	pdma->num_channels = num_channels;
+	pdma->xfer = xfer;
+	pdma->xfer_arg = arg;
+	for (int c = 0; c < PDMA_MAX_CHANNELS; c++) {
+		pdma->chn_fd[c] = -1;
+	}
+	pthread_mutex_init(&pdma->lock, NULL);
+	pthread_cond_init(&pdma->work, NULL);
+	pthread_cond_init(&pdma->done, NULL);
+	// each worker reads its channel from num_workers under the lock
+	pthread_mutex_lock(&pdma->lock);
+	while (pdma->num_workers < num_channels) {
+		int started = pdma->num_workers;
+		if (pthread_create(pdma->workers + started, NULL, pdma_worker, pdma) != 0) {
+			break;
+		}
+		while (pdma->num_workers == started) {
+			pthread_cond_wait(&pdma->done, &pdma->lock);
+		}
+	}
+	pthread_mutex_unlock(&pdma->lock);
+	if (pdma->num_workers < num_channels) {
+		pdma_async_close(pdma);
+		return NULL;
+	}
+	return pdma;
+}
+
+pdma_async_t* pdma_async_open(){
+	int32_t chn_fd[PDMA_MAX_CHANNELS];
+	int num_channels = 0;
+	for (int c = 0; c < PDMA_MAX_CHANNELS; c++) {
+		char channel_name[64];
+		snprintf(channel_name, sizeof(channel_name), "/dev/dma-proxy%d", c);
+		chn_fd[num_channels] = open(channel_name, O_RDWR);
+		if (chn_fd[num_channels] >= 0) {
+			num_channels++;
+		}
+	}
+	pdma_async_t* pdma = num_channels ? pdma_async_init(num_channels, proxy_xfer, NULL) : NULL;
+	if (!pdma) {
+		for (int c = 0; c < num_channels; c++) {
+			close(chn_fd[c]);
+		}
+		return NULL;
+	}
+	pdma->xfer_arg = pdma;
+	memcpy(pdma->chn_fd, chn_fd, num_channels * sizeof(int32_t));
+	return pdma;
+}
+
+void pdma_async_close(pdma_async_t* pdma){
+	if (!pdma) {
+		return;
+	}
+	pthread_mutex_lock(&pdma->lock);
+	pdma->stop = 1;
+	pthread_cond_broadcast(&pdma->work);
+	pthread_mutex_unlock(&pdma->lock);
+	for (int w = 0; w < pdma->num_workers; w++) {
+		pthread_join(pdma->workers[w], NULL);
+	}
+	for (int c = 0; c < pdma->num_channels; c++) {
+		if (pdma->chn_fd[c] >= 0) {
+			close(pdma->chn_fd[c]);
+		}
+	}
+	pthread_cond_destroy(&pdma->done);
+	pthread_cond_destroy(&pdma->work);
+	pthread_mutex_destroy(&pdma->lock);
+	free(pdma);
+}
+
+static int32_t submit_segments(pdma_async_t* pdma, const pdma_segment_t* segments, int num_segments){
+	pthread_mutex_lock(&pdma->lock);
+	// the slot is free once the transfer PDMA_MAX_PENDING before has finished
+	pdma_xfer_t* xfer = pdma->xfers + pdma->next_token % PDMA_MAX_PENDING;
+	while (xfer->status == 1) {
+		pthread_cond_wait(&pdma->done, &pdma->lock);
+	}
+	memcpy(xfer->segments, segments, num_segments * sizeof(pdma_segment_t));
+	xfer->num_segments = num_segments;
+	xfer->next_segment = 0;
+	xfer->segments_left = num_segments;
+	xfer->failed = 0;
+	xfer->status = 1;
+	int32_t token = (int32_t)(pdma->next_token++ & PDMA_TOKEN_MASK);
+	if (num_segments > 1) {
+		pthread_cond_broadcast(&pdma->work);
+	} else {
+		pthread_cond_signal(&pdma->work);
+	}
+	pthread_mutex_unlock(&pdma->lock);
+	return token;
+}
+
+int32_t pdma_async_submit(pdma_async_t* pdma, uint64_t destbuf, uint64_t srcbuf, size_t n){
+	pdma_segment_t segment = {destbuf, srcbuf, n};
+	return submit_segments(pdma, &segment, 1);
+}
+
+pdma_window_t* pdma_window_open(const char* dev, size_t size, uint64_t src_offset){
+	char cdev[64];
+	snprintf(cdev, sizeof(cdev), "%s", dev);
+	int32_t fd = open(cdev, O_RDWR);
+	if (fd < 0) {
+		return NULL;
+	}
+	pdma_window_t* window = (pdma_window_t*)calloc(1, sizeof(pdma_window_t));
+	void* virt = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (!window || virt == MAP_FAILED) {
+		if (virt != MAP_FAILED) {
+			munmap(virt, size);
+		}
+		free(window);
+		close(fd);
+		return NULL;
+	}
+	window->virt = (int8_t*)virt;
+	window->phys = get_phy_addr(cdev);
+	window->size = size;
+	window->src_offset = src_offset;
+	window->fd = fd;
+	return window;
+}
+
+void pdma_window_close(pdma_window_t* window){
+	if (!window) {
+		return;
+	}
+	munmap(window->virt, window->size);
+	close(window->fd);
+	free(window);
+}
+
+// lays the regions out in the window from offset as PDMA segments
+static int pack_regions(const pdma_window_t* window, size_t offset, pdma_region_t* regions, int count,
+		pdma_segment_t* segments, int* num_segments){
+	uint64_t src_end = 0;
+	*num_segments = 0;
+	for (int r = 0; r < count; r++) {
+		uint64_t src = (uint64_t)(uintptr_t)regions[r].src;
+		size_t n = regions[r].n;
+		if (*num_segments && src >= src_end && src - src_end <= PDMA_SG_MAX_GAP) {
+			// keep the gap so the region lands where the one transfer puts it
+			pdma_segment_t* segment = segments + *num_segments - 1;
+			offset += src - src_end;
+			if (offset + n > window->size) {
+				return -1;
+			}
+			segment->n += src - src_end + n;
+		} else {
+			offset = (offset + PDMA_SG_ALIGN - 1) & ~(size_t)(PDMA_SG_ALIGN - 1);
+			if (*num_segments == PDMA_MAX_SEGMENTS || offset + n > window->size) {
+				return -1;
+			}
+			pdma_segment_t segment = {window->phys + offset, src + window->src_offset, n};
+			segments[(*num_segments)++] = segment;
+		}
+		regions[r].dst = window->virt + offset;
+		offset += n;
+		src_end = src + n;
+	}
+	return 0;
+}
+
+// large segments are cut up so every channel has a share of them
+static void split_segments(int num_channels, pdma_segment_t* segments, int* num_segments){
+	for (int s = 0; s < *num_segments && num_channels > 1; s++) {
+		int pieces = num_channels;
+		if (segments[s].n < PDMA_SG_SPLIT_BYTES || *num_segments + pieces - 1 > PDMA_MAX_SEGMENTS) {
+			continue;
+		}
+		size_t piece = (segments[s].n / pieces + PDMA_SG_ALIGN - 1) & ~(size_t)(PDMA_SG_ALIGN - 1);
+		memmove(segments + s + pieces, segments + s + 1, (*num_segments - s - 1) * sizeof(pdma_segment_t));
+		for (int p = pieces - 1; p >= 0; p--) {
+			segments[s + p] = segments[s];
+			segments[s + p].dst += p * piece;
+			segments[s + p].src += p * piece;
+			segments[s + p].n = p < pieces - 1 ? piece : segments[s].n - p * piece;
+		}
+		*num_segments += pieces - 1;
+		s += pieces - 1;
+	}
+}
+
+size_t pdma_pack_bytes(const pdma_region_t* regions, int count){
+	// the layout pack_regions() makes
+	size_t offset = 0;
+	uint64_t src_end = 0;
+	for (int r = 0; r < count; r++) {
+		uint64_t src = (uint64_t)(uintptr_t)regions[r].src;
+		if (r && src >= src_end && src - src_end <= PDMA_SG_MAX_GAP) {
+			offset += src - src_end;
+		} else {
+			offset = (offset + PDMA_SG_ALIGN - 1) & ~(size_t)(PDMA_SG_ALIGN - 1);
+		}
+		offset += regions[r].n;
+		src_end = src + regions[r].n;
+	}
+	return offset;
+}
+
+int32_t pdma_async_submit_sg(pdma_async_t* pdma, const pdma_window_t* window, size_t offset, pdma_region_t* regions, int count){
+	pdma_segment_t segments[PDMA_MAX_SEGMENTS];
+	int num_segments;
+	if (pack_regions(window, offset, regions, count, segments, &num_segments) != 0 || !num_segments) {
+		return -1;
+	}
+	split_segments(pdma->num_channels, segments, &num_segments);
+	return submit_segments(pdma, segments, num_segments);
+}
+
+// status of token with the lock held; a slot reused since finished long ago
+static int32_t token_status(pdma_async_t* pdma, int32_t token){
+	uint32_t age = (pdma->next_token - (uint32_t)token) & PDMA_TOKEN_MASK;
+	if (token == PDMA_TOKEN_DONE) {
+		return 0;
+	}
+	if (token < 0 || age == 0) {
+		return -1;
+	}
+	if (age > PDMA_MAX_PENDING) {
+		return 0;
+	}
+	return pdma->xfers[(uint32_t)token % PDMA_MAX_PENDING].status;
+}
+
+int32_t pdma_async_poll(pdma_async_t* pdma, int32_t token){
+	pthread_mutex_lock(&pdma->lock);
+	int32_t status = token_status(pdma, token);
+	pthread_mutex_unlock(&pdma->lock);
+	return status;
+}
+
+int32_t pdma_async_wait(pdma_async_t* pdma, int32_t token){
+	pthread_mutex_lock(&pdma->lock);
+	int32_t status;
+	while ((status = token_status(pdma, token)) == 1) {
+		pthread_cond_wait(&pdma->done, &pdma->lock);
+	}
+	pthread_mutex_unlock(&pdma->lock);
+	return status;
+}
+
+int32_t pdma_async_wait_all(pdma_async_t* pdma){
+	pthread_mutex_lock(&pdma->lock);
+	int32_t status = 0;
+	for (int x = 0; x < PDMA_MAX_PENDING; x++) {
+		while (pdma->xfers[x].status == 1) {
+			pthread_cond_wait(&pdma->done, &pdma->lock);
+		}
+		if (pdma->xfers[x].status < 0) {
+			status = -1;
+		}
+	}
+	pthread_mutex_unlock(&pdma->lock);
+	return status;
+}
+
+void pdma_copy_init(pdma_copy_t* copy, pdma_async_t* pdma, const pdma_window_t* window){
+	copy->pdma = pdma;
+	copy->window = window;
+	// until calibrated, everything the PDMA can take goes to it
+	for (int s = 0; s < PDMA_NUM_SOURCES; s++) {
+		copy->threshold[s] = pdma ? 0 : SIZE_MAX;
+	}
+}
+
+uint64_t pdma_copy_timed_cost(void* arg, const pdma_copy_t* copy, int engine, size_t n){
+	pdma_region_t region = {arg, n, NULL};
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (engine == PDMA_ENGINE_CPU) {
+		memcpy(copy->window->virt, arg, n);
+	} else {
+		pdma_async_wait(copy->pdma, pdma_async_submit_sg(copy->pdma, copy->window, 0, &region, 1));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec;
+}
+
+void pdma_copy_calibrate(pdma_copy_t* copy, int source, pdma_cost_fn cost, void* arg){
+	if (!copy->pdma || !copy->window) {
+		return;
+	}
+	// the smallest size from which the PDMA stays ahead, checked one size further;
+	// best of three of each, so a stray page fault or preemption doesn't count
+	copy->threshold[source] = SIZE_MAX;
+	int ahead = 0;
+	for (size_t n = PDMA_COPY_CALIBRATE_MIN; n <= PDMA_COPY_CALIBRATE_MAX && n <= copy->window->size && ahead < 2; n *= 2) {
+		uint64_t best[PDMA_NUM_ENGINES] = {UINT64_MAX, UINT64_MAX};
+		for (int run = 0; run < 3; run++) {
+			for (int engine = 0; engine < PDMA_NUM_ENGINES; engine++) {
+				uint64_t ns = cost(arg, copy, engine, n);
+				best[engine] = ns < best[engine] ? ns : best[engine];
+			}
+		}
+		if (best[PDMA_ENGINE_PDMA] < best[PDMA_ENGINE_CPU]) {
+			if (!ahead++) {
+				copy->threshold[source] = n;
+			}
+		} else {
+			ahead = 0;
+			copy->threshold[source] = SIZE_MAX;
+		}
+	}
+}
+
+int32_t pdma_copy_submit(pdma_copy_t* copy, int source, size_t offset, pdma_region_t* regions, int count){
+	if (!copy->window) {
+		// no staging window: read each region where it is
+		for (int r = 0; r < count; r++) {
+			regions[r].dst = (int8_t*)regions[r].src;
+		}
+		return PDMA_TOKEN_DONE;
+	}
+	pdma_segment_t segments[PDMA_MAX_SEGMENTS];
+	int num_segments;
+	if (pack_regions(copy->window, offset, regions, count, segments, &num_segments) != 0) {
+		return -1;
+	}
+	// segments under the threshold are copied here and now, the rest queued
+	int queued = 0;
+	for (int s = 0; s < num_segments; s++) {
+		if (segments[s].n < copy->threshold[source]) {
+			memcpy(copy->window->virt + (segments[s].dst - copy->window->phys),
+					(void*)(uintptr_t)(segments[s].src - copy->window->src_offset), segments[s].n);
+		} else {
+			segments[queued++] = segments[s];
+		}
+	}
+	if (!queued) {
+		return PDMA_TOKEN_DONE;
+	}
+	split_segments(copy->pdma->num_channels, segments, &queued);
+	return submit_segments(copy->pdma, segments, queued);
+}
+
+int32_t pdma_copy_wait(pdma_copy_t* copy, int32_t token){
+	if (token == PDMA_TOKEN_DONE) {
+		return 0;
+	}
+	return copy->pdma && token >= 0 ? pdma_async_wait(copy->pdma, token) : -1;
+}
+
+pdma_ring_t* pdma_ring_init(size_t size){
+	pdma_ring_t* ring = (pdma_ring_t*)calloc(1, sizeof(pdma_ring_t));
+	if (!ring) {
+		return NULL;
+	}
+	ring->size = size & ~(size_t)(PDMA_SG_ALIGN - 1);
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->released, NULL);
+	return ring;
+}
+
+void pdma_ring_close(pdma_ring_t* ring){
+	if (!ring) {
+		return;
+	}
+	pthread_cond_destroy(&ring->released);
+	pthread_mutex_destroy(&ring->lock);
+	free(ring);
+}
+
+// with the lock held: the slot, or -1 if it has to wait for a release
+static int ring_take(pdma_ring_t* ring, size_t bytes, size_t* offset){
+	if (ring->next - ring->first == PDMA_RING_SLOTS) {
+		return -1;
+	}
+	// after the head, or from the start of the window if it won't fit before the end
+	size_t start = ring->head + bytes <= ring->size ? ring->head : 0;
+	size_t cost = start == ring->head ? bytes : ring->size - ring->head + bytes;
+	if (ring->used + cost > ring->size) {
+		return -1;
+	}
+	int slot = ring->next++ % PDMA_RING_SLOTS;
+	ring->slots[slot].offset = start;
+	ring->slots[slot].bytes = cost;
+	ring->slots[slot].held = 1;
+	ring->head = start + bytes;
+	ring->used += cost;
+	*offset = start;
+	return slot;
+}
+
+static int ring_acquire(pdma_ring_t* ring, size_t bytes, size_t* offset, int wait){
+	bytes = (bytes + PDMA_SG_ALIGN - 1) & ~(size_t)(PDMA_SG_ALIGN - 1);
+	if (!bytes || bytes > ring->size) {
+		return -1;
+	}
+	pthread_mutex_lock(&ring->lock);
+	int slot;
+	while ((slot = ring_take(ring, bytes, offset)) < 0 && wait) {
+		pthread_cond_wait(&ring->released, &ring->lock);
+	}
+	pthread_mutex_unlock(&ring->lock);
+	return slot;
+}
+
+int pdma_ring_acquire(pdma_ring_t* ring, size_t bytes, size_t* offset){
+	return ring_acquire(ring, bytes, offset, 1);
+}
+
+int pdma_ring_try_acquire(pdma_ring_t* ring, size_t bytes, size_t* offset){
+	return ring_acquire(ring, bytes, offset, 0);
+}
+
+void pdma_ring_release(pdma_ring_t* ring, int slot){
+	pthread_mutex_lock(&ring->lock);
+	ring->slots[slot].held = 0;
+	while (ring->first != ring->next && !ring->slots[ring->first % PDMA_RING_SLOTS].held) {
+		ring->used -= ring->slots[ring->first++ % PDMA_RING_SLOTS].bytes;
+	}
+	// empty: the next slot may as well start at the beginning
+	if (ring->first == ring->next) {
+		ring->head = 0;
+	}
+	pthread_cond_broadcast(&ring->released);
+	pthread_mutex_unlock(&ring->lock);
+}
@@ -0,0 +1,211 @@
+#ifndef PDMA_HELPERS_H
+#define PDMA_HELPERS_H
+
+#include <stdint.h>
+#include <string.h>
+
+
+#include <sys/fcntl.h> 
+#include <sys/stat.h>
+#include <sys/ioctl.h>      
+#include <unistd.h>     
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+uint64_t get_phy_addr(char* dev);
+
+int32_t pdma_ch_open();
+int32_t pdma_ch_cpy(uint64_t destbuf,  uint64_t srcbuf, size_t n, int32_t chn_fd);
+int32_t pdma_ch_close(int32_t chn_fd);
+
+/*
+ * Asynchronous transfers: submit returns a token straight away and each
+ * dma-proxy channel's thread starts the oldest waiting transfer as soon as
+ * its last one finishes, so copies run while the caller works on what has
+ * already arrived. Tokens stay valid for the last PDMA_MAX_PENDING transfers.
+ *
+ *	pdma_async_t* pdma = pdma_async_open();
+ *	for (o = 0; o < num_outputs; o++) tokens[o] = pdma_async_submit(pdma, dst[o], src[o], length[o]);
+ *	for (o = 0; o < num_outputs; o++) { pdma_async_wait(pdma, tokens[o]); use(dst[o]); }
+ */
+#define PDMA_MAX_CHANNELS 4
+#define PDMA_MAX_PENDING 64
+#define PDMA_MAX_SEGMENTS 16
+
+// moves one transfer on a channel, blocking until it is done; 0 on success
+typedef int32_t (*pdma_xfer_fn)(void* arg, int channel, uint64_t destbuf, uint64_t srcbuf, size_t n);
+
+typedef struct {
+	uint64_t dst;
+	uint64_t src;
+	size_t n;
+} pdma_segment_t;
+
+// one submission: each segment goes to whichever channel is free next
+typedef struct {
+	pdma_segment_t segments[PDMA_MAX_SEGMENTS];
+	int num_segments;
+	int next_segment;     // the first no channel has taken
+	int segments_left;    // not yet finished
+	int failed;
+	int32_t status;       // 1 until done, then 0 or -1
+} pdma_xfer_t;
+
+typedef struct {
+	int32_t chn_fd[PDMA_MAX_CHANNELS];
+	int num_channels;
+	pthread_t workers[PDMA_MAX_CHANNELS];
+	int num_workers;
+	pdma_xfer_t xfers[PDMA_MAX_PENDING];   // token t in xfers[t % PDMA_MAX_PENDING]
+	uint32_t next_token;
+	uint32_t next_start;                   // oldest token with segments no channel has taken
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t work;                   // signalled when a transfer is submitted
+	pthread_cond_t done;                   // signalled when a transfer finishes
+	pdma_xfer_fn xfer;
+	void* xfer_arg;
+} pdma_async_t;
+
+// every /dev/dma-proxyN that opens, or NULL if none do
+pdma_async_t* pdma_async_open();
+// num_channels threads moving transfers with xfer, such as a memcpy stand-in off target
+pdma_async_t* pdma_async_init(int num_channels, pdma_xfer_fn xfer, void* arg);
+// finishes every submitted transfer first
+void pdma_async_close(pdma_async_t* pdma);
+// token (>= 0), waiting for room if PDMA_MAX_PENDING transfers are unfinished
+int32_t pdma_async_submit(pdma_async_t* pdma, uint64_t destbuf, uint64_t srcbuf, size_t n);
+// 1 while the transfer is in flight, 0 when done, -1 if it failed
+int32_t pdma_async_poll(pdma_async_t* pdma, int32_t token);
+// 0 once the transfer is done, -1 if it failed
+int32_t pdma_async_wait(pdma_async_t* pdma, int32_t token);
+/*
+ * Scatter-gather: a list of regions anywhere in DMA memory copied into a
+ * staging window in one submission. The window lays the regions out
+ * itself, and a region starting within PDMA_SG_MAX_GAP bytes of the end of
+ * the one before joins its transfer, gap and all, so outputs allocated
+ * back to back move in a single ioctl round trip. A transfer of
+ * PDMA_SG_SPLIT_BYTES or more is shared between the channels instead.
+ */
+#define PDMA_SG_MAX_GAP 4096
+#define PDMA_SG_ALIGN 64
+#define PDMA_SG_SPLIT_BYTES (64*1024)
+
+typedef struct {
+	int8_t* virt;         // the window mapped into this process
+	uint64_t phys;        // the window as the PDMA sees it
+	size_t size;
+	uint64_t src_offset;  // added to a source's virtual address to reach it from the PDMA
+	int32_t fd;
+} pdma_window_t;
+
+typedef struct {
+	const void* src;
+	size_t n;
+	int8_t* dst;          // set by pdma_async_submit_sg, where the region lands in the window
+} pdma_region_t;
+
+// maps size bytes of a u-dma-buf device such as "/dev/udmabuf-ddr-c0"
+pdma_window_t* pdma_window_open(const char* dev, size_t size, uint64_t src_offset);
+void pdma_window_close(pdma_window_t* window);
+// token for the whole list, or -1 if the regions don't fit in the window from offset
+int32_t pdma_async_submit_sg(pdma_async_t* pdma, const pdma_window_t* window, size_t offset, pdma_region_t* regions, int count);
+// 0 once every submitted transfer is done, -1 if any of the last PDMA_MAX_PENDING failed
+int32_t pdma_async_wait_all(pdma_async_t* pdma);
+// window bytes the regions take, packed from an aligned offset
+size_t pdma_pack_bytes(const pdma_region_t* regions, int count);
+
+/*
+ * Staging ring: hands out the window a frame at a time, so one frame's
+ * outputs can be copied in while an earlier frame's are still being
+ * postprocessed. Each slot is held until released, in any order; space
+ * comes back as the oldest slots are released. When the ring is full
+ * pdma_ring_acquire() waits for a release from another thread, and
+ * pdma_ring_try_acquire() returns -1 for the caller to drop or defer.
+ */
+#define PDMA_RING_SLOTS 8
+
+typedef struct {
+	size_t offset;
+	size_t bytes;         // from the head before it, so any end of the window skipped to wrap
+	int held;
+} pdma_ring_slot_t;
+
+typedef struct {
+	size_t size;
+	size_t head;          // where the next slot starts
+	size_t used;          // from the oldest held slot to head
+	pdma_ring_slot_t slots[PDMA_RING_SLOTS];
+	uint32_t first;       // oldest slot not yet given back
+	uint32_t next;
+	pthread_mutex_t lock;
+	pthread_cond_t released;
+} pdma_ring_t;
+
+// a ring over size bytes of a window
+pdma_ring_t* pdma_ring_init(size_t size);
+void pdma_ring_close(pdma_ring_t* ring);
+// slot holding bytes at *offset, waiting until there is room; -1 if bytes never fit
+int pdma_ring_acquire(pdma_ring_t* ring, size_t bytes, size_t* offset);
+// as pdma_ring_acquire(), -1 rather than waiting
+int pdma_ring_try_acquire(pdma_ring_t* ring, size_t bytes, size_t* offset);
+void pdma_ring_release(pdma_ring_t* ring, int slot);
+
+/*
+ * Copy routing: the ioctl round trip costs more than the cpu copying a few
+ * hundred bytes, while for megabytes the PDMA wins by far, and where the two
+ * cross depends on where the data is. pdma_copy_calibrate() times both
+ * engines from a sample of each source at startup, and pdma_copy_submit()
+ * then sends each packed segment to whichever is faster at its size. With no
+ * PDMA every copy is made by the cpu; with no window the regions are read
+ * where they are.
+ */
+#define PDMA_TOKEN_DONE (-2)   // a submission the cpu finished before returning
+#define PDMA_COPY_CALIBRATE_MIN 256
+#define PDMA_COPY_CALIBRATE_MAX (1024*1024)
+
+typedef enum {
+	PDMA_SOURCE_DMA,      // vbx_cnn DMA buffers such as model outputs, uncached for the cpu
+	PDMA_SOURCE_CACHED,   // ordinary process memory
+	PDMA_NUM_SOURCES
+} pdma_source_t;
+
+typedef enum {
+	PDMA_ENGINE_CPU,
+	PDMA_ENGINE_PDMA,
+	PDMA_NUM_ENGINES
+} pdma_engine_t;
+
+typedef struct {
+	pdma_async_t* pdma;
+	const pdma_window_t* window;
+	size_t threshold[PDMA_NUM_SOURCES];   // segments this large or larger go to the PDMA
+} pdma_copy_t;
+
+// ns to copy n bytes into the window with engine, from the source being calibrated
+typedef uint64_t (*pdma_cost_fn)(void* arg, const pdma_copy_t* copy, int engine, size_t n);
+
+// pdma or window may be NULL
+void pdma_copy_init(pdma_copy_t* copy, pdma_async_t* pdma, const pdma_window_t* window);
+// times real copies from arg, PDMA_COPY_CALIBRATE_MAX bytes of the source's memory
+uint64_t pdma_copy_timed_cost(void* arg, const pdma_copy_t* copy, int engine, size_t n);
+// sets the source's threshold from cost at sizes from PDMA_COPY_CALIBRATE_MIN up
+void pdma_copy_calibrate(pdma_copy_t* copy, int source, pdma_cost_fn cost, void* arg);
+// as pdma_async_submit_sg(), with small segments copied by the cpu before returning
+int32_t pdma_copy_submit(pdma_copy_t* copy, int source, size_t offset, pdma_region_t* regions, int count);
+// 0 once the copies are in the window, -1 if any failed
+int32_t pdma_copy_wait(pdma_copy_t* copy, int32_t token);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PDMA_HELPERS_H */
\ No newline at end of file
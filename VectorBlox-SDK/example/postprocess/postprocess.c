@@ -1,4 +1,6 @@
 #include "postprocess.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_dump.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -1097,109 +1099,11 @@ char *coco_classes[80] = {"person","bicycle","car","motorcycle","airplane","bus"
 
 char *voc_classes[20] = { "aeroplane", "bicycle", "bird", "boat", "bottle", "bus", "car", "cat", "chair", "cow", "diningtable", "dog", "horse", "motorbike", "person", "pottedplant","sheep","sofa", "train", "tv/monitor"};
 
+// io.json is now made on the host from the binary dump, with vbx-dump -j
 void print_json(model_t* model,vbx_cnn_io_ptr_t* io_buffers, int use_int8){
-	
-	FILE *fp;
-	fp = fopen ("io.json", "w");
-	
-	//Take in model and iobuffers;
-	fprintf(fp,"{\n");
-	fprintf(fp,"\"inputs\":[\n");
-	for(int i =0; i < (int)model_get_num_inputs(model);i++){
-			if (i == 0) fprintf(fp,"{");
-			int *in_dims = model_get_input_shape(model,i);
-			int8_t* i8=(int8_t*)(uintptr_t)io_buffers[i];
-			fix16_t* if16=(fix16_t*)(uintptr_t)io_buffers[i];
-
-			fprintf(fp,"\"zero\":%d,", model_get_input_zeropoint(model,i)); 
-			fprintf(fp,"\"scale\":%d,", (fix16_t)model_get_input_scale_fix16_value(model,i));
-			fprintf(fp,"\"shape\":[");
-			for(int j=0;j < (int)model_get_input_dims(model, i);j++){
-				if(j == (int)model_get_input_dims(model, i)-1){
-					fprintf(fp,"%d],\n",in_dims[j]);
-				} else fprintf(fp,"%d,",in_dims[j]);
-			}
-			fprintf(fp,"\"data\":[ ");
-			for (int j=0; j< (int)model_get_input_length(model, i); j++){
-				if(j == (int)model_get_input_length(model, i)-1){
-					if (use_int8) {
-						fprintf(fp,"%d]\n", i8[j]);
-					} else {
-						fprintf(fp,"%d]\n", if16[j]);
-					}
-				} else {
-					if (use_int8) {
-						fprintf(fp,"%d,",i8[j]);
-					} else {
-						fprintf(fp,"%d,",if16[j]);
-					}
-				}
-			}
-			if(i == (int)model_get_num_inputs(model)-1){
-				fprintf(fp,"}],\n");
-			} else {
-			        fprintf(fp,"},\n{");
-			}
+	if (model_dump_io(model, io_buffers, use_int8, "io.vbxd") != 0) {
+		fprintf(stderr, "Unable to write io.vbxd\n");
 	}
-	fprintf(fp,"\n\"outputs\":[\n");
-	for (int o =0; o < (int)model_get_num_outputs(model); o++){
-			if (o == 0) fprintf(fp,"{");
-			int *out_dims = model_get_output_shape(model,o);
-
-			int8_t *o8=(int8_t*)(uintptr_t)io_buffers[o+model_get_num_inputs(model)];
-			uint8_t *o8u=(uint8_t*)(uintptr_t)io_buffers[o+model_get_num_inputs(model)];
-			int16_t *o16=(int16_t*)(uintptr_t)io_buffers[o+model_get_num_inputs(model)];
-			int32_t *o32=(int32_t*)(uintptr_t)io_buffers[o+model_get_num_inputs(model)];
-			fix16_t* of16=(fix16_t*)(uintptr_t)io_buffers[o+model_get_num_inputs(model)];
-
-			fprintf(fp,"\"zero\":%d,", model_get_output_zeropoint(model,o)); 
-			fprintf(fp,"\"scale\":%d,", (fix16_t)model_get_output_scale_fix16_value(model,o));
-			fprintf(fp,"\"shape\":[");
-			for(int i=0;i < (int)model_get_output_dims(model, o);i++){
-				if(i == (int)model_get_output_dims(model, o)-1){
-					fprintf(fp,"%d],\n",out_dims[i]);
-				} else fprintf(fp,"%d,",out_dims[i]);
-			}
-			fprintf(fp,"\"data\":[ ");
-			for (int i=0; i< (int)model_get_output_length(model, o); i++){
-				if(i == (int)model_get_output_length(model, o)-1){
-					if (use_int8) {
-						if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT8) {
-							fprintf(fp,"%d]\n", o8[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_UINT8) {
-							fprintf(fp,"%d]\n", o8u[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT16) {
-							fprintf(fp,"%d]\n", o16[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT32) {
-							fprintf(fp,"%d]\n", o32[i]);
-						}
-					} else {
-						fprintf(fp,"%d]\n",of16[i]);
-					}
-				} else {
-					if (use_int8) {
-						if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT8) {
-							fprintf(fp,"%d,", o8[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_UINT8) {
-							fprintf(fp,"%d,", o8u[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT16) {
-							fprintf(fp,"%d,", o16[i]);
-						} else if (model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT32) {
-							fprintf(fp,"%d,", o32[i]);
-						}
-					} else {
-						fprintf(fp,"%d,",of16[i]);
-					}
-				}
-			}
-			if(o == (int)model_get_num_outputs(model)-1){
-				fprintf(fp,"}]\n");
-			} else {
-			        fprintf(fp,"},\n{");
-			}
-	}
-	fprintf(fp,"}\n");
-	fclose(fp);
 }
 
 void preprocess_inputs(uint8_t* input, fix16_t scale, int32_t zero_point, int input_length, int int8_flag){
@@ -1401,6 +1305,12 @@ fix16_t int8_to_fix16_single(int8_t input,fix16_t scale, int32_t zero_point){
 	return fix16_mul(fix16_from_int((int32_t)(input) - zero_point),scale);
 }
 
+void int8_gather(int8_t* output, const int8_t* input, int count, int stride){
+	for (int i = 0; i < count; i++) {
+		output[i] = input[i*stride];
+	}
+}
+
 int8_t fix16_to_int8(fix16_t input, fix16_t f16_scale, int32_t zero_point){
 	return (int8_t)(fix16_to_int(fix16_div(input,f16_scale)) +zero_point);
 }
@@ -2018,7 +1928,8 @@ int ultralytics_process_box(fix16_t *xywh, fix16_t* arr, fix16_t angle, const in
 	return 0;
 }
 
-int ultralytics_process_box_int8(fix16_t *xywh, int8_t* arr, fix16_t angle, const int h, const int w, const int H, const int W, int zero_point, fix16_t scale_output)
+// box is the cell's 64 channels, gathered from the box tensor
+int ultralytics_process_box_int8(fix16_t *xywh, const int8_t* box, fix16_t angle, const int h, const int w, const int H, const int W, int zero_point, fix16_t scale_output)
 {
 	fix16_t soft[16];
 	fix16_t v[4];
@@ -2030,7 +1941,7 @@ int ultralytics_process_box_int8(fix16_t *xywh, int8_t* arr, fix16_t angle, cons
 	for (int c = 0; c < 4; c++) {
 		fix16_t sum = 0;
 		for (int s = 0; s < 16; s++) {
-			soft[s] = int8_to_fix16_single(arr[(c*16+s)*H*W+h*W+w],scale_output,zero_point);
+			soft[s] = int8_to_fix16_single(box[c*16+s],scale_output,zero_point);
 		}
 		fix16_softmax(soft, 16, soft);
 		for (int s = 0; s < 16; s++) {
@@ -2069,9 +1980,10 @@ int post_process_ultra_int8(int8_t **outputs, int* outputs_shape[], fix16_t *pos
 {
 	int total_count = 0;
 	int C = outputs_shape[0][1];	// number of classes (80 for COCO)
+	int post_sz = C+4+is_obb+!!is_pose*51;
 	fix16_t fix16_log_odds = fix16_log(fix16_div(thresh, fix16_sub(fix16_one, thresh)));
 	bool has_argmax = false;
-	if (num_outputs ==9)
+	if (num_outputs ==9 && !is_obb && !is_pose)	// the last three are angles or keypoints otherwise
 		has_argmax = true;
 	int outputs_per_stride = 2; //increment should be done by stride sets, (usually 3 sets)
 	for(int o=0; o < 6; o+=outputs_per_stride){
@@ -2082,28 +1994,23 @@ int post_process_ultra_int8(int8_t **outputs, int* outputs_shape[], fix16_t *pos
 		fix16_t temp_scale = scale_outs[o];
 		int8_t i8_log_odds = fix16_to_int8(fix16_log_odds,temp_scale,temp_zero);
 
-		int valid_locations[H][W];
-		for(int h=0; h<H; h++)
-			for(int w=0; w<W; w++)
-				valid_locations[h][w] = 0;
+		// first the class (or argmax) tensor finds the likely cells in the int8 domain,
+		// then only their rows of the box and keypoint tensors are read
+		uint8_t valid_locations[H*W];
+		memset(valid_locations, 0, sizeof(valid_locations));
 		if(has_argmax){
-			uint8_t *argmax = outputs[(o/2+6)];
-			for(int h=0; h<H; h++){
-				for(int w=0; w<W; w++){
-					uint8_t C = argmax[h*W+w];
-					if(out8[C*H*W + h*W + w]>i8_log_odds){	// only process likely scores
-						valid_locations[h][w] = 1;
-					}
+			uint8_t *argmax = (uint8_t*)outputs[(o/2+6)];
+			for(int hw=0; hw<H*W; hw++){
+				if(out8[argmax[hw]*H*W + hw]>i8_log_odds){	// only process likely scores
+					valid_locations[hw] = 1;
 				}
 			}
 		}
 		else{
 			for(int c=0; c<C; c++){
-				for(int h=0; h<H; h++){
-					for(int w=0; w<W; w++){
-						if(out8[ c*H*W + h*W + w]>i8_log_odds){	// only process likely scores
-							valid_locations[h][w] = 1;
-						}
+				for(int hw=0; hw<H*W; hw++){
+					if(out8[c*H*W + hw]>i8_log_odds){	// only process likely scores
+						valid_locations[hw] = 1;
 					}
 				}
 			}
@@ -2111,71 +2018,93 @@ int post_process_ultra_int8(int8_t **outputs, int* outputs_shape[], fix16_t *pos
 		fix16_t inv_H = fix16_div(fix16_one, fix16_from_int(H));
 		fix16_t inv_W = fix16_div(fix16_one, fix16_from_int(W));
 
-		for(int h=0; h<H; h++){
-			for(int w=0; w<W; w++){
-				if(valid_locations[h][w] && total_count<max_boxes){
-					fix16_t *xywh = post + total_count*(C+4+is_obb+!!is_pose*51);
-					fix16_t angle = fix16_minimum;
-					if (is_obb) {
-						int8_t angle8 = outputs[6+o/2][h*W+w]; //assumed to be in order
-						angle = fix16_logistic_activate(int8_to_fix16_single(angle8, scale_outs[6+o/2],zero_points[6+o/2]));
-						angle = fix16_sub(angle, F16(0.25));
-						angle = fix16_mul(angle, F16(3.141592741));
-
-						post[total_count*(C+4+is_obb+!!is_pose*51)+4+C] = angle;
-					}
-					ultralytics_process_box_int8(xywh, outputs[o+1], angle, h, w, H, W, zero_points[o+1], scale_outs[o+1]);
-					if (is_pose) {
-						fix16_t py = -1;
-						fix16_t px = -1;
-						fix16_t score = -1;
-
-						for(int p=0; p<17; p++){
-							int idx_x = ((p*3+0)*H*W) + h*W+w;
-							int idx_y = ((p*3+1)*H*W) + h*W+w;
-							int idx_s = ((p*3+2)*H*W) + h*W+w;
-
-							score = fix16_logistic_activate(int8_to_fix16_single(outputs[6+o/2][idx_s], scale_outs[6+o/2],zero_points[6+o/2]));
-							px = fix16_mul(int8_to_fix16_single(outputs[6+o/2][idx_x], scale_outs[6+o/2],zero_points[6+o/2]), F16(2.));
-							py = fix16_mul(int8_to_fix16_single(outputs[6+o/2][idx_y], scale_outs[6+o/2],zero_points[6+o/2]), F16(2.));
-							if(is_pose==2){
-								idx_x = ((p*2+0)*H*W) + h*W+w;
-								idx_y = ((p*2+1)*H*W) + h*W+w;
-								idx_s = ((p*1+0)*H*W) + h*W+w;
-
-								score = fix16_logistic_activate(int8_to_fix16_single(outputs[6+o+1][idx_s], scale_outs[6+o],zero_points[6+o]));
-								px = fix16_mul(int8_to_fix16_single(outputs[6+o][idx_x], scale_outs[6+o],zero_points[6+o]), F16(2.));
-								py = fix16_mul(int8_to_fix16_single(outputs[6+o][idx_y], scale_outs[6+o],zero_points[6+o]), F16(2.));
-							}
-							px = fix16_add(px, fix16_from_int(w));
-							py = fix16_add(py, fix16_from_int(h));
-
-							px = fix16_mul(px, inv_W);
-							py = fix16_mul(py, inv_H);
-							
-							post[total_count*(C+4+is_obb+!!is_pose*51)+4+C+3*p+0] = px;
-							post[total_count*(C+4+is_obb+!!is_pose*51)+4+C+3*p+1] = py;
-							post[total_count*(C+4+is_obb+!!is_pose*51)+4+C+3*p+2] = score;							
-						}						
-					}
+		for(int hw=0; hw<H*W && total_count<max_boxes; hw++){
+			if(!valid_locations[hw])
+				continue;
+			int h = hw / W;
+			int w = hw - h*W;
+			fix16_t *xywh = post + total_count*post_sz;
+			fix16_t angle = fix16_minimum;
+			if (is_obb) {
+				int8_t angle8 = outputs[6+o/2][hw]; //assumed to be in order
+				angle = fix16_logistic_activate(int8_to_fix16_single(angle8, scale_outs[6+o/2],zero_points[6+o/2]));
+				angle = fix16_sub(angle, F16(0.25));
+				angle = fix16_mul(angle, F16(3.141592741));
+
+				xywh[4+C] = angle;
+			}
+			int8_t box[64];
+			int8_gather(box, outputs[o+1] + hw, 64, H*W);
+			ultralytics_process_box_int8(xywh, box, angle, h, w, H, W, zero_points[o+1], scale_outs[o+1]);
+			if (is_pose) {
+				// x, y and score of each keypoint, or the xy and score tensors one after the other when split
+				int8_t kpt[51];
+				int k = 6+o/2;
+				int xy_step = 3;
+				int8_t *kpt_score = kpt + 2;
+				int score_step = 3;
+				if(is_pose==2){
+					k = 6+o;
+					xy_step = 2;
+					kpt_score = kpt + 34;
+					score_step = 1;
+					int8_gather(kpt, outputs[6+o] + hw, 34, H*W);
+					int8_gather(kpt_score, outputs[6+o+1] + hw, 17, H*W);
+				} else {
+					int8_gather(kpt, outputs[6+o/2] + hw, 51, H*W);
+				}
 
-					for(int c=0; c<C; c++){
-						int8_t val = out8[c*H*W + h*W + w];
-						if(val > i8_log_odds){
-							post[total_count*(C+4+is_obb+!!is_pose*51)+4+c] = fix16_logistic_activate(int8_to_fix16_single(val,temp_scale,temp_zero));
-						} else {
-							post[total_count*(C+4+is_obb+!!is_pose*51)+4+c] = 0;
-						}
-					}
-					total_count++;
+				for(int p=0; p<17; p++){
+					fix16_t score = fix16_logistic_activate(int8_to_fix16_single(kpt_score[p*score_step], scale_outs[k],zero_points[k]));
+					fix16_t px = fix16_mul(int8_to_fix16_single(kpt[p*xy_step+0], scale_outs[k],zero_points[k]), F16(2.));
+					fix16_t py = fix16_mul(int8_to_fix16_single(kpt[p*xy_step+1], scale_outs[k],zero_points[k]), F16(2.));
+					px = fix16_add(px, fix16_from_int(w));
+					py = fix16_add(py, fix16_from_int(h));
+
+					px = fix16_mul(px, inv_W);
+					py = fix16_mul(py, inv_H);
+
+					xywh[4+C+3*p+0] = px;
+					xywh[4+C+3*p+1] = py;
+					xywh[4+C+3*p+2] = score;
 				}
 			}
+
+			for(int c=0; c<C; c++){
+				int8_t val = out8[c*H*W + hw];
+				if(val > i8_log_odds){
+					xywh[4+c] = fix16_logistic_activate(int8_to_fix16_single(val,temp_scale,temp_zero));
+				} else {
+					xywh[4+c] = 0;
+				}
+			}
+			total_count++;
 		}
 	}
 	return total_count;
 
 }
 
+int post_process_sparse_outputs(model_t *model, const char *pptype, int sparse[])
+{
+	int num_sparse = 0;
+	for(int o=0; o<(int)model_get_num_outputs(model); o++){
+		int channels = model_get_output_shape(model, o)[1];
+		sparse[o] = 0;
+		if(!strcmp(pptype, "SCRFD")){
+			sparse[o] = channels != 2;	// box and landmark maps, the confidence maps have 2
+		} else if(!strcmp(pptype, "ULTRALYTICS")){
+			sparse[o] = channels == 64;
+		} else if(!strcmp(pptype, "ULTRALYTICS_OBB")){
+			sparse[o] = channels == 64 || channels == 1;	// boxes and angles
+		} else if(!strcmp(pptype, "ULTRALYTICS_POSE")){
+			sparse[o] = channels == 64 || channels == 51 || channels == 34 || channels == 17;
+		}
+		num_sparse += sparse[o];
+	}
+	return num_sparse;
+}
+
 
 int post_process_ultra_nms(fix16_t *output, int output_boxes, int input_h, int input_w, fix16_t thresh, fix16_t overlap, fix16_box fix16_boxes[], poses_t poses[], int boxes_len, const int num_classes, const int is_obb, const int is_pose)
 {
@@ -2540,13 +2469,27 @@ int post_process_blazeface(object_t faces[],fix16_t* scores,fix16_t* points,int
 	return facesLength;
 }
 
+//called every frame with the same model, so keep its io descriptors
+//rather than walking the graph for each of them
+static model_io_info_t* pprint_io_info(model_t *model)
+{
+	static model_io_info_t* io_info = NULL;
+	if (!io_info || io_info->model != model) {
+		model_io_info_free(io_info);
+		io_info = model_io_info_init(model);
+	}
+	return io_info;
+}
+
 int pprint_post_process(const char *name, const char *pptype, model_t *model, fix16_t **o_buffers,int int8_flag, int fps)
 {
 	char label[256];
 	const int topk=5;
-	int *in_dims = model_get_input_shape(model,0);
-	int total_dims = model_get_input_dims(model,0);
-	int num_outputs = (int)model_get_num_outputs(model);
+	model_io_info_t *io = pprint_io_info(model);
+	if (!io) return -1;
+	int *in_dims = io->inputs[0].shape;
+	int total_dims = io->inputs[0].dims;
+	int num_outputs = io->num_outputs;
 	int input_h = in_dims[total_dims-2];
 	int input_w = in_dims[total_dims-1];
 	
@@ -2570,8 +2513,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		// reverse
 		fix16_t* output_buffer0=(fix16_t*)(uintptr_t)o_buffers[1];
 		fix16_t* output_buffer1=(fix16_t*)(uintptr_t)o_buffers[0];
-		int output_length0 = model_get_output_length(model, 1);
-		int output_length1 = model_get_output_length(model, 0);
+		int output_length0 = io->outputs[1].length;
+		int output_length1 = io->outputs[0].length;
 
 		int facesLength = 0;
 		if (output_length0 < output_length1) {
@@ -2646,12 +2589,12 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 
 
 		for (int o = 0; o < num_outputs; o++) {				
-			int *output_shape = model_get_output_shape(model,o);
+			int *output_shape = io->outputs[o].shape;
 			int ind = 2*(output_shape[2]/18) + (output_shape[1]/6); 
 			fix16_buffers[ind]=(fix16_t*)(uintptr_t)o_buffers[o]; //assigns output buffers by first dim ascending, second descending
 			output_buffer_int8[ind]= (int8_t*)(uintptr_t)o_buffers[o];
-			zero_points[ind]=model_get_output_zeropoint(model,o);
-			scale_outs[ind]=model_get_output_scale_fix16_value(model,o);
+			zero_points[ind]=io->outputs[o].zero_point;
+			scale_outs[ind]=io->outputs[o].scale_fix16;
 		}
 		if(int8_flag){
 			platesLength = post_process_lpd_int8(plates, MAX_PLATES, output_buffer_int8, input_w, input_h,
@@ -2698,7 +2641,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			conf = post_process_lpr_int8(output_buffer_int8, model, label);
 		}
 		else{
-			conf = post_process_lpr(fix16_buffers, model_get_output_length(model, 0), label);
+			conf = post_process_lpr(fix16_buffers, io->outputs[0].length, label);
 		}
 		printf("Plate ID: %s Recognition Score: %3.4f\n", label, fix16_to_float(conf));
 
@@ -2714,12 +2657,12 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		fix16_t scale_outs[9];
 		
 		for(int o=0; o<num_outputs; o++){
-			int *output_shape = model_get_output_shape(model,o);
+			int *output_shape = io->outputs[o].shape;
 			int ind = (output_shape[1]/8)*3 + (2-(output_shape[2]/18)); //first dim should be {2,8,20} second dim should be {9,18,36}
 			fix16_buffers[ind]=(fix16_t*)(uintptr_t)o_buffers[o]; //assigns output buffers by first dim ascending, second descending
 			output_buffer_int8[ind]= (int8_t*)(uintptr_t)o_buffers[o];
-			zero_points[ind]=model_get_output_zeropoint(model,o);
-			scale_outs[ind]=model_get_output_scale_fix16_value(model,o);
+			zero_points[ind]=io->outputs[o].zero_point;
+			scale_outs[ind]=io->outputs[o].scale_fix16;
 		}
 		if(int8_flag){
 			facesLength = post_process_scrfd_int8(faces,MAX_FACES,output_buffer_int8, zero_points, scale_outs, input_w, input_h,
@@ -2766,11 +2709,11 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		}
 	} else if (!strcmp(pptype, "CLASSIFY")){
 
-		int output_length = model_get_output_length(model, 0);
+		int output_length = io->outputs[0].length;
 		fix16_t* output_buffer0=(fix16_t*)(uintptr_t)o_buffers[0];
 		int8_t* output_buffer_int8_0=(int8_t*)(uintptr_t)o_buffers[0];
-		fix16_t f16_scale = (fix16_t)model_get_output_scale_fix16_value(model,0); // get output scale
-		int32_t zero_point = model_get_output_zeropoint(model,0); // get output zero
+		fix16_t f16_scale = io->outputs[0].scale_fix16; // get output scale
+		int32_t zero_point = io->outputs[0].zero_point; // get output zero
 		if(int8_flag){
 			post_process_classifier_int8(output_buffer_int8_0,output_length,indexes,topk);
 		}
@@ -2844,9 +2787,9 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		if(!strcmp(pptype, "YOLOV2")){ //tiny yolo v2
 			fix16_t *outputs[] = {(fix16_t*)(uintptr_t)o_buffers[0]};
 			int8_t *output_int8[] = {(int8_t*)(uintptr_t)o_buffers[0]};
-			int zero_point[] = {model_get_output_zeropoint(model,0)};
-			fix16_t f16_scale[] = {model_get_output_scale_fix16_value(model,0)};
-			int* oshape = model_get_output_shape(model,0);
+			int zero_point[] = {io->outputs[0].zero_point};
+			fix16_t f16_scale[] = {io->outputs[0].scale_fix16};
+			int* oshape = io->outputs[0].shape;
 			
 			fix16_t tiny_anchors[] ={F16(1.08),F16(1.19),F16(3.42),F16(4.41),F16(6.63),F16(11.38),F16(9.42),F16(5.11),F16(16.620001),F16(10.52)};
 			fix16_t anchors[] = {F16(1.3221),F16(1.73145),F16(3.19275),F16(4.00944),F16(5.05587),F16(8.09892),F16(9.47112),F16(4.84053),F16(11.2364),F16(10.0071)};		
@@ -2884,8 +2827,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			class_names = coco_classes;
 			fix16_t* output=(fix16_t*)(uintptr_t)o_buffers[0];
 			int8_t* output_int8 =(int8_t*)(uintptr_t)o_buffers[0];
-			fix16_t f16_scale = (fix16_t)model_get_output_scale_fix16_value(model,0); // get output scale
-			int32_t zero_point = model_get_output_zeropoint(model,0); // get output zero
+			fix16_t f16_scale = io->outputs[0].scale_fix16; // get output scale
+			int32_t zero_point = io->outputs[0].zero_point; // get output zero
 			if(int8_flag){
 				valid_boxes = post_process_ultra_nms_int8(output_int8, 8400, input_h, input_w,f16_scale,zero_point, thresh, iou, boxes, max_boxes, 80);
 			} else{
@@ -2907,7 +2850,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			int* shapes[9];
 			
 			for(int n=0; n<num_outputs; n++){
-				shapes[n] = model_get_output_shape(model,n);
+				shapes[n] = io->outputs[n].shape;
 				w_min = MIN(shapes[n][3], w_min);
 				w_max = MAX(shapes[n][3], w_max);
 			}
@@ -2921,8 +2864,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 				else if(shapes[i][1] == 1) o= o/2 + 6;			// box (otherwise class)
 				outputs_shape[o] = shapes[i];
 				outputs_int8[o] = (int8_t*)(uintptr_t)o_buffers[i];
-				zero_points[o]=model_get_output_zeropoint(model,i);
-				scale_outs[o]=model_get_output_scale_fix16_value(model,i);
+				zero_points[o]=io->outputs[i].zero_point;
+				scale_outs[o]=io->outputs[i].scale_fix16;
 			}			
 			
 			const int max_detections = 200;
@@ -2945,7 +2888,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			int32_t w_max = 0;			
 			int* shapes[3];
 			for(int n=0; n<num_outputs; n++){
-				shapes[n] = model_get_output_shape(model,n);
+				shapes[n] = io->outputs[n].shape;
 				w_min = MIN(shapes[n][3], w_min);
 				w_max = MAX(shapes[n][3], w_max);
 			}
@@ -2959,8 +2902,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 				indices[o]=i;
 				outputs[o] = (fix16_t*)(uintptr_t)o_buffers[i];
 				outputs_int8[o] = (int8_t*)(uintptr_t)o_buffers[i];
-				zero_points[o] = model_get_output_zeropoint(model,i);
-				scale_outs[o]=model_get_output_scale_fix16_value(model,i);
+				zero_points[o] = io->outputs[i].zero_point;
+				scale_outs[o]=io->outputs[i].scale_fix16;
 			}
 
 			//set masks
@@ -2979,7 +2922,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 
 			yolo_info_t cfg[num_outputs];
 			for (int i = 0; i < num_outputs; i++) {				
-				int* oshape = model_get_output_shape(model,indices[i]);
+				int* oshape = io->outputs[indices[i]].shape;
 				yolo_info_t temp_cfg = {
 					.version = ver,
 					.input_dims = {in_dims[1], in_dims[2], in_dims[3]},
@@ -3017,7 +2960,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			int32_t w_max = 0;			
 			int* shapes[3];
 			for(int n=0; n<num_outputs; n++){
-				shapes[n] = model_get_output_shape(model,n);
+				shapes[n] = io->outputs[n].shape;
 				w_min = MIN(shapes[n][3], w_min);
 				w_max = MAX(shapes[n][3], w_max);
 			}
@@ -3030,8 +2973,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 				indices[o]=i;
 				outputs[o] = (fix16_t*)(uintptr_t)o_buffers[i];
 				outputs_int8[o] = (int8_t*)(uintptr_t)o_buffers[i];
-				zero_points[o] = model_get_output_zeropoint(model,i);
-				scale_outs[o]=model_get_output_scale_fix16_value(model,i);
+				zero_points[o] = io->outputs[i].zero_point;
+				scale_outs[o]=io->outputs[i].scale_fix16;
 			}
 
 			fix16_t anchors[] = {F16(10),F16(13),F16(16),F16(30),F16(33),F16(23),F16(30),F16(61),F16(62),F16(45),F16(59),F16(119),F16(116),F16(90),F16(156),F16(198),F16(373),F16(326)};
@@ -3043,7 +2986,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			
 			yolo_info_t cfg[num_outputs];
 			for (int i = 0; i < num_outputs; i++) {				
-				int* oshape = model_get_output_shape(model,indices[i]);
+				int* oshape = io->outputs[indices[i]].shape;
 				yolo_info_t temp_cfg = {
 					.version = ver,
 					.input_dims = {in_dims[1], in_dims[2], in_dims[3]},
@@ -3079,7 +3022,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			int32_t zero_point[12];// = model_get_output_zeropoint(model,0); // get output zero
 			if (is_torch) {
 				for(int o=0;o<12;++o){
-				    int* oshape = model_get_output_shape(model,o);
+				    int* oshape = io->outputs[o].shape;
 				    int idx;
 				    if (oshape[2] == 1) {
 					    idx = 5*2;
@@ -3099,8 +3042,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 				    }
 				    output_buffers[idx]=(fix16_t*)(uintptr_t)o_buffers[o];
 				    output_buffers_int8[idx] = (int8_t*)(uintptr_t)o_buffers[o];
-				    f16_scale[idx] = model_get_output_scale_fix16_value(model,o);
-				    zero_point[idx] = model_get_output_zeropoint(model,o);
+				    f16_scale[idx] = io->outputs[o].scale_fix16;
+				    zero_point[idx] = io->outputs[o].zero_point;
 				}
 				if(int8_flag){
 				
@@ -3165,7 +3108,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		const int NUM_KEYPOINTS=17;
 		poses_t r_poses[MAX_TOTALPOSE];
 		
-		int *output_dims = model_get_output_shape(model,1);
+		int *output_dims = io->outputs[1].shape;
 		int poseScoresH = output_dims[2]; 
 		int poseScoresW = output_dims[3]; 	
 		
@@ -3185,8 +3128,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			displacementsFwd_8 = (int8_t*)(uintptr_t)o_buffers[2];
 			displacementsBwd_8 = (int8_t*)(uintptr_t)o_buffers[3];
 			for(int o=0; o<num_outputs; o++){
-				zero_points[o] = model_get_output_zeropoint(model,o);
-				scale_outs[o]=model_get_output_scale_fix16_value(model,o);
+				zero_points[o] = io->outputs[o].zero_point;
+				scale_outs[o]=io->outputs[o].scale_fix16;
 			}
 			pose_count = decodeMultiplePoses_int8(r_poses,scores_8,offsets_8,displacementsFwd_8,displacementsBwd_8, outputStride, MAX_TOTALPOSE, scoreThreshold, nmsRadius, minPoseScore,poseScoresH,poseScoresW,zero_points,scale_outs); //actualpostprocess code
 		}
@@ -3205,7 +3148,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		imageH = 273; //default img input dims
 		imageW = 481; //default img input dims
 		
-		int *model_dims = model_get_input_shape(model,0);
+		int *model_dims = io->inputs[0].shape;
 		int modelInputH = model_dims[2];
 		int modelInputW = model_dims[3];
 		fix16_t scale_Y = fix16_div(fix16_from_int(imageH),fix16_from_int(modelInputH));
@@ -3259,7 +3202,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		int* shapes[num_outputs];
 		int split = num_outputs == 12 ? 2:1; //is_pose flag being set by the split
 		for(int n=0; n<num_outputs; n++){
-			shapes[n] = model_get_output_shape(model,n);
+			shapes[n] = io->outputs[n].shape;
 			w_min = MIN(shapes[n][3], w_min);
 			w_max = MAX(shapes[n][3], w_max);
 		}
@@ -3274,8 +3217,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			if(shapes[i][1]==17) o = 6 +o+1;			// box (otherwise class)
 			outputs_shape[o] = shapes[i];
 			outputs_int8[o] = (int8_t*)(uintptr_t)o_buffers[i];
-			zero_points[o]=model_get_output_zeropoint(model,i);
-			scale_outs[o]=model_get_output_scale_fix16_value(model,i);
+			zero_points[o]=io->outputs[i].zero_point;
+			scale_outs[o]=io->outputs[i].scale_fix16;
 		}	
 		const int max_detections = 200;
 		fix16_t post_buffer[max_detections*(4+1+17*3)];
@@ -3291,7 +3234,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		imageH = 1080; //default img feed dims
 		imageW = 1920; //default img feed dims
 		fix16_t kp_thresh = F16(0.9);
-		int *model_dims = model_get_input_shape(model,0);
+		int *model_dims = io->inputs[0].shape;
 		int modelInputH = model_dims[2];
 		int modelInputW = model_dims[3];
 		fix16_t scale_Y = fix16_div(fix16_from_int(imageH),fix16_from_int(modelInputH));
@@ -3404,7 +3347,7 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 		int32_t w_max = 0;			// maximum width must be stride8
 		int* shapes[6+3];
 		for(int n=0; n<6+3; n++){
-			shapes[n] = model_get_output_shape(model,n);
+			shapes[n] = io->outputs[n].shape;
 			w_min = MIN(shapes[n][3], w_min);
 			w_max = MAX(shapes[n][3], w_max);
 		}
@@ -3417,8 +3360,8 @@ int pprint_post_process(const char *name, const char *pptype, model_t *model, fi
 			if(shapes[i][1]==1) o=6+o/2;			// angles
 			outputs_shape[o] = shapes[i];
 			outputs_int8[o] = (int8_t*)(uintptr_t)o_buffers[i];
-			zero_points[o]=model_get_output_zeropoint(model,i);
-			scale_outs[o]=model_get_output_scale_fix16_value(model,i);
+			zero_points[o]=io->outputs[i].zero_point;
+			scale_outs[o]=io->outputs[i].scale_fix16;
 		}
 		const int max_detections = 4000;
 		fix16_t post_buffer[max_detections*4+15+1];
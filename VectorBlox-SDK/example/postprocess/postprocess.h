@@ -76,6 +76,7 @@ typedef struct {
 
 void reverse(fix16_t* output_buffer[], int len);
 uint32_t fletcher32(const uint16_t *data, size_t len);
+// writes io.vbxd with model_dump_io(), for host-c/vbx-dump -j to turn into io.json
 void print_json(model_t* model,vbx_cnn_io_ptr_t* io_buffers,int use_int8);
 void preprocess_inputs(uint8_t* input, fix16_t scale, int32_t zero_point, int input_length,int int8_flag);
 typedef void (*file_write)(const char*,int);
@@ -144,6 +145,16 @@ int post_process_ultra_nms(fix16_t *output, int output_boxes, int input_h, int i
  * @return int Number of detected boxes
  */
 int post_process_ultra_int8(int8_t **outputs, int* outputs_shape[], fix16_t *post, fix16_t thresh, int zero_points[], fix16_t scale_outs[], const int max_boxes, const int is_obb, const int is_pose, int num_outputs);
+/**
+ * @brief Marks the outputs that post_process_ultra_int8 and post_process_scrfd_int8 read only at the cells that pass the score threshold,
+ * the box, angle and keypoint tensors. The rest are read whole, so they are the ones worth copying out of DMA memory
+ * 
+ * @param model Network model
+ * @param pptype Post-processing type, as given to pprint_post_process
+ * @param sparse Set to 1 for each output read sparsely, 0 otherwise
+ * @return int Number of outputs read sparsely
+ */
+int post_process_sparse_outputs(model_t *model, const char *pptype, int sparse[]);
 /**
  * @brief Post-processing for Yolov2/V3/V4/V5. Returns number of detected objects, along with  boxes containing coordinates, confidence, and class information.
  * 
@@ -205,6 +216,7 @@ int post_process_lpd_int8(object_t objects[],int max_objects, int8_t *detectOutp
 int post_process_lpd(object_t plates[],int max_plates, fix16_t *detectOutputs[9], int image_width, int image_height,
                             fix16_t confidence_threshold, fix16_t nms_threshold,int detectNumOutputs);
 void int8_to_fix16(fix16_t* output, int8_t* input, int size, fix16_t f16_scale, int32_t zero_point);
+void int8_gather(int8_t* output, const int8_t* input, int count, int stride);
 fix16_t int8_to_fix16_single(int8_t input,fix16_t scale, int32_t zero_point);
 fix16_t post_process_lpr_int8(int8_t *output, model_t *model, char *label);
 fix16_t post_process_lpr(fix16_t *output, int output_length, char *label);
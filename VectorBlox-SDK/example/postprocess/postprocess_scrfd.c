@@ -1,6 +1,14 @@
 #include "postprocess.h"
 #include <stdio.h>
 
+// the largest int8 value that converts to no more than threshold, so a value above
+// it is exactly one whose fix16 score would pass
+static int int8_threshold(fix16_t threshold, fix16_t scale, int32_t zero_point){
+    int q = -129;
+    while(q < 127 && int8_to_fix16_single((int8_t)(q+1),scale,zero_point) <= threshold)
+        q++;
+    return q;
+}
 
 int post_process_scrfd_int8(object_t faces[],int max_faces, int8_t *network_outputs[9],int zero_points[], fix16_t scale_outs[], 
                             int image_width, int image_height,
@@ -24,36 +32,39 @@ int post_process_scrfd_int8(object_t faces[],int max_faces, int8_t *network_outp
     int8_t** locMaps = &network_outputs[3];
     int8_t** landMaps = &network_outputs[6];
 
-    int scoresLength = 2*(mapPixels[0]+mapPixels[1]+mapPixels[2]);
-    fix16_t scores[scoresLength]; // this could be stored as int16, since the values should be <1
+    // confidences are compared in the int8 domain and only those that pass converted;
+    // the location and landmark maps are then read at just the best of them
+    int order[maxPreDetects];   // indices into the three maps' scores, as if one array
+    fix16_t orderScores[maxPreDetects];
+    int orderLength = 0;
     int s = 0;  // index to scores
     for(int mapNum=0; mapNum<3; mapNum++){
         int8_t* confMap = confMaps[mapNum];
         int pixels = mapPixels[mapNum];
-        for(int n=0; n<pixels*2; n++){
-            scores[s++] = int8_to_fix16_single((int8_t)confMap[n],scale_outs[mapNum],zero_points[mapNum]); //standardize scores
-        }
-    }
-
-    // add scores above threshold to a sorted list of indices (indices of highest scores first)
-    int order[maxPreDetects];
-    int orderLength = 0;
-    for(int n=0; n<scoresLength; n++){
-        if(scores[n] > confidence_threshold){
+        int threshold8 = int8_threshold(confidence_threshold,scale_outs[mapNum],zero_points[mapNum]);
+        for(int c=0; c<pixels*2; c++, s++){
+            if(confMap[c] <= threshold8)
+                continue;
+            fix16_t score = int8_to_fix16_single(confMap[c],scale_outs[mapNum],zero_points[mapNum]);
+            // add to a sorted list of indices (indices of highest scores first)
             int i=0;
             while(i<orderLength){ // find the insertion index
-                if(scores[n] > scores[order[i]]){
-		            int i_start = orderLength < maxPreDetects-1 ? orderLength : maxPreDetects-1;
-                    for(int i2=i_start; i2>i; i2--) // move down all lower elements
+                if(score > orderScores[i]){
+                    int i_start = orderLength < maxPreDetects-1 ? orderLength : maxPreDetects-1;
+                    for(int i2=i_start; i2>i; i2--){ // move down all lower elements
                         order[i2] = order[i2-1];
-                    order[i] = n;
-		            if (orderLength < maxPreDetects) orderLength++;
-                        break;
+                        orderScores[i2] = orderScores[i2-1];
+                    }
+                    order[i] = s;
+                    orderScores[i] = score;
+                    if (orderLength < maxPreDetects) orderLength++;
+                    break;
                 }
                 i++;
             }
             if(i==orderLength && orderLength<maxPreDetects){   // if not inserted and there's room, then insert at the end
-                order[i] = n;
+                order[i] = s;
+                orderScores[i] = score;
                 orderLength++;
             }
         }
@@ -61,7 +72,7 @@ int post_process_scrfd_int8(object_t faces[],int max_faces, int8_t *network_outp
     int facesLength = 0;
     for(int n=0; n<orderLength; n++){
         int ind = order[n];
-        faces[facesLength].detect_score = scores[ind];
+        faces[facesLength].detect_score = orderScores[n];
 
         // get map number from index
         int mapNum = 0;
@@ -92,11 +103,11 @@ int post_process_scrfd_int8(object_t faces[],int max_faces, int8_t *network_outp
         // python anchor is equal to [anchX, anchY]
         
         // get box location data
-        fix16_t location[4];  //int8
-        int8_t* locPtr = &locMaps[mapNum][anchNum*4*pixels+ind];
+        fix16_t location[4];
+        int8_t loc8[4];
+        int8_gather(loc8, &locMaps[mapNum][anchNum*4*pixels+ind], 4, pixels);
         for(int nLoc=0; nLoc<4; nLoc++){
-            location[nLoc] = int8_to_fix16_single(*locPtr,scale_outs[3+mapNum],zero_points[3+mapNum]) * stride;
-            locPtr += pixels;
+            location[nLoc] = int8_to_fix16_single(loc8[nLoc],scale_outs[3+mapNum],zero_points[3+mapNum]) * stride;
         }
         // [left, top, right, bottom]
         faces[facesLength].box[0] = anchX - location[0];
@@ -116,13 +127,12 @@ int post_process_scrfd_int8(object_t faces[],int max_faces, int8_t *network_outp
         if(!passNms)
             continue;
         // landmarks
-        int8_t* landPtr = &landMaps[mapNum][anchNum*10*pixels+ind];    // elements are every "pixels" elements TODO convert to fix16
+        int8_t land8[10];   // elements are every "pixels" elements in the map
+        int8_gather(land8, &landMaps[mapNum][anchNum*10*pixels+ind], 10, pixels);
         fix16_t stride_16 = fix16_from_int(stride);
         for(int p=0; p<5; p++){
-            faces[facesLength].points[p][0] = anchX + fix16_mul(int8_to_fix16_single(*landPtr,scale_outs[6+mapNum],zero_points[6+mapNum]), stride_16);
-            landPtr += pixels;
-            faces[facesLength].points[p][1] = anchY + fix16_mul(int8_to_fix16_single(*landPtr,scale_outs[6+mapNum],zero_points[6+mapNum]), stride_16);
-            landPtr += pixels;
+            faces[facesLength].points[p][0] = anchX + fix16_mul(int8_to_fix16_single(land8[2*p],scale_outs[6+mapNum],zero_points[6+mapNum]), stride_16);
+            faces[facesLength].points[p][1] = anchY + fix16_mul(int8_to_fix16_single(land8[2*p+1],scale_outs[6+mapNum],zero_points[6+mapNum]), stride_16);
         }
 
         facesLength++;
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string>
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_dump.h"
 #include "postprocess.h"
 
 #define TEST_OUT 0
@@ -155,7 +156,9 @@ int main(int argc, char** argv){
 	}
 	printf("CHECKSUM = 0x%08x\n",checksum);
 	if(WRITE_OUT){
-		print_json(model, io_buffers, INT8FLAG);
+		if (model_dump_io(model, io_buffers, INT8FLAG, "io.vbxd") != 0) {
+			fprintf(stderr, "Unable to write io.vbxd\n");
+		}
 	}
 	if (argc>2){
 		if(std::string(argv[2]) != "TEST_DATA"){
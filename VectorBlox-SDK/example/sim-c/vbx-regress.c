@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_wait.h"
+#include "postprocess.h"
+
+#define MAX_MODELS 256
+#define MAX_NAME 256
+
+typedef struct {
+	char name[MAX_NAME];
+	int status;          // 0 pass, -1 could not run, 1 outputs outside tolerance
+	uint32_t checksum;   // fletcher32 of the outputs, as run-model prints
+	int32_t max_diff;    // largest difference from the embedded test output
+	int mismatches;      // elements differing by more than the tolerance
+	uint32_t p50_us, p90_us, p99_us, max_us;
+} result_t;
+
+static const char* status_name(int status) {
+	return status == 0 ? "pass" : status > 0 ? "FAIL" : "ERROR";
+}
+
+static const char* base_name(const char* path) {
+	const char* slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+static model_t* load_model(vbx_cnn_t* vbx_cnn, const char* filename) {
+#if VBX_SOC_DRIVER
+	return vbx_cnn_model_load(vbx_cnn, filename);
+#else
+	// the simulator runs models from ordinary memory
+	FILE* model_file = fopen(filename, "r");
+	if (!model_file) {
+		return NULL;
+	}
+	fseek(model_file, 0, SEEK_END);
+	long file_size = ftell(model_file);
+	fseek(model_file, 0, SEEK_SET);
+	model_t* model = (model_t*)malloc(file_size);
+	if (!model || fread(model, 1, file_size, model_file) != (size_t)file_size ||
+			model_get_data_bytes(model) != (size_t)file_size) {
+		fclose(model_file);
+		free(model);
+		return NULL;
+	}
+	fclose(model_file);
+	model_t* resized = (model_t*)realloc(model, model_get_allocate_bytes(model));
+	if (!resized) {
+		free(model);
+	}
+	return resized;
+#endif
+}
+
+static void free_model(vbx_cnn_t* vbx_cnn, model_t* model) {
+#if VBX_SOC_DRIVER
+	vbx_free_dma_buffer(vbx_cnn, model);
+#else
+	free(model);
+#endif
+}
+
+static void* alloc_output(vbx_cnn_t* vbx_cnn, size_t bytes) {
+#if VBX_SOC_DRIVER
+	return vbx_allocate_dma_buffer(vbx_cnn, bytes, 0);
+#else
+	return malloc(bytes);
+#endif
+}
+
+static void free_output(vbx_cnn_t* vbx_cnn, void* buffer) {
+#if VBX_SOC_DRIVER
+	vbx_free_dma_buffer(vbx_cnn, buffer);
+#else
+	free(buffer);
+#endif
+}
+
+static int32_t element(const void* data, vbx_cnn_calc_type_e datatype, size_t i) {
+	switch (datatype) {
+	case VBX_CNN_CALC_TYPE_UINT8: return ((const uint8_t*)data)[i];
+	case VBX_CNN_CALC_TYPE_INT8: return ((const int8_t*)data)[i];
+	case VBX_CNN_CALC_TYPE_INT16: return ((const int16_t*)data)[i];
+	default: return ((const int32_t*)data)[i];
+	}
+}
+
+static int compare_u32(const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t* sorted, int n, int pct) {
+	int i = (n * pct + 99) / 100 - 1;
+	return sorted[i < 0 ? 0 : i];
+}
+
+// Runs the model on its embedded test input iterations times, checks the
+// first run's outputs against the embedded test output and times them all.
+static int run_model(vbx_cnn_t* vbx_cnn, const char* filename, int iterations, int32_t tolerance, result_t* result) {
+	memset(result, 0, sizeof(*result));
+	snprintf(result->name, sizeof(result->name), "%s", base_name(filename));
+	result->status = -1;
+
+	model_t* model = load_model(vbx_cnn, filename);
+	if (!model) {
+		fprintf(stderr, "Unable to correctly read %s\n", filename);
+		return -1;
+	}
+	model_io_info_t* io_info = NULL;
+	uint32_t* times_us = (uint32_t*)malloc(iterations * sizeof(uint32_t));
+	vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS] = {0};
+	int num_inputs = model_get_num_inputs(model);
+	int num_outputs = model_get_num_outputs(model);
+	if (model_check_sanity(model) != 0 || num_inputs + num_outputs > MAX_IO_BUFFERS || !times_us ||
+			!(io_info = model_io_info_init(model))) {
+		fprintf(stderr, "Model %s is not sane\n", filename);
+		goto done;
+	}
+	for (int i = 0; i < num_inputs; i++) {
+		io_buffers[i] = (vbx_cnn_io_ptr_t)model_get_test_input(model, i);
+	}
+	for (int o = 0; o < num_outputs; o++) {
+		io_buffers[num_inputs + o] = (vbx_cnn_io_ptr_t)alloc_output(vbx_cnn, io_info->outputs[o].length * sizeof(uint32_t));
+		if (!io_buffers[num_inputs + o]) {
+			fprintf(stderr, "Unable to allocate outputs of %s\n", filename);
+			goto done;
+		}
+	}
+
+	for (int n = 0; n < iterations; n++) {
+		uint64_t start_ns = vbx_cnn_wait_time_ns();
+		int err = vbx_cnn_model_start(vbx_cnn, model, io_buffers);
+		while (err == 0 && (err = vbx_cnn_model_poll(vbx_cnn)) > 0);
+		if (err < 0) {
+			fprintf(stderr, "%s failed with error code: %d\n", filename, vbx_cnn_get_error_val(vbx_cnn));
+			goto done;
+		}
+		times_us[n] = (vbx_cnn_wait_time_ns() - start_ns) / 1000;
+		if (n > 0) {
+			continue;
+		}
+		result->status = 0;
+		for (int o = 0; o < num_outputs; o++) {
+			const vbx_cnn_tensor_info_t* t = &io_info->outputs[o];
+			const void* out = (const void*)io_buffers[num_inputs + o];
+			const void* golden = model_get_test_output(model, o);
+			result->checksum ^= fletcher32((const uint16_t*)out, t->bytes / sizeof(uint16_t));
+			for (size_t i = 0; i < t->length; i++) {
+				int32_t diff = abs(element(out, t->datatype, i) - element(golden, t->datatype, i));
+				if (diff > result->max_diff) {
+					result->max_diff = diff;
+				}
+				if (diff > tolerance) {
+					result->mismatches++;
+					result->status = 1;
+				}
+			}
+		}
+	}
+	qsort(times_us, iterations, sizeof(uint32_t), compare_u32);
+	result->p50_us = percentile(times_us, iterations, 50);
+	result->p90_us = percentile(times_us, iterations, 90);
+	result->p99_us = percentile(times_us, iterations, 99);
+	result->max_us = times_us[iterations - 1];
+
+done:
+	for (int o = 0; o < num_outputs && num_inputs + o < MAX_IO_BUFFERS; o++) {
+		if (io_buffers[num_inputs + o]) {
+			free_output(vbx_cnn, (void*)io_buffers[num_inputs + o]);
+		}
+	}
+	if (io_info) {
+		model_io_info_free(io_info);
+	}
+	free(times_us);
+	free_model(vbx_cnn, model);
+	return result->status;
+}
+
+static int is_model(const char* name) {
+	size_t len = strlen(name);
+	return len > 5 && !strcmp(name + len - 5, ".vnnx");
+}
+
+static int compare_names(const void* a, const void* b) {
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Adds path, or every .vnnx in it if it is a directory, to the model list.
+static int add_models(const char* path, char** models, int num_models) {
+	struct stat st;
+	if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		if (num_models < MAX_MODELS) {
+			models[num_models++] = strdup(path);
+		}
+		return num_models;
+	}
+	DIR* dir = opendir(path);
+	if (!dir) {
+		return num_models;
+	}
+	int first = num_models;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) && num_models < MAX_MODELS) {
+		if (is_model(entry->d_name)) {
+			char* model_path = (char*)malloc(strlen(path) + strlen(entry->d_name) + 2);
+			sprintf(model_path, "%s/%s", path, entry->d_name);
+			models[num_models++] = model_path;
+		}
+	}
+	closedir(dir);
+	qsort(models + first, num_models - first, sizeof(char*), compare_names);
+	return num_models;
+}
+
+// A baseline is one line per model: name, status, checksum and latency percentiles.
+static int write_baseline(const char* filename, const result_t* results, int num_results) {
+	FILE* f = fopen(filename, "w");
+	if (!f) {
+		return -1;
+	}
+	fprintf(f, "# model status checksum p50_us p90_us p99_us max_us\n");
+	for (int r = 0; r < num_results; r++) {
+		const result_t* res = results + r;
+		fprintf(f, "%s %d 0x%08x %u %u %u %u\n", res->name, res->status, res->checksum,
+				res->p50_us, res->p90_us, res->p99_us, res->max_us);
+	}
+	return fclose(f);
+}
+
+static int read_baseline(const char* filename, result_t* baseline) {
+	FILE* f = fopen(filename, "r");
+	if (!f) {
+		return -1;
+	}
+	char line[512];
+	int num_baseline = 0;
+	while (fgets(line, sizeof(line), f) && num_baseline < MAX_MODELS) {
+		result_t* res = baseline + num_baseline;
+		memset(res, 0, sizeof(*res));
+		if (line[0] != '#' && sscanf(line, "%255s %d %x %u %u %u %u", res->name, &res->status, &res->checksum,
+					&res->p50_us, &res->p90_us, &res->p99_us, &res->max_us) == 7) {
+			num_baseline++;
+		}
+	}
+	fclose(f);
+	return num_baseline;
+}
+
+// Reports how each result differs from the baseline, returning the number of regressions.
+// Outputs that change but stay within a nonzero tolerance are reported, not counted.
+static int diff_baseline(const result_t* results, int num_results, const result_t* baseline, int num_baseline,
+		int32_t tolerance, int slower_pct) {
+	int regressions = 0;
+	for (int r = 0; r < num_results; r++) {
+		const result_t* res = results + r;
+		const result_t* base = NULL;
+		for (int b = 0; b < num_baseline && !base; b++) {
+			if (!strcmp(baseline[b].name, res->name)) {
+				base = baseline + b;
+			}
+		}
+		if (!base) {
+			printf("%-32s new model, not in baseline\n", res->name);
+			continue;
+		}
+		if (res->status != base->status) {
+			printf("%-32s was %s, now %s\n", res->name, status_name(base->status), status_name(res->status));
+			regressions += res->status != 0;
+		}
+		if (res->status >= 0 && base->status >= 0 && res->checksum != base->checksum) {
+			printf("%-32s outputs changed, checksum 0x%08x was 0x%08x\n", res->name, res->checksum, base->checksum);
+			regressions += tolerance == 0;
+		}
+		if (res->status >= 0 && base->status >= 0 &&
+				(uint64_t)res->p50_us * 100 > (uint64_t)base->p50_us * (100 + slower_pct)) {
+			printf("%-32s slower, p50 %u us was %u us (%+.1f%%)\n", res->name, res->p50_us, base->p50_us,
+					base->p50_us ? 100.0 * res->p50_us / base->p50_us - 100.0 : 100.0);
+			regressions++;
+		}
+	}
+	for (int b = 0; b < num_baseline; b++) {
+		int found = 0;
+		for (int r = 0; r < num_results && !found; r++) {
+			found = !strcmp(baseline[b].name, results[r].name);
+		}
+		if (!found) {
+			printf("%-32s in baseline, not run\n", baseline[b].name);
+		}
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv) {
+	int iterations = 10;
+	int32_t tolerance = 0;
+	int slower_pct = 10;
+	const char* baseline_file = NULL;
+	const char* write_file = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:t:b:w:p:")) != -1) {
+		switch (opt) {
+		case 'n': iterations = atoi(optarg); break;
+		case 't': tolerance = atoi(optarg); break;
+		case 'b': baseline_file = optarg; break;
+		case 'w': write_file = optarg; break;
+		case 'p': slower_pct = atoi(optarg); break;
+		default: optind = argc + 1; break;
+		}
+	}
+	if (optind >= argc || iterations < 1) {
+		fprintf(stderr,
+				"Usage: %s [-n ITERATIONS] [-t TOLERANCE] [-b BASELINE] [-w BASELINE] [-p SLOWER_PCT] MODEL_DIR|MODEL.vnnx...\n"
+				"   runs every model on its embedded test input and checks the outputs against its test output\n"
+				"   -t allows outputs to differ by TOLERANCE quantized steps (default 0, bit-exact)\n"
+				"   -b reports changes from BASELINE, -w writes the results as a new BASELINE\n"
+				"   -p is how much slower than the baseline p50 a model may get (default 10%%)\n",
+				argv[0]);
+		return 1;
+	}
+
+	// NULL: the simulator has no registers and the SoC driver finds the core itself
+	vbx_cnn_t* vbx_cnn = vbx_cnn_init(NULL);
+	if (!vbx_cnn) {
+		fprintf(stderr, "Unable to initialize vbx_cnn. Exiting\n");
+		return 1;
+	}
+
+	char* models[MAX_MODELS];
+	int num_models = 0;
+	for (int a = optind; a < argc; a++) {
+		num_models = add_models(argv[a], models, num_models);
+	}
+	result_t* results = (result_t*)calloc(num_models + 1, sizeof(result_t));
+	int failures = 0;
+	printf("%-32s %-6s %-10s %8s %6s %8s %8s %8s %8s\n", "model", "status", "checksum", "max_diff", "diffs",
+			"p50_us", "p90_us", "p99_us", "max_us");
+	for (int m = 0; m < num_models; m++) {
+		result_t* res = results + m;
+		failures += run_model(vbx_cnn, models[m], iterations, tolerance, res) != 0;
+		printf("%-32s %-6s 0x%08x %8d %6d %8u %8u %8u %8u\n", res->name, status_name(res->status), res->checksum,
+				res->max_diff, res->mismatches, res->p50_us, res->p90_us, res->p99_us, res->max_us);
+		free(models[m]);
+	}
+	printf("%d of %d models match their test output\n", num_models - failures, num_models);
+
+	int regressions = 0;
+	if (baseline_file) {
+		result_t* baseline = (result_t*)malloc(MAX_MODELS * sizeof(result_t));
+		int num_baseline = read_baseline(baseline_file, baseline);
+		if (num_baseline < 0) {
+			fprintf(stderr, "Unable to read baseline %s\n", baseline_file);
+			regressions = 1;
+		} else {
+			regressions = diff_baseline(results, num_models, baseline, num_baseline, tolerance, slower_pct);
+			printf("%d regressions against %s\n", regressions, baseline_file);
+		}
+		free(baseline);
+	}
+	if (write_file && write_baseline(write_file, results, num_models) != 0) {
+		fprintf(stderr, "Unable to write baseline %s\n", write_file);
+		regressions++;
+	}
+	free(results);
+	return failures || regressions ? 2 : 0;
+}
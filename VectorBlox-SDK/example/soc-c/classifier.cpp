@@ -1,6 +1,9 @@
 #include "classifier.h"
 #include "postprocess.h"
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_batch.h"
+#include "vbx_cnn_trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,7 +12,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
-#include "pdma/pdma_helpers.h"
+#include "pdma_helpers.h"
 #include <cassert>
 #include <limits.h>
 
@@ -28,18 +31,19 @@ extern "C" int resize_image(uint8_t *image_in, int in_w, int in_h,
 // Global state variables
 static vbx_cnn_t *vbx_cnn = NULL;
 static model_t *model = NULL;
-static int8_t* pdma_mmap_ptr = NULL;
-static uint64_t pdma_phys_base = 0;
-static int32_t pdma_channel = -1;
+static pdma_window_t* pdma_window = NULL;
+static pdma_async_t* pdma_engine = NULL;
+static pdma_copy_t output_copy;
 static vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS];
+// rows of io buffers for classifier_predict_batch, the first being io_buffers
+static vbx_cnn_io_ptr_t batch_io_sets[CLASSIFIER_MAX_BATCH * MAX_IO_BUFFERS];
+static int batch_sets_allocated = 0;
+static vbx_cnn_queue_t *queue = NULL;
+static vbx_cnn_wait_t *model_wait = NULL;
 static int is_initialized = 0;
 
 // --- Internal Helper Functions ---
 
-static inline void* virt_to_phys(vbx_cnn_t* vbx_cnn, void* virt){
-    return (char*)(virt) + vbx_cnn->dma_phys_trans_offset;
-}
-
 #if USE_INTERRUPTS
 static void enable_interrupt(vbx_cnn_t *vbx_cnn){
     uint32_t reenable = 1;
@@ -50,21 +54,6 @@ static void enable_interrupt(vbx_cnn_t *vbx_cnn){
 }
 #endif
 
-static uint64_t internal_pdma_mmap(int total_size){
-    char cdev[256] = "/dev/udmabuf-ddr-nc0";
-    uint64_t ddrc_phyadr = get_phy_addr(cdev);  
-    int32_t fdc = open(cdev, O_RDWR); 
-    off_t oft = 0;
-    pdma_mmap_ptr = (int8_t *)mmap(NULL, total_size*sizeof(int8_t), PROT_READ | PROT_WRITE,  MAP_SHARED, fdc, oft);
-    assert(pdma_mmap_ptr != NULL);
-    return ddrc_phyadr + oft;
-}
-
-static int32_t internal_pdma_ch_transfer(uint64_t output_data_phys, void* source_buffer, int offset, int size, vbx_cnn_t *vbx_cnn, int32_t channel){
-    uint64_t srcbuf = (uint64_t)(uintptr_t)virt_to_phys(vbx_cnn, source_buffer);
-    return pdma_ch_cpy(output_data_phys + offset, srcbuf, size, channel);
-}
-
 static void* read_and_resize_image(const char* filename, const int channels, const int height, const int width, int use_bgr){
     unsigned char* image = NULL;
     int h, w;
@@ -105,41 +94,87 @@ static void* read_and_resize_image(const char* filename, const int channels, con
     return resized_planar_img;
 }
 
-static model_t *internal_read_model_file(vbx_cnn_t *vbx_cnn, const char *filename) {
-    FILE *model_file = fopen(filename, "r");
-    if (model_file == NULL) return NULL;
-
-    fseek(model_file, 0, SEEK_END);
-    int file_size = ftell(model_file);
-    fseek(model_file, 0, SEEK_SET);
-
-    model_t *temp_model = (model_t *)malloc(file_size);
-    int size_read = fread(temp_model, 1, file_size, model_file);
-    fclose(model_file);
-
-    if (size_read != file_size) {
-        free(temp_model);
-        return NULL;
+// inputs then outputs, for one run of the model
+static int allocate_io_set(vbx_cnn_io_ptr_t *set){
+    for(unsigned i = 0; i < model_get_num_inputs(model); ++i){
+        set[i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer_flags(vbx_cnn, model_get_input_length(model,i)*sizeof(uint8_t), 1, 0);
+        if(!set[i]){
+            fprintf(stderr, "Error: Input buffer allocation failed\n");
+            return -1;
+        }
+    }
+    for (unsigned o = 0; o < model_get_num_outputs(model); ++o) {
+        set[model_get_num_inputs(model) + o] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(
+                vbx_cnn, model_get_output_length(model, o) * sizeof(uint32_t), 0);
+        if(!set[model_get_num_inputs(model) + o]){
+             fprintf(stderr, "Error: Output buffer allocation failed\n");
+             return -1;
+        }
     }
+    return 0;
+}
 
-    int model_data_size = model_get_data_bytes(temp_model);
-    int model_allocate_size = model_get_allocate_bytes(temp_model);
+// decode and resize the image into the model's input buffer
+static int load_input(const char *image_filename, vbx_cnn_io_ptr_t input){
+    int input_idx = 0; 
+    int dims = model_get_input_dims(model, input_idx);
+    int* input_shape = model_get_input_shape(model, input_idx);
+    int input_length = model_get_input_length(model, input_idx);
     
-    if (model_allocate_size < model_data_size) {
-         free(temp_model);
-         return NULL;
+    int h = input_shape[dims-2];
+    int w = input_shape[dims-1];
+    
+    vbx_cnn_trace_begin("read image");
+    void* read_buffer = read_and_resize_image(image_filename, 3, h, w, 0); // 0 = RGB
+    vbx_cnn_trace_end("read image");
+    if (!read_buffer) {
+        // Only error if pointer is NULL
+        fprintf(stderr, "Error: Failed to read/resize image %s\n", image_filename);
+        return -1;
     }
 
-    temp_model = (model_t *)realloc(temp_model, model_allocate_size);
-    model_t *dma_model = (model_t *)vbx_allocate_dma_buffer(vbx_cnn, model_allocate_size, 0);
+    // Copy to DMA buffer
+    memcpy((void*)input, read_buffer, input_length);
+    free(read_buffer);
+    return 0;
+}
+
+// the class with the highest score in the run's output
+static int classify_output(vbx_cnn_io_ptr_t output){
+    int output_idx = 0; 
+    int out_len = model_get_output_length(model, output_idx);
+    fix16_t scale = (fix16_t)model_get_output_scale_fix16_value(model, output_idx);
+    int32_t zero_point = model_get_output_zeropoint(model, output_idx);
+    
+    // Logits this small are usually copied faster by the cpu than the PDMA
+    vbx_cnn_trace_begin("pdma");
+    pdma_region_t region = {(void*)output, (size_t)out_len, NULL};
+    int32_t token = pdma_copy_submit(&output_copy, PDMA_SOURCE_DMA, 0, &region, 1);
+    int8_t* raw_output = pdma_copy_wait(&output_copy, token) == 0 ? region.dst : (int8_t*)output;
+    vbx_cnn_trace_end("pdma");
     
-    if (dma_model) {
-        memcpy(dma_model, temp_model, model_data_size);
+    // Find ArgMax
+    int max_index = -1;
+    fix16_t max_val = -2147483648; 
+
+    for (int i = 0; i < out_len; i++) {
+        fix16_t val = (raw_output[i] - zero_point) * (float)scale / 65536.0f;
+        if (val > max_val) {
+            max_val = val;
+            max_index = i;
+        }
     }
-    free(temp_model);
-    return dma_model;
+
+    return max_index;
 }
 
+// called as each run of a batch finishes, while the rest are still going
+static void classify_batch_run(void *arg, int index, int status){
+    int *class_ids = (int *)arg;
+    int num_io = model_get_num_inputs(model) + model_get_num_outputs(model);
+    class_ids[index] = status == 0 ?
+        classify_output(batch_io_sets[index * num_io + model_get_num_inputs(model)]) : -1;
+}
 
 // --- Public API Implementation ---
 
@@ -151,8 +186,9 @@ int classifier_init(const char *model_filename) {
         fprintf(stderr, "Error: Unable to initialize vbx_cnn\n");
         return -1;
     }
+    printf("vbx_cnn_init took %.1f ms\n", vbx_cnn->init_us / 1000.0);
 
-    model = internal_read_model_file(vbx_cnn, model_filename);
+    model = vbx_cnn_model_load(vbx_cnn, model_filename);
     if (!model) {
         fprintf(stderr, "Error: Unable to read model %s\n", model_filename);
         return -1;
@@ -163,29 +199,31 @@ int classifier_init(const char *model_filename) {
         return -1;
     }
 
-    // Setup PDMA
+    // Setup PDMA. The staging window is the cached udmabuf: udmabuf-ddr-nc0
+    // is the driver's DMA arena, which holds the model and io buffers.
     int total_size = 32*1024*1024; 
-    pdma_phys_base = internal_pdma_mmap(total_size);
-    pdma_channel = pdma_ch_open();
+    pdma_window = pdma_window_open("/dev/udmabuf-ddr-c0", total_size, vbx_cnn->dma_phys_trans_offset);
+    pdma_engine = pdma_window ? pdma_async_open() : NULL;
+    pdma_copy_init(&output_copy, pdma_engine, pdma_window);
+    void* copy_sample = pdma_engine ? vbx_allocate_dma_buffer(vbx_cnn, PDMA_COPY_CALIBRATE_MAX, 0) : NULL;
+    if (copy_sample) {
+        pdma_copy_calibrate(&output_copy, PDMA_SOURCE_DMA, pdma_copy_timed_cost, copy_sample);
+        vbx_free_dma_buffer(vbx_cnn, copy_sample);
+    }
 
-    // Allocate Input Buffers
-    for(unsigned i = 0; i < model_get_num_inputs(model); ++i){
-        io_buffers[i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(vbx_cnn, model_get_input_length(model,i)*sizeof(uint8_t), 1);
-        if(!io_buffers[i]){
-            fprintf(stderr, "Error: Input buffer allocation failed\n");
-            return -1;
-        }
+    // Allocate Input and Output Buffers
+    if (allocate_io_set(io_buffers) != 0) {
+        return -1;
     }
 
-    // Allocate Output Buffers
-    for (unsigned o = 0; o < model_get_num_outputs(model); ++o) {
-        io_buffers[model_get_num_inputs(model) + o] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(
-                vbx_cnn, model_get_output_length(model, o) * sizeof(uint32_t), 0);
-        if(!io_buffers[model_get_num_inputs(model) + o]){
-             fprintf(stderr, "Error: Output buffer allocation failed\n");
-             return -1;
-        }
+    queue = vbx_cnn_queue_init(vbx_cnn, 2);
+    if (!queue) {
+        fprintf(stderr, "Error: Unable to create inference queue\n");
+        return -1;
     }
+    // sleep through most of each inference rather than spinning a U54 on poll
+    model_wait = vbx_cnn_wait_init(vbx_cnn, 200);
+    vbx_cnn_queue_set_wait(queue, model_wait);
 
 #if USE_INTERRUPTS
     enable_interrupt(vbx_cnn);
@@ -202,62 +240,60 @@ int classifier_predict(const char *image_filename) {
     }
 
     // 1. Load and Resize Image
-    int input_idx = 0; 
-    int dims = model_get_input_dims(model, input_idx);
-    int* input_shape = model_get_input_shape(model, input_idx);
-    int input_length = model_get_input_length(model, input_idx);
-    
-    int h = input_shape[dims-2];
-    int w = input_shape[dims-1];
-    
-    void* read_buffer = read_and_resize_image(image_filename, 3, h, w, 0); // 0 = RGB
-    if (!read_buffer) {
-        // Only error if pointer is NULL
-        fprintf(stderr, "Error: Failed to read/resize image %s\n", image_filename);
+    if (load_input(image_filename, io_buffers[0]) != 0) {
         return -1;
     }
 
-    // Copy to DMA buffer
-    memcpy((void*)io_buffers[input_idx], read_buffer, input_length);
-    free(read_buffer);
-
     // 2. Run Inference
-    int status = vbx_cnn_model_start(vbx_cnn, model, io_buffers);
-#if USE_INTERRUPTS
-    status = vbx_cnn_model_wfi(vbx_cnn);
-#else
-    while(vbx_cnn_model_poll(vbx_cnn) > 0);
-#endif
-
-    if (status < 0) {
+    int status = -1;
+    vbx_cnn_trace_begin("inference");
+    int err = vbx_cnn_queue_submit(queue, model, io_buffers) < 0 ||
+        vbx_cnn_queue_wait(queue, &status) < 0 || status < 0;
+    vbx_cnn_trace_end("inference");
+    if (err) {
         fprintf(stderr, "Model failed with error %d\n", vbx_cnn_get_error_val(vbx_cnn));
         return -1;
     }
 
     // 3. Process Output
-    int output_idx = 0; 
-    int out_len = model_get_output_length(model, output_idx);
-    fix16_t scale = (fix16_t)model_get_output_scale_fix16_value(model, output_idx);
-    int32_t zero_point = model_get_output_zeropoint(model, output_idx);
-    
-    // Sync PDMA
-    internal_pdma_ch_transfer(pdma_phys_base, (void*)io_buffers[model_get_num_inputs(model)+output_idx], 0, out_len, vbx_cnn, pdma_channel);
+    return classify_output(io_buffers[model_get_num_inputs(model)]);
+}
 
-    int8_t* raw_output = (int8_t*)pdma_mmap_ptr;
-    
-    // Find ArgMax
-    int max_index = -1;
-    fix16_t max_val = -2147483648; 
+int classifier_predict_batch(const char **image_filenames, int count, int *class_ids) {
+    if (!is_initialized) {
+        fprintf(stderr, "Error: Classifier not initialized\n");
+        return -1;
+    }
+    if (count < 0 || count > CLASSIFIER_MAX_BATCH) {
+        fprintf(stderr, "Error: Batch of %d images, at most %d\n", count, CLASSIFIER_MAX_BATCH);
+        return -1;
+    }
+    // a set of buffers per image, kept for later batches
+    int num_io = model_get_num_inputs(model) + model_get_num_outputs(model);
+    for (; batch_sets_allocated < count; batch_sets_allocated++) {
+        vbx_cnn_io_ptr_t *set = batch_io_sets + batch_sets_allocated * num_io;
+        if (batch_sets_allocated == 0) {
+            memcpy(set, io_buffers, num_io * sizeof(vbx_cnn_io_ptr_t));
+        } else if (allocate_io_set(set) != 0) {
+            return -1;
+        }
+    }
 
-    for (int i = 0; i < out_len; i++) {
-        fix16_t val = (raw_output[i] - zero_point) * (float)scale / 65536.0f;
-        if (val > max_val) {
-            max_val = val;
-            max_index = i;
+    for (int b = 0; b < count; b++) {
+        if (load_input(image_filenames[b], batch_io_sets[b * num_io]) != 0) {
+            return -1;
         }
     }
 
-    return max_index;
+    // each image's output is classified as it finishes, while the next runs
+    vbx_cnn_trace_begin("inference");
+    int failed = vbx_cnn_queue_run_batch(queue, model, batch_io_sets, count, classify_batch_run, class_ids);
+    vbx_cnn_trace_end("inference");
+    if (failed != 0) {
+        fprintf(stderr, "Model failed with error %d\n", vbx_cnn_get_error_val(vbx_cnn));
+        return -1;
+    }
+    return 0;
 }
 
 void classifier_cleanup() {
@@ -5,6 +5,8 @@
 extern "C" {
 #endif
 
+#define CLASSIFIER_MAX_BATCH 8
+
 /**
  * @brief Initializes the VectorBlox CNN accelerator and loads the model.
  * * @param model_filename Path to the compiled .vnnx model file.
@@ -19,6 +21,16 @@ int classifier_init(const char *model_filename);
  */
 int classifier_predict(const char *image_filename);
 
+/**
+ * @brief Runs inference on several JPEG images, such as a burst of one carton,
+ * back to back on the core; each image's result is read out while the next runs.
+ * * @param image_filenames Paths to count .jpg image files.
+ * * @param count Number of images, at most CLASSIFIER_MAX_BATCH.
+ * * @param class_ids Set to each image's predicted Class ID, or -1 if it failed.
+ * @return 0 on success, -1 on failure.
+ */
+int classifier_predict_batch(const char **image_filenames, int count, int *class_ids);
+
 /**
  * @brief Cleans up resources (optional).
  */
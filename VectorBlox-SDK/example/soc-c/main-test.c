@@ -9,6 +9,8 @@
 #include "classifier.h"
 #include "servo.h" // Wraps the Software PWM logic
 #include "pwm.h"   // Added Hardware PWM logic
+#include "vbx_cnn_api.h"
+#include "vbx_cnn_trace.h"
 
 void print_menu() {
     printf("\n=== FACTORY SYSTEM DIAGNOSTICS ===\n");
@@ -58,6 +60,13 @@ int main() {
 
     if (servo_init() != 0) printf("Servo Init Failed! (Check root/export)\n");
     else printf("Servo Initialized.\n");
+
+    // VBX_CNN_TRACE=trace.json records each sorting cycle for chrome://tracing or ui.perfetto.dev
+    const char* trace_file = getenv("VBX_CNN_TRACE");
+    if (trace_file && vbx_cnn_trace_open(trace_file, 0) == 0) {
+        vbx_cnn_trace_thread_name("sorting");
+        printf("Tracing to %s\n", trace_file);
+    }
     
     int choice;
     while(1) {
@@ -72,6 +81,7 @@ int main() {
                 printf("Exiting...\n");
                 uart_close();
                 servo_close(); // Clean up servo
+                if (trace_file) vbx_cnn_trace_close();
                 // Clean up PWM Channel 0 if used
                 // pwm_disable(0); 
                 return 0;
@@ -160,6 +170,8 @@ int main() {
                 int timeout = 100; 
                 int object_found = 0;
                 
+                vbx_cnn_trace_begin("sort cycle");
+                vbx_cnn_trace_begin("wait for object");
                 while(timeout > 0) {
                     double d = sensor_get_distance();
                     if (d > 0 && d < 10.0) {
@@ -171,32 +183,39 @@ int main() {
                     if (timeout % 10 == 0) printf("."); 
                     fflush(stdout);
                 }
+                vbx_cnn_trace_end("wait for object");
                 printf("\n");
                 
                 if (!object_found) {
                     printf("Timeout! No box seen.\n");
+                    vbx_cnn_trace_end("sort cycle");
                     break;
                 }
 
                 printf("Object Detected at < 10cm! [Simulated] Conveyor Stopped.\n");
                 printf("Taking Picture...\n");
+                vbx_cnn_trace_begin("capture");
                 camera_init(); 
                 camera_capture_to_file("box.jpg");
                 
                 printf("Flushing write buffers...\n");
                 system("sync"); 
                 usleep(200000); 
+                vbx_cnn_trace_end("capture");
 
                 printf("Classifying...\n");
                 static int ai_ready = 0;
                 if (!ai_ready) {
                      if (classifier_init("my_model.vnnx") == 0) ai_ready = 1;
-                     else { printf("AI Init Failed\n"); break; }
+                     else { printf("AI Init Failed\n"); vbx_cnn_trace_end("sort cycle"); break; }
                 }
                 
+                vbx_cnn_trace_begin("classify");
                 int cls = classifier_predict("box.jpg");
+                vbx_cnn_trace_end("classify");
                 printf(">>> RESULT: Class %d <<<\n", cls);
                 
+                vbx_cnn_trace_begin("sort");
                 if (cls == 0) {
                     // Actual Servo Action for Apple
                     servo_sort_left();
@@ -211,6 +230,9 @@ int main() {
                 sleep(1);
                 // Updated to match servo.h signature: angle + duration
                 servo_set_angle(90, 1000); 
+                vbx_cnn_trace_end("sort");
+                vbx_cnn_trace_end("sort cycle");
+                vbx_cnn_trace_flush();
                 break;
 
             case 6: // SERVO TEST
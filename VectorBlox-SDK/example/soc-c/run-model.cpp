@@ -1,5 +1,8 @@
 #include "postprocess.h"
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_loader.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_dump.h"
 #include <stdio.h>
 #include <string.h>
 #include <string>
@@ -7,7 +10,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
-#include "pdma/pdma_helpers.h"
+#include "pdma_helpers.h"
 #include <cassert>
 
 extern "C" int read_JPEG_file (const char * filename, int* width, int* height,
@@ -24,9 +27,6 @@ extern "C" int resize_image(uint8_t *image_in, int in_w, int in_h,
 #define INT8FLAG 1
 #define WRITE_OUT 0
 
-static inline void* virt_to_phys(vbx_cnn_t* vbx_cnn,void* virt){
-	return (char*)(virt) + vbx_cnn->dma_phys_trans_offset;
-}
 #if USE_INTERRUPTS
 void enable_interrupt(vbx_cnn_t *vbx_cnn){
 	uint32_t reenable = 1;
@@ -37,27 +37,6 @@ void enable_interrupt(vbx_cnn_t *vbx_cnn){
 };
 #endif
 
-int8_t* pdma_mmap_t;
-uint64_t pdma_mmap(int total_size/*total num of all outputs*/){
-	
-	char cdev[256] = "/dev/udmabuf-ddr-nc0";
-	uint64_t ddrc_phyadr = get_phy_addr(cdev);  
-	int32_t fdc = open(cdev, O_RDWR); 
-	off_t oft = 0;
-	pdma_mmap_t = (int8_t *)mmap(NULL, total_size*sizeof(int8_t), PROT_READ | PROT_WRITE,  MAP_SHARED, fdc, oft);
-	assert(pdma_mmap_t != NULL);
-	uint64_t output_data_phys = ddrc_phyadr + oft;
-
-	return output_data_phys;
-
-}
-
-
-int32_t pdma_ch_transfer(uint64_t output_data_phys, void* source_buffer,int offset,int size,vbx_cnn_t *vbx_cnn,int32_t channel){
-	uint64_t srcbuf=(uint64_t)(uintptr_t)virt_to_phys(vbx_cnn, source_buffer);
-	return pdma_ch_cpy(output_data_phys + offset, srcbuf, size, channel);
-
-}
 
 
 void* read_image(const char* filename, const int channels, const int height, const int width, int data_type, int use_bgr){
@@ -90,37 +69,6 @@ void* read_image(const char* filename, const int channels, const int height, con
 
 
 
-model_t *read_model_file(vbx_cnn_t *vbx_cnn, const char *filename) {
-	FILE *model_file = fopen(filename, "r");
-	if (model_file == NULL) {
-		return NULL;
-	}
-	fseek(model_file, 0, SEEK_END);
-	int file_size = ftell(model_file);
-	fseek(model_file, 0, SEEK_SET);
-	model_t *model = (model_t *)malloc(file_size);
-	printf("Reading model\n");
-	int size_read = fread(model, 1, file_size, model_file);
-	printf("Done\n");
-	if (size_read != file_size) {
-		fprintf(stderr, "Error reading full model file %s\n", filename);
-		return NULL;
-	}
-	int model_data_size = model_get_data_bytes(model);
-	if (model_data_size != file_size) {
-		fprintf(stderr, "Error model file is not correct size%s\n", filename);
-		return NULL;
-	}
-	int model_allocate_size = model_get_allocate_bytes(model);
-	model = (model_t *)realloc(model, model_allocate_size);
-	model_t *dma_model =
-		(model_t *)vbx_allocate_dma_buffer(vbx_cnn, model_allocate_size, 0);
-	if (dma_model) {
-		memcpy(dma_model, model, model_data_size);
-	}
-	free(model);
-	return dma_model;
-}
 
 
 int gettimediff_us(struct timeval start, struct timeval end) {
@@ -148,7 +96,8 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Unable to initialize vbx_cnn. Exiting\n");
 		exit(1);
 	}
-	model_t *model = read_model_file(vbx_cnn, argv[1]);
+	printf("vbx_cnn_init took %3.4f ms\n", vbx_cnn->init_us / 1000.0);
+	model_t *model = vbx_cnn_model_load(vbx_cnn, argv[1]);
 	if (!model) {
 		fprintf(stderr, "Unable to correctly read %s. Exiting\n", argv[1]);
 		exit(1);
@@ -156,16 +105,29 @@ int main(int argc, char **argv) {
 	if (model_check_sanity(model) != 0) {
 		printf("Model %s is not sane\n", argv[1]);
 	};
+	model_io_info_t *io_info = model_io_info_init(model);
+	if (!io_info) {
+		fprintf(stderr, "Unable to read io descriptors of %s. Exiting\n", argv[1]);
+		exit(1);
+	}
 	int total_size = 32*1024*1024; //#TODO Check limit size in comparison
 	
 	
-	uint64_t pdma_out = pdma_mmap(total_size);
-	int32_t pdma_channel = pdma_ch_open();
+	// staged in the cached udmabuf, not udmabuf-ddr-nc0 where the driver keeps the model and io buffers
+	pdma_window_t* pdma_window = pdma_window_open("/dev/udmabuf-ddr-c0", total_size, vbx_cnn->dma_phys_trans_offset);
+	pdma_async_t* pdma_engine = pdma_window ? pdma_async_open() : NULL;
+	pdma_copy_t output_copy;
+	pdma_copy_init(&output_copy, pdma_engine, pdma_window);
+	void *copy_sample = pdma_engine ? vbx_allocate_dma_buffer(vbx_cnn, PDMA_COPY_CALIBRATE_MAX, 0) : NULL;
+	if (copy_sample) {
+		pdma_copy_calibrate(&output_copy, PDMA_SOURCE_DMA, pdma_copy_timed_cost, copy_sample);
+		vbx_free_dma_buffer(vbx_cnn, copy_sample);
+	}
 	void *read_buffer = NULL;
 	
 	vbx_cnn_io_ptr_t io_buffers[MAX_IO_BUFFERS];
 	for(unsigned i =0;i<model_get_num_inputs(model);++i){
-		io_buffers[i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer(vbx_cnn, model_get_input_length(model,i)*sizeof(uint8_t),1);
+		io_buffers[i] = (vbx_cnn_io_ptr_t)vbx_allocate_dma_buffer_flags(vbx_cnn, model_get_input_length(model,i)*sizeof(uint8_t),1,0);
 		if(!io_buffers[i]){
 			fprintf(stderr,"Model io_buffer requested exceeds buffer length.\n");
 			exit(1);
@@ -180,7 +142,7 @@ int main(int argc, char **argv) {
 				int* input_shape = model_get_input_shape(model,i);
 				int input_length = model_get_input_length(model, i);
 				int dims = model_get_input_dims(model,i);
-				uint8_t *input_buffer = (uint8_t *)vbx_allocate_dma_buffer(vbx_cnn, input_length * sizeof(uint8_t), 0);
+				uint8_t *input_buffer = (uint8_t *)vbx_allocate_dma_buffer_flags(vbx_cnn, input_length * sizeof(uint8_t), 0, 0);
 				if(!input_buffer){
 					fprintf(stderr, "Input_buffer requested exceeds buffer length.\n");
 					exit(1);
@@ -188,6 +150,7 @@ int main(int argc, char **argv) {
 				int use_bgr=0; //read as RGB
 				read_buffer = read_image(argv[2], input_shape[dims-3], input_shape[dims-2], input_shape[dims-1], input_datatype,use_bgr);
 				memcpy(input_buffer, read_buffer, input_length);
+				vbx_free_dma_buffer(vbx_cnn, (void*)io_buffers[i]);
 				io_buffers[i] = (vbx_cnn_io_ptr_t)input_buffer;
 #if 0
 				fix16_t scale = (fix16_t)model_get_input_scale_fix16_value(model,i); // input scale * 255 (as inputs are 0-255 not 0-1.
@@ -244,28 +207,29 @@ int main(int argc, char **argv) {
 
 	}
 #endif
-	fix16_t* fix16_output_buffers[model_get_num_outputs(model)];
-	for (int o = 0; o < (int)model_get_num_outputs(model); ++o){
-		int size=model_get_output_length(model, o);
-		fix16_t scale = (fix16_t)model_get_output_scale_fix16_value(model,o); // get output scale
-		int32_t zero_point = model_get_output_zeropoint(model,o); // get output zero
+	int num_inputs = io_info->num_inputs;
+	int num_outputs = io_info->num_outputs;
+	// the copies run while the outputs are converted below
+	pdma_region_t pdma_regions[num_outputs];
+	for(int o =0; o<num_outputs;o++){
+		pdma_regions[o].src = (void*)io_buffers[num_inputs+o];
+		pdma_regions[o].n = io_info->outputs[o].length;
+	}
+	int32_t pdma_token = pdma_copy_submit(&output_copy, PDMA_SOURCE_DMA, 0, pdma_regions, num_outputs);
+	fix16_t* fix16_output_buffers[num_outputs];
+	for (int o = 0; o < num_outputs; ++o){
+		int size=io_info->outputs[o].length;
+		fix16_t scale = io_info->outputs[o].scale_fix16; // get output scale
+		int32_t zero_point = io_info->outputs[o].zero_point; // get output zero
 		fix16_output_buffers[o] = (fix16_t*)malloc(size*sizeof(fix16_t));
-		int8_to_fix16(fix16_output_buffers[o], (int8_t*)io_buffers[model_get_num_inputs(model)+o], size, scale, zero_point);
+		int8_to_fix16(fix16_output_buffers[o], (int8_t*)io_buffers[num_inputs+o], size, scale, zero_point);
 	}	
-	// users can modify this post-processing function in post_process.c
-	vbx_cnn_io_ptr_t pdma_buffer[model_get_num_outputs(model)];
-	for(int i =0; i<(int)model_get_num_inputs(model);i++){
-		pdma_buffer[i]=0;
-	}
-	int output_offset=0;
-
-	
-	for(int o =0; o<(int)model_get_num_outputs(model);o++){
-		int output_length = model_get_output_length(model, o);
-		pdma_ch_transfer(pdma_out,(void*)io_buffers[model_get_num_inputs(model)+o],output_offset,model_get_output_length(model, o),vbx_cnn,pdma_channel);
-		pdma_buffer[o] = (vbx_cnn_io_ptr_t)(pdma_mmap_t + output_offset);
-		output_offset+= output_length;
+	int pdma_status = pdma_copy_wait(&output_copy, pdma_token);
+	vbx_cnn_io_ptr_t pdma_buffer[num_outputs];
+	for(int o =0; o<num_outputs;o++){
+		pdma_buffer[o] = pdma_status == 0 ? (vbx_cnn_io_ptr_t)pdma_regions[o].dst : io_buffers[num_inputs+o];
 	}
+	// users can modify this post-processing function in post_process.c
 
 #if INT8FLAG	
 	if (argc > 3) pprint_post_process(argv[1], argv[3], model, (fix16_t**)(uintptr_t)pdma_buffer,1,0);
@@ -273,19 +237,24 @@ int main(int argc, char **argv) {
 	if (argc > 3) pprint_post_process(argv[1], argv[3], model, fix16_output_buffers,0,0);
 #endif
 
-	int output_bytes = model_get_output_datatype(model,0) == VBX_CNN_CALC_TYPE_INT16 ? 2 : 1;
-	if (model_get_output_datatype(model,0) == VBX_CNN_CALC_TYPE_INT32) output_bytes = 4;
-	unsigned checksum = fletcher32((uint16_t*)(io_buffers[model_get_num_inputs(model)]),model_get_output_length(model, 0)*output_bytes/sizeof(uint16_t));
-	for(unsigned o =1;o<model_get_num_outputs(model);++o){
-		int output_bytes = model_get_output_datatype(model,o) == VBX_CNN_CALC_TYPE_INT16 ? 2 : 1;
-		if (model_get_output_datatype(model,0) == VBX_CNN_CALC_TYPE_INT32) output_bytes = 4;
-		checksum ^= fletcher32((uint16_t*)io_buffers[model_get_num_inputs(model)+o], model_get_output_length(model, o)*output_bytes/sizeof(uint16_t));
+	int output_bytes = io_info->outputs[0].datatype == VBX_CNN_CALC_TYPE_INT16 ? 2 : 1;
+	if (io_info->outputs[0].datatype == VBX_CNN_CALC_TYPE_INT32) output_bytes = 4;
+	unsigned checksum = fletcher32((uint16_t*)(io_buffers[num_inputs]),io_info->outputs[0].length*output_bytes/sizeof(uint16_t));
+	for(int o =1;o<num_outputs;++o){
+		int output_bytes = io_info->outputs[o].datatype == VBX_CNN_CALC_TYPE_INT16 ? 2 : 1;
+		if (io_info->outputs[0].datatype == VBX_CNN_CALC_TYPE_INT32) output_bytes = 4;
+		checksum ^= fletcher32((uint16_t*)io_buffers[num_inputs+o], io_info->outputs[o].length*output_bytes/sizeof(uint16_t));
 	}
 	printf("CHECKSUM = %08x\n",checksum);
 	if(WRITE_OUT || (argc<=3 && !strcmp(argv[1],"test.vnnx"))){
-		print_json(model,io_buffers,INT8FLAG);
+		if (model_dump_io(model, io_buffers, INT8FLAG, "io.vbxd") != 0) {
+			fprintf(stderr, "Unable to write io.vbxd\n");
+		}
 	}
 	if (read_buffer) free(read_buffer);
+	model_io_info_free(io_info);
+	pdma_async_close(pdma_engine);
+	pdma_window_close(pdma_window);
 
 	return 0;
 }
\ No newline at end of file
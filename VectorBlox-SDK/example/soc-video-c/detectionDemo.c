@@ -1,5 +1,8 @@
 #include "imageScaler/scaler.h"
 #include "detectionDemo.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_reset.h"
+#include "vbx_cnn_trace.h"
 #include "frameDrawing/draw_assist.h"
 #include "frameDrawing/draw.h"
 
@@ -66,7 +69,7 @@ static inline uint32_t* virt_loop() {
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
-#include "pdma/pdma_helpers.h"
+#include "pdma_helpers.h"
 
 
 extern uint32_t *linux_draw_frame;
@@ -83,14 +86,8 @@ static int gettimediff_us_2(struct timeval start, struct timeval end) {
 	return sec * 1000000 + usec;
 }
 
-extern int8_t* pdma_mmap_t;
-extern uint64_t pdma_out;
-extern int32_t pdma_channel;
-
-int32_t pdma_ch_transfer(uint64_t output_data_phys, void* source_buffer,int offset,int size,vbx_cnn_t *vbx_cnn,int32_t channel){
-	uint64_t srcbuf=0x3000000000 + (uint64_t)(uintptr_t)virt_to_phys(vbx_cnn, source_buffer);
-	return pdma_ch_cpy(output_data_phys + offset, srcbuf, size, channel);
-}
+extern pdma_copy_t output_copy;
+extern pdma_ring_t* output_ring;
 #else
 	
 	#include "../tinyprintf.h"
@@ -115,6 +112,12 @@ short detectionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models, ui
 	struct model_descr_t *object_model = models+modelIdx;
 	object_model->buf_idx=0;
 	object_model->is_running = 0;
+	// usually read from the file at start up, to size the DMA memory left for io buffers
+	if (!object_model->io_info) object_model->io_info = model_io_info_init(object_model->model);
+	if(!object_model->io_info){
+		printf("Unable to read model io descriptors.\n");
+		return -1;
+	}
 	object_model->model_io_buffers  = vbx_allocate_dma_buffer(the_vbx_cnn, (1+model_get_num_outputs(object_model->model))*sizeof(object_model->model_io_buffers), 0);
 	if(!object_model->model_io_buffers){
 		printf("Memory allocation issue for model io buffers.\n");
@@ -125,8 +128,8 @@ short detectionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models, ui
 #ifdef HLS_RESIZE
 	input_length = model_get_input_length(object_model->model, 0) *
 		((int)model_get_input_datatype(object_model->model, 0) + 1);
-	object_model->pipelined_input_buffer[0] = vbx_allocate_dma_buffer(the_vbx_cnn, input_length, 0);
-	object_model->pipelined_input_buffer[1] = vbx_allocate_dma_buffer(the_vbx_cnn, input_length, 0);
+	object_model->pipelined_input_buffer[0] = vbx_allocate_dma_buffer_flags(the_vbx_cnn, input_length, 0, 0);
+	object_model->pipelined_input_buffer[1] = vbx_allocate_dma_buffer_flags(the_vbx_cnn, input_length, 0, 0);
 	object_model->model_io_buffers[0] =(uintptr_t)object_model->pipelined_input_buffer[0];
 	if(!object_model->pipelined_input_buffer[0] ||!object_model->pipelined_input_buffer[1]){
 			printf("Memory allocation issue for model input buffers.\n");
@@ -135,7 +138,7 @@ short detectionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models, ui
 #else	
 	input_length = model_get_input_length(object_model->model, 0) *
 		((int)model_get_input_datatype(object_model->model, 0) + 1);
-	object_model->model_input_buffer = vbx_allocate_dma_buffer(the_vbx_cnn, input_length, 0);
+	object_model->model_input_buffer = vbx_allocate_dma_buffer_flags(the_vbx_cnn, input_length, 0, 0);
 	object_model->model_io_buffers[0] = (uintptr_t)object_model->model_input_buffer;
 	if(!object_model->model_input_buffer){
 		printf("Memory allocation issue for model input buffers.\n");
@@ -177,7 +180,8 @@ int runDetectionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uint8
 	status = 0;
 	struct timeval m_run1, m_run2;
 	struct model_descr_t *object_model = models+modelIdx;
-	int* input_dims = model_get_input_shape(object_model->model, 0);	
+	model_io_info_t* io_info = object_model->io_info;
+	int* input_dims = io_info->inputs[0].shape;
 	uint32_t offset;
 	//Start processing the network if not already running - 1st pass only (frame 0 )
 	if(!object_model->is_running) {		
@@ -232,31 +236,61 @@ int runDetectionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uint8
 		object_model->is_running = 1;
 	}
 
-	status = vbx_cnn_model_wfi(the_vbx_cnn); // Check if model done
+	status = vbx_cnn_model_wfi_timeout(the_vbx_cnn, MODEL_TIMEOUT_US); // Check if model done, reset if hung
 	
 	if(status < 0) {
 		return status;
 	} else if (status == 0) { // When  model is completed
+#if VBX_SOC_DRIVER
+		// Copy the outputs out while the next inference, the scaler and PIXEL drawing start;
+		// the next model writes the other set of pipelined buffers.
+		// Box and keypoint outputs are only read at the likely cells, so they stay where they are
+		int sparse[io_info->num_outputs];
+		post_process_sparse_outputs(object_model->model, object_model->post_process_type, sparse);
+		pdma_region_t pdma_regions[io_info->num_outputs];
+		int num_regions = 0;
+		for(int o =0; o<io_info->num_outputs;o++){
+			if (!sparse[o]) {
+				pdma_regions[num_regions].src = object_model->pipelined_output_buffers[object_model->buf_idx][o];
+				pdma_regions[num_regions].n = io_info->outputs[o].length;
+				num_regions++;
+			}
+		}
+		// a full ring, or none, leaves postprocessing to read the model's buffers
+		size_t pdma_offset;
+		int pdma_slot = output_ring ? pdma_ring_try_acquire(output_ring, pdma_pack_bytes(pdma_regions, num_regions), &pdma_offset) : -1;
+		int32_t pdma_token = pdma_slot >= 0 ? pdma_copy_submit(&output_copy, PDMA_SOURCE_DMA, pdma_offset, pdma_regions, num_regions) : -1;
+#endif
 
 		//Swap set of pipelined output buffers
 #ifdef HLS_RESIZE
 		object_model->model_io_buffers[0] = (uintptr_t)object_model->pipelined_input_buffer[!object_model->buf_idx];
 
         //wait for next frame scaling to finish, if it hasn't already
+		vbx_cnn_trace_begin("scaler wait");
 		resize_image_hls_wait(SCALER_BASE_ADDRESS);
+		vbx_cnn_trace_end("scaler wait");
 #else		
 		offset = (*PROCESSING_NEXT_FRAME_ADDRESS) - 0x70000000;
 		object_model->model_input_buffer = (uint8_t*)(uintptr_t)(SCALER_FRAME_ADDRESS + offset);
 		object_model->model_io_buffers[0] = (uintptr_t)object_model->model_input_buffer - the_vbx_cnn->dma_phys_trans_offset;	
 #endif
-		int num_outputs = model_get_num_outputs(object_model->model);
+		int num_outputs = io_info->num_outputs;
 		for (int o = 0; o < num_outputs; o++) {			
 			object_model->model_io_buffers[o+1] = (uintptr_t)object_model->pipelined_output_buffers[!object_model->buf_idx][o];
 		}	
 		//Start model inference
 		
 		err = vbx_cnn_model_start(the_vbx_cnn, object_model->model, object_model->model_io_buffers); 
-		if(err != 0) return err;
+		if(err != 0) {
+#if VBX_SOC_DRIVER
+			if (pdma_slot >= 0) {
+				pdma_copy_wait(&output_copy, pdma_token);
+				pdma_ring_release(output_ring, pdma_slot);
+			}
+#endif
+			return err;
+		}
 		object_model->is_running = 1;
 #ifdef HLS_RESIZE
 		resize_image_hls_start(SCALER_BASE_ADDRESS,(uint32_t*)(intptr_t)(*PROCESSING_NEXT_FRAME_ADDRESS),
@@ -272,19 +306,28 @@ int runDetectionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uint8
 #if VBX_SOC_DRIVER
 		gettimeofday(&m_run2, NULL);
 		m_run_fps = 1000/ (gettimediff_us_2(m_run1, m_run2) / 1000);
-	if (PDMA){
-		vbx_cnn_io_ptr_t pdma_buffer[model_get_num_outputs(object_model->model)];
-		int output_offset=0;
-		for(int o =0; o<(int)model_get_num_outputs(object_model->model);o++){
-			int output_length = model_get_output_length(object_model->model, o);
-			pdma_ch_transfer(pdma_out,(void*)object_model->pipelined_output_buffers[object_model->buf_idx][o],output_offset,model_get_output_length(object_model->model, o),the_vbx_cnn,pdma_channel);
-			pdma_buffer[o] = (vbx_cnn_io_ptr_t)(pdma_mmap_t + output_offset);
-			output_offset+= output_length;
+		vbx_cnn_io_ptr_t pdma_buffer[io_info->num_outputs];
+		vbx_cnn_trace_begin("pdma wait");
+		int pdma_status = pdma_copy_wait(&output_copy, pdma_token);
+		vbx_cnn_trace_end("pdma wait");
+		// straight from the model's buffers if the copy couldn't be made
+		for(int o =0, r = 0; o<io_info->num_outputs;o++){
+			pdma_buffer[o] = (vbx_cnn_io_ptr_t)object_model->pipelined_output_buffers[object_model->buf_idx][o];
+			if (!sparse[o] && pdma_status == 0) {
+				pdma_buffer[o] = (vbx_cnn_io_ptr_t)pdma_regions[r].dst;
+			}
+			r += !sparse[o];
 		}
+		vbx_cnn_trace_begin("postprocess");
 		pprint_post_process(object_model->name, object_model->post_process_type, object_model->model, (fix16_t**)(uintptr_t)pdma_buffer,1,fps);
-	}
+		vbx_cnn_trace_end("postprocess");
+		if (pdma_slot >= 0) {
+			pdma_ring_release(output_ring, pdma_slot);
+		}
 #else
+		vbx_cnn_trace_begin("postprocess");
 		pprint_post_process(object_model->name, object_model->post_process_type, object_model->model, (fix16_t**)(uintptr_t)object_model->pipelined_output_buffers[object_model->buf_idx],1,fps);
+		vbx_cnn_trace_end("postprocess");
 
 #endif
 	object_model->buf_idx = !object_model->buf_idx;
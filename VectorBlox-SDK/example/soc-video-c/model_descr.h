@@ -2,17 +2,30 @@
 #define __MODEL_DESCR_H
 
 #include "tracking.h"
+#include "vbx_cnn_io_info.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// longest one model may run before the core is taken to be hung and reset
+#define MODEL_TIMEOUT_US 500000
+
+// give up on frames after this many resets in a row
+#define MAX_CONSECUTIVE_RESETS 3
+
+// DMA memory kept out of the model cache besides the demos' io buffers, which
+// are sized from the models' io descriptors: the warp buffer, the PDMA
+// calibration sample and the like
+#define MODEL_CACHE_HEADROOM_MB 4
+
 struct model_descr_t{
     const char *name;
     const char *fname;
     int spi_offset;
     const char* post_process_type;
     model_t* model;
+    model_io_info_t* io_info;
     short modelSetup_done;
     int time_ms;
     vbx_cnn_io_ptr_t* model_io_buffers;
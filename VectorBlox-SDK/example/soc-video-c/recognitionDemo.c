@@ -1,4 +1,7 @@
 #include "recognitionDemo.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_reset.h"
+#include "vbx_cnn_trace.h"
 #include "imageScaler/scaler.h"
 #include "warpAffine/warp.h"
 #include "frameDrawing/draw_assist.h"
@@ -24,17 +27,14 @@ extern uint32_t* overlay_draw_frame;
 
 // Globals Specification
 #if VBX_SOC_DRIVER
-	#include "pdma/pdma_helpers.h"
+	#include "pdma_helpers.h"
 	#define MAX_TRACKS 48
 	#define DB_LENGTH 32
 	extern int delete_embedding_mode;
 	extern int add_embedding_mode;
 	extern int capture_embedding;
-#if PDMA
-	extern int8_t* pdma_mmap_t;
-	extern uint64_t pdma_out;
-	extern int32_t pdma_channel;
-#endif	
+	extern pdma_copy_t output_copy;
+	extern pdma_ring_t* output_ring;
 	
 #else
 	#define MAX_TRACKS 20
@@ -45,6 +45,25 @@ extern uint32_t* overlay_draw_frame;
 #endif
 
 uint8_t* warp_temp_buffer = NULL;
+// Sleeps through most of each model's run instead of spinning on poll
+static vbx_cnn_wait_t* model_wait = NULL;
+static uint64_t detect_start_ns;
+
+vbx_cnn_wait_t* recognitionDemoWait(vbx_cnn_t* the_vbx_cnn) {
+	if (model_wait == NULL) model_wait = vbx_cnn_wait_init(the_vbx_cnn, 200);
+	return model_wait;
+}
+
+// vbx_cnn_wait_model with a deadline: a hung core is reset and the frame
+// dropped, rather than stalling the demo
+static int wait_model_bounded(vbx_cnn_t* the_vbx_cnn, model_t* model, uint64_t start_ns) {
+	int status = vbx_cnn_wait_model_until(model_wait, model, start_ns, start_ns + MODEL_TIMEOUT_US*1000ull);
+	if (status > 0) {
+		vbx_cnn_reset(the_vbx_cnn);
+		return VBX_CNN_TIMED_OUT;
+	}
+	return status;
+}
 
 // Database Embeddings
 #define PRESET_DB_LENGTH 4
@@ -103,18 +122,12 @@ void print_list(){
 	printf("\n");
 
 }
-#if PDMA
-static int32_t pdma_ch_transfer(uint64_t output_data_phys, void* source_buffer,int offset,int size,vbx_cnn_t *vbx_cnn,int32_t channel){
-	uint64_t srcbuf=0x3000000000 + (uint64_t)(uintptr_t)virt_to_phys(vbx_cnn, source_buffer);
-	return pdma_ch_cpy(output_data_phys + offset, srcbuf, size, channel);
-}
-#endif
 void embedding_calc(fix16_t* embedding, struct model_descr_t* recognition_model){
 	fix16_t sum = 0;
 	fix16_t temp[128];
 	int8_t* output_buffer_int8 = (int8_t*)(uintptr_t)recognition_model->model_output_buffer[0];
-	int32_t zero_point = model_get_output_zeropoint(recognition_model->model,0);
-	fix16_t scale = model_get_output_scale_fix16_value(recognition_model->model,0);
+	int32_t zero_point = recognition_model->io_info->outputs[0].zero_point;
+	fix16_t scale = recognition_model->io_info->outputs[0].scale_fix16;
 	for(int n = 0; n < recognition_model->model_output_length[0]; n++){
 		temp[n] = int8_to_fix16_single(output_buffer_int8[n], scale,  zero_point);
 		sum += fix16_sq(temp[n]);
@@ -201,6 +214,11 @@ int facing_front(object_t* object){
 
 short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models, uint8_t modelIdx, int has_attribute_model, int screen_height, int screen_width, int screen_y_offset, int screen_x_offset) {
 	struct model_descr_t *detect_model = models + modelIdx;
+	if (!detect_model->io_info) detect_model->io_info = model_io_info_init(detect_model->model);
+	if(!detect_model->io_info){
+		printf("Unable to read detect model io descriptors.\n");
+		return -1;
+	}
 	// Allocate memory for Models
     // Allocate Memory needed for the Detect Model buffers
 	detect_model->model_io_buffers  = vbx_allocate_dma_buffer(the_vbx_cnn, (1+model_get_num_outputs(detect_model->model))*sizeof(detect_model->model_io_buffers[0]), 0);
@@ -221,7 +239,7 @@ short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models,
 		
 	}
 	// Allocate the buffer for input for Detect Model
-	detect_model->model_input_buffer = vbx_allocate_dma_buffer(the_vbx_cnn, model_get_input_length(detect_model->model, 0)*sizeof(uint8_t), 0);
+	detect_model->model_input_buffer = vbx_allocate_dma_buffer_flags(the_vbx_cnn, model_get_input_length(detect_model->model, 0)*sizeof(uint8_t), 0, 0);
 	detect_model->model_io_buffers[0] = (uintptr_t)detect_model->model_input_buffer;
 	if(!detect_model->model_input_buffer) {
 		printf("Memory allocation issue for model input buffers.\n");
@@ -233,6 +251,11 @@ short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models,
 	// Allocate memory for Recognition Model I/Os
 	// Specify the input size for Recognition Model
 	struct model_descr_t *recognition_model = models + modelIdx + 1;
+	if (!recognition_model->io_info) recognition_model->io_info = model_io_info_init(recognition_model->model);
+	if(!recognition_model->io_info){
+		printf("Unable to read recognition model io descriptors.\n");
+		return -1;
+	}
 	recognition_model->coord4 = (fix16_t*)malloc(8*sizeof(fix16_t));
 
 	if(!strcmp(recognition_model->post_process_type, "ARCFACE")){
@@ -266,7 +289,7 @@ short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models,
 		return -1;
 	}
 	// Allocate the buffer for input for Recognition Model
-	recognition_model->model_input_buffer = vbx_allocate_dma_buffer(the_vbx_cnn, model_get_input_length(recognition_model->model, 0)*sizeof(uint8_t), 0);
+	recognition_model->model_input_buffer = vbx_allocate_dma_buffer_flags(the_vbx_cnn, model_get_input_length(recognition_model->model, 0)*sizeof(uint8_t), 0, 0);
 	if(!recognition_model->model_input_buffer){
 		printf("Memory allocation issue with recognition input buffer.\n");
 		return -1;
@@ -297,7 +320,7 @@ short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models,
 		// Specify the input size for Attribute Model
 		struct model_descr_t *attribute_model = models + modelIdx + 2;
 		// Allocate the buffer for input for Attribute Model
-		attribute_model->model_input_buffer = vbx_allocate_dma_buffer(the_vbx_cnn, model_get_input_length(attribute_model->model, 0)*sizeof(uint8_t), 0);
+		attribute_model->model_input_buffer = vbx_allocate_dma_buffer_flags(the_vbx_cnn, model_get_input_length(attribute_model->model, 0)*sizeof(uint8_t), 0, 0);
 		if(!attribute_model->model_input_buffer){
 			printf("Memory allocation issue with attribute input buffer.\n");
 			return -1;
@@ -323,6 +346,10 @@ short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models,
 		attribute_model->model_io_buffers[1] = (uintptr_t)attribute_model->model_output_buffer[0];
 		attribute_model->model_io_buffers[2] = (uintptr_t)attribute_model->model_output_buffer[1];
 	}
+	if (recognitionDemoWait(the_vbx_cnn) == NULL) {
+		printf("Memory allocation issue for model wait policy.\n");
+		return -1;
+	}
 	
 	return 1;
 }
@@ -340,8 +367,9 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 	char gender_char;
 	int status;
 	uint32_t offset;
-	int detectInputH = model_get_input_shape(detect_model->model, 0)[2];
-	int detectInputW = model_get_input_shape(detect_model->model, 0)[3];
+	model_io_info_t *detect_info = detect_model->io_info;
+	int detectInputH = detect_info->inputs[0].shape[2];
+	int detectInputW = detect_info->inputs[0].shape[3];
 	//Tracks are initialized if current model has no previous tracks
 	if(recognition_model->pTracker == NULL || recognition_model->pTracks == NULL){
 		tracksInit(recognition_model);
@@ -365,14 +393,11 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 		// Start Detection model
 		err = vbx_cnn_model_start(the_vbx_cnn, detect_model->model, detect_model->model_io_buffers);		
 		if(err != 0) return err;
+		detect_start_ns = vbx_cnn_wait_time_ns();
 		detect_model->is_running = 1;
 	}
 	
-	status = vbx_cnn_model_poll(the_vbx_cnn); //vbx_cnn_model_wfi(the_vbx_cnn); // Check if model done
-	while(status > 0) {
-		for(int i =0;i<1000;i++);
-		status = vbx_cnn_model_poll(the_vbx_cnn);
-	}
+	status = wait_model_bounded(the_vbx_cnn, detect_model->model, detect_start_ns); // Wait for the Detect model
 	
 	if(status < 0) {
 		return status;
@@ -380,18 +405,25 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 
 		int length=0;
 //pdma copy buffers
-#if PDMA
-	vbx_cnn_io_ptr_t pdma_buffer[model_get_num_outputs(detect_model->model)];
-	int output_offset=0;
-	for(int o =0; o<(int)model_get_num_outputs(detect_model->model);o++){
-		int output_length = model_get_output_length(detect_model->model, o);
-		pdma_ch_transfer(pdma_out,(void*)detect_model->pipelined_output_buffers[detect_model->buf_idx][o],output_offset,output_length,the_vbx_cnn,pdma_channel);
-		pdma_buffer[o] = (vbx_cnn_io_ptr_t)(pdma_mmap_t + output_offset);
-		output_offset+= output_length;
+#if VBX_SOC_DRIVER
+	// only the confidences are read whole; the box and landmark maps are read where a face is likely
+	int sparse[detect_info->num_outputs];
+	post_process_sparse_outputs(detect_model->model, detect_model->post_process_type, sparse);
+	pdma_region_t pdma_regions[detect_info->num_outputs];
+	int num_regions = 0;
+	for(int o =0; o<detect_info->num_outputs;o++){
+		if (!sparse[o]) {
+			pdma_regions[num_regions].src = detect_model->pipelined_output_buffers[detect_model->buf_idx][o];
+			pdma_regions[num_regions].n = detect_info->outputs[o].length;
+			num_regions++;
+		}
 	}
+	size_t pdma_offset;
+	int pdma_slot = output_ring ? pdma_ring_try_acquire(output_ring, pdma_pack_bytes(pdma_regions, num_regions), &pdma_offset) : -1;
+	int32_t pdma_token = pdma_slot >= 0 ? pdma_copy_submit(&output_copy, PDMA_SOURCE_DMA, pdma_offset, pdma_regions, num_regions) : -1;
 #endif
 // Swap pipeline IO
-		for (int o = 0; o <  model_get_num_outputs(detect_model->model); o++) {
+		for (int o = 0; o < detect_info->num_outputs; o++) {
 			detect_model->model_io_buffers[o+1] = (uintptr_t)detect_model->pipelined_output_buffers[!detect_model->buf_idx][o];	
 		}	
 //
@@ -399,6 +431,7 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 		snprintf(label,sizeof(label),"Face Recognition Demo %dx%d  %d fps",detectInputW,detectInputH,fps);
 		if(use_attribute_model)
 			snprintf(label,sizeof(label),"Face Recognition + Attribute Demo %dx%d  %d fps",detectInputW,detectInputH,fps);
+		vbx_cnn_trace_begin("postprocess");
 		if(!strcmp(detect_model->post_process_type, "BLAZEFACE")) {
 			// Post Processing BlazeFace output
 			int anchor_shift = 1;
@@ -435,8 +468,20 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 			fix16_t confidence_threshold=F16(0.8);
 			fix16_t nms_threshold=F16(0.34);
 			//( 0 1 2 3 4 5 6 7 8)->(2 5 8 1 4 7 0 3 6)
-#if PDMA
-			fix16_t** output_buffers = (fix16_t**)pdma_buffer;
+#if VBX_SOC_DRIVER
+			// the copy started when the model finished
+			vbx_cnn_trace_begin("pdma wait");
+			int pdma_status = pdma_copy_wait(&output_copy, pdma_token);
+			vbx_cnn_trace_end("pdma wait");
+			fix16_t* pdma_buffer[detect_info->num_outputs];
+			for(int o =0, r = 0; o<detect_info->num_outputs;o++){
+				pdma_buffer[o] = detect_model->pipelined_output_buffers[detect_model->buf_idx][o];
+				if (!sparse[o] && pdma_status == 0) {
+					pdma_buffer[o] = (fix16_t*)pdma_regions[r].dst;
+				}
+				r += !sparse[o];
+			}
+			fix16_t** output_buffers = pdma_buffer;
 #else			
 			fix16_t** output_buffers = detect_model->pipelined_output_buffers[detect_model->buf_idx];
 #endif
@@ -445,12 +490,12 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 			int8_t* output_buffer_int8[9];
 			int zero_points[9];
 			fix16_t scale_outs[9];
-			for(int o=0; o<model_get_num_outputs(detect_model->model); o++){
-				int *output_shape = model_get_output_shape(detect_model->model,o);
+			for(int o=0; o<detect_info->num_outputs; o++){
+				int *output_shape = detect_info->outputs[o].shape;
 				int ind = (output_shape[1]/8)*3 + (2-(output_shape[2]/18)); //first dim should be {2,8,20} second dim should be {9,18,36}
 				output_buffer_int8[ind]= (int8_t*)(uintptr_t)output_buffers[o];
-				zero_points[ind]=model_get_output_zeropoint(detect_model->model,o);
-				scale_outs[ind]=model_get_output_scale_fix16_value(detect_model->model,o);
+				zero_points[ind]=detect_info->outputs[o].zero_point;
+				scale_outs[ind]=detect_info->outputs[o].scale_fix16;
 			}		
 			length = post_process_scrfd_int8(objects, MAX_TRACKS, output_buffer_int8, zero_points, scale_outs, detectInputW, detectInputH,
 				confidence_threshold,nms_threshold,detect_model->model);
@@ -461,17 +506,17 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 			use_plate = 1;
 			fix16_t confidence_threshold=F16(0.55);
 			fix16_t nms_threshold=F16(0.2);
-			int num_outputs = model_get_num_outputs(detect_model->model);
+			int num_outputs = detect_info->num_outputs;
 			int8_t* output_buffer_int8[9];
 			int zero_points[9];
 			fix16_t scale_outs[9];
 			fix16_t** output_buffers = detect_model->pipelined_output_buffers[detect_model->buf_idx];
 			for (int o = 0; o < num_outputs; o++) {				
-				int *output_shape = model_get_output_shape(detect_model->model,o);
+				int *output_shape = detect_info->outputs[o].shape;
 				int ind = 2*(output_shape[2]/18) + (output_shape[1]/6); 
 				output_buffer_int8[ind]= (int8_t*)(uintptr_t)output_buffers[o];
-				zero_points[ind]=model_get_output_zeropoint(detect_model->model,o);
-				scale_outs[ind]=model_get_output_scale_fix16_value(detect_model->model,o);
+				zero_points[ind]=detect_info->outputs[o].zero_point;
+				scale_outs[ind]=detect_info->outputs[o].scale_fix16;
 			}
 
 			length = post_process_lpd_int8(objects, MAX_TRACKS, output_buffer_int8, detectInputW, detectInputH,
@@ -479,6 +524,14 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 							
 			snprintf(label,sizeof(label),"Plate Recognition Demo %dx%d  %d fps",detectInputW,detectInputH,fps);
 		}
+		vbx_cnn_trace_end("postprocess");
+#if VBX_SOC_DRIVER
+		// the frame's slot goes back once nothing is copying into it
+		if (pdma_slot >= 0) {
+			pdma_copy_wait(&output_copy, pdma_token);
+			pdma_ring_release(output_ring, pdma_slot);
+		}
+#endif
 		
 		draw_label(label,20,2,overlay_draw_frame,2048,1080,WHITE);
 
@@ -510,18 +563,17 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 					if(new_h > (fix16_to_int(object->box[3]) - fix16_to_int(object->box[1])) && (new_w>fix16_to_int(object->box[2]) - fix16_to_int(object->box[0])))
 						object = &(objects[i]);				
 				}
+				vbx_cnn_trace_begin("warp");
 				recognizeObject(the_vbx_cnn, recognition_model, object, detect_model->post_process_type,
 						screen_height, screen_width, screen_stride, screen_y_offset, screen_x_offset);
+				vbx_cnn_trace_end("warp");
 
 				// Start Recognition model
 				err = vbx_cnn_model_start(the_vbx_cnn, recognition_model->model, recognition_model->model_io_buffers);
 				if(err != 0) return err;
+				uint64_t recognition_start_ns = vbx_cnn_wait_time_ns();
 
-				err = vbx_cnn_model_poll(the_vbx_cnn); // Wait for the Recognition model
-				while(err > 0) {
-					for(int i =0;i<1000;i++);
-					err = vbx_cnn_model_poll(the_vbx_cnn);
-				}
+				err = wait_model_bounded(the_vbx_cnn, recognition_model->model, recognition_start_ns); // Wait for the Recognition model
 				if(err < 0) return err;
 				fix16_t embedding[128] = {0};
 				embedding_calc(embedding,recognition_model);
@@ -568,7 +620,9 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 				
 			} else {
 				// Match detected objects to tracks
+				vbx_cnn_trace_begin("tracking");
 				matchTracks(objects, length, recognition_model->pTracker, MAX_TRACKS, recognition_model->pTracks, tracks,use_plate);
+				vbx_cnn_trace_end("tracking");
 				// Run Recognition if there is a tracked object
 				if(recognition_model->pTracker->recognitionTrackInd < 0) {
 					printf("Obj not tracked\n");
@@ -579,8 +633,10 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 				
 				object_t* object = recognition_model->pTracks[recognition_model->pTracker->recognitionTrackInd]->object;
 				// Warp the tracked objects							
+				vbx_cnn_trace_begin("warp");
 				recognizeObject(the_vbx_cnn, recognition_model, object, detect_model->post_process_type,
 					screen_height, screen_width, screen_stride, screen_y_offset, screen_x_offset);
+				vbx_cnn_trace_end("warp");
 				if(use_attribute_model){
 					// GENDER+AGE ATTRIBUTE 
 					// get region within object bbox and see if nose keypoint within region for determining a "frontal view"
@@ -593,27 +649,25 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 					resize_image_hls(SCALER_BASE_ADDRESS,
 						(uint32_t*)(intptr_t)(*PROCESSING_FRAME_ADDRESS), bbox_w, bbox_h, screen_stride, fix16_to_int(object->box[0]), fix16_to_int(object->box[1]),
 						(uint8_t*)virt_to_phys(the_vbx_cnn, (void*)attribute_model->model_input_buffer),
-						model_get_input_shape(detect_model->model, 0)[3], model_get_input_shape(detect_model->model, 0)[2]);
+						detectInputW, detectInputH);
 				}
 
 				// Start Recognition model
 				err = vbx_cnn_model_start(the_vbx_cnn, recognition_model->model, recognition_model->model_io_buffers);
 				if(err != 0) return err;
+				uint64_t recognition_start_ns = vbx_cnn_wait_time_ns();
 
 				// Update kalman filters
 				updateFilters(objects, length, recognition_model->pTracker, recognition_model->pTracks, tracks);
 
-				err = vbx_cnn_model_poll(the_vbx_cnn); // Wait for the Recognition model	
-				while(err > 0) {
-					for(int i =0;i<1000;i++);
-					err = vbx_cnn_model_poll(the_vbx_cnn);
-				}
+				err = wait_model_bounded(the_vbx_cnn, recognition_model->model, recognition_start_ns); // Wait for the Recognition model
 				if(err < 0) return err;
 
-
+				uint64_t attribute_start_ns = 0;
 				if(use_attribute_model) {
 					// Start attribute model
 					vbx_cnn_model_start(the_vbx_cnn, attribute_model->model, attribute_model->model_io_buffers);
+					attribute_start_ns = vbx_cnn_wait_time_ns();
 				}
 
 			
@@ -633,11 +687,7 @@ int runRecognitionDemo(struct model_descr_t* models, vbx_cnn_t* the_vbx_cnn, uin
 				// Filter recognition output
 				updateRecognition(recognition_model->pTracks, recognition_model->pTracker->recognitionTrackInd, confidence, name, recognition_model->pTracker);
 				if(use_attribute_model) {
-					err = vbx_cnn_model_poll(the_vbx_cnn); // Wait for the attribute model
-					while(err > 0) {
-						for(int i =0;i<1000;i++);
-						err = vbx_cnn_model_poll(the_vbx_cnn);
-					}
+					err = wait_model_bounded(the_vbx_cnn, attribute_model->model, attribute_start_ns); // Wait for the attribute model
 					if(err < 0) return err;
 					// Update gender+age of object tracks
 					fix16_t age = 100*attribute_model->model_output_buffer[0][0];
@@ -794,5 +844,5 @@ void recognizeObject(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* model, object
 		(uint8_t*)virt_to_phys(the_vbx_cnn, (void*)warp_temp_buffer),
 		xy, ref,
 		screen_width, screen_height, screen_stride,
-		model_get_input_shape(model->model, 0)[3],model_get_input_shape(model->model, 0)[2]);
+		model->io_info->inputs[0].shape[3],model->io_info->inputs[0].shape[2]);
 }
@@ -3,6 +3,7 @@
 
 #include "libfixmath/fixmath.h"
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_wait.h"
 #include "postprocess.h"
 #include "model_descr.h"
 #include "tracking.h"
@@ -27,6 +28,8 @@ void delete_embedding(char* input_buf,struct model_descr_t* models,uint8_t model
 void tracksInit(struct model_descr_t* models);
 void trackClean(struct model_descr_t* models, uint8_t modelIdx);
 
+// the wait policy the recognition models are run with, created on first use
+vbx_cnn_wait_t* recognitionDemoWait(vbx_cnn_t* the_vbx_cnn);
 short recognitionDemoInit(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* models, uint8_t modelIdx, int has_attribute_model, int screen_height, int screen_width, int screen_y_offset, int screen_x_offset);
 void matchEmbedding(fix16_t embedding[],fix16_t* similarity, char** name);
 void recognizeObject(vbx_cnn_t* the_vbx_cnn, struct model_descr_t* model, object_t* object, const char* post_process_type, int screen_height, int screen_width, int screen_stride, int screen_y_offset, int screen_x_offset);
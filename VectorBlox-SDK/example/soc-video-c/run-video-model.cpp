@@ -1,5 +1,11 @@
 #include "postprocess.h"
 #include "vbx_cnn_api.h"
+#include "vbx_cnn_io_info.h"
+#include "vbx_cnn_reset.h"
+#include "vbx_cnn_ctx.h"
+#include "vbx_cnn_cache.h"
+#include "vbx_cnn_bundle.h"
+#include "vbx_cnn_trace.h"
 #include <stdio.h>
 #include <string.h>
 #include <string>
@@ -10,7 +16,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
-#include "pdma/pdma_helpers.h"
+#include "pdma_helpers.h"
 #include <cassert>
 
 #include "frameDrawing/draw_assist.h"
@@ -31,8 +37,6 @@ struct model_descr_t models[] = {
 		{"Midas V2", "/home/root/samples_V1000_2.0.3/Midas-V2-Quantized.vnnx", 0, "PIXEL"},
 };
 
-#define UIO_DMA_LIMIT 512*1024*1024*2
-int total_fsize=0;
 short demo_setup = 0;
 int use_attribute_model = 0;
 int fps = 0;
@@ -59,25 +63,17 @@ void enable_interrupt(vbx_cnn_t *vbx_cnn){
 static inline void* virt_to_phys(vbx_cnn_t* vbx_cnn,void* virt){
 	return (char*)(virt) + vbx_cnn->dma_phys_trans_offset;
 }
-#if PDMA
-int8_t* pdma_mmap_t;
-uint64_t pdma_out;
-int32_t pdma_channel;
-uint64_t pdma_mmap(int total_size/*total num of all outputs*/){
-	
-	char cdev[256] = "/dev/udmabuf-ddr-c0";
-	uint64_t ddrc_phyadr = get_phy_addr(cdev);  
-	int32_t fdc = open(cdev, O_RDWR); 
-	off_t oft = 0;
-	pdma_mmap_t = (int8_t *)mmap(NULL, total_size*sizeof(int8_t), PROT_READ | PROT_WRITE,  MAP_SHARED, fdc, oft);
-	assert(pdma_mmap_t != NULL);
-	uint64_t output_data_phys = ddrc_phyadr + oft;
-
-	return output_data_phys;
-
-}
-#endif
-static int swap_model(int model_idx) {
+// where the PDMA reaches the model buffers' physical addresses
+#define PDMA_SRC_BASE 0x3000000000
+#define PDMA_WINDOW_BYTES (32*1024*1024)
+pdma_window_t* pdma_window;
+pdma_async_t* pdma_engine;
+// copies of model outputs for postprocessing, routed by size to the PDMA or the cpu,
+// each frame's into its own slot of the window until its postprocessing is done
+pdma_copy_t output_copy;
+pdma_ring_t* output_ring;
+// the demo after model_idx, skipping the models that only run behind a detector
+static int next_demo(int model_idx) {
 	model_idx = (model_idx + 1) % (int)(sizeof(models)/sizeof(*models));
 	
 	while((!strcmp(models[model_idx].post_process_type, "ARCFACE") || !strcmp(models[model_idx].post_process_type, "GENDERAGE") || 
@@ -85,6 +81,11 @@ static int swap_model(int model_idx) {
 		
 		model_idx = (model_idx + 1) % (int)(sizeof(models)/sizeof(*models));
 	}
+	return model_idx;
+}
+
+static int swap_model(int model_idx) {
+	model_idx = next_demo(model_idx);
 	models[model_idx].is_running = 0;
 	if (!strcmp(models[model_idx].post_process_type, "ARCFACE") && (use_attribute_model == 1)) {
 		model_idx -=1;
@@ -106,6 +107,132 @@ static int swap_model(int model_idx) {
 	return model_idx;
 }
 
+// Models live in a cache in DMA memory, entry i holding models[i], so the
+// catalog can be larger than the memory; a demo pins only the models it runs.
+static vbx_cnn_cache_t *model_cache;
+
+// recognition demos run the model after the detector, and the attribute model after that
+static int demo_models(int mode, int attribute) {
+	if(!strcmp(models[mode].post_process_type, "RETINAFACE") || !strcmp(models[mode].post_process_type, "SCRFD") ||
+		!strcmp(models[mode].post_process_type, "LPD")) {
+		return attribute ? 3 : 2;
+	}
+	return 1;
+}
+
+static void release_demo(int mode, int attribute) {
+	for (int m = mode; m < mode + demo_models(mode, attribute); m++) {
+		vbx_cnn_cache_release(model_cache, m);
+	}
+}
+
+// load the next demo's models in the background while this one runs
+static void prefetch_demo(int mode, int attribute) {
+	for (int m = mode; m < mode + demo_models(mode, attribute); m++) {
+		vbx_cnn_cache_prefetch(model_cache, m);
+	}
+}
+
+// pin a demo's models, loading any that aren't resident; they may be at a new address.
+// They are queued first so the cache's loaders read them side by side.
+static int acquire_demo(int mode, int attribute) {
+	prefetch_demo(mode, attribute);
+	for (int m = mode; m < mode + demo_models(mode, attribute); m++) {
+		model_t *model = vbx_cnn_cache_acquire(model_cache, m);
+		if (!model) {
+			fprintf(stderr, "Unable to load %s into the model cache\n", models[m].fname);
+			while (--m >= mode) {
+				vbx_cnn_cache_release(model_cache, m);
+			}
+			return -1;
+		}
+		models[m].model = model;
+		if (models[m].io_info) {
+			models[m].io_info->model = model;
+		}
+	}
+	return 0;
+}
+
+// set up a demo's io buffers when it is first shown, rather than every demo at
+// start up, so the first demo runs without waiting for the others' models to load.
+// -1 if they can't be, and the demo is skipped from then on.
+static int setup_demo(vbx_cnn_t *vbx_cnn, int mode) {
+	if (models[mode].modelSetup_done) {
+		return models[mode].modelSetup_done > 0 ? 0 : -1;
+	}
+	for (int m = mode; m < mode + demo_models(mode, 0); m++) {
+		if (model_check_sanity(models[m].model) != 0) {
+			printf("Model %s is not sane\n", models[m].fname);
+		}
+	}
+	if(!strcmp(models[mode].post_process_type, "RETINAFACE") || !strcmp(models[mode].post_process_type, "SCRFD") ||
+		!strcmp(models[mode].post_process_type, "LPD")) {
+		demo_setup = recognitionDemoInit(vbx_cnn,models, mode, 0, 1080, 1920, 0, 0);
+	} else {
+		demo_setup = detectionDemoInit(vbx_cnn, models, mode);
+	}
+	for (int m = mode; m < mode + demo_models(mode, 0); m++) {
+		models[m].modelSetup_done = demo_setup < 0 ? -1 : 1;
+	}
+	if (demo_setup < 0) {
+		printf("Error setting up %s demo, skipping it\n",models[mode].name);
+		return -1;
+	}
+	return 0;
+}
+
+// pin and set up demo mode, or the next that can be, any that can't being
+// skipped; -1 if none can
+static int start_demo(vbx_cnn_t *vbx_cnn, int *mode, int attribute) {
+	int num_models = (int)(sizeof(models)/sizeof(*models));
+	for (int tries = 0; tries < num_models; tries++) {
+		if (models[*mode].modelSetup_done >= 0 && acquire_demo(*mode, attribute) == 0) {
+			if (setup_demo(vbx_cnn, *mode) == 0) {
+				return 0;
+			}
+			release_demo(*mode, attribute);
+		}
+		*mode = swap_model(*mode);
+	}
+	return -1;
+}
+
+// DMA memory setup_demo takes for a model: the table of its io buffers, two of
+// each input, at most four bytes an element, and two of each output as fix16,
+// so one frame's can be filled while the last is processed; each rounded up to
+// the arena's granule
+static size_t demo_io_bytes(const model_io_info_t *io_info, size_t granule) {
+	size_t bytes = (1 + io_info->num_outputs) * sizeof(vbx_cnn_io_ptr_t);
+	bytes = (bytes + granule - 1) / granule * granule;
+	for (int i = 0; i < io_info->num_inputs; i++) {
+		bytes += 2 * ((io_info->inputs[i].length * sizeof(uint32_t) + granule - 1) / granule * granule);
+	}
+	for (int o = 0; o < io_info->num_outputs; o++) {
+		bytes += 2 * ((io_info->outputs[o].length * sizeof(fix16_t) + granule - 1) / granule * granule);
+	}
+	return bytes;
+}
+
+// models[i]'s io descriptors, from the bundle or its file, without loading it
+static model_io_info_t *peek_io_info(vbx_cnn_bundle_t *bundle, int i) {
+	int entry = bundle ? vbx_cnn_bundle_find(bundle, models[i].name) : -1;
+	if (entry >= 0) {
+		return vbx_cnn_model_peek_io_info_fd(bundle->fd, bundle->entries[entry].model_offset,
+				bundle->entries[entry].model_bytes);
+	}
+	model_io_info_t *io_info = NULL;
+	struct stat st;
+	int fd = open(models[i].fname, O_RDONLY);
+	if (fd >= 0 && fstat(fd, &st) == 0) {
+		io_info = vbx_cnn_model_peek_io_info_fd(fd, 0, st.st_size);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	return io_info;
+}
+
 void *read_ascii_file(vbx_cnn_t *vbx_cnn, const char *filename) {
 	FILE *fd = fopen(filename, "r");
 	if (fd == NULL) {
@@ -120,7 +247,7 @@ void *read_ascii_file(vbx_cnn_t *vbx_cnn, const char *filename) {
 		fprintf(stderr, "Error reading full file %s\n", filename);
 		return NULL;
 	}
-	void *dma_ascii = vbx_allocate_dma_buffer(vbx_cnn, file_size, 0);
+	void *dma_ascii = vbx_allocate_dma_buffer_flags(vbx_cnn, file_size, 0, 0);
 	if (dma_ascii) {
 		memcpy(dma_ascii, ascii, file_size);
 	}
@@ -131,41 +258,6 @@ void *read_ascii_file(vbx_cnn_t *vbx_cnn, const char *filename) {
 
 
 
-model_t *read_model_file(vbx_cnn_t *vbx_cnn, const char *filename) {
-	FILE *model_file = fopen(filename, "r");
-	if (model_file == NULL) {
-		return NULL;
-	}
-	fseek(model_file, 0, SEEK_END);
-	int file_size = ftell(model_file);
-	fseek(model_file, 0, SEEK_SET);
-	model_t *model = (model_t *)malloc(file_size);
-	int size_read = fread(model, 1, file_size, model_file);
-	if (size_read != file_size) {
-		fprintf(stderr, "Error reading full model file %s\n", filename);
-		return NULL;
-	}
-	int model_data_size = model_get_data_bytes(model);
-	if (model_data_size != file_size) {
-		fprintf(stderr, "Error model file is not correct size%s\n", filename);
-		return NULL;
-	}
-	
-	int model_allocate_size = model_get_allocate_bytes(model);
-	total_fsize += model_allocate_size;
-	if(total_fsize > UIO_DMA_LIMIT){ //hardcoded for now, will update
-		printf("%s exceeds max model allocate size limit by %d MB\nExiting...\n",filename,(total_fsize-UIO_DMA_LIMIT)/(1024*1024));
-		exit(1);
-	}
-	model = (model_t *)realloc(model, model_allocate_size);
-	model_t *dma_model =
-		(model_t *)vbx_allocate_dma_buffer(vbx_cnn, model_allocate_size, 0);
-	if (dma_model) {
-		memcpy(dma_model, model, model_data_size);
-	}
-	free(model);
-	return dma_model;
-}
 
 
 int gettimediff_us(struct timeval start, struct timeval end) {
@@ -280,7 +372,68 @@ uint32_t* swap_draw_frame(){
 
 
 int main(int argc, char **argv) {
-	
+	uint64_t boot_ns = vbx_cnn_wait_time_ns();
+	vbx_cnn_t *vbx_cnn = vbx_cnn_init(NULL);
+    if (!vbx_cnn) {
+        fprintf(stderr, "Unable to initialize vbx_cnn. Exiting\n");
+        exit(1);
+    }
+	printf("vbx_cnn_init took %3.4f ms\n", vbx_cnn->init_us / 1000.0);
+
+	void *ascii_characters = read_ascii_file(vbx_cnn, "./frameDrawing/ascii_characters.bin");
+    if (!ascii_characters) {
+        fprintf(stderr, "Unable to correctly read %s. Exiting\n", "./ascii_characters.bin");
+        exit(1);
+    }
+	ascii_characters_base_address = virt_to_phys(vbx_cnn,(void*)ascii_characters);
+
+	// ./run-video-model MODELS.vbxb reads the models named in models[] from one bundle,
+	// with the postprocess types packed alongside them, instead of a file each
+	vbx_cnn_bundle_t *bundle = NULL;
+	if (argc > 1) {
+		bundle = vbx_cnn_bundle_open(argv[1]);
+		if (!bundle) {
+			fprintf(stderr, "Unable to read model bundle %s. Exiting\n", argv[1]);
+			exit(1);
+		}
+	}
+
+	//Setup Models, in a slice of DMA memory that need not hold them all, leaving
+	//out what every demo's io buffers will take; the descriptors read for that
+	//are kept, and pointed at each model once it is loaded
+	size_t io_reserve = MODEL_CACHE_HEADROOM_MB << 20;
+	for (int i = 0; i < (int)(sizeof(models)/sizeof(*models)); i++) {
+		models[i].io_info = peek_io_info(bundle, i);
+		if (models[i].io_info) {
+			io_reserve += demo_io_bytes(models[i].io_info, vbx_cnn->dma_arena->granule);
+		}
+	}
+	vbx_dma_arena_stats_t dma_stats;
+	vbx_dma_arena_get_stats(vbx_cnn->dma_arena, &dma_stats);
+	size_t cache_bytes = dma_stats.largest_free > io_reserve ? dma_stats.largest_free - io_reserve : 0;
+	vbx_cnn_ctx_t *cache_slice = vbx_cnn_ctx_init(vbx_cnn, cache_bytes, "model cache");
+	model_cache = cache_slice ? vbx_cnn_cache_init(cache_slice->dma_arena) : NULL;
+	if (!model_cache) {
+		fprintf(stderr, "Unable to set up a %d MB model cache (%d MB of DMA memory free). Exiting\n",
+				(int)(cache_bytes/(1024*1024)), (int)(dma_stats.free/(1024*1024)));
+		exit(1);
+	}
+	// a model loaded where an evicted one was mustn't inherit its run time estimate
+	vbx_cnn_cache_add_wait(model_cache, recognitionDemoWait(vbx_cnn));
+	for (int i = 0; i < (int)(sizeof(models)/sizeof(*models)); i++) {
+		int entry = bundle ? vbx_cnn_bundle_find(bundle, models[i].name) : -1;
+		if (entry < 0) {
+			vbx_cnn_cache_add(model_cache, models[i].fname);
+			continue;
+		}
+		models[i].post_process_type = bundle->entries[entry].post_process;
+		vbx_cnn_cache_add_fd(model_cache, bundle->fd, bundle->entries[entry].model_offset, bundle->entries[entry].model_bytes);
+	}
+	printf("DMA memory: %d MB for models, %d MB for buffers\n",
+		   (int)(cache_bytes/(1024*1024)), (int)(io_reserve/(1024*1024)));
+	// the first demo's models load on the cache's loader threads while the
+	// display is set up; the next demo's are queued once they are in
+	prefetch_demo(0, 0);
 
 	volatile uint32_t* frame_reg = (volatile uint32_t*)uio_mmap_from_addr((void*)FRAME_BASE);
 	volatile uint32_t* scale_reg = (volatile uint32_t*)uio_mmap_from_addr((void*)SCALE_BASE);
@@ -336,19 +489,6 @@ int main(int argc, char **argv) {
 	*MIN_LATENCY_SEL_ADDR  = 0;
 	overlay_draw_frame 	   = (uint32_t*)(intptr_t)(*OVERLAY_DRAW_ADDR);
 	
-	vbx_cnn_t *vbx_cnn = vbx_cnn_init(NULL);
-    if (!vbx_cnn) {
-        fprintf(stderr, "Unable to initialize vbx_cnn. Exiting\n");
-        exit(1);
-    }
-
-	void *ascii_characters = read_ascii_file(vbx_cnn, "./frameDrawing/ascii_characters.bin");
-    if (!ascii_characters) {
-        fprintf(stderr, "Unable to correctly read %s. Exiting\n", "./ascii_characters.bin");
-        exit(1);
-    }
-	ascii_characters_base_address = virt_to_phys(vbx_cnn,(void*)ascii_characters);
-
     int fd = fileno(stdin);
     int flags = fcntl(fd, F_GETFL, 0);
     if (fcntl(fd, F_SETFL, flags|O_NONBLOCK) != 0) {
@@ -357,44 +497,21 @@ int main(int argc, char **argv) {
     }
     
 	char input_buf[128]="";
-#if PDMA	
-	int total_size = 32*1024*1024; //#TODO Check limit size in comparison
-	
-
-	pdma_out = pdma_mmap(total_size);	
-	pdma_channel = pdma_ch_open();
-#endif
-	//Setup Models
-	for (int i = 0; i < (int)(sizeof(models)/sizeof(*models)); i++) {
-		model_t *model = read_model_file(vbx_cnn, models[i].fname);
-		if (!model) {
-			fprintf(stderr, "Unable to correctly read %s. Exiting\n", models[i].fname);
-			exit(1);
-		}
-
-		if (model_check_sanity(model) != 0) {
-			printf("Model %s is not sane\n", models[i].fname);
-		}
-		models[i].model = model;
-		models[i].modelSetup_done = 1;
-	}
-	
-	//Initialize models	
-	for(int i = 0; i < (int)(sizeof(models)/sizeof(*models));i++){
-		if(!strcmp(models[i].post_process_type, "RETINAFACE") || !strcmp(models[i].post_process_type, "SCRFD")) {
-			demo_setup = recognitionDemoInit(vbx_cnn,models, i, 0, 1080, 1920, 0, 0);
-			i+=1;
-		} else if(!strcmp(models[i].post_process_type, "LPD")) {
-			demo_setup = recognitionDemoInit(vbx_cnn,models, i, 0, 1080, 1920, 0, 0);
-			i+=1;
+	// without the staging window postprocessing reads the model buffers in place
+	pdma_window = pdma_window_open("/dev/udmabuf-ddr-c0", PDMA_WINDOW_BYTES, PDMA_SRC_BASE + vbx_cnn->dma_phys_trans_offset);
+	pdma_engine = pdma_window ? pdma_async_open() : NULL;
+	pdma_copy_init(&output_copy, pdma_engine, pdma_window);
+	output_ring = pdma_window ? pdma_ring_init(pdma_window->size) : NULL;
+	void *copy_sample = pdma_engine ? vbx_allocate_dma_buffer(vbx_cnn, PDMA_COPY_CALIBRATE_MAX, 0) : NULL;
+	if (copy_sample) {
+		pdma_copy_calibrate(&output_copy, PDMA_SOURCE_DMA, pdma_copy_timed_cost, copy_sample);
+		vbx_free_dma_buffer(vbx_cnn, copy_sample);
+		if (output_copy.threshold[PDMA_SOURCE_DMA] == SIZE_MAX) {
+			printf("Output copies are faster on the cpu at every size\n");
 		} else {
-			demo_setup = detectionDemoInit(vbx_cnn, models,i);
-		}
-		if (demo_setup < 0) {
-			printf("Error setting up %s demo\n",models[i].name);
+			printf("Output copies of %zu bytes or more go to the PDMA\n", output_copy.threshold[PDMA_SOURCE_DMA]);
 		}
 	}
-  
     int mode = 0;
 	int name_input = 0;
 	int embedding_modify = 0;
@@ -404,6 +521,11 @@ int main(int argc, char **argv) {
 	int x_offset = 0;
 	int y_offset = 0;
 
+	if (start_demo(vbx_cnn, &mode, use_attribute_model) != 0) {
+		fprintf(stderr, "Unable to set up any demo. Exiting\n");
+		exit(1);
+	}
+	prefetch_demo(next_demo(mode), use_attribute_model);
 	input_dims = model_get_input_shape(models[mode].model, 0);
 
 	int img_h = input_dims[2];
@@ -428,10 +550,19 @@ int main(int argc, char **argv) {
 	
 	static struct timeval tv1, tv2,prev_timestamp;
 	gettimeofday(&prev_timestamp, NULL); 
-	printf("Starting Demo\n");
+	int consecutive_resets = 0;
+	// VBX_CNN_TRACE=trace.json records each frame's stages for chrome://tracing or ui.perfetto.dev
+	const char* trace_file = getenv("VBX_CNN_TRACE");
+	unsigned traced_frames = 0;
+	if (trace_file && vbx_cnn_trace_open(trace_file, 0) == 0) {
+		vbx_cnn_trace_thread_name("video pipeline");
+		printf("Tracing to %s\n", trace_file);
+	}
+	printf("Starting Demo, %.1f ms after start up\n", (vbx_cnn_wait_time_ns() - boot_ns) / 1e6);
     while(1) {
 		gettimeofday(&tv1, NULL);
 		int status = 1;
+		vbx_cnn_trace_begin("frame");
 		while(status > 0) {
 			if (privacy)
 				if (!strcmp(models[mode].post_process_type, "POSENET") || !strcmp(models[mode].post_process_type, "ULTRALYTICS_POSE")){ //blank screen
@@ -444,14 +575,27 @@ int main(int argc, char **argv) {
 				status = runDetectionDemo(models, vbx_cnn, mode);
 			}			
 		}
+		vbx_cnn_trace_end("frame");
+		if (++traced_frames % 64 == 0) {
+			vbx_cnn_trace_flush();
+		}
 		
 		if (status < 0) {
 			printf("Error running mode %d\n", mode);
 			printf("control_reg = %x\n", vbx_cnn->ctrl_reg[0]);
 			printf("error code: %d",vbx_cnn_get_error_val(vbx_cnn));
 			printf("state = %d\n", vbx_cnn_get_state(vbx_cnn));
-			while(1);
+			// drop the frame and carry on from a reset core; a timeout has already reset it
+			if ((status != VBX_CNN_TIMED_OUT && vbx_cnn_reset(vbx_cnn) != 0) ||
+					++consecutive_resets > MAX_CONSECUTIVE_RESETS) {
+				printf("Unable to recover the core, %u resets\n", vbx_cnn->resets);
+				break;
+			}
+			printf("Core reset (%u so far), dropping the frame\n", vbx_cnn->resets);
+			models[mode].is_running = 0;
+			continue;
 		}
+		consecutive_resets = 0;
 		if (gettimediff_us(prev_timestamp,tv1) > 1500*1000/CLASSIFIER_FPS){
 			update_Classifier = 1;
 			gettimeofday(&prev_timestamp, NULL);
@@ -462,6 +606,7 @@ int main(int argc, char **argv) {
 
 		gettimeofday(&tv2, NULL);
 		fps = 1000/ (gettimediff_us(tv1, tv2) / 1000);
+		vbx_cnn_trace_counter("fps", fps);
 		loop_draw_frame = swap_draw_frame();
 		overlay_draw_frame = (uint32_t*)(intptr_t)(*OVERLAY_DRAW_ADDR);
 		
@@ -515,8 +660,19 @@ int main(int argc, char **argv) {
 				add_embedding_mode =1;
 				printf("Enter 'a' to add the highlighted face\n");
 			} else { //swap models and display  to UART 
-				while(vbx_cnn_model_poll(vbx_cnn) > 0);
+				uint64_t deadline_ns = vbx_cnn_wait_time_ns() + MODEL_TIMEOUT_US*1000ull;
+				while(vbx_cnn_model_poll(vbx_cnn) > 0) {
+					if (vbx_cnn_wait_time_ns() > deadline_ns) {
+						vbx_cnn_reset(vbx_cnn);
+						break;
+					}
+				}
+				release_demo(mode, use_attribute_model);
 				mode = swap_model(mode);
+				if (start_demo(vbx_cnn, &mode, use_attribute_model) != 0) {
+					break;
+				}
+				prefetch_demo(next_demo(mode), use_attribute_model);
 				input_dims = model_get_input_shape(models[mode].model, 0);
 				int img_h = input_dims[2];
 				int img_w = input_dims[3];
@@ -538,6 +694,13 @@ int main(int argc, char **argv) {
 			}
 		}
 	}
+	vbx_cnn_cache_stats_t cache_stats;
+	vbx_cnn_cache_get_stats(model_cache, &cache_stats);
+	printf("Model cache: %u hits, %u misses, %u evictions, %u prefetched, %.1f ms waiting for models\n",
+		   cache_stats.hits, cache_stats.misses, cache_stats.evictions, cache_stats.prefetches, cache_stats.stall_us / 1000.0);
+	if (trace_file) {
+		vbx_cnn_trace_close();
+	}
 
     return 0;
 }